@@ -99,6 +99,15 @@ public:
 
     static void clearCache();
 
+    /** Time spent parsing one model's source file in prefetch() \sa Scene::LoadOptions::prefetchModels */
+    class PrefetchTiming {
+    public:
+        String      filename;
+
+        /** Seconds on a worker thread, or zero if the file format cannot be parsed ahead */
+        RealTime    parseTime = 0.0;
+    };
+
     /** Parameters for cleanGeometry(). Note that HAIR format models are never cleaned on load, as an optimization, because 
         they are always generated cleanly. */
     class CleanGeometrySettings {
@@ -1268,8 +1277,23 @@ protected:
 
 #   ifdef USE_ASSIMP
     void loadASSIMP(const Specification& specification);
+
+    /** \copydoc prefetchOBJ */
+    static shared_ptr<void> prefetchASSIMP(const Specification& specification);
+
+    /** \copydoc prefetchOBJTextures */
+    static void prefetchASSIMPTextures(const Specification& specification, const shared_ptr<void>& parsed);
 #   endif
 
+    /** Parses the OBJ file for a later loadOBJ() and returns the ParseOBJ. Threadsafe. \sa prefetch */
+    static shared_ptr<void> prefetchOBJ(const Specification& specification);
+
+    /** Starts decoding the textures of the materials in \a parsed. Call on the OpenGL thread. \sa prefetch */
+    static void prefetchOBJTextures(const Specification& specification, const shared_ptr<void>& parsed);
+
+    /** Removes and returns the source file that prefetch() parsed for \a specification, or nullptr */
+    static shared_ptr<void> takePrefetched(const Specification& specification);
+
     void load(const Specification& specification);
 
     ArticulatedModel() : m_nextID(1) {}
@@ -1316,6 +1340,10 @@ public:
      const Model::Pose*             prevPose,
      const Surface::ExpressiveLightScatteringProperties& e) override;
 
+    /** True once the geometry is on the GPU, unless the model is skinned.
+        Skinned models upload bone textures during pose(). */
+    virtual bool canPoseConcurrently() const override;
+
     /** Saves an OBJ with the given filename of this ArticulatedModel 
         materials currently only work if loaded from an OBJ*/
     void saveOBJ(const String& filename);
@@ -1372,6 +1400,23 @@ public:
     /** \sa G3D::Scene::registerModelSubclass */
     static lazy_ptr<Model> lazyCreate(const String& name, const Any& any);
 
+    /** 
+      Parses the source files of \a specificationArray concurrently on worker threads, and then
+      starts decoding the textures that their materials reference, so that later calls to create()
+      for the same specifications skip parsing and do not wait on one texture file at a time.
+      
+      OBJ and ASSIMP formats (e.g., FBX) are parsed ahead. Other formats, and specifications that
+      are already in the cache, are skipped. The Scene invokes this before instantiating entities.
+
+      Must be called on the OpenGL thread, because texture creation is not threadsafe. Parsed files
+      that are not consumed by create() are kept until clearPrefetched().
+
+      \param timingArray Receives one entry per file that was parsed ahead */
+    static void prefetch(const Array<Specification>& specificationArray, Array<PrefetchTiming>& timingArray);
+
+    /** Releases parsed source files that prefetch() stored and create() has not consumed */
+    static void clearPrefetched();
+
     /** From a model filename (e.g., .obj, .fbx) */
     static shared_ptr<ArticulatedModel> fromFile(const String& filename) {
         Specification s;
@@ -154,6 +154,21 @@ public:
          const unorm8*       src,
          const BumpMapPreprocess& preprocess = BumpMapPreprocess());
 
+    /**
+     Computes the normal map as above into \a mipArray[0], followed by a MIP chain
+     down to 1 x 1. Each level averages 2 x 2 blocks of the previous level and
+     renormalizes the averaged normals, so that lower levels remain unit length
+     instead of shrinking toward the surface as a box filter of the packed colors would.
+     The alpha (bump) channel is averaged.
+     */
+    static void computeNormalMap
+        (int                 width,
+         int                 height,
+         int                 channels,
+         const unorm8*       src,
+         Array<shared_ptr<PixelTransferBuffer>>& mipArray,
+         const BumpMapPreprocess& preprocess = BumpMapPreprocess());
+
     /** 
       \param signConvention Set the sign convention based on the coordinate system of your
        source normal map and texture coordinates. It will be fairly
@@ -0,0 +1,218 @@
+/**
+  \file G3D-app.lib/include/G3D-app/CollisionWorld.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_CollisionWorld_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/AABox.h"
+#include "G3D-base/Box.h"
+#include "G3D-base/Sphere.h"
+#include "G3D-base/Capsule.h"
+#include "G3D-base/Triangle.h"
+
+namespace G3D {
+
+class TriTree;
+
+/**
+  \brief Finds the overlapping pairs among many moving spheres, boxes, and
+  capsules and static TriTree meshes, and moves spheres through them as
+  character controllers.
+
+  The caller moves a body by setting its new world-space geometry each step.
+  getCollidingPairs() then runs two phases:
+
+  - The broadphase is sweep-and-prune over the bodies' bounding boxes along
+    the axis on which their centers vary the most. The sweep order persists
+    between calls, so for coherent motion re-sorting takes linear time.
+    Candidate pairs are generated concurrently in blocks of the sweep order,
+    comparing each body against four following bodies at a time with SIMD.
+
+  - The narrowphase tests the candidates with CollisionDetection, using its
+    SIMD batch tests for the common sphere-sphere and sphere-box pairs.
+    A body overlapping a mesh is tested against the triangles that the
+    TriTree returns for the body's bounds.
+
+  slideSphere() replaces the hand-written per-triangle loops that games
+  otherwise use for character movement.
+
+  Methods must be called from a single thread; they use multiple threads internally.
+
+  \code
+  CollisionWorld world;
+  world.addMesh(staticSceneTriTree);
+  const CollisionWorld::BodyID ball = world.addSphere(Sphere(Point3(0, 5, 0), 0.5f));
+  ...
+  world.setSphere(ball, Sphere(newCenter, 0.5f));
+  Array<CollisionWorld::Pair> pairArray;
+  world.getCollidingPairs(pairArray);
+  \endcode
+
+  \sa CollisionDetection, TriTree
+*/
+class CollisionWorld {
+public:
+
+    enum BodyType {SPHERE, BOX, CAPSULE, MESH};
+
+    /** Identifies a body from the add method until remove() */
+    typedef int BodyID;
+
+    enum {NONE = -1};
+
+    class Pair {
+    public:
+        /** a < b */
+        BodyID      a;
+        BodyID      b;
+
+        Pair() : a(NONE), b(NONE) {}
+        Pair(BodyID x, BodyID y) : a(min(x, y)), b(max(x, y)) {}
+
+        bool operator==(const Pair& other) const {
+            return (a == other.a) && (b == other.b);
+        }
+
+        bool operator<(const Pair& other) const {
+            return (a < other.a) || ((a == other.a) && (b < other.b));
+        }
+
+        bool operator>(const Pair& other) const {
+            return other < *this;
+        }
+    };
+
+protected:
+
+    class Body {
+    public:
+        BodyType                type = SPHERE;
+
+        /** False for free slots */
+        bool                    inUse = false;
+
+        /** The geometry for type */
+        Sphere                  sphere;
+        Box                     box;
+        Capsule                 capsule;
+        shared_ptr<TriTree>     mesh;
+
+        /** World-space bounds of the geometry */
+        AABox                   bounds;
+
+        void updateBounds();
+    };
+
+    Array<Body>                 m_bodyArray;
+
+    /** Slots in m_bodyArray available for reuse */
+    Array<BodyID>               m_freeList;
+
+    /** Bodies in order of the lower bound on m_sweepAxis. Persists between
+        calls so that sorting is fast for coherent motion. */
+    Array<BodyID>               m_sweepOrder;
+
+    /** Bounds of m_sweepOrder[i] in structure-of-arrays form, padded so that
+        SIMD loads past the end are safe. Rebuilt by updateSweep(). */
+    Array<float>                m_sweepLow[3];
+    Array<float>                m_sweepHigh[3];
+
+    int                         m_sweepAxis = 0;
+
+    /** True if bodies were added or removed since the last updateSweep() */
+    bool                        m_sweepOrderChanged = false;
+
+    /** False if any body changed since the last updateSweep() */
+    bool                        m_sweepCurrent = false;
+
+    BodyID allocateBody(BodyType type);
+
+    const Body& body(BodyID id) const {
+        debugAssertM((id >= 0) && (id < m_bodyArray.size()) && m_bodyArray[id].inUse, "Invalid BodyID");
+        return m_bodyArray[id];
+    }
+
+    Body& body(BodyID id) {
+        debugAssertM((id >= 0) && (id < m_bodyArray.size()) && m_bodyArray[id].inUse, "Invalid BodyID");
+        return m_bodyArray[id];
+    }
+
+    /** Chooses the sweep axis, re-sorts m_sweepOrder, and rebuilds the bound arrays */
+    void updateSweep();
+
+    /** Exact overlap test for one pair. Mesh-mesh pairs never overlap. */
+    static bool intersects(const Body& a, const Body& b);
+
+    /** Triangles of \a mesh whose bounds overlap \a box, in world space */
+    static void getTriangles(const TriTree& mesh, const AABox& box, Array<Triangle>& triangleArray);
+
+public:
+
+    BodyID addSphere(const Sphere& sphere);
+
+    BodyID addBox(const Box& box);
+
+    BodyID addCapsule(const Capsule& capsule);
+
+    /** Adds a static mesh. Its triangles are the TriTree's triangles in world space,
+        which must not change while the mesh is in the world. */
+    BodyID addMesh(const shared_ptr<TriTree>& mesh);
+
+    void setSphere(BodyID id, const Sphere& sphere);
+
+    void setBox(BodyID id, const Box& box);
+
+    void setCapsule(BodyID id, const Capsule& capsule);
+
+    void remove(BodyID id);
+
+    void clear();
+
+    /** Number of bodies */
+    int size() const {
+        return m_bodyArray.size() - m_freeList.size();
+    }
+
+    BodyType type(BodyID id) const {
+        return body(id).type;
+    }
+
+    const AABox& bounds(BodyID id) const {
+        return body(id).bounds;
+    }
+
+    /** Pairs of bodies whose bounding boxes overlap, in no particular order.
+        Excludes pairs of meshes. */
+    void getPotentialPairs(Array<Pair>& pairArray);
+
+    /** Pairs of bodies whose geometry overlaps, in no particular order */
+    void getCollidingPairs(Array<Pair>& pairArray);
+
+    /** Bodies whose bounding boxes overlap \a box */
+    void getBodiesIntersectingBox(const AABox& box, Array<BodyID>& bodyArray);
+
+    /**
+      Moves \a sphere by \a velocity for \a deltaTime, stopping at the first contact
+      with any body and continuing along the tangent plane for the remaining time,
+      as a character controller does.
+
+      \param ignore A body to ignore, typically the body that represents the character itself
+      \param maxIterations Bounds the number of contacts processed
+      \return The final center of the sphere
+    */
+    Point3 slideSphere
+       (const Sphere&       sphere,
+        const Vector3&      velocity,
+        float               deltaTime,
+        BodyID              ignore = NONE,
+        int                 maxIterations = 8);
+};
+
+} // namespace G3D
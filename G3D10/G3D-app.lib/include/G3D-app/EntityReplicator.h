@@ -0,0 +1,241 @@
+/**
+  \file G3D-app.lib/include/G3D-app/EntityReplicator.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_EntityReplicator_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/ReferenceCount.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/Table.h"
+#include "G3D-base/QuantizedPhysicsFrame.h"
+#include "G3D-base/network.h"
+
+namespace G3D {
+
+class Entity;
+
+/**
+  \brief Sends the frames of many Entity%s from a server to its clients in a
+  compact binary form, sending each client only what changed since the last
+  state that the client acknowledged.
+
+  Each call to send() (or snapshot()) captures the quantized frames of all
+  added entities. Entities whose Entity::lastChangeTime() precedes the
+  previous snapshot reuse their previous quantized frame without being read.
+  For each client, the message encodes the difference between the new snapshot
+  and the most recent snapshot that the client acknowledged:
+  a 4-bit header for each moved entity followed by the bit-packed deltas of the
+  axes that changed, and nothing at all for entities that did not move. An
+  entity that the client has never acknowledged is sent in full with its name.
+  A client that has acknowledged nothing recent receives the full state.
+
+  One message per client per tick carries all entities, on Specification::channel.
+  Use several replicators with different channels to send groups of entities
+  at different rates or reliability.
+
+  The client decodes messages with an EntityReplicator::Receiver and reports
+  the sequence number that receive() returns back to the server, which calls
+  acknowledge(). The transport for acknowledgements is up to the application.
+
+  \code
+  // Server
+  shared_ptr<EntityReplicator> replicator = EntityReplicator::create();
+  for (const shared_ptr<Entity>& e : entityArray) { replicator->add(e); }
+  const EntityReplicator::ClientID id = replicator->addClient(connection);
+  ...
+  replicator->send();   // Each tick
+
+  // Client
+  shared_ptr<EntityReplicator::Receiver> receiver = EntityReplicator::Receiver::create();
+  for (const shared_ptr<Entity>& e : entityArray) { receiver->add(e); }
+  ...
+  const uint32 sequence = receiver->receive(message.binaryInput());
+  \endcode
+
+  \sa QuantizedPhysicsFrame, NetSendConnection
+*/
+class EntityReplicator : public ReferenceCountedObject {
+public:
+
+    typedef int ClientID;
+
+    class Specification {
+    public:
+        QuantizedPhysicsFrame::Format   format;
+
+        /** Type of the messages sent by send() */
+        NetMessageType                  messageType = 1;
+
+        NetChannel                      channel = 0;
+
+        /** Number of past snapshots kept as baselines. A client whose acknowledged
+            snapshot is older receives the full state. */
+        int                             historyLength = 32;
+
+        Specification() {}
+    };
+
+    class Receiver;
+
+protected:
+
+    class Record {
+    public:
+        /** Assigned by add(). Increases with the order in which entities were added. */
+        uint32                  id;
+        QuantizedPhysicsFrame   frame;
+    };
+
+    class Snapshot {
+    public:
+        uint32                  sequence = 0;
+
+        /** System::time() when the snapshot was begun */
+        RealTime                time = 0;
+
+        /** Sorted by id */
+        Array<Record>           recordArray;
+    };
+
+    class Tracked {
+    public:
+        uint32                  id;
+        shared_ptr<Entity>      entity;
+    };
+
+    class Client {
+    public:
+        bool                    inUse = false;
+
+        /** May be null if the application transmits encode() itself */
+        shared_ptr<NetSendConnection> connection;
+
+        /** Most recent snapshot that the client acknowledged, or 0 */
+        uint32                  acknowledged = 0;
+    };
+
+    enum RecordType {UPDATE, SPAWN, REMOVE};
+
+    Specification               m_specification;
+
+    /** Sorted by id */
+    Array<Tracked>              m_trackedArray;
+
+    /** Names of the entities in the current snapshot and ones added since */
+    Table<uint32, String>       m_nameTable;
+
+    /** Entities removed since the last snapshot, whose names are needed until then */
+    Array<uint32>               m_removedArray;
+
+    uint32                      m_nextID = 1;
+
+    /** Oldest first. The last is the current snapshot. */
+    Array<shared_ptr<Snapshot>> m_history;
+
+    Array<Client>               m_clientArray;
+
+    /** Reused by send() */
+    BinaryOutput                m_message;
+
+    EntityReplicator(const Specification& specification);
+
+    /** The snapshot with this sequence number, or null if it is not in the history */
+    shared_ptr<Snapshot> findSnapshot(uint32 sequence) const;
+
+public:
+
+    static shared_ptr<EntityReplicator> create(const Specification& specification = Specification());
+
+    const Specification& specification() const {
+        return m_specification;
+    }
+
+    /** Begins replicating \a entity, starting from the next snapshot */
+    void add(const shared_ptr<Entity>& entity);
+
+    /** Stops replicating \a entity. Clients remove it on the next message. */
+    void remove(const shared_ptr<Entity>& entity);
+
+    /** \param connection If not null, send() sends this client's messages over it */
+    ClientID addClient(const shared_ptr<NetSendConnection>& connection = nullptr);
+
+    void removeClient(ClientID client);
+
+    /** Called when \a client reports that it received the message with this sequence number.
+        Later messages to the client encode only the changes since that snapshot. */
+    void acknowledge(ClientID client, uint32 sequence);
+
+    /** Captures the current frames of all entities and returns the sequence number of the snapshot */
+    uint32 snapshot();
+
+    /** Sequence number of the most recent snapshot, or 0 if there is none */
+    uint32 sequence() const {
+        return (m_history.size() > 0) ? m_history.last()->sequence : 0;
+    }
+
+    /** Writes the message for \a client that brings it from its acknowledged snapshot
+        to the most recent one. Requires at least one snapshot(). */
+    void encode(ClientID client, BinaryOutput& message) const;
+
+    /** Invokes snapshot() and then sends encode() to every client that has a connection */
+    void send();
+
+    /** \brief Decodes messages from an EntityReplicator and applies them to local entities. */
+    class Receiver : public ReferenceCountedObject {
+    protected:
+
+        QuantizedPhysicsFrame::Format       m_format;
+
+        /** Received snapshots that the server might use as baselines. Oldest first. */
+        Array<shared_ptr<Snapshot>>         m_history;
+
+        Table<uint32, String>               m_nameTable;
+        Table<String, uint32>               m_idTable;
+
+        /** Local entities by name */
+        Table<String, shared_ptr<Entity>>   m_entityTable;
+
+        Receiver(const QuantizedPhysicsFrame::Format& format) : m_format(format) {}
+
+        void apply(uint32 id, const QuantizedPhysicsFrame& frame);
+
+    public:
+
+        /** \a format must match the server's Specification::format */
+        static shared_ptr<Receiver> create(const QuantizedPhysicsFrame::Format& format = QuantizedPhysicsFrame::Format());
+
+        /** Frames received for the entity with the same name are applied to \a entity */
+        void add(const shared_ptr<Entity>& entity);
+
+        void remove(const shared_ptr<Entity>& entity);
+
+        /** Decodes \a message, produced by EntityReplicator::encode, and applies the new
+            frames to the local entities.
+
+            \return The sequence number to acknowledge to the server, or 0 if the message
+            was out of date or its baseline is unknown. */
+        uint32 receive(BinaryInput& message);
+
+        /** Sequence number of the most recent message received, or 0 */
+        uint32 sequence() const {
+            return (m_history.size() > 0) ? m_history.last()->sequence : 0;
+        }
+
+        /** The most recently received frame of the named entity.
+            Returns false if the server has not sent it, or has removed it. */
+        bool getFrame(const String& entityName, PhysicsFrame& frame) const;
+
+        /** Number of entities in the most recently received snapshot */
+        int size() const {
+            return (m_history.size() > 0) ? m_history.last()->recordArray.size() : 0;
+        }
+    };
+};
+
+} // namespace G3D
@@ -0,0 +1,133 @@
+/**
+  \file G3D-app.lib/include/G3D-app/FramePipeline.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_app_FramePipeline_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/ReferenceCount.h"
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace G3D {
+
+class Surface;
+class Surface2D;
+
+/**
+  \brief Double-buffered posed surfaces and a persistent worker thread that
+  produces the next frame while the caller consumes the current one.
+
+  The caller launch()es a job that fills back() on the worker, uses front()
+  meanwhile, and then wait()s for the job and swap()s the buffers. front()
+  is never written while a job is running, so it is an immutable snapshot for
+  rendering. back() may only be touched by the job, or by the caller when
+  busy() is false.
+
+  GApp uses this to overlap simulation of frame N + 1 with rendering of frame N
+  when GApp::Settings::Pipeline::enabled is true. It does not depend on
+  a GPU, so the scheduling can be benchmarked with synthetic surfaces.
+
+  \sa GApp::Settings::Pipeline, GApp::onePipelinedFrame
+*/
+class FramePipeline : public ReferenceCountedObject {
+public:
+
+    /** The output of one pose */
+    class Frame {
+    public:
+        Array<shared_ptr<Surface> >     posed3D;
+        Array<shared_ptr<Surface2D> >   posed2D;
+
+        void fastClear() {
+            posed3D.fastClear();
+            posed2D.fastClear();
+        }
+    };
+
+    /** Runs on the worker thread. The argument is back(). */
+    typedef std::function<void (Frame&)> Job;
+
+protected:
+
+    Frame                       m_frame[2];
+    int                         m_front;
+
+    std::thread                 m_thread;
+
+    /** Protects the members below */
+    mutable std::mutex          m_mutex;
+    std::condition_variable     m_condition;
+
+    Job                         m_job;
+    bool                        m_busy;
+    bool                        m_quit;
+
+    /** Thrown by the most recent job, rethrown by wait() */
+    std::exception_ptr          m_exception;
+
+    /** Seconds that the most recent job took on the worker */
+    RealTime                    m_jobTime;
+
+    FramePipeline();
+
+    void threadMain();
+
+public:
+
+    static shared_ptr<FramePipeline> create();
+
+    /** Waits for any running job and then joins the worker */
+    virtual ~FramePipeline();
+
+    /** Starts \a job on the worker, first waiting for the previous one if it is still running.
+        \a job must not touch front(). */
+    void launch(const Job& job);
+
+    /** Blocks until the current job, if any, completes. Rethrows any exception that it threw. */
+    void wait();
+
+    /** True between launch() and the completion of the job */
+    bool busy() const;
+
+    /** Exchanges front() and back(), and then clears the new back(). Waits for any running job first. */
+    void swap();
+
+    /** The most recently completed frame */
+    const Frame& front() const {
+        return m_frame[m_front];
+    }
+
+    /** Non-const so that it can be passed to GApp::onGraphics. The caller may reorder,
+        but should not otherwise modify, the arrays. */
+    Frame& front() {
+        return m_frame[m_front];
+    }
+
+    /** The frame being produced. Only access from the caller's thread when busy() is false. */
+    Frame& back() {
+        return m_frame[1 - m_front];
+    }
+
+    /** Waits for any running job and then clears both frames, e.g., when the Scene is reloaded */
+    void clear();
+
+    /** Seconds of worker time used by the most recently completed job */
+    RealTime jobTime() const;
+
+    /** True when called from within a job */
+    bool isWorkerThread() const {
+        return std::this_thread::get_id() == m_thread.get_id();
+    }
+};
+
+} // namespace G3D
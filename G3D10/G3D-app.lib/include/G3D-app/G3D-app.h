@@ -14,6 +14,7 @@
 #include "G3D-app/Camera.h"
 #include "G3D-app/Surfel.h"
 #include "G3D-app/TriTree.h"
+#include "G3D-app/CollisionWorld.h"
 #include "G3D-app/TriTreeBase.h"
 #include "G3D-app/NativeTriTree.h"
 #include "G3D-app/EmbreeTriTree.h"
@@ -23,8 +24,10 @@
 #include "G3D-app/FirstPersonManipulator.h"
 #include "G3D-app/Draw.h"
 #include "G3D-app/Light.h"
+#include "G3D-app/LightTree.h"
 #include "G3D-app/GApp.h"
 #include "G3D-app/Surface.h"
+#include "G3D-app/SurfaceCuller.h"
 #include "G3D-app/MD2Model.h"
 #include "G3D-app/MD3Model.h"
 #include "G3D-app/DepthOfFieldSettings.h"
@@ -104,6 +107,7 @@
 #include "G3D-app/SkyboxSurface.h"
 #include "G3D-app/VisibleEntity.h"
 #include "G3D-app/MarkerEntity.h"
+#include "G3D-app/EntityReplicator.h"
 #include "G3D-app/VisualizeCameraSurface.h"
 #include "G3D-app/VisualizeLightSurface.h"
 #include "G3D-app/SVO.h"
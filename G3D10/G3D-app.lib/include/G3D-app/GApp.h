@@ -28,6 +28,7 @@
 #include "G3D-app/GBuffer.h"
 #include "G3D-app/debugDraw.h"
 #include "G3D-app/ArticulatedModelSpecificationEditorDialog.h"
+#include "G3D-app/FramePipeline.h"
 #include <mutex>
 
 namespace G3D {
@@ -81,6 +82,13 @@ class XRWidget;
  onWait runs before onGraphics because the beginning of onGraphics causes the CPU to block, waiting for the GPU
  to complete the previous frame.
 
+ Dedicated servers can set GApp::Settings::Headless::enabled to run without a window or GPU. The main loop
+ then invokes only onAI, onNetwork, and onSimulation, on a fixed timestep (see GApp::oneHeadlessFrame
+ and GApp::headlessStats).
+
+ CPU-bound programs can set GApp::Settings::Pipeline::enabled to simulate the next frame on a worker
+ thread while the main thread renders the current one (see GApp::onePipelinedFrame).
+
  When you override a method, invoke the GApp version of that method to ensure that Widget%s still work
  properly.  This allows you to control whether your per-app operations occur before or after the Widget ones.
 
@@ -362,6 +370,52 @@ public:
                 depthOfFieldSettings.setEnabled(false);
             }
         } vr;
+
+        /** For dedicated servers and other programs that need only AI, networking, and simulation. */
+        class Headless {
+        public:
+
+            /** When true, GApp never creates an OSWindow, RenderDevice, developer tools, or
+                other GPU state, and run() repeatedly invokes oneHeadlessFrame() instead of oneFrame().
+                onUserInput(), onPose(), onGraphics(), and onWait() are never called.
+                Simulation advances on a fixed timestep of frameDuration() seconds.
+                Defaults to false. */
+            bool                enabled;
+
+            /** When simulation falls behind schedule, up to this many steps run back to back
+                to catch up. If it is further behind than that, the missed steps are dropped
+                and the schedule restarts from the current time. Defaults to 5. */
+            int                 maxCatchUpSteps;
+
+            /** The scheduler sleeps until this many seconds before each step is due and
+                then yields the processor until it is, trading a little CPU time for precise
+                timing. Set to 0 to only sleep. Defaults to 0.0005. */
+            RealTime            spinTime;
+
+            Headless() : enabled(false), maxCatchUpSteps(5), spinTime(0.0005) {}
+        } headless;
+
+        /** Overlaps simulation of the next frame with rendering of the current one. */
+        class Pipeline {
+        public:
+
+            /** When true, onAI() and onSimulation() for frame N + 1 run on a worker thread
+                while onGraphics() renders the surfaces that were posed for frame N, at the
+                cost of one frame of latency. User input, networking, Widget%s, and rendering
+                stay on the main thread. See onePipelinedFrame() for what
+                onSimulation() may touch. Not supported by VRApp or Headless mode.
+                Defaults to false. */
+            bool                enabled;
+
+            /** When true, onPose() also runs on the worker thread. Only enable this if no
+                Entity or Model in the Scene makes OpenGL calls while posing (e.g., skinned
+                ArticulatedModel%s upload their vertices when posed), because the OpenGL
+                context is only current on the main thread. Defaults to false. */
+            bool                poseOnWorkerThread;
+
+            Pipeline() : enabled(false), poseOnWorkerThread(false) {}
+        } pipeline;
+
         /** Also invokes initGLG3D() */
         Settings();
 
@@ -371,6 +425,36 @@ public:
         virtual ~Settings() {}
     };
 
+    /** Scheduling statistics for GApp::Settings::Headless mode, e.g., for deciding how
+        many server instances fit on one machine. The time of the most recent step in
+        each phase is in logicWatch(), networkWatch(), simulationWatch(), and waitWatch(). */
+    class HeadlessStats {
+    public:
+        /** Simulation steps run */
+        int64                   stepCount;
+
+        /** Steps that ran late, back to back with the previous one, to catch up */
+        int64                   catchUpStepCount;
+
+        /** Steps skipped because simulation fell more than
+            GApp::Settings::Headless::maxCatchUpSteps behind */
+        int64                   droppedStepCount;
+
+        /** Total seconds spent in onAI(), onNetwork(), and onSimulation() */
+        RealTime                busyTime;
+
+        /** Total seconds spent waiting for the next step */
+        RealTime                idleTime;
+
+        HeadlessStats() : stepCount(0), catchUpStepCount(0), droppedStepCount(0), busyTime(0), idleTime(0) {}
+
+        /** Fraction of wall-clock time spent working, on [0, 1]. This is
+            approximately the fraction of one core that the program needs. */
+        float utilization() const {
+            return (busyTime + idleTime > 0) ? float(busyTime / (busyTime + idleTime)) : 0.0f;
+        }
+    };
+
     class DebugShape {
     public:
         shared_ptr<Shape>   shape;
@@ -493,6 +577,11 @@ protected:
 
     std::mutex                      m_debugTextMutex;
 
+    /** In GApp::Settings::Pipeline mode, screenPrintf output for the next frame
+        accumulates here and replaces debugText at the end of the frame.
+        Protected by m_debugTextMutex. */
+    Array<String>                   m_pipelineDebugText;
+
     /** Used by the default onGraphics3D to render Surface%s. */
     shared_ptr<Renderer>            m_renderer;
 
@@ -559,6 +648,31 @@ protected:
     /** Used to track how much onWait overshot its desired target during the previous frame. */
     RealTime                        m_lastFrameOverWait;
 
+    /** Wall-clock time at which the next headless simulation step is due */
+    RealTime                        m_nextHeadlessStepTime;
+
+    /** Running estimate of how much System::sleep overshoots in headless mode */
+    RealTime                        m_headlessOverSleep;
+
+    HeadlessStats                   m_headlessStats;
+
+    /** Double-buffered posed surfaces and the simulation thread in
+        GApp::Settings::Pipeline mode. nullptr otherwise. Created by beginRun(). */
+    shared_ptr<FramePipeline>       m_framePipeline;
+
+    /** Times of the most recent job on the m_framePipeline thread. Copied into
+        m_logicWatch, m_simulationWatch, and m_poseWatch when the job completes. */
+    Stopwatch                       m_pipelineLogicWatch;
+    Stopwatch                       m_pipelineSimulationWatch;
+    Stopwatch                       m_pipelinePoseWatch;
+
+    /** Snapshots taken when the surfaces being rendered in GApp::Settings::Pipeline
+        mode were posed. \sa renderCamera(), renderLightingEnvironment() */
+    shared_ptr<Camera>              m_renderCamera;
+    LightingEnvironment             m_renderLightingEnvironment;
+    Array<DebugShape>               m_renderDebugShapeArray;
+    Array<DebugLabel>               m_renderDebugLabelArray;
+
     /** Default/current AO object for the primary view, allocated in GApp::GApp.*/
     shared_ptr<class AmbientOcclusion> m_ambientOcclusion;
 
@@ -728,6 +842,20 @@ public:
         return m_activeCamera;
     }
 
+    /** The camera that onGraphics() renders from. This is activeCamera(), except in
+        GApp::Settings::Pipeline mode, where it is a copy of activeCamera() taken when
+        the surfaces being rendered were posed. */
+    const shared_ptr<Camera>& renderCamera() const {
+        return pipelined() ? m_renderCamera : activeCamera();
+    }
+
+    /** The lights that onGraphics() renders with. Like renderCamera(), this is a copy
+        in GApp::Settings::Pipeline mode, since onSimulation() may move the Scene's lights
+        while the previous frame renders. */
+    LightingEnvironment& renderLightingEnvironment() {
+        return pipelined() ? m_renderLightingEnvironment : scene()->lightingEnvironment();
+    }
+
     /** Exposes the debugging camera */
     virtual const shared_ptr<Camera>& debugCamera() const {
         return m_debugCamera;
@@ -802,6 +930,20 @@ public:
         return m_simulationWatch;
     }
 
+    const HeadlessStats& headlessStats() const {
+        return m_headlessStats;
+    }
+
+    /** True if running in GApp::Settings::Headless mode */
+    bool headless() const {
+        return m_settings.headless.enabled;
+    }
+
+    /** True if running in GApp::Settings::Pipeline mode */
+    bool pipelined() const {
+        return m_settings.pipeline.enabled && ! m_settings.headless.enabled;
+    }
+
     /** Initialized to GApp::Settings::dataDir, or if that is "<AUTO>",
         to  FilePath::parent(System::currentProgramFilename()). To make your program
         distributable, override the default
@@ -936,7 +1078,7 @@ public:
 
        \param createWindowOnNull Create the window or renderDevice if they are nullptr.
        Setting createWindowOnNull = false allows a subclass to explicitly decide when to invoke
-       those calls.
+       those calls. Ignored in GApp::Settings::Headless mode.
     */
     GApp(const Settings& options = Settings(), OSWindow* window = nullptr, RenderDevice* rd = nullptr, bool createWindowOnNull = true);
 
@@ -944,6 +1086,10 @@ public:
         a constructor, but allows subclasses to perform their own pre-OpenGL steps. */
     void initializeOpenGL(RenderDevice* rd, OSWindow* window, bool createWindowIfNull, const Settings& settings);
 
+    /** Called from GApp constructor instead of initializeOpenGL in GApp::Settings::Headless mode.
+        Creates the widget manager, debug camera, and active camera marker, but no OpenGL state. */
+    void initializeHeadless();
+
     virtual ~GApp();
 
     /**
@@ -999,6 +1145,8 @@ protected:
     /** Used by onSimulation for elapsed time. */
     RealTime               m_now, m_lastTime;
 
+    /** Surfaces posed for the current frame. In GApp::Settings::Pipeline mode these
+        are unused and m_framePipeline double buffers them instead. */
     Array<shared_ptr<Surface> >   m_posed3D;
     Array<shared_ptr<Surface2D> > m_posed2D;
 
@@ -1023,6 +1171,66 @@ protected:
     */
     virtual void oneFrame();
 
+    /**
+        Used instead of oneFrame() in GApp::Settings::Headless mode. Sleeps until the
+        next simulation step is due and then runs onAI(), onNetwork(), and onSimulation()
+        for it, repeating to catch up if the program has fallen behind schedule.
+    */
+    virtual void oneHeadlessFrame();
+
+    /** Sleeps until System::time() reaches \a deadline, yielding for the final
+        GApp::Settings::Headless::spinTime seconds. */
+    void sleepUntil(RealTime deadline);
+
+    /**
+        Used instead of oneFrame() in GApp::Settings::Pipeline mode. On the main thread,
+        processes user input and networking and runs Widget::onAI() and Widget::onSimulation().
+        It then launches onAI() and onSimulation() for the next frame (and onPose(), if
+        GApp::Settings::Pipeline::poseOnWorkerThread) on the m_framePipeline thread, and
+        meanwhile waits and invokes onGraphics() on the surfaces posed during the previous frame.
+        Once both complete, it poses the new frame, snapshots renderCamera(),
+        renderLightingEnvironment(), and the debug shapes, and swaps the buffers.
+
+        Because onSimulation() runs concurrently with onGraphics(), subclasses must not
+        change state in onSimulation() that their onGraphics() reads, other than through
+        the posed surfaces and the snapshots above. GApp's own onAI(), onSimulation(), and
+        onPose() skip the WidgetManager on the worker, since Widget%s run on the main thread.
+        Profiler events from the worker appear as a separate thread.
+    */
+    virtual void onePipelinedFrame();
+
+    /** Computes the real, simulation, and ideal time steps for a frame
+        that began \a timeStep seconds after the previous one */
+    void computeSimulationTimeSteps(RealTime timeStep, RealTime& rdt, SimTime& sdt, SimTime& idt) const;
+
+    /** The part of the default onSimulation() that moves Widget%s, the debug camera, and the active camera marker */
+    void simulateWidgetsAndDebugCamera(RealTime rdt, SimTime sdt, SimTime idt);
+
+    /** Records the step that just completed, advancing realTime() and simTime() */
+    void advanceTime(RealTime rdt, SimTime sdt);
+
+    /** Replaces the contents of \a posed3D and \a posed2D by invoking onPose() */
+    void poseFrame(Array<shared_ptr<Surface> >& posed3D, Array<shared_ptr<Surface2D> >& posed2D);
+
+    /** Sleeps until the next frame is due, learning how much onWait() overshoots */
+    void waitForNextFrame();
+
+    /** Invokes onGraphics() between RenderDevice::beginFrame() and RenderDevice::endFrame(),
+        swapping the buffers according to submitToDisplayMode() */
+    void renderFrame(Array<shared_ptr<Surface> >& posed3D, Array<shared_ptr<Surface2D> >& posed2D);
+
+    /** Copies the state that onGraphics() reads besides the posed surfaces in GApp::Settings::Pipeline mode.
+        \sa renderCamera(), renderLightingEnvironment() */
+    void snapshotForRendering();
+
+    /** True when called from the m_framePipeline thread */
+    bool onPipelineThread() const {
+        return notNull(m_framePipeline) && m_framePipeline->isWorkerThread();
+    }
+
+    /** Removes debug shapes, labels, and text that have expired at the end of a frame */
+    void removeExpiredDebugOutput();
+
     virtual void sampleGazeTrackerData();
 
 public:
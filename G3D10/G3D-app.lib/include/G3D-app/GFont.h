@@ -10,9 +10,11 @@
 #ifndef G3D_GFont_h
 #define G3D_GFont_h
 
+#include <mutex>
 #include "G3D-base/G3DString.h"
 #include "G3D-base/BinaryInput.h"
 #include "G3D-base/CoordinateFrame.h"
+#include "G3D-base/Table.h"
 #include "G3D-gfx/Texture.h"
 
 namespace G3D {
@@ -33,6 +35,11 @@ namespace G3D {
  files and rules for distribution. 
 
  You can make new fonts with the GFont::makeFont static function.
+
+ GFont caches the layout of recently drawn strings, so redrawing the same
+ text at the same size, wrap width, and alignment only copies the glyph
+ quads, whatever its position and color. Layouts that are not drawn for a
+ while are discarded.
  */
 class GFont : public ReferenceCountedObject {
 public:
@@ -96,10 +103,91 @@ private:
         Array<CPUCharVertex>& vertexArray,
         Array<int>&         indexArray) const;
 
+    /** Glyph quads of a string laid out at the origin */
+    class Layout {
+    public:
+        class Vertex {
+        public:
+            Vector2         texCoord;
+            Point2          position;
+        };
+
+        String              text;
+        float               size;
+        float               wrapWidth;
+        XAlign              xalign;
+        YAlign              yalign;
+        Spacing             spacing;
+
+        /** Four per glyph */
+        Array<Vertex>       vertexArray;
+
+        Vector2             bounds;
+    };
+
+    /** Maximum number of entries plus glyphs in each generation of the layout cache */
+    enum {MAX_LAYOUT_CACHE_SIZE = 64 * 1024};
+
+    /** Layouts by the hash of their parameters, in two generations. A null layout
+        marks a string that has been seen only once. When the current generation
+        reaches MAX_LAYOUT_CACHE_SIZE, the previous one is discarded and the current
+        one becomes the previous one. Layouts found in the previous generation move back
+        to the current one, so text drawn every frame stays cached. */
+    mutable Table<uint64, shared_ptr<Layout>> m_layoutCache[2];
+
+    /** Index of the current generation in m_layoutCache */
+    mutable int             m_layoutGeneration = 0;
+
+    /** Entries plus glyphs in the current generation */
+    mutable int             m_layoutCacheSize = 0;
+
+    /** Protects the layout cache, so that text can be measured on any thread */
+    mutable std::mutex      m_layoutMutex;
+
     GFont(const String& filename, BinaryInput& b);
 
     float m_textureMatrix[16];
 
+    /** Returns the cached layout for these parameters, laying out the string if necessary.
+        Returns null the first time that a string is seen. */
+    shared_ptr<Layout> layout(const String& s, float size, float wrapWidth, XAlign xalign, YAlign yalign, Spacing spacing) const;
+
+    /** Appends the quads of \a layout translated by \a pos2D */
+    static Vector2 appendLayout
+       (const Layout&               layout,
+        const Point2&               pos2D,
+        const Color4&               color,
+        const Color4&               outline,
+        Array<CPUCharVertex>&       cpuCharArray,
+        Array<int>&                 indexArray);
+
+    /** Lays out \a s without the cache */
+    Vector2 layOut
+       (Array<CPUCharVertex>&       cpuCharArray,
+        Array<int>&                 indexArray,
+        const String&               s,
+        const Point2&               pos2D,
+        float                       size,
+        const Color4&               color,
+        const Color4&               outline,
+        XAlign                      xalign,
+        YAlign                      yalign,
+        Spacing                     spacing) const;
+
+    /** Lays out \a s with word wrapping, without the cache */
+    Vector2 layOutWordWrap
+       (Array<CPUCharVertex>&       cpuCharArray,
+        Array<int>&                 indexArray,
+        float                       wrapWidth,
+        const String&               s,
+        const Point2&               pos2D,
+        float                       size,
+        const Color4&               color,
+        const Color4&               outline,
+        XAlign                      xalign,
+        YAlign                      yalign,
+        Spacing                     spacing) const;
+
 public:
     
     inline String name() const {
@@ -358,6 +446,8 @@ public:
        \endcode
 
        This amortizes the cost of the font setup across multiple calls.
+       Strings that were appended recently with the same size, wrap width,
+       spacing, and alignment reuse their cached layout.
      */
     void renderCharVertexArray(RenderDevice* rd, const Array<CPUCharVertex>& cpuCharArray, Array<int>& indexArray) const;
 
@@ -0,0 +1,155 @@
+/**
+  \file G3D-app.lib/include/G3D-app/LightTree.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_LightTree_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/AABox.h"
+#include "G3D-base/Vector3.h"
+
+namespace G3D {
+
+/**
+  \brief Bounding volume hierarchy over light emitters. It chooses one emitter
+  to sample at a shading point in O(log n) time.
+
+  Each node bounds the positions, emission directions, and total power of the
+  emitters below it. sample() descends from the root, choosing each child in
+  proportion to a conservative estimate of its contribution at the shading point.
+  Emitters that are far away, face away, or lie edge-on to the surface are
+  therefore rarely chosen. The returned probability is exact, so dividing a
+  sample's contribution by it gives an unbiased estimate.
+
+  The emitters may be Light%s or emissive triangles. LightTree only sees their
+  bounds and power, and the caller maps emitter indices back to its own data.
+  Infinite (directional) emitters are kept outside the hierarchy and are chosen
+  at the root.
+
+  \cite Conty Estevez and Kulla, Importance Sampling of Many Lights with Adaptive Tree Splitting, HPG 2018
+
+  \sa PathTracer
+*/
+class LightTree {
+public:
+
+    class Emitter {
+    public:
+        /** World-space bounds of the emitting surface. Ignored for infinite emitters. */
+        AABox       bounds;
+
+        /** Center of the cone of emission directions. For an infinite emitter, the unit
+            direction from the scene towards the emitter. */
+        Vector3     axis = Vector3::unitZ();
+
+        /** Half-angle in radians of the cone about axis that contains all surface normals, on [0, pi] */
+        float       thetaO = pif();
+
+        /** Angle in radians beyond thetaO over which emission falls to zero.
+            pi/2 for a Lambertian emitter. */
+        float       thetaE = float(halfPi());
+
+        /** Emitted power scaled so that the biradiance at distance d along the axis
+            is at most power / (4 pi d^2). For an infinite emitter, 4 pi times its
+            biradiance. Emitters with zero power are never sampled. */
+        float       power = 0.0f;
+
+        bool        infinite = false;
+
+        bool operator==(const Emitter& other) const {
+            return (bounds == other.bounds) && (axis == other.axis) && (thetaO == other.thetaO) &&
+                (thetaE == other.thetaE) && (power == other.power) && (infinite == other.infinite);
+        }
+
+        bool operator!=(const Emitter& other) const {
+            return ! (*this == other);
+        }
+    };
+
+protected:
+
+    /** Bounds of all emitters below this node */
+    class Node : public Emitter {
+    public:
+        /** Cached for importance() */
+        float       cosThetaO = -1.0f;
+        float       sinThetaO = 0.0f;
+
+        /** cos(thetaE), or -1 if thetaO + thetaE covers the sphere */
+        float       cosThetaE = -1.0f;
+
+        /** For an interior node, the index of the second child. The first child
+            immediately follows the node. For a leaf, -1 - the emitter index. */
+        int         child = -1;
+
+        void set(const Emitter& emitter);
+    };
+
+    Array<Emitter>  m_emitterArray;
+
+    /** Depth-first order. Node 0 is the root. */
+    Array<Node>     m_node;
+
+    /** Parent of each node, or -1 for the root */
+    Array<int>      m_parent;
+
+    /** Leaf node of each emitter, or -1 if it is infinite or has no power */
+    Array<int>      m_leaf;
+
+    /** Indices of the infinite emitters with nonzero power */
+    Array<int>      m_infinite;
+
+    /** Builds the subtree for index[start...stopBefore - 1] and returns its root */
+    int buildNode(Array<int>& index, int start, int stopBefore, int parent);
+
+    /** Sum of the root importance of the hierarchy and all infinite emitters */
+    float totalImportance(const Point3& X, const Vector3& n, float& treeImportance) const;
+
+    static float importance(const Node& node, const Point3& X, const Vector3& n);
+
+    /** Probability of descending to the first child of interior node \a i */
+    float firstChildProbability(int i, const Point3& X, const Vector3& n) const;
+
+public:
+
+    /** Replaces the emitters and rebuilds the hierarchy in O(n log n) time */
+    void setEmitters(const Array<Emitter>& emitterArray);
+
+    void clear();
+
+    /** Number of emitters, including any with zero power */
+    int size() const {
+        return m_emitterArray.size();
+    }
+
+    const Array<Emitter>& emitterArray() const {
+        return m_emitterArray;
+    }
+
+    /** Chooses an emitter for the shading point \a X with normal \a n. Pass a NaN normal to
+        ignore the cosine at the receiver (e.g., for volumes).
+
+        \param u Uniform random number on [0, 1). A single number is enough because
+        it is rescaled at each level of the tree.
+
+        \param pdfValue Probability with which the returned emitter was chosen.
+
+        \return The index of the emitter in emitterArray(), or -1 if no emitter can
+        contribute at \a X. */
+    int sample(const Point3& X, const Vector3& n, float u, float& pdfValue) const;
+
+    /** Probability with which sample() chooses \a emitterIndex at \a X */
+    float pdf(int emitterIndex, const Point3& X, const Vector3& n) const;
+
+    /** Conservative estimate of the biradiance that \a emitter (or node) can deliver to \a X,
+        scaled by the cosine at the receiver. Zero only when the emitter cannot contribute. */
+    static float importance(const Emitter& emitter, const Point3& X, const Vector3& n);
+};
+
+} // namespace G3D
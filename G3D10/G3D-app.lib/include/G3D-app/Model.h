@@ -120,6 +120,13 @@ public:
      const Model::Pose*             prevPose,
      const Surface::ExpressiveLightScatteringProperties& e) = 0;
 
+    /** True if pose() may currently run on a thread without the OpenGL context, concurrently with
+        pose() on <i>other</i> Model%s. Scene::onPose uses this to re-pose moving Entity%s in parallel;
+        calls on the same Model are always serialized. Default: false */
+    virtual bool canPoseConcurrently() const {
+        return false;
+    }
+
     /**
         Determines if the ray intersects the heightfield and
         fills the \a info with the proper information.
@@ -14,6 +14,7 @@
 #include "G3D-base/Array.h"
 #include "G3D-base/Ray.h"
 #include "G3D-app/TriTree.h"
+#include "G3D-app/LightTree.h"
 
 namespace G3D {
 
@@ -22,6 +23,7 @@ class Light;
 class Surfel;
 class Image;
 class Scene;
+class CubeMapSampler;
 
 class PathTracer : public ReferenceCountedObject {
 public:
@@ -67,6 +69,22 @@ public:
             */
         float       areaLightDirectFraction = 0.7f;
 
+        /** If true, emissive triangles (e.g., glowing panels modeled as geometry) are sampled
+            by direct illumination like area lights, instead of only being found by indirect rays.
+            areaLightDirectFraction applies to them as well. */
+        bool        sampleEmissiveTriangles = true;
+
+        /** Scenes with more direct lights than this choose the light to sample at each
+            shading point from a LightTree in O(log n) time, instead of evaluating every
+            light. The LightTree is also used whenever emissive triangles are sampled. */
+        int         maxLightsForExhaustiveSampling = 12;
+
+        /** If true and the Scene has a skybox, direct illumination also chooses directions
+            towards the bright parts of the skybox with a CubeMapSampler. This is combined with
+            the skybox radiance found by indirect rays by multiple importance sampling, so that
+            a small, bright sun converges quickly without adding noise on glossy surfaces. */
+        bool        sampleEnvironment = true;
+
         G3D_DECLARE_ENUM_CLASS(LightSamplingMethod,
             UNIFORM_AREA,
             STRATIFIED_AREA,
@@ -118,6 +136,11 @@ protected:
             do not contribute to indirect light unless the previous event was an impulse. This
             avoids double-counting the lights. */
         Array<bool>                             impulseRay;
+
+        /** Multiple importance sampling weight applied to skybox radiance if the ray misses,
+            based on the probability with which direct illumination could have chosen the same
+            direction. 1 for primary rays, impulses, and when the environment is not sampled. */
+        Array<float>                            skyWeight;
     
         /** Location in the output buffer to write the final radiance to.*/
         Array<int>                              outputIndex;
@@ -138,6 +161,7 @@ protected:
             shadowRay.resize(n);
             lightShadowed.resize(n);
             impulseRay.resize(n);
+            skyWeight.resize(n);
         }
 
         /** Removes element \a i from all arrays, including either outputIndex or outputCoord. */
@@ -149,6 +173,7 @@ protected:
             shadowRay.fastRemove(i);
             lightShadowed.fastRemove(i);
             impulseRay.fastRemove(i);
+            skyWeight.fastRemove(i);
 
             if (outputIndex.size() > 0) {
                 outputIndex.fastRemove(i);
@@ -170,6 +195,30 @@ protected:
 
     static const Ray                            s_degenerateRay;
 
+    /** Direct light sources for importanceSampleLightTree(): the direct Light%s followed
+        by the emissive triangles. Empty when every light is evaluated at each shading point. */
+    mutable LightTree                           m_lightTree;
+
+    /** Sorted indices into m_triTree of emissive triangles, which follow the Light%s in m_lightTree
+        when m_sampleEmissiveTriangles is true */
+    mutable Array<int>                          m_emissiveTriIndex;
+
+    /** Emitter for each element of m_emissiveTriIndex */
+    mutable Array<LightTree::Emitter>           m_emissiveTriEmitter;
+
+    /** TriTree::lastBuildTime() when m_emissiveTriIndex was computed */
+    mutable RealTime                            m_emissiveTriBuildTime = -inf();
+
+    mutable bool                                m_sampleEmissiveTriangles = false;
+
+    /** Importance sampling of m_skybox for direct illumination. Rebuilt when m_skybox changes, and
+        shared by all threads. nullptr if Options::sampleEnvironment is false or there is no skybox. */
+    mutable shared_ptr<CubeMapSampler>          m_environmentSampler;
+
+    /** Probability that direct illumination samples m_environmentSampler instead of the lights.
+        Zero when the environment is not sampled. */
+    mutable float                               m_environmentSampleProbability = 0.0f;
+
     PathTracer(const shared_ptr<TriTree>& t = nullptr);
 
     Radiance3 skyRadiance(const Vector3& direction) const;
@@ -215,13 +264,14 @@ protected:
        (const Array<Ray>&                       rayFromEye,
         const Array<shared_ptr<Surfel>>&        surfelBuffer, 
         const Array<bool>&                      impulseRay,
+        const Array<float>&                     skyWeight,
         const Array<Color3>&                    modulationBuffer,
         Radiance3*                              outputBuffer,
         const Array<int>                        outputCoordBuffer,
         const shared_ptr<Image>&                radianceImage,
         const Array<PixelCoord>&                pixelCoordBuffer) const;
 
-    /** Choose what light surface to sample, storing the corresponding shadow ray and biradiance value */
+    /** Choose what light surface (or skybox direction) to sample, storing the corresponding shadow ray and biradiance value */
     void computeDirectIllumination
        (const Array<shared_ptr<Surfel>>&        surfelBuffer,
         const Array<shared_ptr<Light>>&         lightArray,
@@ -269,6 +319,26 @@ protected:
         Color3&                                 cosBSDFDivPDF,
         Point3&                                 lightPosition) const;
 
+    /** Called by importanceSampleLight() when m_lightTree is not empty. Chooses one Light or
+        emissive triangle in O(log n) time and divides by the probability of choosing it.
+        Returns nullptr for an emissive triangle. */
+    const shared_ptr<Light>& importanceSampleLightTree
+       (const Array<shared_ptr<Light>>&         lightArray,
+        const Vector3&                          w_o,
+        const shared_ptr<Surfel>&               surfel,
+        int                                     sequenceIndex,
+        int                                     rayIndex,
+        int                                     raysPerPixel,
+        Biradiance3&                            biradiance,
+        Color3&                                 cosBSDFDivPDF,
+        Point3&                                 lightPosition) const;
+
+    /** Finds the emissive triangles in m_triTree for m_lightTree */
+    void findEmissiveTriangles() const;
+
+    /** True if emission from triangle \a triIndex in m_triTree is already sampled by direct illumination */
+    bool isSampledEmissiveTriangle(int triIndex) const;
+
     /** Compute the next bounce direction by mutating rayBuffer, and then multiply the modulationBuffer by
         the inverse probability density that the direction was taken. Those probabilities are computed across
         three color channels, so modulationBuffer can become "colored" by this. */
@@ -280,7 +350,8 @@ protected:
         int                                     raysPerPixel,
         Array<Ray>&                             rayBuffer,
         Array<Color3>&                          modulationBuffer,
-        Array<bool>&                            impulseScatterBuffer) const;
+        Array<bool>&                            impulseScatterBuffer,
+        Array<float>&                           skyWeightBuffer) const;
 
     void prepare
        (const Options&                          options, 
@@ -26,6 +26,7 @@ class Light;
 class Camera;
 class Model;
 class Skybox;
+class VisibleEntity;
 class SceneVisualizationSettings;
 class CubeMap;
 
@@ -80,7 +81,12 @@ public:
         /** Remove VisibleEntitys for which canChange = false. Default = false */
         bool        stripDynamicVisibleEntitys;
 
-        LoadOptions() : stripStaticVisibleEntitys(false), stripDynamicVisibleEntitys(false) {}
+        /** Parse the ArticulatedModel files concurrently and start decoding their textures
+            before instantiating entities. The per-file timing is written to the log.
+            Default = true \sa ArticulatedModel::prefetch */
+        bool        prefetchModels;
+
+        LoadOptions() : stripStaticVisibleEntitys(false), stripDynamicVisibleEntitys(false), prefetchModels(true) {}
     };
 
     /** \sa registerEntityType */
@@ -128,6 +134,14 @@ protected:
 
     Array< shared_ptr<Camera> >         m_cameraArray;
 
+    /** The VisibleEntity subset of m_entityArray, in no particular order. Used by onPose to find the
+        Entity%s to re-pose concurrently without casting every Entity every frame. */
+    Array< shared_ptr<VisibleEntity> >  m_visibleEntityArray;
+
+    /** Scratch space for onPose: VisibleEntity%s that need re-posing, grouped by Model */
+    Array<VisibleEntity*>               m_poseQueue;
+    Array<int>                          m_poseGroupStart;
+
     shared_ptr<Skybox>                  m_skybox;
 
     RealTime                            m_lastStructuralChangeTime;
@@ -163,6 +177,10 @@ protected:
     /** If m_needEntitySort, sort Entitys to resolve dependencies and set m_needEntitySort = false. Called fromOnSimulation */
     void sortEntitiesByDependency();
 
+    /** Invokes ArticulatedModel::prefetch on the ArticulatedModel specifications in m_modelsAny and logs
+        the timing. Called from load() before the entities resolve their models. */
+    void prefetchModels();
+
 public:
 
     const VRSettings& vrSettings() const {
@@ -325,6 +343,9 @@ public:
     */
     Any toAny(const bool forceAll = false) const;
 
+    /** Appends the surfaces of every Entity in order. VisibleEntity%s reuse their surfaces from the
+        previous frame unless they changed; those that changed and whose Model allows it are re-posed
+        concurrently first, one task per Model. \sa VisibleEntity::updatePoseCache, Model::canPoseConcurrently */
     virtual void onPose(Array<shared_ptr<Surface> >& surfaceArray);
 
     virtual void onSimulation(SimTime deltaTime);
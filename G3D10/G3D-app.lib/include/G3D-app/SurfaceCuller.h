@@ -0,0 +1,128 @@
+/**
+  \file G3D-app.lib/include/G3D-app/SurfaceCuller.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_SurfaceCuller_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/CoordinateFrame.h"
+#include "G3D-base/Projection.h"
+#include "G3D-base/Rect2D.h"
+
+namespace G3D {
+
+class Surface;
+
+/**
+  \brief Frustum culls many Surface%s against several views at once.
+
+  setSurfaces() queries the bounds of each Surface once (in parallel) and
+  stores the world-space bounding spheres and oriented boxes in
+  structure-of-arrays form. cull() then tests four surfaces at a time
+  with SIMD against every view in a single pass over that data, so culling
+  for the camera plus several shadow maps touches each Surface's virtual
+  methods only once per frame.
+
+  The tests are the same as the single-view Surface::cull: the sphere
+  against the projection's clip planes, then the box against the frustum
+  planes and the box's own face planes against the frustum vertices.
+  Output preserves the order of the input array.
+
+  \code
+  SurfaceCuller culler;
+  culler.setSurfaces(allSurfaces);
+
+  Array<SurfaceCuller::View> viewArray;
+  viewArray.append(SurfaceCuller::View(camera->frame(), camera->projection(), viewport));
+  viewArray.append(SurfaceCuller::View(lightFrame, lightProjection, shadowMapRect));
+
+  Array<Array<shared_ptr<Surface>>> visibleArray;
+  culler.cull(viewArray, visibleArray);
+  \endcode
+
+  \sa Surface::cull
+*/
+class SurfaceCuller {
+public:
+
+    class View {
+    public:
+        CFrame              frame;
+        Projection          projection;
+        Rect2D              viewport;
+
+        View() {}
+
+        View(const CFrame& frame, const Projection& projection, const Rect2D& viewport) :
+            frame(frame), projection(projection), viewport(viewport) {}
+    };
+
+protected:
+
+    /** Bits in m_flags */
+    enum {
+        /** The box is empty, so the surface is always culled */
+        EMPTY_BOX     = 1,
+
+        /** The box is not finite, so the box tests never cull */
+        INFINITE_BOX  = 2
+    };
+
+    Array<shared_ptr<Surface>>  m_surfaceArray;
+
+    /** World-space bounding spheres. All float arrays are padded to a multiple of 4. */
+    Array<float>                m_sphereX;
+    Array<float>                m_sphereY;
+    Array<float>                m_sphereZ;
+    Array<float>                m_sphereRadius;
+
+    /** World-space box centers */
+    Array<float>                m_boxX;
+    Array<float>                m_boxY;
+    Array<float>                m_boxZ;
+
+    /** m_boxAxis[3 * a + c] holds component c of the world-space box axis a,
+        scaled by the half-extent along that axis. */
+    Array<float>                m_boxAxis[9];
+
+    Array<uint8>                m_flags;
+
+    /** One bit per view for each surface, written by computeVisibility() */
+    mutable Array<uint32>       m_visibilityMask;
+
+public:
+
+    /** Maximum number of views that computeVisibility() can test in one pass.
+        cull() accepts any number of views. */
+    static const int MAX_VIEWS_PER_PASS = 32;
+
+    /** Reads the bounds of every surface in \a surfaceArray. Retains the array. */
+    void setSurfaces(const Array<shared_ptr<Surface>>& surfaceArray, bool previous = false);
+
+    int size() const {
+        return m_surfaceArray.size();
+    }
+
+    const Array<shared_ptr<Surface>>& surfaceArray() const {
+        return m_surfaceArray;
+    }
+
+    /** Sets bit v of \a visibilityMask[i] if surface i is visible in
+        \a viewArray[v]. At most MAX_VIEWS_PER_PASS views.  */
+    void computeVisibility(const Array<View>& viewArray, Array<uint32>& visibilityMask, bool singleThread = false) const;
+
+    /** Resizes \a visibleArray to the number of views and appends the
+        surfaces visible in each view to the corresponding element, preserving order. */
+    void cull(const Array<View>& viewArray, Array<Array<shared_ptr<Surface>>>& visibleArray, bool singleThread = false) const;
+
+    /** Appends the surfaces visible in \a view to \a visible, preserving order. */
+    void cull(const View& view, Array<shared_ptr<Surface>>& visible, bool singleThread = false) const;
+};
+
+} // namespace G3D
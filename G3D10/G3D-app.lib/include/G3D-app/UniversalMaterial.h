@@ -114,6 +114,11 @@ public:
 
         Specification();
 
+        /** Creates the file-backed textures that UniversalMaterial::create() will need, which starts
+            decoding them on background threads. Creating materials one at a time otherwise waits on
+            each material's textures in turn. Call on the OpenGL thread. \sa ArticulatedModel::prefetch */
+        void prefetchTextures() const;
+
         void setSampler(const Sampler& sampler) {
             m_sampler = sampler;
         }
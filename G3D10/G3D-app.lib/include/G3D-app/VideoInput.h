@@ -2,7 +2,7 @@
   \file G3D-app.lib/include/G3D-app/VideoInput.h
 
   G3D Innovation Engine http://casual-effects.com/g3d
-  Copyright 2000-2019, Morgan McGuire
+  Copyright 2000-2020, Morgan McGuire
   All rights reserved
   Available under the BSD License
 */
@@ -12,7 +12,9 @@
 #include "G3D-base/G3DString.h"
 #include "G3D-base/Rect2D.h"
 #include "G3D-base/ReferenceCount.h"
-#include "G3D-base/ThreadsafeQueue.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/MPMCQueue.h"
+#include "G3D-base/Thread.h"
 #include <future>
 
 #ifndef G3D_NO_FFMPEG
@@ -20,6 +22,7 @@
 // forward declarations for ffmpeg
 struct AVFormatContext;
 struct AVCodecContext;
+struct AVFrame;
 struct AVStream;
 struct SwsContext;
 
@@ -38,14 +41,27 @@ class Texture;
     otherwise will not copy the frame.  Use imageFormat() to create the supported
     format.
 
+    A thread decodes a few frames ahead into recycled buffers and sleeps
+    while the queue is full. Frames can also be produced in
+    ImageFormat::YUV420_PLANAR, which for most codecs only copies the decoded
+    planes instead of converting to RGB.
+
+    seek() uses an index of keyframes, taken from the container and extended
+    while decoding, and decodes forward instead of seeking when no keyframe
+    lies between the current position and the target.
+
     Use VideoPlayer to playback a video at the correct speed.
 
     \sa VideoPlayer
 */
 class VideoInput : public ReferenceCountedObject {
 public:
-    /** @return nullptr if unable to open file or video is not supported  */
-    static shared_ptr<VideoInput> fromFile(const String& filename);
+    /** \param format RGB8 or SRGB8 (the default when nullptr) converts each
+        frame to RGB. YUV420_PLANAR produces frames in the decoder's native
+        layout for 4:2:0 codecs, and converts others to it.
+
+        @return nullptr if unable to open file or video is not supported  */
+    static shared_ptr<VideoInput> fromFile(const String& filename, const ImageFormat* format = nullptr);
     ~VideoInput();
 
     int width() const;
@@ -57,9 +73,22 @@ public:
     /** @return Recommended ImageFormat for Texture or PixelTransferBuffer */
     static const ImageFormat* imageFormat();
 
-    /** @return The buffer containing the next available frame or nullptr if no available frame */
+    /** Format of the buffers returned by nextFrame(), RGB8 or YUV420_PLANAR */
+    const ImageFormat* frameFormat() const {
+        return m_frameFormat;
+    }
+
+    /** @return The buffer containing the next available frame or nullptr if no available frame.
+        Pass it to recycleFrame() when done to avoid allocating a new buffer for a later frame. */
     shared_ptr<CPUPixelTransferBuffer> nextFrame();
 
+    /** Returns a buffer from nextFrame() for reuse by the decoder */
+    void recycleFrame(const shared_ptr<CPUPixelTransferBuffer>& frame);
+
+    /** Discards queued frames so that the next frame is the one displayed at
+        \a time seconds from the start. Returns false if the container cannot seek there. */
+    bool seek(RealTime time);
+
     /** Copies the next available frame into the Texture *
         @return true if frame was available and copied, false otherwise */
     bool nextFrame(shared_ptr<Texture> frame);
@@ -69,21 +98,70 @@ public:
     bool nextFrame(shared_ptr<PixelTransferBuffer> frame);
 
 private:
+    /** Frames that the decoder may have ready before it waits */
+    enum { MAX_QUEUED_FRAMES = 4 };
+
+    class DecodedFrame {
+    public:
+        shared_ptr<CPUPixelTransferBuffer>  buffer;
+        /** Presentation timestamp in stream time_base units */
+        int64                               timestamp;
+        DecodedFrame() : timestamp(0) {}
+    };
+
     VideoInput();
 
-    bool initialize(const String& filename);
+    bool initialize(const String& filename, const ImageFormat* format);
 
     static bool decode(VideoInput* vi);
+
+    void startDecoding();
+
+    /** Joins the decoder thread. Queued frames remain in m_frames and m_unqueuedFrame. */
+    void stopDecoding();
+
+    /** Pushes \a frames, in order, into an m_frames that the decoder is not using */
+    void requeue(const Array<DecodedFrame>& frames);
+
+    /** A recycled buffer if one is available, otherwise a new one */
+    shared_ptr<CPUPixelTransferBuffer> allocateFrame();
+
+    /** Converts or copies m_avDecodingFrame into \a buffer */
+    void copyDecodedFrame(CPUPixelTransferBuffer* buffer);
+
+    /** Records a keyframe at \a timestamp, keeping m_keyframeTimestamps sorted */
+    void addKeyframe(int64 timestamp);
+
     std::future<bool>  m_thread;
     std::atomic_bool   m_quitThread;
 
-    ThreadsafeQueue<shared_ptr<CPUPixelTransferBuffer>> m_frames;
+    /** Decoded frames in presentation order. The decoder waits while this is full. */
+    MPMCQueue<DecodedFrame> m_frames;
+
+    /** A frame that did not fit in m_frames when the decoder stopped */
+    DecodedFrame        m_unqueuedFrame;
+
+    /** Buffers whose frames have been consumed */
+    MPMCQueue<shared_ptr<CPUPixelTransferBuffer>> m_recycledFrames;
+
+    const ImageFormat*  m_frameFormat;
+
+    /** Timestamps of known keyframes, sorted. Protected by m_keyframeLock. */
+    Array<int64>        m_keyframeTimestamps;
+    Spinlock            m_keyframeLock;
+
+    /** After a seek, the decoder discards frames before this timestamp */
+    int64               m_skipUntilTimestamp;
+
+    /** Timestamp of the frame that the decoder produced most recently. Only read while it is stopped. */
+    int64               m_lastDecodedTimestamp;
 
     // ffmpeg management
     AVFormatContext*    m_avFormatContext;
     AVCodecContext*     m_avCodecContext;
     AVStream*           m_avStream;
     SwsContext*         m_avResizeContext;
+    AVFrame*            m_avDecodingFrame;
 };
 
 /**
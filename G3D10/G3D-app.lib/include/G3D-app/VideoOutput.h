@@ -2,7 +2,7 @@
   \file G3D-app.lib/include/G3D-app/VideoOutput.h
 
   G3D Innovation Engine http://casual-effects.com/g3d
-  Copyright 2000-2019, Morgan McGuire
+  Copyright 2000-2020, Morgan McGuire
   All rights reserved
   Available under the BSD License
 */
@@ -13,22 +13,32 @@
 #include "G3D-base/Image.h"
 #include "G3D-base/ReferenceCount.h"
 #include "G3D-base/Table.h"
+#include "G3D-base/MPMCQueue.h"
 #include "G3D-gfx/Texture.h"
+#include <future>
+#include <memory>
 
 #ifndef G3D_NO_FFMPEG
 
 // forward declarations for ffmpeg
 struct AVCodecContext;
 struct AVDictionary;
-struct AVFilterContext;
-struct AVFilterGraph;
 struct AVFormatContext;
+struct AVFrame;
 struct AVStream;
+struct SwsContext;
 
 namespace G3D {
 
 /** 
     \brief Creates video files such as mp4/h264 from provided frames or textures. 
+
+    By default, append() only copies the frame into a pooled buffer and returns;
+    a dedicated encoder thread converts it to the codec's pixel format and
+    encodes it. When Settings::queueLength frames are already waiting, append()
+    blocks until one is encoded, or drops the frame if
+    Settings::dropFramesWhenBusy is set. commit() encodes all queued frames
+    before finishing the file.
  */
 class VideoOutput : public ReferenceCountedObject {
 public:
@@ -58,6 +68,16 @@ public:
         int bitrate;
         bool flipVertical;
 
+        /** Number of frames that append() may queue for the encoder thread.
+            Zero encodes each frame on the thread that calls append(). Default is 4. */
+        int queueLength;
+
+        /** If true, append() discards the frame instead of waiting when
+            queueLength frames are already queued. Dropped frames still
+            advance the timestamps, so the video plays at the right speed.
+            Default is false. */
+        bool dropFramesWhenBusy;
+
         Encoder encoder;
 
         void setBitrateQuality(float quality = 1.0f);
@@ -71,15 +91,54 @@ protected:
     bool initialize();
     void shutdown();
 
+    /** A copy of an appended frame, waiting for the encoder thread */
+    class PendingFrame {
+    public:
+        uint8*          data;
+        size_t          capacity;
+        size_t          rowBytes;
+        /** AVPixelFormat of data */
+        int             pixelFormat;
+        int64           pts;
+
+        PendingFrame() : data(nullptr), capacity(0), rowBytes(0), pixelFormat(0), pts(0) {}
+    };
+
     bool validSettings();
     void encodeFrame(const uint8* pixels, const ImageFormat* format);
 
+    /** Converts to m_avEncodeFrame and encodes. Called on the encoder thread when asynchronous. */
+    void encodePixels(const uint8* pixels, int pixelFormat, size_t rowBytes, int64 pts);
+
+    /** Converts \a pixels to the codec pixel format in horizontal bands, in parallel */
+    void convertPixels(const uint8* pixels, int pixelFormat, size_t rowBytes);
+
+    /** Writes all packets that the codec has finished */
+    void writeEncodedPackets();
+
+    /** Encoder thread main loop. Returns when it pops a null frame. */
+    static void encode(VideoOutput* vo);
+
+    /** Encodes (or, if \a discard, drops) all queued frames and joins the encoder thread */
+    void stopEncoderThread(bool discard);
+
     String              m_filename;
     Settings            m_settings;
 
     bool                m_isInitialized;
     bool                m_isFinished;
     int                 m_framecount;
+    int                 m_droppedFrameCount;
+
+    /** Owns all PendingFrames */
+    Array<PendingFrame*> m_framePool;
+
+    std::unique_ptr<MPMCQueue<PendingFrame*>> m_freeFrameQueue;
+
+    /** Frames to encode, in order. A null frame stops the encoder thread. */
+    std::unique_ptr<MPMCQueue<PendingFrame*>> m_pendingFrameQueue;
+
+    std::future<void>   m_encoderThread;
 
     // ffmpeg management
     AVFormatContext*    m_avFormatContext;
@@ -87,9 +146,13 @@ protected:
     AVStream*           m_avVideoStream;
     AVDictionary*       m_avOptions;
 
-    AVFilterContext*    m_avBufferSrc;
-    AVFilterContext*    m_avBufferSink;
-    AVFilterGraph*      m_avFilterGraph;
+    /** Frame in the codec pixel format, reused for every frame */
+    AVFrame*            m_avEncodeFrame;
+
+    /** One converter per horizontal band of the frame, for m_swsSourceFormat */
+    Array<SwsContext*>  m_swsContextArray;
+    Array<int>          m_swsBandStart;
+    int                 m_swsSourceFormat;
 
 public:
     /**
@@ -127,6 +190,9 @@ public:
 
     bool finished()       { return m_isFinished; }
 
+    /** Number of frames that append() discarded because of Settings::dropFramesWhenBusy */
+    int droppedFrameCount() const { return m_droppedFrameCount; }
+
 };
 
 } // namespace G3D
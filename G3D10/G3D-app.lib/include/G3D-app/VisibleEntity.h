@@ -55,6 +55,18 @@ protected:
     the Entity never returns any surfaces from onPose(). Does not necessarily mean that the underlying model is visible to primary rays.*/
     bool                            m_visible;
 
+    /** Surfaces from the most recent poseModel(), reused by onPose() while the inputs below and
+        lastChangeTime() are unchanged. Code that modifies the model or pose in place must call markChanged(). */
+    Array<shared_ptr<Surface> >     m_poseCache;
+
+    /** Inputs that produced m_poseCache */
+    shared_ptr<Model>               m_poseCacheModel;
+    shared_ptr<Model::Pose>         m_poseCachePose;
+    shared_ptr<Model::Pose>         m_poseCachePreviousPose;
+    CFrame                          m_poseCacheFrame;
+    CFrame                          m_poseCachePreviousFrame;
+    RealTime                        m_poseCacheTime;
+
     VisibleEntity();
 
     /** \sa create */
@@ -172,11 +184,24 @@ public:
     virtual void setModel(const shared_ptr<Model>& model);
     
     /** 
-     Invokes poseModel to compute the actual surfaces and then computes bounds on them when needed.
+     Invokes updatePoseCache() and appends the cached surfaces if visible().
      \sa Entity::onPose
     */
     virtual void onPose(Array<shared_ptr<Surface> >& surfaceArray) override;
 
+    /** If the cached surfaces are out of date, invokes poseModel to recompute them and then computes bounds
+        on them when needed. Scene::onPose calls this concurrently for Entity%s with different models
+        when canPoseConcurrently() is true. */
+    void updatePoseCache();
+
+    /** True if the surfaces cached by the previous updatePoseCache() are what poseModel() would produce now */
+    bool poseCacheValid() const;
+
+    /** True if poseModel() may run off of the OpenGL thread, concurrently with Entity%s that
+        have other models. Subclasses whose poseModel() is not thread safe should override this
+        to return false. */
+    virtual bool canPoseConcurrently() const;
+
     virtual void onSimulation(SimTime absoluteTime, SimTime deltaTime) override;
 
     virtual bool intersect(const Ray& R, float& maxDistance, Model::HitInfo& info = Model::HitInfo::ignore) const override;
@@ -192,6 +217,7 @@ public:
 
     void setCastsShadows(bool b) {
         m_expressiveLightScatteringProperties.castsShadows = b;
+        markChanged();
     }
 
     bool castsShadows() const {
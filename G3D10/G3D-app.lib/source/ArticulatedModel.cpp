@@ -10,7 +10,9 @@
 #include "G3D-base/Ray.h"
 #include "G3D-base/FileSystem.h"
 #include "G3D-base/Stopwatch.h"
+#include "G3D-base/Thread.h"
 #include "G3D-app/GApp.h"
+#include <mutex>
 
 namespace G3D {
 
@@ -31,8 +33,94 @@ String ArticulatedModel::resolveRelativeFilename(const String& filename, const S
 
 Table<ArticulatedModel::Specification, shared_ptr<ArticulatedModel> > s_cache;
 
+/** Source files parsed by prefetch() that load() has not yet consumed. The value is a
+    ParseOBJ or an Assimp::Importer, depending on the file format. */
+static Table<ArticulatedModel::Specification, shared_ptr<void> > s_prefetched;
+static std::mutex s_prefetchedMutex;
+
 void ArticulatedModel::clearCache() {
     s_cache.clear();
+    clearPrefetched();
+}
+
+
+void ArticulatedModel::clearPrefetched() {
+    std::lock_guard<std::mutex> guard(s_prefetchedMutex);
+    s_prefetched.clear();
+}
+
+
+shared_ptr<void> ArticulatedModel::takePrefetched(const Specification& specification) {
+    std::lock_guard<std::mutex> guard(s_prefetchedMutex);
+    Specification ignore;
+    shared_ptr<void> parsed;
+    s_prefetched.getRemove(specification, ignore, parsed);
+    return parsed;
+}
+
+
+void ArticulatedModel::prefetch(const Array<Specification>& specificationArray, Array<PrefetchTiming>& timingArray) {
+    // Unique specifications in a format that can be parsed ahead and that are not already loaded
+    Array<Specification> pending;
+    {
+        std::lock_guard<std::mutex> guard(s_prefetchedMutex);
+        for (const Specification& specification : specificationArray) {
+            const String& ext = toLower(FilePath::ext(specification.filename));
+            const bool supported = (ext == "obj")
+#               ifdef USE_ASSIMP
+                    || (ext == "dae") || (ext == "fbx") || (ext == "lwo") || (ext == "ase") || (ext == "glb") || (ext == "gltf")
+#               endif
+                ;
+            if (supported && ! (specification.cachable && s_cache.containsKey(specification)) &&
+                ! s_prefetched.containsKey(specification) && ! pending.contains(specification)) {
+                pending.append(specification);
+            }
+        }
+    }
+
+    Array<shared_ptr<void>> parsedArray;
+    parsedArray.resize(pending.size());
+    const int first = timingArray.size();
+    timingArray.resize(first + pending.size());
+
+    runConcurrently(0, pending.size(), [&](int i) {
+        const Specification& specification = pending[i];
+        const RealTime start = System::time();
+        try {
+            if (toLower(FilePath::ext(specification.filename)) == "obj") {
+                parsedArray[i] = prefetchOBJ(specification);
+            }
+#           ifdef USE_ASSIMP
+                else {
+                    parsedArray[i] = prefetchASSIMP(specification);
+                }
+#           endif
+        } catch (...) {
+            // Leave the file for load() to parse again and report the error
+            parsedArray[i] = nullptr;
+        }
+        timingArray[first + i].filename = specification.filename;
+        timingArray[first + i].parseTime = System::time() - start;
+    });
+
+    // Texture::create() reads and writes caches that are not threadsafe, so the texture
+    // decoding threads are launched from this thread once all parsing has completed
+    for (int i = 0; i < pending.size(); ++i) {
+        const shared_ptr<void>& parsed = parsedArray[i];
+        if (notNull(parsed)) {
+            if (toLower(FilePath::ext(pending[i].filename)) == "obj") {
+                prefetchOBJTextures(pending[i], parsed);
+            }
+#           ifdef USE_ASSIMP
+                else {
+                    prefetchASSIMPTextures(pending[i], parsed);
+                }
+#           endif
+
+            std::lock_guard<std::mutex> guard(s_prefetchedMutex);
+            s_prefetched.set(pending[i], parsed);
+        }
+    }
 }
 
 
@@ -673,18 +673,54 @@ public:
 };
 }
 
-void ArticulatedModel::loadASSIMP(const Specification& specification) {
-    
-    Assimp::Importer importer;
-    
-    importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
-    const aiScene* scene = importer.ReadFile(specification.filename.c_str(), 
+/** The importer owns the scene that it reads */
+static shared_ptr<Assimp::Importer> readASSIMP(const ArticulatedModel::Specification& specification) {
+    const shared_ptr<Assimp::Importer>& importer = std::make_shared<Assimp::Importer>();
+    importer->SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
+    importer->ReadFile(specification.filename.c_str(), 
         aiProcessPreset_TargetRealtime_MaxQuality
         | aiProcess_FlipUVs);
+    return importer;
+}
+
+
+shared_ptr<void> ArticulatedModel::prefetchASSIMP(const Specification& specification) {
+    const shared_ptr<Assimp::Importer>& importer = readASSIMP(specification);
+    // Leave failures for loadASSIMP() to report
+    return isNull(importer->GetScene()) ? nullptr : importer;
+}
+
+
+void ArticulatedModel::prefetchASSIMPTextures(const Specification& specification, const shared_ptr<void>& parsed) {
+    const aiScene* scene = static_pointer_cast<Assimp::Importer>(parsed)->GetScene();
+    const String& basePath = FilePath::parent(FileSystem::resolve(specification.filename));
+    for (unsigned int i = 0; i < scene->mNumMaterials; ++i) {
+        // Layered textures are combined on the GPU, so leave them to loadASSIMP()
+        const aiMaterial* mat = scene->mMaterials[i];
+        if ((mat->GetTextureCount(aiTextureType_DIFFUSE) > 1) || (mat->GetTextureCount(aiTextureType_EMISSIVE) > 1)) {
+            continue;
+        }
+
+        String materialName;
+        UniversalMaterial::Specification materialSpec;
+        Color3 transmissive;
+        toMaterialSpecification(scene->mMaterials, i, basePath, materialName, materialSpec, transmissive);
+        materialSpec.prefetchTextures();
+    }
+}
+
+
+void ArticulatedModel::loadASSIMP(const Specification& specification) {
+    
+    shared_ptr<Assimp::Importer> importer = static_pointer_cast<Assimp::Importer>(takePrefetched(specification));
+    if (isNull(importer)) {
+        importer = readASSIMP(specification);
+    }
+    const aiScene* scene = importer->GetScene();
     const String& basePath = FilePath::parent(FileSystem::resolve(specification.filename));
 
     if (isNull(scene)) {
-        String err = importer.GetErrorString();
+        String err = importer->GetErrorString();
         if (specification.filename.find(".zip", 0) != String::npos) {
             err += " The Open Asset Import Library (which we use for this model type) has trouble loading files in zip files. Try moving it out of its zip file.";
         }  
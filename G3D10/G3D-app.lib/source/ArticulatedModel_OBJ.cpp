@@ -10,6 +10,7 @@
 #include "G3D-base/ParseOBJ.h"
 #include "G3D-base/FileSystem.h"
 #include "G3D-base/Stopwatch.h"
+#include "G3D-base/Set.h"
 
 namespace G3D {
 
@@ -272,6 +273,33 @@ inline static Point2 G3DToOBJTex(const Vector2& t) {
 }
 
 
+shared_ptr<void> ArticulatedModel::prefetchOBJ(const Specification& specification) {
+    const shared_ptr<ParseOBJ>& parseData = std::make_shared<ParseOBJ>();
+    BinaryInput bi(specification.filename, G3D_LITTLE_ENDIAN);
+    parseData->parse(bi, specification.objOptions);
+    return parseData;
+}
+
+
+void ArticulatedModel::prefetchOBJTextures(const Specification& specification, const shared_ptr<void>& parsed) {
+    if (specification.stripMaterials) {
+        return;
+    }
+
+    const ParseOBJ& parseData = *static_pointer_cast<ParseOBJ>(parsed);
+    Set<shared_ptr<ParseMTL::Material>> visited;
+    for (ParseOBJ::GroupTable::Iterator groupIterator = parseData.groupTable.begin(); groupIterator.isValid(); ++groupIterator) {
+        for (ParseOBJ::MeshTable::Iterator meshIterator = groupIterator->value->meshTable.begin(); meshIterator.isValid(); ++meshIterator) {
+            const shared_ptr<ParseMTL::Material>& material = meshIterator->value->material;
+            if (! visited.contains(material)) {
+                visited.insert(material);
+                toMaterialSpecification(specification, material, specification.alphaFilter, specification.refractionHint).prefetchTextures();
+            }
+        }
+    }
+}
+
+
 const bool timeArticulatedModelLoad = false;
 
 void ArticulatedModel::loadOBJ(const Specification& specification) {
@@ -281,11 +309,18 @@ void ArticulatedModel::loadOBJ(const Specification& specification) {
     ContinuousStopwatch timer;
     timer.setEnabled(timeArticulatedModelLoad);
 
-    ParseOBJ parseData;
+    shared_ptr<ParseOBJ> parsed = static_pointer_cast<ParseOBJ>(takePrefetched(specification));
+    const bool prefetched = notNull(parsed);
+    if (! prefetched) {
+        parsed = std::make_shared<ParseOBJ>();
+    }
+    ParseOBJ& parseData = *parsed;
     {
-        BinaryInput bi(specification.filename, G3D_LITTLE_ENDIAN);
-        timer.printElapsedTime(" open file");
-        parseData.parse(bi, specification.objOptions);
+        if (! prefetched) {
+            BinaryInput bi(specification.filename, G3D_LITTLE_ENDIAN);
+            timer.printElapsedTime(" open file");
+            parseData.parse(bi, specification.objOptions);
+        }
 
         m_mtlArray = parseData.mtlArray;
         //adds a dummy entry to the end of the array so that models loaded from an OBJ without textures can be distinguished from other models
@@ -8,6 +8,7 @@
 */
 #include "G3D-base/Stopwatch.h"
 #include "G3D-base/AreaMemoryManager.h"
+#include "G3D-base/Thread.h"
 #include "G3D-app/ArticulatedModel.h"
 #include "G3D-base/FastPointHashGrid.h"
 
@@ -624,6 +625,20 @@ void ArticulatedModel::Geometry::computeMissingTangents(const Array<Mesh*> affec
  }
 
  
+namespace {
+/** Vertex index sorted by hash code, for grouping identical vertices in mergeVertices() */
+class HashedIndex {
+public:
+    size_t          hashCode;
+    int             index;
+
+    bool operator<(const HashedIndex& other) const {
+        return (hashCode < other.hashCode) || ((hashCode == other.hashCode) && (index < other.index));
+    }
+};
+} // anonymous namespace
+
+
 void ArticulatedModel::Geometry::mergeVertices(const Array<Face>& faceArray, float maxNormalWeldAngle, const Array<Mesh*> affectedMeshes) {
     // Clear all mesh index arrays
     for (int m = 0; m < affectedMeshes.size(); ++m) {
@@ -639,55 +654,80 @@ void ArticulatedModel::Geometry::mergeVertices(const Array<Face>& faceArray, flo
     cpuVertexArray.boneIndices.fastClear();
     cpuVertexArray.boneWeights.fastClear();
 
-    Stopwatch timer;
-    timer.setEnabled(false);
-
-    // Track the location of vertices in cpuVertexArray by their exact texcoord and position.
-    // The vertices in the list may have differing normals.
-    typedef int VertexIndex;
-    typedef SmallArray<VertexIndex, 4> VertexIndexList;
-    Table<Face::Vertex, VertexIndexList, Face::AMFaceVertexHash, Face::AMFaceVertexHash> vertexIndexTable;
+    const float normalClosenessThreshold = cos(maxNormalWeldAngle);
+    const int numVertices = 3 * faceArray.size();
+
+    // Find identical vertices (by exact texcoord, position, etc.) by sorting on
+    // their hash codes, which is parallel, instead of inserting them into a
+    // Table, which is not. Table would have required equal hash codes and then
+    // equal vertices, so grouping on the hash code and then comparing gives
+    // the same results. Within a group, vertices remain in their original order.
+    Array<HashedIndex> order;
+    order.resize(numVertices);
+    runConcurrently(0, numVertices, [&](int i) {
+        order[i].hashCode = Face::AMFaceVertexHash::hashCode(faceArray[i / 3].vertex[i % 3]);
+        order[i].index = i;
+    });
+    tbb::parallel_sort(order.begin(), order.end());
 
-    // Almost all of the time in this method is spent deallocating the table at
-    // the end, so use an AreaMemoryManager to directly dump the allocated memory
-    // without freeing individual objects.
-    vertexIndexTable.clearAndSetMemoryManager(AreaMemoryManager::create());
+    Array<int> runStart;
+    for (int i = 0; i < numVertices; ++i) {
+        if ((i == 0) || (order[i].hashCode != order[i - 1].hashCode)) {
+            runStart.append(i);
+        }
+    }
+    runStart.append(numVertices);
+
+    // For each vertex, the first earlier identical vertex with a close enough normal
+    // that was itself not merged, or the vertex itself.
+    Array<int> mergedInto;
+    mergedInto.resize(numVertices);
+    runConcurrently(0, runStart.size() - 1, [&](int r) {
+        // Vertices in this run that were not merged, in order
+        SmallArray<int, 4> list;
+        for (int i = runStart[r]; i < runStart[r + 1]; ++i) {
+            const int u = order[i].index;
+            const Face::Vertex& vertex = faceArray[u / 3].vertex[u % 3];
+            mergedInto[u] = u;
+
+            for (int k = 0; k < list.size(); ++k) {
+                const int w = list[k];
+                // The texture coordinates and vertices must exactly match.
+                // The normals may be slightly off, since the order of computation can affect them
+                // even if we wanted no normal welding.
+                const Face::Vertex& other = faceArray[w / 3].vertex[w % 3];
+                if (Face::AMFaceVertexHash::equals(other, vertex) &&
+                    ((other.normal.dot(vertex.normal) >= normalClosenessThreshold) ||
+                     other.normal.isZero() || vertex.normal.isZero())) {
+                    // Reuse this vertex
+                    mergedInto[u] = w;
+                    break;
+                }
+            }
 
-    // Conservative estimate of the size (overallocation here is bad for large models on low RAM systems (such as San Miguel on a standard 8GB RAM computer)
-    vertexIndexTable.setSizeHint(faceArray.size() / 6); 
+            if (mergedInto[u] == u) {
+                list.append(u);
+            }
+        }
+    });
 
-    const float normalClosenessThreshold = cos(maxNormalWeldAngle);
+    // Index of each unmerged vertex in cpuVertexArray
+    Array<int> outputIndex;
+    outputIndex.resize(numVertices);
 
     // Iterate over all faces
-    int longestListLength = 0;
     for (int f = 0; f < faceArray.size(); ++f) {
         const Face& face = faceArray[f];
         Mesh* mesh = face.mesh;
         int vertexIndex[3];
         for (int v = 0; v < 3; ++v) {
-            const Face::Vertex& vertex = face.vertex[v];
-
-            // Find the location of this vertex in cpuVertexArray...or add it.
-            // The texture coordinates and vertices must exactly match.
-            // The normals may be slightly off, since the order of computation can affect them
-            // even if we wanted no normal welding.
-            VertexIndexList& list = vertexIndexTable.getCreate(vertex);
+            const int u = 3 * f + v;
+            const int w = mergedInto[u];
 
             int index = -1;
-            for (int i = 0; i < list.size(); ++i) {
-                int j = list[i];
-                // See if the normals are close (we know that the texcoords and positions match exactly)
-                const Vector3& otherNormal = cpuVertexArray.vertex[j].normal;
-                if ((otherNormal.dot(vertex.normal) >= normalClosenessThreshold) 
-                    || otherNormal.isZero() || vertex.normal.isZero()) { 
-                    // Reuse this vertex
-                    index = j;
-                    break;
-                }
-            }
-
-            if (index == -1) {
+            if (w == u) {
                 // This must be a new vertex, so add it
+                const Face::Vertex& vertex = face.vertex[v];
                 index = cpuVertexArray.size();
                 cpuVertexArray.vertex.append(vertex);
                 if (cpuVertexArray.hasTexCoord1) {
@@ -700,8 +740,10 @@ void ArticulatedModel::Geometry::mergeVertices(const Array<Face>& faceArray, flo
                     cpuVertexArray.boneIndices.append(vertex.boneIndices);
                     cpuVertexArray.boneWeights.append(vertex.boneWeights);
                 }
-                list.append(index);
-                longestListLength = max(longestListLength, list.size());
+                outputIndex[u] = index;
+            } else {
+                // Earlier vertices have already been assigned
+                index = outputIndex[w];
             }
 
             // Add this vertex index to the mesh
@@ -713,10 +755,6 @@ void ArticulatedModel::Geometry::mergeVertices(const Array<Face>& faceArray, flo
             mesh->cpuIndexArray.append(vertexIndex[0], vertexIndex[1], vertexIndex[2]);
         }
     }
-
-   // debugPrintf("average bucket size = %f\n", vertexIndexTable.debugGetAverageBucketSize());
-   // debugPrintf("deepest bucket size = %d\n", vertexIndexTable.debugGetDeepestBucketSize());
-   // debugPrintf("longestListLength = %d\n", longestListLength);
 }
 
 
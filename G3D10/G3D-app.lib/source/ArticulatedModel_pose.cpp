@@ -187,6 +187,28 @@ static void uploadBones
 }
 
 
+bool ArticulatedModel::canPoseConcurrently() const {
+    if (m_boneArray.size() > 0) {
+        return false;
+    }
+
+    // The first pose() copies geometry to the GPU
+    for (const Geometry* geometry : m_geometryArray) {
+        if ((geometry->cpuVertexArray.size() > 0) && ! geometry->gpuPositionArray.valid()) {
+            return false;
+        }
+    }
+
+    for (const Mesh* mesh : m_meshArray) {
+        if ((mesh->cpuIndexArray.size() > 0) && ! mesh->gpuIndexArray.valid()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
 void ArticulatedModel::pose
    (Array<shared_ptr<Surface> >&       surfaceArray,
     const CFrame&                      cframe,
@@ -9,6 +9,7 @@
 #include "G3D-app/BumpMap.h"
 #include "G3D-base/Any.h"
 #include "G3D-base/CPUPixelTransferBuffer.h"
+#include "G3D-base/Float4.h"
 
 namespace G3D {
 
@@ -86,6 +87,23 @@ bool BumpMap::Settings::operator==(const Settings& other) const {
 }
 
 
+/** Rows of the normal map computed by each task of computeNormalMap. Large enough
+    to amortize loading the rows above and below each block. */
+static const int NORMAL_MAP_ROWS_PER_TASK = 32;
+
+/** Copies the elevations (the first channel) of row \a y, wrapped, into
+    row[1...w] as bytes 0-255. row[0] and row[w + 1] receive the wrapped
+    neighbors, so that the Sobel filter needs no bounds checks. */
+static void loadElevationRow(const unorm8* src, int w, int h, int channels, int y, float* row) {
+    const unorm8* p = src + size_t((y + h) % h) * w * channels;
+    for (int x = 0; x < w; ++x) {
+        row[x + 1] = float(p[x * channels].bits());
+    }
+    row[0]     = row[w];
+    row[w + 1] = row[1];
+}
+
+
 shared_ptr<PixelTransferBuffer> BumpMap::computeNormalMap
 (int                 width,
  int                 height,
@@ -110,109 +128,244 @@ shared_ptr<PixelTransferBuffer> BumpMap::computeNormalMap
 
     const int w = width;
     const int h = height;
-    const int stride = channels;
     
-    const unorm8* const B = src;
     Color4unorm8* const N = static_cast<Color4unorm8*>(normal->buffer());
 
-    // 1/s for the scale factor that each ELEVATION should be multiplied by.
+    // 1/s for the scale factor that each elevation should be multiplied by.
     // We avoid actually multiplying by this and instead just divide it out of z.
-    float elevationInvScale = 255.0f / whiteHeightInPixels;
-
-    runConcurrently(Point2int32(0, 0), Point2int32(w, h), [&](const Point2int32& P) {
-        const int x = P.x;
-        const int y = P.y;
-        // Index into normal map pixel
-        int i = x + y * w;
-
-        // Index into bump map *byte*
-        int j = stride * i;
-
-        Vector3 delta;
-
-        // Get a value from B (with wrapping lookup) relative to (x, y)
-        // and divide by 255
-#       define ELEVATION(DX, DY)  ((int)(B[(((DX + x + w) % w) +               \
-                                    ((DY + y + h) % h) * w) * stride].bits()))
-
-        // Sobel filter to compute the normal.  
-        //
-        // Y Filter (X filter is the transpose)
-        //  [ -1 -2 -1 ]
-        //  [  0  0  0 ]
-        //  [  1  2  1 ]
-
-        // Write the Y value directly into the x-component so we don't have
-        // to explicitly compute a cross product at the end.  Does not 
-        // go out of bounds because the above is computed mod (width, height)
-        delta.y = float(-( ELEVATION(-1, -1) * 1 +  ELEVATION( 0, -1) * 2 +  ELEVATION( 1, -1) * 1 +
-                    -ELEVATION(-1,  1) * 1 + -ELEVATION( 0,  1) * 2 + -ELEVATION( 1,  1) * 1));
-
-        delta.x = float(-(-ELEVATION(-1, -1) * 1 + ELEVATION( 1, -1) * 1 + 
-                    -ELEVATION(-1,  0) * 2 + ELEVATION( 1,  0) * 2 + 
-                    -ELEVATION(-1,  1) * 1 + ELEVATION( 1,  1) * 1));
-
-        // The scale of each filter row is 4, the filter width is two pixels,
-        // and the "normal" range is 0-255.
-        delta.z = 4 * 2 * elevationInvScale;
-
-        // Delta is now scaled in pixels; normalize 
-        delta = delta.direction();
-
-        // Copy over the bump value into the alpha channel.
-        float H = B[j];
-
-        if (lowPassBump) {
-            H = (ELEVATION(-1, -1) + ELEVATION( 0, -1) + ELEVATION(1, -1) +
-                ELEVATION(-1,  0) + ELEVATION( 0,  0) + ELEVATION(1,  0) +
-                ELEVATION(-1,  1) + ELEVATION( 0,  1) + ELEVATION(1,  1)) / (255.0f * 9.0f);
-        }
-#       undef ELEVATION
-
-        if (scaleHeightByNz) {
-            // delta.z can't possibly be negative, so we avoid actually
-            // computing the absolute value.
-            H *= delta.z;
-        }
+    const float elevationInvScale = 255.0f / whiteHeightInPixels;
+
+    // The scale of each filter row is 4, the filter width is two pixels,
+    // and the "normal" range is 0-255.
+    const float z = 4 * 2 * elevationInvScale;
+
+    // Rows are processed four pixels at a time. Every scratch row has room for
+    // the padding pixels and for reading whole Float4s past the last pixel.
+    const int paddedWidth = ((w + 3) & ~3) + 4;
+
+    const int numTasks = (h + NORMAL_MAP_ROWS_PER_TASK - 1) / NORMAL_MAP_ROWS_PER_TASK;
+    runConcurrently(0, numTasks, [&](int task) {
+        const int y0 = task * NORMAL_MAP_ROWS_PER_TASK;
+        const int y1 = min(h, y0 + NORMAL_MAP_ROWS_PER_TASK);
+
+        // Elevation rows y - 1, y, and y + 1, followed by the vertical passes of the
+        // separable filters: v = [1 2 1]^T, d = [-1 0 1]^T, and s = [1 1 1]^T
+        Array<float> scratch;
+        scratch.resize(6 * paddedWidth);
+        System::memset(scratch.getCArray(), 0, sizeof(float) * scratch.size());
+        float* up  = scratch.getCArray();
+        float* mid = up  + paddedWidth;
+        float* dn  = mid + paddedWidth;
+        float* v   = dn  + paddedWidth;
+        float* d   = v   + paddedWidth;
+        float* s   = d   + paddedWidth;
+
+        loadElevationRow(src, w, h, channels, y0 - 1, up);
+        loadElevationRow(src, w, h, channels, y0, mid);
+
+        const Float4 two(2.0f), zero(0.0f), one(1.0f), half(0.5f), byteScale(255.0f);
+        const Float4 Z(z), zSquared(z * z);
+        float nx[4], ny[4], nz[4], nh[4];
+
+        for (int y = y0; y < y1; ++y) {
+            loadElevationRow(src, w, h, channels, y + 1, dn);
+
+            for (int k = 0; k < paddedWidth; k += 4) {
+                const Float4 U = Float4::load(up + k), M = Float4::load(mid + k), D = Float4::load(dn + k);
+                ((U + M * two) + D).store(v + k);
+                (D - U).store(d + k);
+                if (lowPassBump) {
+                    ((U + M) + D).store(s + k);
+                }
+            }
 
-        N[i].a = unorm8(H);
+            Color4unorm8* row = N + size_t(y) * w;
+            for (int x = 0; x < w; x += 4) {
+                // Sobel filter to compute the normal.  
+                //
+                // Y Filter (X filter is the transpose)
+                //  [ -1 -2 -1 ]
+                //  [  0  0  0 ]
+                //  [  1  2  1 ]
+                //
+                // Write the Y value directly into the x-component so we don't have
+                // to explicitly compute a cross product at the end. Every partial
+                // sum is an integer, so this matches filtering in one pass exactly.
+                const Float4 dx = Float4::load(v + x) - Float4::load(v + x + 2);
+                const Float4 dy = (Float4::load(d + x) + Float4::load(d + x + 1) * two) + Float4::load(d + x + 2);
+
+                // Delta is now scaled in pixels; normalize 
+                const Float4 invLength = one / ((dx * dx + dy * dy) + zSquared).sqrt();
+                const Float4 X = dx * invLength;
+                const Float4 Y = dy * invLength;
+                const Float4 NZ = Z * invLength;
+
+                // Copy over the bump value into the alpha channel.
+                Float4 H = lowPassBump ?
+                    ((Float4::load(s + x) + Float4::load(s + x + 1)) + Float4::load(s + x + 2)) / Float4(255.0f * 9.0f) :
+                    Float4::load(mid + x + 1) * Float4(1.0f / 255.0f);
+
+                if (scaleHeightByNz) {
+                    // NZ can't possibly be negative, so we avoid actually
+                    // computing the absolute value.
+                    H = H * NZ;
+                }
+
+                // Pack into byte range, rounding as unorm8 does
+                (Float4::min(Float4::max(X * half + half, zero), one) * byteScale + half).store(nx);
+                (Float4::min(Float4::max(Y * half + half, zero), one) * byteScale + half).store(ny);
+                (Float4::min(Float4::max(NZ * half + half, zero), one) * byteScale + half).store(nz);
+                (Float4::min(Float4::max(H, zero), one) * byteScale + half).store(nh);
+
+                for (int i = 0; i < min(4, w - x); ++i) {
+                    row[x + i] = Color4unorm8(unorm8::fromBits(uint8(nx[i])), unorm8::fromBits(uint8(ny[i])), 
+                                              unorm8::fromBits(uint8(nz[i])), unorm8::fromBits(uint8(nh[i])));
+                }
+            }
 
-        // Pack into byte range
-        delta = delta * 0.5f + Vector3(0.5f, 0.5f, 0.5f);
-        N[i].r = unorm8(delta.x);
-        N[i].g = unorm8(delta.y);
-        N[i].b = unorm8(delta.z);
+            // Rotate the rows
+            float* temp = up;
+            up  = mid;
+            mid = dn;
+            dn  = temp;
+        }
     });
 
     return normal;
 }
 
 
+void BumpMap::computeNormalMap
+(int                 width,
+ int                 height,
+ int                 channels,
+ const unorm8*       src,
+ Array<shared_ptr<PixelTransferBuffer>>& mipArray,
+ const BumpMapPreprocess& preprocess) {
+
+    shared_ptr<CPUPixelTransferBuffer> previous = dynamic_pointer_cast<CPUPixelTransferBuffer>(computeNormalMap(width, height, channels, src, preprocess));
+    mipArray.fastClear();
+    mipArray.append(previous);
+
+    while ((width > 1) || (height > 1)) {
+        const int w = max(1, width / 2);
+        const int h = max(1, height / 2);
+        const shared_ptr<CPUPixelTransferBuffer>& level = CPUPixelTransferBuffer::create(w, h, ImageFormat::RGBA8());
+        const Color4unorm8* const S = static_cast<const Color4unorm8*>(previous->buffer());
+        Color4unorm8* const D = static_cast<Color4unorm8*>(level->buffer());
+        const int srcWidth = width, srcHeight = height;
+
+        runConcurrently(0, h, [&](int y) {
+            // Clamp, so that a dimension that is already 1 is not averaged
+            const int sy0 = min(2 * y, srcHeight - 1), sy1 = min(2 * y + 1, srcHeight - 1);
+            for (int x = 0; x < w; ++x) {
+                const int sx0 = min(2 * x, srcWidth - 1), sx1 = min(2 * x + 1, srcWidth - 1);
+                const Color4unorm8& a = S[sx0 + sy0 * srcWidth];
+                const Color4unorm8& b = S[sx1 + sy0 * srcWidth];
+                const Color4unorm8& c = S[sx0 + sy1 * srcWidth];
+                const Color4unorm8& e = S[sx1 + sy1 * srcWidth];
+
+                // Unpack, sum, and renormalize. The sum is in units of 1/255 of a
+                // packed value, which does not change its direction. Opposing normals
+                // sum to zero; choose the surface normal for them.
+                Vector3 n(float(int(a.r.bits()) + b.r.bits() + c.r.bits() + e.r.bits() - 510),
+                          float(int(a.g.bits()) + b.g.bits() + c.g.bits() + e.g.bits() - 510),
+                          float(int(a.b.bits()) + b.b.bits() + c.b.bits() + e.b.bits() - 510));
+                n = (n.squaredLength() > 0.0f) ? n.direction() : Vector3::unitZ();
+
+                const float H = float(int(a.a.bits()) + b.a.bits() + c.a.bits() + e.a.bits()) * (0.25f / 255.0f);
+                n = n * 0.5f + Vector3(0.5f, 0.5f, 0.5f);
+                D[x + y * w] = Color4unorm8(unorm8(n.x), unorm8(n.y), unorm8(n.z), unorm8(H));
+            }
+        });
+
+        mipArray.append(level);
+        previous = level;
+        width  = w;
+        height = h;
+    }
+}
+
+
+/** Relaxes one row of the Poisson solve of computeBumpMap. */
+static void relaxBumpRow(const float* src, const float* laplacian, float* dst, int w, int h, int y) {
+    const float* row = src + size_t(y) * w;
+    const float* up  = src + size_t((y + h - 1) % h) * w;
+    const float* dn  = src + size_t((y + 1) % h) * w;
+    const float* L   = laplacian + size_t(y) * w;
+    float* out       = dst + size_t(y) * w;
+
+    // Edges wrap; the interior is a branch-free loop that the compiler vectorizes
+    out[0] = (row[w - 1] + up[0] + row[min(1, w - 1)] + dn[0] + L[0]) * 0.25f;
+    for (int x = 1; x < w - 1; ++x) {
+        out[x] = (row[x - 1] + up[x] + row[x + 1] + dn[x] + L[x]) * 0.25f;
+    }
+    if (w > 1) {
+        out[w - 1] = (row[w - 2] + up[w - 1] + row[0] + dn[w - 1] + L[w - 1]) * 0.25f;
+    }
+}
+
+
 shared_ptr<PixelTransferBuffer> BumpMap::computeBumpMap
-(const shared_ptr<PixelTransferBuffer>& _normalMap,
+(const shared_ptr<PixelTransferBuffer>& normalMap,
  float signConvention) {
 
-    const shared_ptr<Image>& normalMap = Image::fromPixelTransferBuffer(_normalMap);
-
     const int w = normalMap->width();
     const int h = normalMap->height();
+    const int n = w * h;
+
+    // The x and y components of the normals, as stored (on [0, 1])
+    Array<float> red, green;
+    red.resize(n);
+    green.resize(n);
+
+    const ImageFormat* format = normalMap->format();
+    if (((format == ImageFormat::RGB8()) || (format == ImageFormat::RGBA8())) && 
+        (normalMap->size() == size_t(n) * format->cpuBitsPerPixel / 8)) {
+        // Tightly packed bytes, the common case; read them directly
+        const int stride = format->numComponents;
+        const unorm8* bytes = static_cast<const unorm8*>(normalMap->mapRead());
+        runConcurrently(0, h, [&](int y) {
+            for (int i = y * w; i < (y + 1) * w; ++i) {
+                red[i]   = float(bytes[i * stride]);
+                green[i] = float(bytes[i * stride + 1]);
+            }
+        });
+        normalMap->unmap();
+    } else {
+        const shared_ptr<Image>& image = Image::fromPixelTransferBuffer(normalMap);
+        runConcurrently(0, h, [&](int y) {
+            for (int x = 0; x < w; ++x) {
+                const Color3& c = image->get<Color3>(x, y);
+                red[x + y * w]   = c.r;
+                green[x + y * w] = c.g;
+            }
+        });
+    }
 
     // Compute the laplacian once; it never changes
-    shared_ptr<Image> laplacian = Image::create(w, h, ImageFormat::R32F());
-
-    runConcurrently(Point2int32(0, 0), Point2int32(w, h), [&](const Point2int32& P) {
-        const int x = P.x;
-        const int y = P.y;
-        float ddx = normalMap->get<Color3>(x + 1, y, WrapMode::TILE).r - normalMap->get<Color3>(x - 1, y, WrapMode::TILE).r;
-        float ddy = normalMap->get<Color3>(x, y + 1, WrapMode::TILE).g - normalMap->get<Color3>(x, y - 1, WrapMode::TILE).g;
-        laplacian->set(x, y, Color1(ddx + signConvention * ddy) * 0.5f);
+    Array<float> laplacian;
+    laplacian.resize(n);
+    runConcurrently(0, h, [&](int y) {
+        const int up = ((y + h - 1) % h) * w;
+        const int dn = ((y + 1) % h) * w;
+        for (int x = 0; x < w; ++x) {
+            const float ddx = red[(x + 1) % w + y * w] - red[(x + w - 1) % w + y * w];
+            const float ddy = green[x + dn] - green[x + up];
+            laplacian[x + y * w] = (ddx + signConvention * ddy) * 0.5f;
+        }
     });
 
     // Ping-pong buffers
-    shared_ptr<Image> src = Image::create(w, h, ImageFormat::R32F());
-    shared_ptr<Image> dst = Image::create(w, h, ImageFormat::R32F());
-
-    dst->setAll(Color1(0.5f));
+    Array<float> buffer0, buffer1;
+    buffer0.resize(n);
+    buffer1.resize(n);
+    float* src = buffer0.getCArray();
+    float* dst = buffer1.getCArray();
+
+    for (int i = 0; i < n; ++i) {
+        dst[i] = 0.5f;
+    }
 
     // Number of Poisson iterations
     const int N = 100;
@@ -220,30 +373,42 @@ shared_ptr<PixelTransferBuffer> BumpMap::computeBumpMap
         // Swap buffers
         std::swap(src, dst);
 
-        runConcurrently(Point2int32(0, 0), Point2int32(w, h), [&](const Point2int32& P) {
-            const int x = P.x;
-            const int y = P.y;
-            dst->set(x, y,
-                        Color1((src->get<Color1>(x - 1, y, WrapMode::TILE).value + src->get<Color1>(x, y - 1, WrapMode::TILE).value +
-                                src->get<Color1>(x + 1, y, WrapMode::TILE).value + src->get<Color1>(x, y + 1, WrapMode::TILE).value + 
-                                laplacian->get<Color1>(x, y).value) * 0.25f));
+        runConcurrently(0, h, [&](int y) {
+            relaxBumpRow(src, laplacian.getCArray(), dst, w, h, y);
         });
         debugPrintf("On pass %d/%d\n", i, N);
     }
 
-    float lo = finf(), hi = -finf();
-    runConcurrently(Point2int32(0, 0), Point2int32(w, h), [&](const Point2int32& P) {
-        const float v = dst->get<Color1>(P).value;
-        lo = min(lo, v);
-        hi = max(hi, v);
+    // Reduce each row concurrently and then the rows serially
+    Array<float> rowLo, rowHi;
+    rowLo.resize(h);
+    rowHi.resize(h);
+    runConcurrently(0, h, [&](int y) {
+        float lo = finf(), hi = -finf();
+        for (int i = y * w; i < (y + 1) * w; ++i) {
+            lo = min(lo, dst[i]);
+            hi = max(hi, dst[i]);
+        }
+        rowLo[y] = lo;
+        rowHi[y] = hi;
     });
 
-    const shared_ptr<Image>& final = Image::create(w, h, ImageFormat::RGB8());
-    runConcurrently(Point2int32(0, 0), Point2int32(w, h), [&](const Point2int32& P) {
-        final->set(P, Color1((dst->get<Color1>(P).value - lo) / (hi - lo)));
+    float lo = finf(), hi = -finf();
+    for (int y = 0; y < h; ++y) {
+        lo = min(lo, rowLo[y]);
+        hi = max(hi, rowHi[y]);
+    }
+
+    const shared_ptr<CPUPixelTransferBuffer>& final = CPUPixelTransferBuffer::create(w, h, ImageFormat::RGB8());
+    Color3unorm8* const F = static_cast<Color3unorm8*>(final->buffer());
+    runConcurrently(0, h, [&](int y) {
+        for (int i = y * w; i < (y + 1) * w; ++i) {
+            const unorm8 b((dst[i] - lo) / (hi - lo));
+            F[i] = Color3unorm8(b, b, b);
+        }
     });
 
-    return final->toPixelTransferBuffer();
+    return final;
 }
 
 
@@ -0,0 +1,610 @@
+/**
+  \file G3D-app.lib/source/CollisionWorld.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-app/CollisionWorld.h"
+#include "G3D-app/TriTree.h"
+#include "G3D-app/Tri.h"
+#include "G3D-base/CollisionDetection.h"
+#include "G3D-base/CoordinateFrame.h"
+#include "G3D-base/Float4.h"
+#include "G3D-base/Thread.h"
+#include <algorithm>
+
+namespace G3D {
+
+/** Number of sweep indices (for broadphase) or candidate pairs (for narrowphase) per concurrent task */
+static const int BLOCK_SIZE = 256;
+
+/** Padding entries at the end of the sweep bound arrays, so that four-wide loads never run past the end */
+static const int SWEEP_PADDING = 4;
+
+void CollisionWorld::Body::updateBounds() {
+    switch (type) {
+    case SPHERE:
+        sphere.getBounds(bounds);
+        break;
+
+    case BOX:
+        box.getBounds(bounds);
+        break;
+
+    case CAPSULE:
+        capsule.getBounds(bounds);
+        break;
+
+    case MESH:
+        {
+            const CPUVertexArray& vertexArray = mesh->vertexArray();
+            bounds = AABox::empty();
+            for (int t = 0; t < mesh->size(); ++t) {
+                const Tri& tri = (*mesh)[t];
+                for (int v = 0; v < 3; ++v) {
+                    bounds.merge(tri.position(vertexArray, v));
+                }
+            }
+        }
+        break;
+    }
+}
+
+
+CollisionWorld::BodyID CollisionWorld::allocateBody(BodyType type) {
+    BodyID id;
+    if (m_freeList.size() > 0) {
+        id = m_freeList.pop();
+    } else {
+        id = m_bodyArray.size();
+        m_bodyArray.next();
+    }
+
+    Body& b = m_bodyArray[id];
+    b = Body();
+    b.type = type;
+    b.inUse = true;
+    m_sweepOrderChanged = true;
+    m_sweepCurrent = false;
+    return id;
+}
+
+
+CollisionWorld::BodyID CollisionWorld::addSphere(const Sphere& sphere) {
+    const BodyID id = allocateBody(SPHERE);
+    setSphere(id, sphere);
+    return id;
+}
+
+
+CollisionWorld::BodyID CollisionWorld::addBox(const Box& box) {
+    const BodyID id = allocateBody(BOX);
+    setBox(id, box);
+    return id;
+}
+
+
+CollisionWorld::BodyID CollisionWorld::addCapsule(const Capsule& capsule) {
+    const BodyID id = allocateBody(CAPSULE);
+    setCapsule(id, capsule);
+    return id;
+}
+
+
+CollisionWorld::BodyID CollisionWorld::addMesh(const shared_ptr<TriTree>& mesh) {
+    debugAssert(notNull(mesh));
+    const BodyID id = allocateBody(MESH);
+    Body& b = body(id);
+    b.mesh = mesh;
+    b.updateBounds();
+    return id;
+}
+
+
+void CollisionWorld::setSphere(BodyID id, const Sphere& sphere) {
+    Body& b = body(id);
+    debugAssertM(b.type == SPHERE, "Not a sphere");
+    b.sphere = sphere;
+    b.updateBounds();
+    m_sweepCurrent = false;
+}
+
+
+void CollisionWorld::setBox(BodyID id, const Box& box) {
+    Body& b = body(id);
+    debugAssertM(b.type == BOX, "Not a box");
+    b.box = box;
+    b.updateBounds();
+    m_sweepCurrent = false;
+}
+
+
+void CollisionWorld::setCapsule(BodyID id, const Capsule& capsule) {
+    Body& b = body(id);
+    debugAssertM(b.type == CAPSULE, "Not a capsule");
+    b.capsule = capsule;
+    b.updateBounds();
+    m_sweepCurrent = false;
+}
+
+
+void CollisionWorld::remove(BodyID id) {
+    Body& b = body(id);
+    b.inUse = false;
+    b.mesh.reset();
+    m_freeList.append(id);
+    m_sweepOrderChanged = true;
+    m_sweepCurrent = false;
+}
+
+
+void CollisionWorld::clear() {
+    m_bodyArray.fastClear();
+    m_freeList.fastClear();
+    m_sweepOrder.fastClear();
+    m_sweepOrderChanged = true;
+    m_sweepCurrent = false;
+}
+
+
+void CollisionWorld::updateSweep() {
+    if (m_sweepCurrent) {
+        return;
+    }
+
+    // Sweep along the axis on which the centers of the moving bodies vary the most,
+    // which minimizes the number of overlapping intervals. Meshes are static and
+    // usually span the whole world, so they would not help to choose.
+    Vector3 sum, sumSquares;
+    int count = 0;
+    for (const Body& b : m_bodyArray) {
+        if (b.inUse && (b.type != MESH)) {
+            const Point3& c = b.bounds.center();
+            sum += c;
+            sumSquares += c * c;
+            ++count;
+        }
+    }
+
+    int axis = m_sweepAxis;
+    if (count > 1) {
+        const Vector3& mean = sum / float(count);
+        const Vector3& variance = sumSquares / float(count) - mean * mean;
+        axis = variance.primaryAxis();
+    }
+
+    const auto lessThan = [&](BodyID x, BodyID y) {
+        return m_bodyArray[x].bounds.low()[axis] < m_bodyArray[y].bounds.low()[axis];
+    };
+
+    bool sorted = false;
+    if (! m_sweepOrderChanged && (axis == m_sweepAxis)) {
+        // Insertion sort is linear for the nearly-sorted order that coherent motion
+        // produces. Give up and fall back to a full sort if the motion was incoherent.
+        const int n = m_sweepOrder.size();
+        int moves = 0;
+        const int maxMoves = 8 * n;
+        sorted = true;
+        for (int i = 1; (i < n) && sorted; ++i) {
+            const BodyID id = m_sweepOrder[i];
+            int j = i - 1;
+            while ((j >= 0) && lessThan(id, m_sweepOrder[j])) {
+                m_sweepOrder[j + 1] = m_sweepOrder[j];
+                --j;
+                ++moves;
+            }
+            m_sweepOrder[j + 1] = id;
+            sorted = (moves <= maxMoves);
+        }
+    }
+
+    if (! sorted) {
+        m_sweepOrder.fastClear();
+        for (BodyID id = 0; id < m_bodyArray.size(); ++id) {
+            if (m_bodyArray[id].inUse) {
+                m_sweepOrder.append(id);
+            }
+        }
+        std::sort(m_sweepOrder.begin(), m_sweepOrder.end(), lessThan);
+    }
+
+    m_sweepAxis = axis;
+    m_sweepOrderChanged = false;
+
+    const int n = m_sweepOrder.size();
+    for (int a = 0; a < 3; ++a) {
+        m_sweepLow[a].resize(n + SWEEP_PADDING, false);
+        m_sweepHigh[a].resize(n + SWEEP_PADDING, false);
+        for (int i = 0; i < n; ++i) {
+            const AABox& bounds = m_bodyArray[m_sweepOrder[i]].bounds;
+            m_sweepLow[a][i] = bounds.low()[a];
+            m_sweepHigh[a][i] = bounds.high()[a];
+        }
+
+        // Empty intervals after the end, which also stop the scan along the sweep axis
+        for (int i = n; i < n + SWEEP_PADDING; ++i) {
+            m_sweepLow[a][i] = finf();
+            m_sweepHigh[a][i] = -finf();
+        }
+    }
+
+    m_sweepCurrent = true;
+}
+
+
+void CollisionWorld::getPotentialPairs(Array<Pair>& pairArray) {
+    pairArray.fastClear();
+    updateSweep();
+
+    const int n = m_sweepOrder.size();
+    const int numBlocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (numBlocks == 0) {
+        return;
+    }
+
+    const int a0 = m_sweepAxis;
+    const int a1 = (a0 + 1) % 3;
+    const int a2 = (a0 + 2) % 3;
+    const float* low0  = m_sweepLow[a0].getCArray();
+    const float* low1  = m_sweepLow[a1].getCArray();
+    const float* high1 = m_sweepHigh[a1].getCArray();
+    const float* low2  = m_sweepLow[a2].getCArray();
+    const float* high2 = m_sweepHigh[a2].getCArray();
+
+    Array<Array<Pair>> blockPairArray;
+    blockPairArray.resize(numBlocks);
+    runConcurrently(0, numBlocks, [&](int block) {
+        Array<Pair>& out = blockPairArray[block];
+        const int stop = min(n, (block + 1) * BLOCK_SIZE);
+        for (int i = block * BLOCK_SIZE; i < stop; ++i) {
+            const BodyID id = m_sweepOrder[i];
+            const bool isMesh = (m_bodyArray[id].type == MESH);
+
+            // Bodies later in the sweep start at or after this one on the sweep axis, so
+            // they overlap it on that axis until one starts after this one ends
+            const float end = m_sweepHigh[a0][i];
+            const Float4 end0(end);
+            const Float4 start1(low1[i]), end1(high1[i]);
+            const Float4 start2(low2[i]), end2(high2[i]);
+            for (int j = i + 1; low0[j] <= end; j += 4) {
+                const Float4 overlap =
+                    (Float4::load(low0 + j) <= end0) &
+                    (Float4::load(low1 + j) <= end1) & (Float4::load(high1 + j) >= start1) &
+                    (Float4::load(low2 + j) <= end2) & (Float4::load(high2 + j) >= start2);
+
+                const int bits = overlap.bits();
+                if (bits != 0) {
+                    for (int k = 0; k < 4; ++k) {
+                        if ((bits & (1 << k)) != 0) {
+                            const BodyID other = m_sweepOrder[j + k];
+                            if (! (isMesh && (m_bodyArray[other].type == MESH))) {
+                                out.append(Pair(id, other));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    for (const Array<Pair>& out : blockPairArray) {
+        pairArray.append(out);
+    }
+}
+
+
+void CollisionWorld::getTriangles(const TriTree& mesh, const AABox& box, Array<Triangle>& triangleArray) {
+    Array<Tri> triArray;
+    mesh.intersectBox(box, triArray);
+
+    const CPUVertexArray& vertexArray = mesh.vertexArray();
+    triangleArray.fastClear();
+    for (const Tri& tri : triArray) {
+        triangleArray.append(Triangle(tri.position(vertexArray, 0), tri.position(vertexArray, 1), tri.position(vertexArray, 2)));
+    }
+}
+
+
+/** Minimizes a convex function of t on [0, 1] by golden-section search */
+template<class Function>
+static float minimizeOnInterval(const Function& f) {
+    static const float invPhi = 0.618034f;
+    float lo = 0.0f, hi = 1.0f;
+    float x1 = hi - invPhi * (hi - lo), x2 = lo + invPhi * (hi - lo);
+    float f1 = f(x1), f2 = f(x2);
+    for (int i = 0; i < 32; ++i) {
+        if (f1 < f2) {
+            hi = x2; x2 = x1; f2 = f1;
+            x1 = hi - invPhi * (hi - lo);
+            f1 = f(x1);
+        } else {
+            lo = x1; x1 = x2; f1 = f2;
+            x2 = lo + invPhi * (hi - lo);
+            f2 = f(x2);
+        }
+    }
+    return min(min(f1, f2), min(f(0.0f), f(1.0f)));
+}
+
+
+static float squaredDistanceToBox(const Box& box, const Point3& P) {
+    const Vector3& delta = P - box.center();
+    float d2 = 0.0f;
+    for (int a = 0; a < 3; ++a) {
+        d2 += square(max(fabsf(delta.dot(box.axis(a))) - box.extent(a) * 0.5f, 0.0f));
+    }
+    return d2;
+}
+
+
+static float squaredDistanceToTriangle(const Triangle& triangle, const Point3& P) {
+    const Vector3& n = triangle.normal();
+    const Point3& Q = P - n * n.dot(P - triangle.vertex(0));
+    if (CollisionDetection::isPointInsideTriangle(triangle.vertex(0), triangle.vertex(1), triangle.vertex(2), n, Q, triangle.primaryAxis())) {
+        return (P - Q).squaredLength();
+    } else {
+        return (P - CollisionDetection::closestPointOnTrianglePerimeter(triangle.vertex(0), triangle.vertex(1), triangle.vertex(2), P)).squaredLength();
+    }
+}
+
+
+static Point3 pointOnCapsule(const Capsule& capsule, float t) {
+    return capsule.point(0) + (capsule.point(1) - capsule.point(0)) * t;
+}
+
+
+bool CollisionWorld::intersects(const Body& x, const Body& y) {
+    const Body& a = (x.type <= y.type) ? x : y;
+    const Body& b = (x.type <= y.type) ? y : x;
+
+    switch (b.type) {
+    case SPHERE:
+        return CollisionDetection::fixedSolidSphereIntersectsFixedSolidSphere(a.sphere, b.sphere);
+
+    case BOX:
+        if (a.type == SPHERE) {
+            return CollisionDetection::fixedSolidSphereIntersectsFixedSolidBox(a.sphere, b.box);
+        } else {
+            return CollisionDetection::fixedSolidBoxIntersectsFixedSolidBox(a.box, b.box);
+        }
+
+    case CAPSULE:
+        {
+            const Capsule& capsule = b.capsule;
+            switch (a.type) {
+            case SPHERE:
+                return (a.sphere.center - CollisionDetection::closestPointOnLineSegment(capsule.point(0), capsule.point(1), a.sphere.center)).squaredLength() <=
+                    square(a.sphere.radius + capsule.radius());
+
+            case BOX:
+                return minimizeOnInterval([&](float t) { return squaredDistanceToBox(a.box, pointOnCapsule(capsule, t)); }) <=
+                    square(capsule.radius());
+
+            default:
+                return minimizeOnInterval([&](float t) {
+                        const Point3& P = pointOnCapsule(capsule, t);
+                        return (P - CollisionDetection::closestPointOnLineSegment(a.capsule.point(0), a.capsule.point(1), P)).squaredLength();
+                    }) <= square(a.capsule.radius() + capsule.radius());
+            }
+        }
+
+    case MESH:
+        {
+            if (a.type == MESH) {
+                return false;
+            }
+
+            Array<Triangle> triangleArray;
+            getTriangles(*b.mesh, a.bounds, triangleArray);
+
+            if (a.type == BOX) {
+                // Test in the box's frame, where it is axis-aligned
+                const CoordinateFrame& frame = a.box.localFrame();
+                const Vector3& halfExtent = a.box.extent() * 0.5f;
+                const AABox localBox(-halfExtent, halfExtent);
+                for (const Triangle& triangle : triangleArray) {
+                    if (CollisionDetection::fixedSolidBoxIntersectsFixedTriangle(localBox, frame.toObjectSpace(triangle))) {
+                        return true;
+                    }
+                }
+            } else {
+                for (const Triangle& triangle : triangleArray) {
+                    if (((a.type == SPHERE) && CollisionDetection::fixedSolidSphereIntersectsFixedTriangle(a.sphere, triangle)) ||
+                        ((a.type == CAPSULE) &&
+                         (minimizeOnInterval([&](float t) { return squaredDistanceToTriangle(triangle, pointOnCapsule(a.capsule, t)); }) <=
+                          square(a.capsule.radius())))) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+    }
+
+    return false;
+}
+
+
+void CollisionWorld::getCollidingPairs(Array<Pair>& pairArray) {
+    Array<Pair> candidateArray;
+    getPotentialPairs(candidateArray);
+
+    Array<bool> colliding;
+    colliding.resize(candidateArray.size());
+
+    const int numBlocks = (candidateArray.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    runConcurrently(0, numBlocks, [&](int block) {
+        const int start = block * BLOCK_SIZE;
+        const int stop = min(candidateArray.size(), start + BLOCK_SIZE);
+
+        // Gather the sphere-sphere and sphere-box pairs for the batch tests
+        // and test everything else directly
+        Sphere sphere1[BLOCK_SIZE], sphere2[BLOCK_SIZE], sphere3[BLOCK_SIZE];
+        Box box[BLOCK_SIZE];
+        int sphereSphereIndex[BLOCK_SIZE], sphereBoxIndex[BLOCK_SIZE];
+        int numSphereSphere = 0, numSphereBox = 0;
+        for (int c = start; c < stop; ++c) {
+            const Body& a = m_bodyArray[candidateArray[c].a];
+            const Body& b = m_bodyArray[candidateArray[c].b];
+            if ((a.type == SPHERE) && (b.type == SPHERE)) {
+                sphere1[numSphereSphere] = a.sphere;
+                sphere2[numSphereSphere] = b.sphere;
+                sphereSphereIndex[numSphereSphere] = c;
+                ++numSphereSphere;
+            } else if (((a.type == SPHERE) && (b.type == BOX)) || ((a.type == BOX) && (b.type == SPHERE))) {
+                sphere3[numSphereBox] = (a.type == SPHERE) ? a.sphere : b.sphere;
+                box[numSphereBox] = (a.type == BOX) ? a.box : b.box;
+                sphereBoxIndex[numSphereBox] = c;
+                ++numSphereBox;
+            } else {
+                colliding[c] = intersects(a, b);
+            }
+        }
+
+        bool result[BLOCK_SIZE];
+        CollisionDetection::fixedSolidSphereIntersectsFixedSolidSphere(sphere1, sphere2, numSphereSphere, result);
+        for (int i = 0; i < numSphereSphere; ++i) {
+            colliding[sphereSphereIndex[i]] = result[i];
+        }
+
+        CollisionDetection::fixedSolidSphereIntersectsFixedSolidBox(sphere3, box, numSphereBox, result);
+        for (int i = 0; i < numSphereBox; ++i) {
+            colliding[sphereBoxIndex[i]] = result[i];
+        }
+    });
+
+    pairArray.fastClear();
+    for (int c = 0; c < candidateArray.size(); ++c) {
+        if (colliding[c]) {
+            pairArray.append(candidateArray[c]);
+        }
+    }
+}
+
+
+void CollisionWorld::getBodiesIntersectingBox(const AABox& box, Array<BodyID>& bodyArray) {
+    bodyArray.fastClear();
+    updateSweep();
+
+    const int a0 = m_sweepAxis;
+    const float end = box.high()[a0];
+    for (int i = 0; (i < m_sweepOrder.size()) && (m_sweepLow[a0][i] <= end); ++i) {
+        const BodyID id = m_sweepOrder[i];
+        if (m_bodyArray[id].bounds.intersects(box)) {
+            bodyArray.append(id);
+        }
+    }
+}
+
+
+Point3 CollisionWorld::slideSphere
+   (const Sphere&       sphere,
+    const Vector3&      velocity,
+    float               deltaTime,
+    BodyID              ignore,
+    int                 maxIterations) {
+
+    static const float epsilon = 0.0001f;
+
+    // Everything that the sphere could reach in this step
+    const float reach = sphere.radius + velocity.length() * deltaTime;
+    const AABox region(sphere.center - Vector3(reach, reach, reach), sphere.center + Vector3(reach, reach, reach));
+
+    Array<BodyID> nearbyArray;
+    getBodiesIntersectingBox(region, nearbyArray);
+
+    Array<Triangle> triangleArray;
+    Array<BodyID> solidArray;
+    for (const BodyID id : nearbyArray) {
+        if (id == ignore) {
+            continue;
+        }
+        const Body& b = m_bodyArray[id];
+        if (b.type == MESH) {
+            Array<Triangle> meshTriangleArray;
+            getTriangles(*b.mesh, region, meshTriangleArray);
+            triangleArray.append(meshTriangleArray);
+        } else {
+            solidArray.append(id);
+        }
+    }
+
+    Sphere current = sphere;
+    Vector3 v = velocity;
+    float timeLeft = deltaTime;
+
+    // Keep moving until out of time or velocity, at which point no further movement is possible
+    for (int iteration = 0; (iteration < maxIterations) && (timeLeft > epsilon) && (v.length() > epsilon); ++iteration) {
+        float stepTime = timeLeft;
+        Vector3 collisionNormal;
+        Point3 collisionPoint;
+        bool collided = false;
+
+        // Accepts a contact at time d and location C if it is the first one, and
+        // is interpenetrating or the sphere is moving towards it
+        const auto consider = [&](float d, const Point3& C) {
+            if (d < stepTime) {
+                const Vector3& delta = (current.center + v * d) - C;
+                const float r = delta.length();
+                if (r > 0.0f) {
+                    const Vector3& n = delta / r;
+                    static const float threshold = 0.000001f;
+                    if ((r < current.radius - threshold) || (n.dot(v) < -threshold)) {
+                        collisionNormal = n;
+                        collisionPoint = C;
+                        stepTime = d;
+                        collided = true;
+                    }
+                }
+            }
+        };
+
+        for (const Triangle& triangle : triangleArray) {
+            Point3 C;
+            consider(CollisionDetection::collisionTimeForMovingSphereFixedTriangle(current, v, triangle, C), C);
+        }
+
+        for (const BodyID id : solidArray) {
+            const Body& b = m_bodyArray[id];
+            Point3 C;
+            float d = finf();
+            switch (b.type) {
+            case SPHERE:
+                d = CollisionDetection::collisionTimeForMovingSphereFixedSphere(current, v, b.sphere, C);
+                break;
+
+            case BOX:
+                d = CollisionDetection::collisionTimeForMovingSphereFixedBox(current, v, b.box, C);
+                break;
+
+            case CAPSULE:
+                d = CollisionDetection::collisionTimeForMovingSphereFixedCapsule(current, v, b.capsule, C);
+                break;
+
+            default:;
+            }
+            consider(d, C);
+        }
+
+        // Advance to just before the collision
+        stepTime = max(0.0f, stepTime - epsilon * 0.5f);
+        current.center += v * stepTime;
+        timeLeft -= stepTime;
+
+        if (collided) {
+            if (current.contains(collisionPoint)) {
+                // Interpenetration. Place the sphere adjacent to the contact.
+                current.center = collisionPoint + collisionNormal * (current.radius + epsilon * 2.0f);
+            }
+
+            // Slide: remove the component of velocity into the contact
+            v -= collisionNormal * collisionNormal.dot(v);
+        }
+    }
+
+    return current.center;
+}
+
+} // namespace G3D
@@ -74,6 +74,9 @@ void DebugTextWidget::render(RenderDevice *rd) const {
                 pos.y += size * 1.5f;
 
                 const float fps = rd->stats().smoothFrameRate;
+                const bool pipelined = notNull(m_app->m_framePipeline);
+                const int num3D = pipelined ? m_app->m_framePipeline->front().posed3D.size() : m_app->m_posed3D.size();
+                const int num2D = pipelined ? m_app->m_framePipeline->front().posed2D.size() : m_app->m_posed2D.size();
                 const String& s = format(
                     "% 4d fps (% 3d ms)  % 5.1fM tris  GL Calls: %d/%d Maj;  %d/%d Min;  %d push; %d Surfaces; %d Surface2Ds",
                     iRound(fps),
@@ -81,7 +84,7 @@ void DebugTextWidget::render(RenderDevice *rd) const {
                     iRound(rd->stats().smoothTriangles / 1e5) * 0.1f,
                     /*iRound(rd->stats().smoothTriangleRate / 1e4) * 0.01f,*/
                     majGL, majAll, minGL, minAll, pushCalls,
-                    m_app->m_posed3D.size(), m_app->m_posed2D.size());
+                    num3D, num2D);
                 m_app->debugFont->appendToCharVertexArray(charVertexArray, indexArray, rd, s, pos, size, statColor);
 
                 pos.x = x;
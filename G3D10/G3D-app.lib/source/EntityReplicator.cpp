@@ -0,0 +1,393 @@
+/**
+  \file G3D-app.lib/source/EntityReplicator.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-app/EntityReplicator.h"
+#include "G3D-app/Entity.h"
+#include "G3D-base/BinaryOutput.h"
+#include "G3D-base/BinaryInput.h"
+#include "G3D-base/System.h"
+
+namespace G3D {
+
+EntityReplicator::EntityReplicator(const Specification& specification) :
+    m_specification(specification),
+    m_message("<memory>", G3D_LITTLE_ENDIAN) {
+    debugAssert(specification.historyLength >= 1);
+}
+
+
+shared_ptr<EntityReplicator> EntityReplicator::create(const Specification& specification) {
+    return createShared<EntityReplicator>(specification);
+}
+
+
+void EntityReplicator::add(const shared_ptr<Entity>& entity) {
+    debugAssert(notNull(entity));
+    Tracked& t = m_trackedArray.next();
+    t.id = m_nextID;
+    t.entity = entity;
+    m_nameTable.set(m_nextID, entity->name());
+    ++m_nextID;
+}
+
+
+void EntityReplicator::remove(const shared_ptr<Entity>& entity) {
+    for (int i = 0; i < m_trackedArray.size(); ++i) {
+        if (m_trackedArray[i].entity == entity) {
+            m_removedArray.append(m_trackedArray[i].id);
+            // Preserve the order by id
+            m_trackedArray.remove(i);
+            return;
+        }
+    }
+}
+
+
+EntityReplicator::ClientID EntityReplicator::addClient(const shared_ptr<NetSendConnection>& connection) {
+    ClientID id = 0;
+    while ((id < m_clientArray.size()) && m_clientArray[id].inUse) {
+        ++id;
+    }
+    if (id == m_clientArray.size()) {
+        m_clientArray.next();
+    }
+
+    Client& client = m_clientArray[id];
+    client = Client();
+    client.inUse = true;
+    client.connection = connection;
+    return id;
+}
+
+
+void EntityReplicator::removeClient(ClientID client) {
+    debugAssert((client >= 0) && (client < m_clientArray.size()));
+    m_clientArray[client] = Client();
+}
+
+
+void EntityReplicator::acknowledge(ClientID client, uint32 sequence) {
+    debugAssert((client >= 0) && (client < m_clientArray.size()) && m_clientArray[client].inUse);
+    Client& c = m_clientArray[client];
+    // Acknowledgements may arrive out of order
+    if (sequence > c.acknowledged) {
+        c.acknowledged = sequence;
+    }
+}
+
+
+shared_ptr<EntityReplicator::Snapshot> EntityReplicator::findSnapshot(uint32 sequence) const {
+    for (int i = m_history.size() - 1; i >= 0; --i) {
+        if (m_history[i]->sequence == sequence) {
+            return m_history[i];
+        }
+    }
+    return nullptr;
+}
+
+
+uint32 EntityReplicator::snapshot() {
+    const shared_ptr<Snapshot> previous = (m_history.size() > 0) ? m_history.last() : nullptr;
+    if (m_history.size() >= m_specification.historyLength) {
+        m_history.remove(0, m_history.size() - m_specification.historyLength + 1);
+    }
+
+    const shared_ptr<Snapshot>& current = createShared<Snapshot>();
+    current->sequence = (notNull(previous) ? previous->sequence : 0) + 1;
+    current->time = System::time();
+    current->recordArray.resize(m_trackedArray.size(), false);
+
+    // Both arrays are sorted by id. Entities that have not changed since the
+    // previous snapshot reuse its quantized frame.
+    const Array<Record>* previousArray = notNull(previous) ? &previous->recordArray : nullptr;
+    int p = 0;
+    for (int i = 0; i < m_trackedArray.size(); ++i) {
+        const Tracked& t = m_trackedArray[i];
+        Record& record = current->recordArray[i];
+        record.id = t.id;
+
+        if (notNull(previousArray)) {
+            while ((p < previousArray->size()) && ((*previousArray)[p].id < t.id)) {
+                ++p;
+            }
+        }
+
+        if (notNull(previousArray) && (p < previousArray->size()) && ((*previousArray)[p].id == t.id) &&
+            (t.entity->lastChangeTime() < previous->time)) {
+            record.frame = (*previousArray)[p].frame;
+        } else {
+            record.frame = QuantizedPhysicsFrame(PhysicsFrame(t.entity->frame()), m_specification.format);
+        }
+    }
+
+    m_history.append(current);
+
+    // Removed entities can no longer be spawned, so their names are no longer needed
+    for (const uint32 id : m_removedArray) {
+        m_nameTable.remove(id);
+    }
+    m_removedArray.fastClear();
+
+    return current->sequence;
+}
+
+
+void EntityReplicator::encode(ClientID client, BinaryOutput& message) const {
+    debugAssert((client >= 0) && (client < m_clientArray.size()) && m_clientArray[client].inUse);
+    debugAssertM(m_history.size() > 0, "Call snapshot() before encode()");
+
+    const Snapshot& current = *m_history.last();
+    const shared_ptr<Snapshot>& baseline = findSnapshot(m_clientArray[client].acknowledged);
+    static const Array<Record> empty;
+    const Array<Record>& baseArray = notNull(baseline) ? baseline->recordArray : empty;
+    const Array<Record>& currentArray = current.recordArray;
+
+    // Find the records to send by merging the two arrays in id order
+    class Change {
+    public:
+        RecordType  type;
+        /** Index in currentArray, or in baseArray for REMOVE */
+        int         index;
+        /** Index in baseArray for UPDATE */
+        int         baseIndex;
+    };
+    Array<Change> changeArray;
+    int c = 0, b = 0;
+    while ((c < currentArray.size()) || (b < baseArray.size())) {
+        if ((b == baseArray.size()) || ((c < currentArray.size()) && (currentArray[c].id < baseArray[b].id))) {
+            changeArray.append(Change{SPAWN, c, -1});
+            ++c;
+        } else if ((c == currentArray.size()) || (baseArray[b].id < currentArray[c].id)) {
+            changeArray.append(Change{REMOVE, b, -1});
+            ++b;
+        } else {
+            if (currentArray[c].frame != baseArray[b].frame) {
+                changeArray.append(Change{UPDATE, c, b});
+            }
+            ++c;
+            ++b;
+        }
+    }
+
+    message.writeUInt32(current.sequence);
+    message.writeUInt32(notNull(baseline) ? baseline->sequence : 0);
+    message.writeUInt32(changeArray.size());
+
+    if (changeArray.size() > 0) {
+        message.beginBits();
+        uint32 previousID = 0;
+        for (const Change& change : changeArray) {
+            const Record& record = (change.type == REMOVE) ? baseArray[change.index] : currentArray[change.index];
+
+            // Ids are increasing, so send the small gaps between them
+            QuantizedPhysicsFrame::writeSignedBits(message, int32(record.id - previousID));
+            previousID = record.id;
+            message.writeBits(change.type, 2);
+
+            if (change.type == UPDATE) {
+                record.frame.serializeDeltaBits(baseArray[change.baseIndex].frame, message, m_specification.format);
+            } else if (change.type == SPAWN) {
+                record.frame.serializeBits(message, m_specification.format);
+            }
+        }
+        message.endBits();
+
+        // Names of new entities, in order
+        for (const Change& change : changeArray) {
+            if (change.type == SPAWN) {
+                message.writeString(m_nameTable[currentArray[change.index].id]);
+            }
+        }
+    }
+}
+
+
+void EntityReplicator::send() {
+    snapshot();
+    for (ClientID id = 0; id < m_clientArray.size(); ++id) {
+        const Client& client = m_clientArray[id];
+        if (client.inUse && notNull(client.connection)) {
+            m_message.reset();
+            encode(id, m_message);
+            client.connection->send(m_specification.messageType, m_message, m_specification.channel);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+
+shared_ptr<EntityReplicator::Receiver> EntityReplicator::Receiver::create(const QuantizedPhysicsFrame::Format& format) {
+    return createShared<Receiver>(format);
+}
+
+
+void EntityReplicator::Receiver::add(const shared_ptr<Entity>& entity) {
+    m_entityTable.set(entity->name(), entity);
+
+    // Apply the frame that may already have been received
+    PhysicsFrame frame;
+    if (getFrame(entity->name(), frame)) {
+        entity->setFrame(frame);
+    }
+}
+
+
+void EntityReplicator::Receiver::remove(const shared_ptr<Entity>& entity) {
+    m_entityTable.remove(entity->name());
+}
+
+
+void EntityReplicator::Receiver::apply(uint32 id, const QuantizedPhysicsFrame& frame) {
+    const String* name = m_nameTable.getPointer(id);
+    if (notNull(name)) {
+        const shared_ptr<Entity>* entity = m_entityTable.getPointer(*name);
+        if (notNull(entity)) {
+            (*entity)->setFrame(frame.toPhysicsFrame(m_format));
+        }
+    }
+}
+
+
+uint32 EntityReplicator::Receiver::receive(BinaryInput& message) {
+    const uint32 sequence = message.readUInt32();
+    const uint32 baseSequence = message.readUInt32();
+    const int numChanges = int(message.readUInt32());
+
+    if (sequence <= this->sequence()) {
+        // Duplicate or out of order
+        return 0;
+    }
+
+    // Find the baseline. The server never uses a baseline older than one it used
+    // before, so older snapshots can be dropped.
+    shared_ptr<Snapshot> baseline;
+    if (baseSequence != 0) {
+        int b = 0;
+        while ((b < m_history.size()) && (m_history[b]->sequence != baseSequence)) {
+            ++b;
+        }
+        if (b == m_history.size()) {
+            return 0;
+        }
+        baseline = m_history[b];
+        if (b > 0) {
+            m_history.remove(0, b);
+        }
+    } else {
+        m_history.fastClear();
+    }
+
+    static const Array<Record> empty;
+    const Array<Record>& baseArray = notNull(baseline) ? baseline->recordArray : empty;
+
+    const shared_ptr<Snapshot>& current = createShared<Snapshot>();
+    current->sequence = sequence;
+    Array<Record>& currentArray = current->recordArray;
+    currentArray.reserve(baseArray.size() + numChanges);
+
+    Array<uint32> spawnArray;
+    Array<uint32> removeArray;
+    int b = 0;
+    if (numChanges > 0) {
+        message.beginBits();
+        uint32 id = 0;
+        for (int i = 0; i < numChanges; ++i) {
+            id += uint32(QuantizedPhysicsFrame::readSignedBits(message));
+            const RecordType type = RecordType(message.readBits(2));
+
+            // Unchanged entities before this one
+            while ((b < baseArray.size()) && (baseArray[b].id < id)) {
+                currentArray.append(baseArray[b]);
+                ++b;
+            }
+
+            if (type == REMOVE) {
+                debugAssert((b < baseArray.size()) && (baseArray[b].id == id));
+                removeArray.append(id);
+                ++b;
+            } else {
+                Record& record = currentArray.next();
+                record.id = id;
+                if (type == UPDATE) {
+                    debugAssert((b < baseArray.size()) && (baseArray[b].id == id));
+                    record.frame.deserializeDeltaBits(baseArray[b].frame, message, m_format);
+                    ++b;
+                } else {
+                    record.frame.deserializeBits(message, m_format);
+                    spawnArray.append(id);
+                }
+            }
+        }
+        message.endBits();
+    }
+    while (b < baseArray.size()) {
+        currentArray.append(baseArray[b]);
+        ++b;
+    }
+
+    for (const uint32 id : spawnArray) {
+        const String& name = message.readString();
+        m_nameTable.set(id, name);
+        m_idTable.set(name, id);
+    }
+
+    for (const uint32 id : removeArray) {
+        const String* name = m_nameTable.getPointer(id);
+        if (notNull(name)) {
+            // The name may have been reused by an entity spawned in the same message
+            const uint32* currentID = m_idTable.getPointer(*name);
+            if (notNull(currentID) && (*currentID == id)) {
+                m_idTable.remove(*name);
+            }
+            m_nameTable.remove(id);
+        }
+    }
+
+    // Apply the frames of the entities that changed. Both arrays are sorted by id.
+    b = 0;
+    for (const Record& record : currentArray) {
+        while ((b < baseArray.size()) && (baseArray[b].id < record.id)) {
+            ++b;
+        }
+        if ((b == baseArray.size()) || (baseArray[b].id != record.id) || (baseArray[b].frame != record.frame)) {
+            apply(record.id, record.frame);
+        }
+    }
+
+    m_history.append(current);
+    return sequence;
+}
+
+
+bool EntityReplicator::Receiver::getFrame(const String& entityName, PhysicsFrame& frame) const {
+    const uint32* id = m_idTable.getPointer(entityName);
+    if (isNull(id) || (m_history.size() == 0)) {
+        return false;
+    }
+
+    // Binary search, since the records are sorted by id
+    const Array<Record>& recordArray = m_history.last()->recordArray;
+    int lo = 0, hi = recordArray.size();
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (recordArray[mid].id < *id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if ((lo < recordArray.size()) && (recordArray[lo].id == *id)) {
+        frame = recordArray[lo].frame.toPhysicsFrame(m_format);
+        return true;
+    } else {
+        return false;
+    }
+}
+
+} // namespace G3D
@@ -0,0 +1,133 @@
+/**
+  \file G3D-app.lib/source/FramePipeline.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-app/FramePipeline.h"
+#include "G3D-app/Surface.h"
+#include "G3D-base/System.h"
+#include "G3D-gfx/Profiler.h"
+
+namespace G3D {
+
+FramePipeline::FramePipeline() :
+    m_front(0),
+    m_busy(false),
+    m_quit(false),
+    m_jobTime(0) {
+
+    m_thread = std::thread([this]() { threadMain(); });
+}
+
+
+shared_ptr<FramePipeline> FramePipeline::create() {
+    return createShared<FramePipeline>();
+}
+
+
+FramePipeline::~FramePipeline() {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return ! m_busy; });
+        m_quit = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+
+void FramePipeline::threadMain() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_condition.wait(lock, [this]() { return m_busy || m_quit; });
+        if (! m_busy) {
+            // Quit
+            break;
+        }
+
+        Job job;
+        std::swap(job, m_job);
+        Frame& frame = back();
+        lock.unlock();
+
+        std::exception_ptr exception;
+        const RealTime start = System::time();
+        try {
+            job(frame);
+        } catch (...) {
+            exception = std::current_exception();
+        }
+        const RealTime duration = System::time() - start;
+
+        // Release anything that the job captured before reporting completion
+        job = nullptr;
+
+        lock.lock();
+        m_exception = exception;
+        m_jobTime = duration;
+        m_busy = false;
+        m_condition.notify_all();
+    }
+    lock.unlock();
+
+    // Events recorded by jobs belong to this thread
+    Profiler::threadShutdownHook();
+}
+
+
+void FramePipeline::launch(const Job& job) {
+    debugAssert(job);
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return ! m_busy; });
+        m_job = job;
+        m_exception = nullptr;
+        m_busy = true;
+    }
+    m_condition.notify_all();
+}
+
+
+void FramePipeline::wait() {
+    std::exception_ptr exception;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return ! m_busy; });
+        std::swap(exception, m_exception);
+    }
+
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+
+bool FramePipeline::busy() const {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_busy;
+}
+
+
+void FramePipeline::swap() {
+    wait();
+    m_front = 1 - m_front;
+    back().fastClear();
+}
+
+
+void FramePipeline::clear() {
+    wait();
+    m_frame[0].fastClear();
+    m_frame[1].fastClear();
+}
+
+
+RealTime FramePipeline::jobTime() const {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_jobTime;
+}
+
+} // namespace G3D
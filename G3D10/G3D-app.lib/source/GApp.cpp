@@ -45,6 +45,7 @@
 #include "G3D-gfx/XR.h"
 #include "G3D-app/XRWidget.h"
 #include <time.h>
+#include <thread>
 
 // Force discrete GPU on Optimus
 // http://developer.download.nvidia.com/devzone/devcenter/gamegraphics/files/OptimusRenderingPolicies.pdf
@@ -130,7 +131,7 @@ void GApp::vscreenPrintf
         const Array<String>& newlineSeparatedStrings = stringSplit(s, '\n');
 
         std::lock_guard<std::mutex> guard(m_debugTextMutex);
-        debugText.append(newlineSeparatedStrings);
+        (pipelined() ? m_pipelineDebugText : debugText).append(newlineSeparatedStrings);
     }
 }
 
@@ -441,6 +442,9 @@ void GApp::initializeOpenGL(RenderDevice* rd, OSWindow* window, bool createWindo
 GApp::GApp(const Settings& settings, OSWindow* window, RenderDevice* rd, bool createWindowIfNull) :
     m_lastDebugID(0),
     m_screenCapture(nullptr),
+    m_window(nullptr),
+    m_hasUserCreatedWindow(false),
+    m_hasUserCreatedRenderDevice(false),
     m_submitToDisplayMode(SubmitToDisplayMode::MAXIMIZE_THROUGHPUT),
     m_settings(settings),
     m_renderPeriod(1),
@@ -450,6 +454,8 @@ GApp::GApp(const Settings& settings, OSWindow* window, RenderDevice* rd, bool cr
     m_debugTextOutlineColor(Color3(0.7f)),
     m_currentEyeIndex(0),
     m_lastFrameOverWait(0),
+    m_nextHeadlessStepTime(0),
+    m_headlessOverSleep(0),
     debugPane(nullptr),
     renderDevice(nullptr),
     userInput(nullptr),
@@ -522,15 +528,41 @@ GApp::GApp(const Settings& settings, OSWindow* window, RenderDevice* rd, bool cr
         ScreenCapture::checkAppScmRevision(m_settings.screenCapture.outputDirectory);
     }
 
-    if (createWindowIfNull || notNull(window)) {
-        initializeOpenGL(renderDevice, window, createWindowIfNull, settings);
+    if (settings.headless.enabled) {
+        debugAssertM(isNull(window) && isNull(rd), "Headless GApps cannot have an OSWindow or RenderDevice");
+        initializeHeadless();
+    } else {
+        if (createWindowIfNull || notNull(window)) {
+            initializeOpenGL(renderDevice, window, createWindowIfNull, settings);
+        }
+        // Initialize with monocular gaze tracking
+        m_gazeTracker = EmulatedGazeTracker::create(this, true);
     }
-    // Initialize with monocular gaze tracking
-    m_gazeTracker = EmulatedGazeTracker::create(this, true);
     logPrintf("Done GApp::GApp()\n\n");
 }
 
 
+void GApp::initializeHeadless() {
+    // Only the CPU state that the default onAI, onNetwork,
+    // and onSimulation use; nothing that requires OpenGL
+    m_widgetManager = WidgetManager::create(nullptr);
+
+    m_debugCamera  = Camera::create("(Debug Camera)");
+    m_debugCamera->setPosition(Vector3(0, 0, 4));
+    m_debugCamera->lookAt(Vector3::zero());
+    m_activeCamera = m_debugCamera;
+
+    m_activeCameraMarker = MarkerEntity::create("(Active Camera Marker)", nullptr,
+        Array<Box>(Box(Point3(-0.11f, -0.11f, -0.11f), Point3(0.11f, 0.11f, 0.11f))), Color3::green());
+    m_activeCameraMarker->setShouldBeSaved(false);
+    m_activeListener = m_activeCameraMarker;
+
+    m_simTime      = 0;
+    m_realTime     = 0;
+    m_lastWaitTime = System::time();
+}
+
+
 CFrame GApp::headFrame() const {
     // Try to find a tracked head
     if (m_scene) {
@@ -883,7 +915,14 @@ int GApp::run() {
 
 
 void GApp::onRun() {
-    if (window()->requiresMainLoop()) {
+    if (headless()) {
+        beginRun();
+        do {
+            oneHeadlessFrame();
+        } while (! m_endProgram);
+        endRun();
+
+    } else if (window()->requiresMainLoop()) {
 
         // The window push/pop will take care of
         // calling beginRun/oneFrame/endRun for us.
@@ -905,7 +944,9 @@ void GApp::onRun() {
 
 void GApp::loadScene(const String& sceneName) {
     // Use immediate mode rendering to force a simple message onto the screen
-    drawMessage("Loading " + sceneName + "...");
+    if (! headless()) {
+        drawMessage("Loading " + sceneName + "...");
+    }
 
     const String oldSceneName = scene()->name();
 
@@ -925,7 +966,9 @@ void GApp::loadScene(const String& sceneName) {
             // instead of assigning a pointer to it.
             m_debugCamera->copyParametersFrom(scene()->defaultCamera());
             m_debugCamera->setTrack(nullptr);
-            m_debugController->setFrame(m_debugCamera->frame());
+            if (notNull(m_debugController)) {
+                m_debugController->setFrame(m_debugCamera->frame());
+            }
 
             setActiveCamera(scene()->defaultCamera());
         }
@@ -937,20 +980,33 @@ void GApp::loadScene(const String& sceneName) {
         const String& msg = e.filename + format(":%d(%d): ", e.line, e.character) + e.message;
         debugPrintf("%s", msg.c_str());
         logPrintf("%s", msg.c_str());
-        drawMessage(msg);
-        System::sleep(5);
+        if (! headless()) {
+            drawMessage(msg);
+            System::sleep(5);
+        }
         scene()->clear();
         scene()->lightingEnvironment().ambientOcclusion = m_ambientOcclusion;
     }
 
-    // Trigger one frame of rendering, to force shaders to load and compile
-    m_posed3D.fastClear();
-    m_posed2D.fastClear();
-    if (scene()) {
-        onPose(m_posed3D, m_posed2D);
+    if (notNull(m_framePipeline)) {
+        // Surfaces posed from the old scene must not be rendered
+        m_framePipeline->clear();
     }
 
-    onGraphics(renderDevice, m_posed3D, m_posed2D);
+    if (pipelined()) {
+        snapshotForRendering();
+    }
+
+    // Trigger one frame of rendering, to force shaders to load and compile
+    if (! headless()) {
+        m_posed3D.fastClear();
+        m_posed2D.fastClear();
+        if (scene()) {
+            onPose(m_posed3D, m_posed2D);
+        }
+
+        onGraphics(renderDevice, m_posed3D, m_posed2D);
+    }
 
     // Reset our idea of "now" so that simulation doesn't see a huge lag
     // due to the scene load time.
@@ -1132,7 +1188,7 @@ void GApp::onGraphics3D(RenderDevice* rd, Array<shared_ptr<Surface> >& allSurfac
         }
         rd->clear();
         rd->pushState(); {
-            rd->setProjectionAndCameraMatrix(activeCamera()->projection(), activeCamera()->frame());
+            rd->setProjectionAndCameraMatrix(renderCamera()->projection(), renderCamera()->frame());
             drawDebugShapes();
         } rd->popState();
         return;
@@ -1146,18 +1202,22 @@ void GApp::onGraphics3D(RenderDevice* rd, Array<shared_ptr<Surface> >& allSurfac
     const Vector2int32 framebufferSize = m_settings.hdrFramebuffer.hdrFramebufferSizeFromDeviceSize(Vector2int32(m_deviceFramebuffer->vector2Bounds()));
     m_framebuffer->resize(framebufferSize);
     m_gbuffer->resize(framebufferSize);
-    m_gbuffer->prepare(rd, activeCamera(), 0, -(float)previousSimTimeStep(), m_settings.hdrFramebuffer.depthGuardBandThickness, m_settings.hdrFramebuffer.colorGuardBandThickness);
+    m_gbuffer->prepare(rd, renderCamera(), 0, -(float)previousSimTimeStep(), m_settings.hdrFramebuffer.depthGuardBandThickness, m_settings.hdrFramebuffer.colorGuardBandThickness);
 
-    m_renderer->render(rd, activeCamera(), m_framebuffer, scene()->lightingEnvironment().ambientOcclusionSettings.enabled ? m_depthPeelFramebuffer : nullptr, 
-        scene()->lightingEnvironment(), m_gbuffer, allSurfaces);
+    LightingEnvironment& lightingEnvironment = renderLightingEnvironment();
+    m_renderer->render(rd, renderCamera(), m_framebuffer, lightingEnvironment.ambientOcclusionSettings.enabled ? m_depthPeelFramebuffer : nullptr, 
+        lightingEnvironment, m_gbuffer, allSurfaces);
 
     // Debug visualizations and post-process effects
     rd->pushState(m_framebuffer); {
         // Call to make the App show the output of debugDraw(...)
-        rd->setProjectionAndCameraMatrix(activeCamera()->projection(), activeCamera()->frame());
+        rd->setProjectionAndCameraMatrix(renderCamera()->projection(), renderCamera()->frame());
         drawDebugShapes();
-        const shared_ptr<Entity>& selectedEntity = (notNull(developerWindow) && notNull(developerWindow->sceneEditorWindow)) ? developerWindow->sceneEditorWindow->selectedEntity() : nullptr;
-        scene()->visualize(rd, selectedEntity, allSurfaces, sceneVisualizationSettings(), activeCamera());
+        if (! pipelined()) {
+            // Visualization reads the live entities, which the simulation thread may be moving
+            const shared_ptr<Entity>& selectedEntity = (notNull(developerWindow) && notNull(developerWindow->sceneEditorWindow)) ? developerWindow->sceneEditorWindow->selectedEntity() : nullptr;
+            scene()->visualize(rd, selectedEntity, allSurfaces, sceneVisualizationSettings(), renderCamera());
+        }
 
         onPostProcessHDR3DEffects(rd);
     } rd->popState();
@@ -1176,21 +1236,21 @@ void GApp::onGraphics3D(RenderDevice* rd, Array<shared_ptr<Surface> >& allSurfac
     END_PROFILER_EVENT();
 
     // Perform gamma correction, bloom, and SSAA, and write to the native window frame buffer
-    m_film->exposeAndRender(rd, activeCamera()->filmSettings(), m_framebuffer->texture(0), 
+    m_film->exposeAndRender(rd, renderCamera()->filmSettings(), m_framebuffer->texture(0), 
         settings().hdrFramebuffer.trimBandThickness().x,
         settings().hdrFramebuffer.depthGuardBandThickness.x,
         Texture::opaqueBlackIfNull(notNull(m_gbuffer) ? m_gbuffer->texture(GBuffer::Field::SS_POSITION_CHANGE) : nullptr),
-        activeCamera()->jitterMotion());
+        renderCamera()->jitterMotion());
     END_PROFILER_EVENT();
 }
 
 
 void GApp::onPostProcessHDR3DEffects(RenderDevice* rd) {
     // Post-process special effects
-    m_depthOfField->apply(rd, m_framebuffer->texture(0), m_framebuffer->texture(Framebuffer::DEPTH), activeCamera(), m_settings.hdrFramebuffer.depthGuardBandThickness - m_settings.hdrFramebuffer.colorGuardBandThickness);
+    m_depthOfField->apply(rd, m_framebuffer->texture(0), m_framebuffer->texture(Framebuffer::DEPTH), renderCamera(), m_settings.hdrFramebuffer.depthGuardBandThickness - m_settings.hdrFramebuffer.colorGuardBandThickness);
 
     m_motionBlur->apply(rd, m_framebuffer->texture(0), m_gbuffer->texture(GBuffer::Field::SS_POSITION_CHANGE),
-                        m_framebuffer->texture(Framebuffer::DEPTH), activeCamera(),
+                        m_framebuffer->texture(Framebuffer::DEPTH), renderCamera(),
                         m_settings.hdrFramebuffer.depthGuardBandThickness - m_settings.hdrFramebuffer.colorGuardBandThickness);
 }
 
@@ -1203,8 +1263,8 @@ void GApp::onGraphics2D(RenderDevice* rd, Array<shared_ptr<Surface2D> >& posed2D
 void GApp::onGraphics(RenderDevice* rd, Array<shared_ptr<Surface> >& posed3D, Array<shared_ptr<Surface2D> >& posed2D) {
 
     rd->pushState(); {
-        debugAssert(notNull(activeCamera()));
-        rd->setProjectionAndCameraMatrix(activeCamera()->projection(), activeCamera()->frame());
+        debugAssert(notNull(renderCamera()));
+        rd->setProjectionAndCameraMatrix(renderCamera()->projection(), renderCamera()->frame());
         onGraphics3D(rd, posed3D);
     } rd->popState();
     
@@ -1281,6 +1341,11 @@ void GApp::resize(int w, int h) {
 
 
 void GApp::oneFrame() {
+    if (pipelined()) {
+        onePipelinedFrame();
+        return;
+    }
+
     for (int repeat = 0; repeat < max(1, m_renderPeriod); ++repeat) {
         Profiler::nextFrame();
         m_lastTime = m_now;
@@ -1320,26 +1385,15 @@ void GApp::oneFrame() {
         m_simulationWatch.tick();
         BEGIN_PROFILER_EVENT("Simulation");
         {
-            RealTime rdt = timeStep;
-
-            SimTime sdt = m_simTimeStep;
-            if (sdt == MATCH_REAL_TIME_TARGET) {
-                sdt = m_wallClockTargetDuration;
-            } else if (sdt == REAL_TIME) {
-                sdt = float(timeStep);
-            }
-            sdt *= m_simTimeScale;
-
-            SimTime idt = m_wallClockTargetDuration;
+            RealTime rdt;
+            SimTime sdt, idt;
+            computeSimulationTimeSteps(timeStep, rdt, sdt, idt);
 
             onBeforeSimulation(rdt, sdt, idt);
             onSimulation(rdt, sdt, idt);
             onAfterSimulation(rdt, sdt, idt);
 
-            m_previousSimTimeStep = float(sdt);
-            m_previousRealTimeStep = float(rdt);
-            setRealTime(realTime() + rdt);
-            setSimTime(simTime() + sdt);
+            advanceTime(rdt, sdt);
         }
         m_simulationWatch.tock();
         END_PROFILER_EVENT();
@@ -1348,18 +1402,168 @@ void GApp::oneFrame() {
     // Pose
     BEGIN_PROFILER_EVENT("Pose");
     m_poseWatch.tick(); {
-        m_posed3D.fastClear();
-        m_posed2D.fastClear();
-        onPose(m_posed3D, m_posed2D);
-
-        // The debug camera is not in the scene, so we have
-        // to explicitly pose it. This actually does nothing, but
-        // it allows us to trigger the TAA code.
-        m_debugCamera->onPose(m_posed3D);
+        poseFrame(m_posed3D, m_posed2D);
     } m_poseWatch.tock();
     END_PROFILER_EVENT();
 
-    // Wait
+    waitForNextFrame();
+    renderFrame(m_posed3D, m_posed2D);
+
+    removeExpiredDebugOutput();
+
+    m_posed3D.fastClear();
+    m_posed2D.fastClear();
+
+    if (m_endProgram && window()->requiresMainLoop()) {
+        window()->popLoopBody();
+    }
+}
+
+
+void GApp::onePipelinedFrame() {
+    debugAssert(notNull(m_framePipeline));
+
+    // The simulation thread is idle, so the profiler can latch its events as well
+    Profiler::nextFrame();
+    m_lastTime = m_now;
+    m_now = System::time();
+    const RealTime timeStep = m_now - m_lastTime;
+
+    // User input
+    m_userInputWatch.tick();
+    if (manageUserInput) {
+        processGEventQueue();
+    }
+    onAfterEvents();
+    onUserInput(userInput);
+    m_userInputWatch.tock();
+
+    if (notNull(m_gazeTracker)) {
+        BEGIN_PROFILER_EVENT("GApp::sampleGazeTrackerData");
+        sampleGazeTrackerData();
+        END_PROFILER_EVENT();
+    }
+
+    // Network
+    BEGIN_PROFILER_EVENT("GApp::onNetwork");
+    m_networkWatch.tick();
+    onNetwork();
+    m_networkWatch.tock();
+    END_PROFILER_EVENT();
+
+    RealTime rdt;
+    SimTime sdt, idt;
+    computeSimulationTimeSteps(timeStep, rdt, sdt, idt);
+
+    // Widgets are not thread safe, so they always simulate on this thread, before the Scene does
+    BEGIN_PROFILER_EVENT("WidgetManager::onSimulation");
+    m_widgetManager->onAI();
+    simulateWidgetsAndDebugCamera(rdt, sdt, idt);
+    END_PROFILER_EVENT();
+
+    // Simulate (and perhaps pose) the next frame on the worker...
+    const bool poseOnWorkerThread = m_settings.pipeline.poseOnWorkerThread;
+    m_framePipeline->launch([this, rdt, sdt, idt, poseOnWorkerThread](FramePipeline::Frame& frame) {
+        m_pipelineLogicWatch.tick();
+        BEGIN_PROFILER_EVENT("GApp::onAI");
+        onAI();
+        END_PROFILER_EVENT();
+        m_pipelineLogicWatch.tock();
+
+        m_pipelineSimulationWatch.tick();
+        BEGIN_PROFILER_EVENT("Simulation");
+        {
+            RealTime r = rdt;
+            SimTime s = sdt, i = idt;
+            onBeforeSimulation(r, s, i);
+            onSimulation(r, s, i);
+            onAfterSimulation(r, s, i);
+        }
+        END_PROFILER_EVENT();
+        m_pipelineSimulationWatch.tock();
+
+        if (poseOnWorkerThread) {
+            BEGIN_PROFILER_EVENT("Pose");
+            m_pipelinePoseWatch.tick(); {
+                poseFrame(frame.posed3D, frame.posed2D);
+            } m_pipelinePoseWatch.tock();
+            END_PROFILER_EVENT();
+        }
+    });
+
+    // ...while rendering the surfaces posed for the previous one
+    waitForNextFrame();
+    FramePipeline::Frame& front = m_framePipeline->front();
+    renderFrame(front.posed3D, front.posed2D);
+
+    BEGIN_PROFILER_EVENT("FramePipeline::wait");
+    m_framePipeline->wait();
+    END_PROFILER_EVENT();
+
+    advanceTime(rdt, sdt);
+    m_logicWatch = m_pipelineLogicWatch;
+    m_simulationWatch = m_pipelineSimulationWatch;
+
+    // Pose
+    FramePipeline::Frame& back = m_framePipeline->back();
+    BEGIN_PROFILER_EVENT("Pose");
+    if (poseOnWorkerThread) {
+        m_poseWatch = m_pipelinePoseWatch;
+        m_widgetManager->onPose(back.posed3D, back.posed2D);
+    } else {
+        m_poseWatch.tick(); {
+            poseFrame(back.posed3D, back.posed2D);
+        } m_poseWatch.tock();
+    }
+    END_PROFILER_EVENT();
+
+    snapshotForRendering();
+    m_framePipeline->swap();
+
+    removeExpiredDebugOutput();
+
+    if (m_endProgram && window()->requiresMainLoop()) {
+        window()->popLoopBody();
+    }
+}
+
+
+void GApp::computeSimulationTimeSteps(RealTime timeStep, RealTime& rdt, SimTime& sdt, SimTime& idt) const {
+    rdt = timeStep;
+
+    sdt = m_simTimeStep;
+    if (sdt == MATCH_REAL_TIME_TARGET) {
+        sdt = m_wallClockTargetDuration;
+    } else if (sdt == REAL_TIME) {
+        sdt = float(timeStep);
+    }
+    sdt *= m_simTimeScale;
+
+    idt = m_wallClockTargetDuration;
+}
+
+
+void GApp::advanceTime(RealTime rdt, SimTime sdt) {
+    m_previousSimTimeStep = float(sdt);
+    m_previousRealTimeStep = float(rdt);
+    setRealTime(realTime() + rdt);
+    setSimTime(simTime() + sdt);
+}
+
+
+void GApp::poseFrame(Array<shared_ptr<Surface> >& posed3D, Array<shared_ptr<Surface2D> >& posed2D) {
+    posed3D.fastClear();
+    posed2D.fastClear();
+    onPose(posed3D, posed2D);
+
+    // The debug camera is not in the scene, so we have
+    // to explicitly pose it. This actually does nothing, but
+    // it allows us to trigger the TAA code.
+    m_debugCamera->onPose(posed3D);
+}
+
+
+void GApp::waitForNextFrame() {
     // Note: we might end up spending all of our time inside of
     // RenderDevice::beginFrame.  Waiting here isn't double waiting,
     // though, because while we're sleeping the CPU the GPU is working
@@ -1396,7 +1600,10 @@ void GApp::oneFrame() {
         }
     }  m_waitWatch.tock();
     END_PROFILER_EVENT();
+}
+
 
+void GApp::renderFrame(Array<shared_ptr<Surface> >& posed3D, Array<shared_ptr<Surface2D> >& posed2D) {
     debugAssertGLOk();
     if ((submitToDisplayMode() == SubmitToDisplayMode::BALANCE) && (! renderDevice->swapBuffersAutomatically())) {
         swapBuffers();
@@ -1409,7 +1616,7 @@ void GApp::oneFrame() {
         debugAssertGLOk();
         renderDevice->pushState(); {
             debugAssertGLOk();
-            onGraphics(renderDevice, m_posed3D, m_posed2D);
+            onGraphics(renderDevice, posed3D, posed2D);
         } renderDevice->popState();
     }  m_graphicsWatch.tock();
     renderDevice->endFrame();
@@ -1417,7 +1624,40 @@ void GApp::oneFrame() {
         swapBuffers();
     }
     END_PROFILER_EVENT();
+}
+
+
+void GApp::snapshotForRendering() {
+    if (isNull(m_renderCamera)) {
+        m_renderCamera = Camera::create("(Render Camera)");
+    }
+    m_renderCamera->copyParametersFrom(activeCamera());
 
+    // Keep the textures that the renderer caches in the snapshot, but copy
+    // the lights, which onSimulation may move during the next frame
+    m_renderLightingEnvironment.lightArray.fastClear();
+    if (notNull(scene())) {
+        const LightingEnvironment& environment = scene()->lightingEnvironment();
+        for (const shared_ptr<Light>& light : environment.lightArray) {
+            m_renderLightingEnvironment.lightArray.append(shared_ptr<Light>(new Light(*light)));
+        }
+        m_renderLightingEnvironment.ambientOcclusion = environment.ambientOcclusion;
+        m_renderLightingEnvironment.ambientOcclusionSettings = environment.ambientOcclusionSettings;
+        m_renderLightingEnvironment.environmentMapArray = environment.environmentMapArray;
+        m_renderLightingEnvironment.environmentMapWeightArray = environment.environmentMapWeightArray;
+        m_renderLightingEnvironment.uniformTable = environment.uniformTable;
+    }
+
+    m_renderDebugShapeArray = debugShapeArray;
+    m_renderDebugLabelArray = debugLabelArray;
+
+    std::lock_guard<std::mutex> guard(m_debugTextMutex);
+    Array<String>::swap(debugText, m_pipelineDebugText);
+    m_pipelineDebugText.fastClear();
+}
+
+
+void GApp::removeExpiredDebugOutput() {
     // Remove all expired debug shapes
     for (int i = 0; i < debugShapeArray.size(); ++i) {
         if (debugShapeArray[i].endTime <= m_now) {
@@ -1433,13 +1673,101 @@ void GApp::oneFrame() {
         }
     }
 
-    debugText.fastClear();
+    if (! pipelined()) {
+        // Otherwise snapshotForRendering replaced it
+        debugText.fastClear();
+    }
+}
 
-    m_posed3D.fastClear();
-    m_posed2D.fastClear();
 
-    if (m_endProgram && window()->requiresMainLoop()) {
-        window()->popLoopBody();
+void GApp::oneHeadlessFrame() {
+    const Settings::Headless& settings = m_settings.headless;
+    const RealTime period = m_wallClockTargetDuration;
+    debugAssert(period > 0.0);
+
+    // Wait
+    m_waitWatch.tick(); {
+        sleepUntil(m_nextHeadlessStepTime);
+    } m_waitWatch.tock();
+    m_headlessStats.idleTime += m_waitWatch.elapsedTime();
+
+    // Run every step that is due, up to the catch-up limit
+    int steps = 0;
+    for (RealTime now = System::time(); (now >= m_nextHeadlessStepTime) && ! m_endProgram; now = System::time()) {
+        if (steps > settings.maxCatchUpSteps) {
+            // Too far behind to catch up; drop the missed steps rather than
+            // spiraling, and restart the schedule from now
+            const int64 missed = int64((now - m_nextHeadlessStepTime) / period) + 1;
+            m_headlessStats.droppedStepCount += missed;
+            m_nextHeadlessStepTime = now + period;
+            break;
+        }
+
+        m_lastTime = m_now;
+        m_now = now;
+
+        // Logic
+        m_logicWatch.tick();
+        onAI();
+        m_logicWatch.tock();
+
+        // Network
+        m_networkWatch.tick();
+        onNetwork();
+        m_networkWatch.tock();
+
+        // Simulation on a fixed timestep, so that servers are reproducible
+        m_simulationWatch.tick(); {
+            RealTime rdt = period;
+
+            SimTime sdt = m_simTimeStep;
+            if ((sdt == MATCH_REAL_TIME_TARGET) || (sdt == REAL_TIME)) {
+                sdt = float(period);
+            }
+            sdt *= m_simTimeScale;
+
+            SimTime idt = float(period);
+
+            onBeforeSimulation(rdt, sdt, idt);
+            onSimulation(rdt, sdt, idt);
+            onAfterSimulation(rdt, sdt, idt);
+
+            m_previousSimTimeStep = float(sdt);
+            m_previousRealTimeStep = float(rdt);
+            setRealTime(realTime() + rdt);
+            setSimTime(simTime() + sdt);
+        } m_simulationWatch.tock();
+
+        m_headlessStats.busyTime += m_logicWatch.elapsedTime() + m_networkWatch.elapsedTime() + m_simulationWatch.elapsedTime();
+        ++m_headlessStats.stepCount;
+        if (steps > 0) {
+            ++m_headlessStats.catchUpStepCount;
+        }
+        ++steps;
+        m_nextHeadlessStepTime += period;
+
+        removeExpiredDebugOutput();
+    }
+}
+
+
+void GApp::sleepUntil(RealTime deadline) {
+    const RealTime spinTime = max(0.0, m_settings.headless.spinTime);
+
+    for (RealTime now = System::time(); now < deadline; now = System::time()) {
+        const RealTime sleepTime = deadline - now - spinTime - m_headlessOverSleep;
+        if (sleepTime > 0.0) {
+            System::sleep(sleepTime);
+
+            // Learn how much System::sleep overshoots and compensate
+            const RealTime overSleep = max(0.0, System::time() - now - sleepTime);
+            m_headlessOverSleep = lerp(m_headlessOverSleep, overSleep, 0.1);
+        } else if (spinTime > 0.0) {
+            std::this_thread::yield();
+        } else {
+            // Close enough
+            break;
+        }
     }
 }
 
@@ -1455,21 +1783,24 @@ void GApp::drawDebugShapes() {
     BEGIN_PROFILER_EVENT("GApp::drawDebugShapes");
     renderDevice->setObjectToWorldMatrix(CFrame());
 
-    if (debugShapeArray.size() > 0) {
+    const Array<DebugShape>& shapeArray = pipelined() ? m_renderDebugShapeArray : debugShapeArray;
+    const Array<DebugLabel>& labelArray = pipelined() ? m_renderDebugLabelArray : debugLabelArray;
+
+    if (shapeArray.size() > 0) {
 
         renderDevice->setPolygonOffset(-1.0f);
-        for (int i = 0; i < debugShapeArray.size(); ++i) {
-            const DebugShape& s = debugShapeArray[i];
+        for (int i = 0; i < shapeArray.size(); ++i) {
+            const DebugShape& s = shapeArray[i];
             s.shape->render(renderDevice, s.frame, s.solidColor, s.wireColor);
         }
         renderDevice->setPolygonOffset(0.0f);
     }
 
-    if (debugLabelArray.size() > 0) {
+    if (labelArray.size() > 0) {
         renderDevice->pushState(); {
             renderDevice->setDepthWrite(false);
-            for (int i = 0; i < debugLabelArray.size(); ++i) {
-                const DebugLabel& label = debugLabelArray[i];
+            for (int i = 0; i < labelArray.size(); ++i) {
+                const DebugLabel& label = labelArray[i];
                 if (! label.text.text().empty()) {
                     static const shared_ptr<GFont> defaultFont = GFont::fromFile(System::findDataFile("arial.fnt"));
                     const shared_ptr<GFont>& f = label.text.element(0).font(defaultFont);
@@ -1514,6 +1845,11 @@ void GApp::setSimTime(SimTime s) {
 
 
 void GApp::onInit() {
+    if (headless()) {
+        setScene(Scene::create(m_ambientOcclusion));
+        return;
+    }
+
     // create screen capture after data directory is set and opengl initialized
     const shared_ptr<GFont>& devFont = GFont::fromFile(System::findDataFile(m_settings.developerToolsFontName));
     const shared_ptr<GuiTheme>& devTheme = GuiTheme::fromFile(System::findDataFile(m_settings.developerToolsThemeName), devFont);
@@ -1542,6 +1878,16 @@ void GApp::onCleanup() {}
 
 
 void GApp::onSimulation(RealTime rdt, SimTime sdt, SimTime idt) {
+    if (! onPipelineThread()) {
+        // onePipelinedFrame runs these on the main thread
+        simulateWidgetsAndDebugCamera(rdt, sdt, idt);
+    }
+
+    if (scene()) { scene()->onSimulation(sdt); }
+}
+
+
+void GApp::simulateWidgetsAndDebugCamera(RealTime rdt, SimTime sdt, SimTime idt) {
     if (notNull(m_cameraManipulator)) { m_cameraManipulator->setEnabled(activeCamera() == m_debugCamera); }
 
     m_widgetManager->onSimulation(rdt, sdt, idt);
@@ -1562,8 +1908,6 @@ void GApp::onSimulation(RealTime rdt, SimTime sdt, SimTime idt) {
         // m_activeCameraMarker to match it instead of using a Entity::Track.
         m_activeCameraMarker->setFrame(m_debugCamera->frame());
     }
-
-    if (scene()) { scene()->onSimulation(sdt); }
 }
 
 
@@ -1593,7 +1937,10 @@ void GApp::onAfterSimulation(RealTime rdt, SimTime sdt, SimTime idt) {
 
 
 void GApp::onPose(Array<shared_ptr<Surface> >& surface, Array<shared_ptr<Surface2D> >& surface2D) {
-    m_widgetManager->onPose(surface, surface2D);
+    if (! onPipelineThread()) {
+        // Otherwise onePipelinedFrame poses the Widgets on the main thread
+        m_widgetManager->onPose(surface, surface2D);
+    }
 
     if (scene()) {
         scene()->onPose(surface);
@@ -1607,7 +1954,9 @@ void GApp::onNetwork() {
 
 
 void GApp::onAI() {
-    m_widgetManager->onAI();
+    if (! onPipelineThread()) {
+        m_widgetManager->onAI();
+    }
 }
 
 
@@ -1616,6 +1965,10 @@ void GApp::beginRun() {
     m_endProgram = false;
     m_exitCode = 0;
 
+    if (pipelined()) {
+        m_framePipeline = FramePipeline::create();
+    }
+
     onInit();
 
     // Move the controller to the camera's location
@@ -1623,11 +1976,20 @@ void GApp::beginRun() {
         m_cameraManipulator->setFrame(m_debugCamera->frame());
     }
 
+    if (pipelined()) {
+        // There is nothing to render until the first frame has been simulated
+        snapshotForRendering();
+    }
+
     m_now = System::time() - 0.001;
+    m_nextHeadlessStepTime = System::time();
 }
 
 
 void GApp::endRun() {
+    // Release the posed surfaces while the OpenGL context still exists
+    m_framePipeline.reset();
+
     onCleanup();
 
     Log::common()->section("Files Used");
@@ -1673,7 +2035,7 @@ void GApp::endRun() {
     }
     Log::common()->println("");
 
-    if (window()->requiresMainLoop() && m_endProgram) {
+    if (notNull(window()) && window()->requiresMainLoop() && m_endProgram) {
         ::exit(m_exitCode);
     }
 }
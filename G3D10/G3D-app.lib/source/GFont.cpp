@@ -334,6 +334,102 @@ void GFont::renderCharVertexArray(RenderDevice* renderDevice, const Array<CPUCha
 }
 
 
+shared_ptr<GFont::Layout> GFont::layout(const String& s, float size, float wrapWidth, XAlign xalign, YAlign yalign, Spacing spacing) const {
+    // Strings are compared on lookup, so the parameters need not be hashed perfectly
+    uint32 params[3];
+    System::memcpy(&params[0], &size, sizeof(float));
+    System::memcpy(&params[1], &wrapWidth, sizeof(float));
+    params[2] = uint32(xalign) | (uint32(yalign) << 8) | (uint32(spacing) << 16);
+    const uint64 key = (uint64(superFastHash(s.c_str(), s.size())) << 32) | uint64(superFastHash(params, sizeof(params)));
+
+    std::lock_guard<std::mutex> lock(m_layoutMutex);
+
+    Table<uint64, shared_ptr<Layout>>& current = m_layoutCache[m_layoutGeneration];
+    bool created = false;
+    shared_ptr<Layout>& entry = current.getCreate(key, created);
+    if (created) {
+        const shared_ptr<Layout>* previous = m_layoutCache[1 - m_layoutGeneration].getPointer(key);
+        if (isNull(previous)) {
+            // Most strings that are drawn once are never drawn again, e.g., frame rate
+            // counters, so only remember that this one was seen
+            ++m_layoutCacheSize;
+            return nullptr;
+        }
+
+        // Still in use; move to the current generation
+        entry = *previous;
+        m_layoutCacheSize += 1 + (notNull(entry) ? entry->vertexArray.size() / 4 : 0);
+    }
+
+    if (notNull(entry) && (entry->text == s) && (entry->size == size) && (entry->wrapWidth == wrapWidth) &&
+        (entry->xalign == xalign) && (entry->yalign == yalign) && (entry->spacing == spacing)) {
+        return entry;
+    }
+
+    // Second use, or a hash collision. Lay out at the origin; the colors
+    // are supplied when the layout is appended.
+    Array<CPUCharVertex> cpuCharArray;
+    Array<int> indexArray;
+    const shared_ptr<Layout>& result = std::make_shared<Layout>();
+    result->text      = s;
+    result->size      = size;
+    result->wrapWidth = wrapWidth;
+    result->xalign    = xalign;
+    result->yalign    = yalign;
+    result->spacing   = spacing;
+    result->bounds    = layOutWordWrap(cpuCharArray, indexArray, wrapWidth, s, Point2(0, 0), size, Color4::zero(), Color4::zero(), xalign, yalign, spacing);
+    result->vertexArray.resize(cpuCharArray.size());
+    for (int v = 0; v < cpuCharArray.size(); ++v) {
+        result->vertexArray[v].texCoord = cpuCharArray[v].texCoord;
+        result->vertexArray[v].position = cpuCharArray[v].position;
+    }
+
+    entry = result;
+    m_layoutCacheSize += result->vertexArray.size() / 4;
+
+    if (m_layoutCacheSize > MAX_LAYOUT_CACHE_SIZE) {
+        m_layoutGeneration = 1 - m_layoutGeneration;
+        m_layoutCache[m_layoutGeneration].clear();
+        m_layoutCacheSize = 0;
+    }
+
+    return result;
+}
+
+
+Vector2 GFont::appendLayout
+   (const Layout&           layout,
+    const Point2&           pos2D,
+    const Color4&           color,
+    const Color4&           border,
+    Array<CPUCharVertex>&   cpuCharArray,
+    Array<int>&             indexArray) {
+
+    const int numVertices = layout.vertexArray.size();
+    const int firstVertex = cpuCharArray.size();
+    const int firstIndex  = indexArray.size();
+    cpuCharArray.resize(firstVertex + numVertices, false);
+    indexArray.resize(firstIndex + numVertices / 4 * 6, false);
+
+    const Layout::Vertex* src = layout.vertexArray.getCArray();
+    CPUCharVertex* dst = cpuCharArray.getCArray() + firstVertex;
+    for (int v = 0; v < numVertices; ++v) {
+        dst[v].texCoord    = src[v].texCoord;
+        dst[v].position    = src[v].position + pos2D;
+        dst[v].color       = color;
+        dst[v].borderColor = border;
+    }
+
+    int* index = indexArray.getCArray() + firstIndex;
+    for (int v = firstVertex; v < firstVertex + numVertices; v += 4, index += 6) {
+        index[0] = v + 0; index[1] = v + 1; index[2] = v + 2;
+        index[3] = v + 0; index[4] = v + 2; index[5] = v + 3;
+    }
+
+    return layout.bounds;
+}
+
+
 Vector2 GFont::appendToCharVertexArrayWordWrap
 (Array<CPUCharVertex>&       cpuCharArray,
  Array<int>&                 indexArray,
@@ -346,10 +442,54 @@ Vector2 GFont::appendToCharVertexArrayWordWrap
  const Color4&               border,
  XAlign                      xalign,
  YAlign                      yalign,
+ Spacing                     spacing) const {
+
+    const shared_ptr<Layout>& cached = layout(s, size, maxWidth, xalign, yalign, spacing);
+    if (notNull(cached)) {
+        return appendLayout(*cached, pos2D, color, border, cpuCharArray, indexArray);
+    } else {
+        return layOutWordWrap(cpuCharArray, indexArray, maxWidth, s, pos2D, size, color, border, xalign, yalign, spacing);
+    }
+}
+
+
+Vector2 GFont::appendToCharVertexArray
+   (Array<CPUCharVertex>&       cpuCharArray,
+    Array<int>&                 indexArray,
+    RenderDevice*               renderDevice,
+    const String&               s,
+    const Vector2&              pos2D,
+    float                       size,
+    const Color4&               color,
+    const Color4&               border,
+    XAlign                      xalign,
+    YAlign                      yalign,
+    Spacing                     spacing) const {
+
+    const shared_ptr<Layout>& cached = layout(s, size, finf(), xalign, yalign, spacing);
+    if (notNull(cached)) {
+        return appendLayout(*cached, pos2D, color, border, cpuCharArray, indexArray);
+    } else {
+        return layOut(cpuCharArray, indexArray, s, pos2D, size, color, border, xalign, yalign, spacing);
+    }
+}
+
+
+Vector2 GFont::layOutWordWrap
+(Array<CPUCharVertex>&       cpuCharArray,
+ Array<int>&                 indexArray,
+ float                       maxWidth,
+ const String&               s,
+ const Vector2&              pos2D,
+ float                       size,
+ const Color4&               color,
+ const Color4&               border,
+ XAlign                      xalign,
+ YAlign                      yalign,
  Spacing                     spacing) const {
 
     if (maxWidth == finf()) {
-        return appendToCharVertexArray(cpuCharArray, indexArray, renderDevice, s, pos2D, size, color, border, xalign, yalign, spacing);
+        return layOut(cpuCharArray, indexArray, s, pos2D, size, color, border, xalign, yalign, spacing);
     }
 
     Vector2 bounds = Vector2::zero();
@@ -359,7 +499,7 @@ Vector2 GFont::appendToCharVertexArrayWordWrap
 
     while (! rest.empty()) {
         wordWrapCut(maxWidth, rest, first, size, spacing);
-        Vector2 extent = appendToCharVertexArray(cpuCharArray, indexArray, renderDevice, first, p, size, color, border, xalign, yalign, spacing);
+        Vector2 extent = layOut(cpuCharArray, indexArray, first, p, size, color, border, xalign, yalign, spacing);
         bounds.x = max(bounds.x, extent.x);
         bounds.y += extent.y;
         p.y += iCeil(extent.y * 0.8f);
@@ -369,10 +509,9 @@ Vector2 GFont::appendToCharVertexArrayWordWrap
 }
 
 
-Vector2 GFont::appendToCharVertexArray
+Vector2 GFont::layOut
    (Array<CPUCharVertex>&       cpuCharArray,
     Array<int>&                 indexArray,
-    RenderDevice*               renderDevice,
     const String&               s,
     const Vector2&              pos2D,
     float                       size,
@@ -21,6 +21,7 @@
 #include "G3D-app/GuiPane.h"
 #include "G3D-gfx/GLPixelTransferBuffer.h"
 #include "G3D-app/ArticulatedModel.h"
+#include "G3D-app/SurfaceCuller.h"
 
 namespace G3D {
 
@@ -939,49 +940,62 @@ void Light::renderShadowMaps(RenderDevice* rd, const Array<shared_ptr<Light> >&
     bool ignoreBool;
     Surface::getBoxBounds(allSurfaces, shadowCasterBounds, false, ignoreBool, true);
 
-    Array<shared_ptr<Surface> > lightVisible;
-    lightVisible.reserve(allSurfaces.size());
+    // Only shadow casters can appear in a shadow map. Culling them against every
+    // light in one pass reads each surface's bounds once instead of once per light.
+    Array<shared_ptr<Surface> > casterArray;
+    casterArray.reserve(allSurfaces.size());
+    for (const shared_ptr<Surface>& surface : allSurfaces) {
+        if (surface->expressiveLightScatteringProperties.castsShadows) {
+            casterArray.append(surface);
+        }
+    }
 
-    // Generate shadow maps
-    int s = 0;
+    Array<shared_ptr<Light> > shadowLightArray;
+    Array<CFrame> lightFrameArray;
+    Array<Matrix4> lightProjectionMatrixArray;
+    Array<SurfaceCuller::View> viewArray;
     for (const shared_ptr<Light>& light : lightArray) {
-        
         if (light->shadowsEnabled() && light->enabled()) {
-
             CFrame lightFrame;
             Matrix4 lightProjectionMatrix;
                 
             const float nearMin = -light->nearPlaneZLimit();
             const float farMax = -light->farPlaneZLimit();
             ShadowMap::computeMatrices(light, shadowCasterBounds, lightFrame, light->shadowMap()->projection(), lightProjectionMatrix, 20, 20, nearMin, farMax);
-                
-            // Cull objects not visible to the light
             debugAssert(notNull(light->shadowMap()->depthTexture()));
-            Surface::cull(lightFrame, light->shadowMap()->projection(), light->shadowMap()->rect2DBounds(), allSurfaces, lightVisible, false);
-
-            // Cull objects that don't cast shadows
-            for (int i = 0; i < lightVisible.size(); ++i) {
-                if (! lightVisible[i]->expressiveLightScatteringProperties.castsShadows) {
-                    // Changing order is OK because we sort below
-                    lightVisible.fastRemove(i);
-                    --i;
-                }
-            }
 
-            Surface::sortFrontToBack(lightVisible, lightFrame.lookVector());
+            shadowLightArray.append(light);
+            lightFrameArray.append(lightFrame);
+            lightProjectionMatrixArray.append(lightProjectionMatrix);
+            viewArray.append(SurfaceCuller::View(lightFrame, light->shadowMap()->projection(), light->shadowMap()->rect2DBounds()));
+        }
+    }
+
+    // Cull objects not visible to each light
+    Array<Array<shared_ptr<Surface> > > lightVisibleArray;
+    if (viewArray.size() > 0) {
+        SurfaceCuller culler;
+        culler.setSurfaces(casterArray);
+        culler.cull(viewArray, lightVisibleArray);
+    }
+
+    // Generate shadow maps
+    for (int s = 0; s < shadowLightArray.size(); ++s) {
+        const shared_ptr<Light>& light = shadowLightArray[s];
+        const CFrame& lightFrame = lightFrameArray[s];
+        const Matrix4& lightProjectionMatrix = lightProjectionMatrixArray[s];
+        Array<shared_ptr<Surface> >& lightVisible = lightVisibleArray[s];
 
-            const CullFace renderCullFace = (cullFace == CullFace::CURRENT) ? light->shadowCullFace() : cullFace;
-            const Color3 transmissionWeight = light->bulbPower() / max(light->bulbPower().sum(), 1e-6f);
+        Surface::sortFrontToBack(lightVisible, lightFrame.lookVector());
 
-            if (light->shadowMap()->useVarianceShadowMap()) {
-                light->shadowMap()->updateDepth(rd, lightFrame, lightProjectionMatrix, lightVisible, renderCullFace, transmissionWeight, RenderPassType::OPAQUE_SHADOW_MAP);
-                light->shadowMap()->updateDepth(rd, lightFrame, lightProjectionMatrix, lightVisible, renderCullFace, transmissionWeight, RenderPassType::TRANSPARENT_SHADOW_MAP);
-            } else {
-                light->shadowMap()->updateDepth(rd, lightFrame, lightProjectionMatrix, lightVisible, renderCullFace, transmissionWeight, RenderPassType::SHADOW_MAP);
-            }
+        const CullFace renderCullFace = (cullFace == CullFace::CURRENT) ? light->shadowCullFace() : cullFace;
+        const Color3 transmissionWeight = light->bulbPower() / max(light->bulbPower().sum(), 1e-6f);
 
-            lightVisible.fastClear();
-            ++s;
+        if (light->shadowMap()->useVarianceShadowMap()) {
+            light->shadowMap()->updateDepth(rd, lightFrame, lightProjectionMatrix, lightVisible, renderCullFace, transmissionWeight, RenderPassType::OPAQUE_SHADOW_MAP);
+            light->shadowMap()->updateDepth(rd, lightFrame, lightProjectionMatrix, lightVisible, renderCullFace, transmissionWeight, RenderPassType::TRANSPARENT_SHADOW_MAP);
+        } else {
+            light->shadowMap()->updateDepth(rd, lightFrame, lightProjectionMatrix, lightVisible, renderCullFace, transmissionWeight, RenderPassType::SHADOW_MAP);
         }
     }
 
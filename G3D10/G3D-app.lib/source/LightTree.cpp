@@ -0,0 +1,315 @@
+/**
+  \file G3D-app.lib/source/LightTree.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-app/LightTree.h"
+#include "G3D-base/Matrix3.h"
+#include <algorithm>
+
+namespace G3D {
+
+/** Smallest cone containing the direction cones of \a a and \a b */
+static void coneUnion(const LightTree::Emitter& a, const LightTree::Emitter& b, Vector3& axis, float& thetaO) {
+    if (b.thetaO > a.thetaO) {
+        coneUnion(b, a, axis, thetaO);
+        return;
+    }
+
+    // a is the wider cone
+    const float thetaD = acos(clamp(a.axis.dot(b.axis), -1.0f, 1.0f));
+    if (min(thetaD + b.thetaO, pif()) <= a.thetaO) {
+        // a already contains b
+        axis = a.axis;
+        thetaO = a.thetaO;
+        return;
+    }
+
+    thetaO = (a.thetaO + thetaD + b.thetaO) * 0.5f;
+    const Vector3& rotationAxis = a.axis.cross(b.axis);
+    if ((thetaO >= pif()) || (rotationAxis.squaredLength() < 1e-12f)) {
+        // Full sphere (or opposite axes)
+        axis = a.axis;
+        thetaO = pif();
+        return;
+    }
+
+    // Rotate a's axis towards b's until the cone just contains both
+    axis = (Matrix3::fromAxisAngle(rotationAxis.direction(), thetaO - a.thetaO) * a.axis).directionOrZero();
+}
+
+
+/** cos(max(0, a - b)) from the sines and cosines of angles a and b on [0, pi] */
+static float cosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+    return (cosA > cosB) ? 1.0f : (cosA * cosB + sinA * sinB);
+}
+
+
+/** sin(max(0, a - b)) from the sines and cosines of angles a and b on [0, pi] */
+static float sinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+    return (cosA > cosB) ? 0.0f : (sinA * cosB - cosA * sinB);
+}
+
+
+void LightTree::Node::set(const Emitter& emitter) {
+    static_cast<Emitter&>(*this) = emitter;
+    cosThetaO = cosf(thetaO);
+    sinThetaO = sinf(thetaO);
+    // When the cones cover the sphere, there is no angle that can be culled
+    cosThetaE = (thetaO + thetaE >= pif()) ? -1.0f : cosf(thetaE);
+}
+
+
+float LightTree::importance(const Emitter& emitter, const Point3& X, const Vector3& n) {
+    Node node;
+    node.set(emitter);
+    return importance(node, X, n);
+}
+
+
+float LightTree::importance(const Node& node, const Point3& X, const Vector3& n) {
+    if (node.power <= 0.0f) {
+        return 0.0f;
+    }
+
+    const bool ignoreNormal = n.isNaN();
+    if (node.infinite) {
+        return node.power * (ignoreNormal ? 1.0f : fabsf(n.dot(node.axis))) / (4.0f * pif());
+    }
+
+    const Point3& center = node.bounds.center();
+    const Vector3& delta = X - center;
+    const float d2 = delta.squaredLength();
+    const float r2 = 0.25f * node.bounds.extent().squaredLength();
+
+    float cosEmitter = 1.0f;
+    float cosReceiver = 1.0f;
+    if (d2 > r2) {
+        // Direction from the emitter's center to X
+        const Vector3& w = delta / sqrtf(d2);
+
+        // Half-angle theta_b of the cone from X that contains the bounding sphere
+        const float sinThetaB2 = r2 / d2;
+        const float sinThetaB = sqrtf(sinThetaB2);
+        const float cosThetaB = sqrtf(1.0f - sinThetaB2);
+
+        // Smallest possible angle between an emitter normal and the direction to X,
+        // theta' = max(0, theta_w - theta_o - theta_b)
+        const float cosThetaW = clamp(node.axis.dot(w), -1.0f, 1.0f);
+        const float sinThetaW = sqrtf(1.0f - square(cosThetaW));
+        const float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, node.sinThetaO, node.cosThetaO);
+        const float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, node.sinThetaO, node.cosThetaO);
+        cosEmitter = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+        if (cosEmitter < node.cosThetaE) {
+            // Facing away from X
+            return 0.0f;
+        }
+
+        if (! ignoreNormal) {
+            // Either side of the surface may receive light (e.g., for transmission)
+            const float cosThetaI = min(fabsf(n.dot(w)), 1.0f);
+            const float sinThetaI = sqrtf(1.0f - square(cosThetaI));
+            cosReceiver = cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+        }
+    }
+
+    // Distance to the nearest point of the bounds distinguishes between nearby
+    // subtrees better than distance to the center
+    const Point3& closest = X.clamp(node.bounds.low(), node.bounds.high());
+    const float closest2 = max((closest - X).squaredLength(), 0.01f * r2, 1e-8f);
+
+    return node.power * cosEmitter * cosReceiver / (4.0f * pif() * closest2);
+}
+
+
+void LightTree::clear() {
+    m_emitterArray.fastClear();
+    m_node.fastClear();
+    m_parent.fastClear();
+    m_leaf.fastClear();
+    m_infinite.fastClear();
+}
+
+
+void LightTree::setEmitters(const Array<Emitter>& emitterArray) {
+    clear();
+    m_emitterArray = emitterArray;
+    m_leaf.resize(emitterArray.size());
+    m_leaf.setAll(-1);
+
+    Array<int> index;
+    for (int e = 0; e < emitterArray.size(); ++e) {
+        const Emitter& emitter = emitterArray[e];
+        if (emitter.power > 0.0f) {
+            if (emitter.infinite) {
+                m_infinite.append(e);
+            } else {
+                debugAssertM(! emitter.bounds.isEmpty(), "Finite emitters must have bounds");
+                index.append(e);
+            }
+        }
+    }
+
+    if (index.size() > 0) {
+        m_node.reserve(2 * index.size() - 1);
+        m_parent.reserve(2 * index.size() - 1);
+        buildNode(index, 0, index.size(), -1);
+    }
+}
+
+
+int LightTree::buildNode(Array<int>& index, int start, int stopBefore, int parent) {
+    const int n = m_node.size();
+    m_node.next();
+    m_parent.append(parent);
+
+    if (stopBefore - start == 1) {
+        const int e = index[start];
+        Node& leaf = m_node[n];
+        leaf.set(m_emitterArray[e]);
+        leaf.child = -1 - e;
+        m_leaf[e] = n;
+        return n;
+    }
+
+    // Split at the median along the longest axis of the emitter centers
+    AABox centerBounds;
+    for (int i = start; i < stopBefore; ++i) {
+        centerBounds.merge(m_emitterArray[index[i]].bounds.center());
+    }
+    const Vector3::Axis axis = centerBounds.extent().primaryAxis();
+    const int mid = (start + stopBefore) / 2;
+    std::nth_element(index.begin() + start, index.begin() + mid, index.begin() + stopBefore, [&](int a, int b) {
+        const float ca = m_emitterArray[a].bounds.center()[axis];
+        const float cb = m_emitterArray[b].bounds.center()[axis];
+        return (ca < cb) || ((ca == cb) && (a < b));
+    });
+
+    const int first = buildNode(index, start, mid, n);
+    const int second = buildNode(index, mid, stopBefore, n);
+
+    // m_node may have been reallocated by the recursive calls
+    const Node& a = m_node[first];
+    const Node& b = m_node[second];
+    Emitter bounds;
+    bounds.bounds = a.bounds;
+    bounds.bounds.merge(b.bounds);
+    coneUnion(a, b, bounds.axis, bounds.thetaO);
+    bounds.thetaE = max(a.thetaE, b.thetaE);
+    bounds.power = a.power + b.power;
+
+    Node& node = m_node[n];
+    node.set(bounds);
+    node.child = second;
+
+    return n;
+}
+
+
+float LightTree::totalImportance(const Point3& X, const Vector3& n, float& treeImportance) const {
+    treeImportance = (m_node.size() > 0) ? importance(m_node[0], X, n) : 0.0f;
+    float total = treeImportance;
+    for (const int e : m_infinite) {
+        total += importance(m_emitterArray[e], X, n);
+    }
+    return total;
+}
+
+
+float LightTree::firstChildProbability(int i, const Point3& X, const Vector3& n) const {
+    const float a = importance(m_node[i + 1], X, n);
+    const float b = importance(m_node[m_node[i].child], X, n);
+    if (a + b > 0.0f) {
+        return a / (a + b);
+    } else {
+        // Neither child can contribute, but the choice must still be consistent with pdf()
+        return 0.5f;
+    }
+}
+
+
+int LightTree::sample(const Point3& X, const Vector3& n, float u, float& pdfValue) const {
+    pdfValue = 0.0f;
+
+    float treeImportance;
+    const float total = totalImportance(X, n, treeImportance);
+    if (! (total > 0.0f)) {
+        return -1;
+    }
+
+    // Choose between the hierarchy and the infinite emitters
+    float r = u * total;
+    if (r >= treeImportance) {
+        r -= treeImportance;
+        int chosen = -1;
+        float chosenImportance = 0.0f;
+        for (const int e : m_infinite) {
+            const float I = importance(m_emitterArray[e], X, n);
+            if (I > 0.0f) {
+                // Fall back to the last one with nonzero importance in case of roundoff
+                chosen = e;
+                chosenImportance = I;
+                if (r < I) { break; }
+                r -= I;
+            }
+        }
+
+        if (chosen != -1) {
+            pdfValue = chosenImportance / total;
+            return chosen;
+        }
+        // Only reachable through roundoff: sample the hierarchy
+        r = treeImportance * 0.5f;
+    }
+
+    pdfValue = treeImportance / total;
+    u = min(r / treeImportance, 0.99999994f);
+
+    int i = 0;
+    while (m_node[i].child >= 0) {
+        const float p = firstChildProbability(i, X, n);
+        if (u < p) {
+            u /= p;
+            pdfValue *= p;
+            i = i + 1;
+        } else {
+            u = (u - p) / (1.0f - p);
+            pdfValue *= 1.0f - p;
+            i = m_node[i].child;
+        }
+        u = min(u, 0.99999994f);
+    }
+
+    return -1 - m_node[i].child;
+}
+
+
+float LightTree::pdf(int emitterIndex, const Point3& X, const Vector3& n) const {
+    debugAssert((emitterIndex >= 0) && (emitterIndex < m_emitterArray.size()));
+    const Emitter& emitter = m_emitterArray[emitterIndex];
+
+    float treeImportance;
+    const float total = totalImportance(X, n, treeImportance);
+    if (! (total > 0.0f) || (emitter.power <= 0.0f)) {
+        return 0.0f;
+    }
+
+    if (emitter.infinite) {
+        return importance(emitter, X, n) / total;
+    }
+
+    // Walk from the leaf to the root
+    float p = treeImportance / total;
+    for (int i = m_leaf[emitterIndex]; m_parent[i] != -1; i = m_parent[i]) {
+        const int parent = m_parent[i];
+        const float first = firstChildProbability(parent, X, n);
+        p *= (i == parent + 1) ? first : 1.0f - first;
+    }
+
+    return p;
+}
+
+} // namespace G3D
@@ -9,10 +9,12 @@
 #include "G3D-app/PathTracer.h"
 #include "G3D-base/Image.h"
 #include "G3D-base/CubeMap.h"
+#include "G3D-base/CubeMapSampler.h"
 #include "G3D-app/Light.h"
 #include "G3D-app/Camera.h"
 #include "G3D-app/Scene.h"
 #include "G3D-app/UniversalSurfel.h"
+#include "G3D-app/UniversalMaterial.h"
 #include "G3D-gfx/GLPixelTransferBuffer.h"
 
 namespace G3D {
@@ -76,6 +78,7 @@ void PathTracer::traceImage
         buffers.resize(numPixels);
         buffers.modulation.setAll(Color3::one());
         buffers.impulseRay.setAll(true);
+        buffers.skyWeight.setAll(1.0f);
         buffers.outputCoord.resize(numPixels);
         
         generateEyeRays(radianceImage->width(), radianceImage->height(), camera, buffers.ray, options.raysPerPixel > 1, buffers.outputCoord, weightSumImage, rayIndex, options.raysPerPixel);
@@ -147,6 +150,7 @@ void PathTracer::addEmissive
 (const Array<Ray>&                   rayFromEye,
  const Array<shared_ptr<Surfel>>&    surfelBuffer, 
  const Array<bool>&                  impulseRay,
+ const Array<float>&                 skyWeight,
  const Array<Color3>&                modulationBuffer,
  Radiance3*                          outputBuffer,
  const Array<int>                    outputCoordBuffer,
@@ -156,9 +160,9 @@ void PathTracer::addEmissive
     runConcurrently(0, rayFromEye.length(), [&](int i) {
         const Surfel* surfel = surfelBuffer[i].get();
         const Vector3& w_o = -rayFromEye[i].direction();
-        Radiance3 L_e = notNull(surfel) ? surfel->emittedRadiance(w_o) : skyRadiance(w_o);
+        Radiance3 L_e = notNull(surfel) ? surfel->emittedRadiance(w_o) : skyRadiance(w_o) * skyWeight[i];
         
-        if (surfel && ! impulseRay[i] && surfel->isLight()) {
+        if (surfel && ! impulseRay[i] && (surfel->isLight() || isSampledEmissiveTriangle(surfel->source.index))) {
             // Remove the portion of non-impulse sampling of area lights that was already handled by direct illumination
             L_e *= 1.0f - m_options.areaLightDirectFraction;
         }
@@ -183,6 +187,50 @@ static bool visibleAreaLight(const shared_ptr<Light>& light) {
 }
 
 
+/** Conservative bounds on the position and emission directions of \a light for LightTree */
+static LightTree::Emitter lightEmitter(const shared_ptr<Light>& light) {
+    LightTree::Emitter emitter;
+    if (light->type() == Light::Type::DIRECTIONAL) {
+        // Constant biradiance from a fixed direction
+        emitter.infinite = true;
+        emitter.axis = light->position().xyz().direction();
+        emitter.power = 4.0f * pif() * light->biradiance(Point3::zero()).sum();
+    } else {
+        emitter.bounds = AABox(light->position().xyz());
+        if (light->type() == Light::Type::AREA) {
+            for (int c = 0; c < 4; ++c) {
+                emitter.bounds.merge(light->position((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f).xyz());
+            }
+        }
+
+        emitter.axis = light->frame().lookVector();
+        const float halfAngle = light->spotHalfAngle();
+        if (halfAngle < halfPi()) {
+            // A rectangular spot light's corners are farther from the axis than its sides
+            emitter.thetaO = light->rectangular() ? atanf(sqrtf(2.0f) * tanf(halfAngle)) : halfAngle;
+        } else {
+            emitter.thetaO = pif();
+        }
+        emitter.thetaE = float(halfPi());
+        emitter.power = light->bulbPower().sum();
+    }
+    return emitter;
+}
+
+
+static bool sameEmitters(const Array<LightTree::Emitter>& a, const Array<LightTree::Emitter>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (int i = 0; i < a.size(); ++i) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
 Point3 PathTracer::sampleOneLight(const shared_ptr<Light>& light, const Point3& X, const Vector3& n, int pixelIndex, int lightIndex, int sampleIndex, int numSamples, float& areaTimesPDFValue) const {
     areaTimesPDFValue = 1.0f;
 
@@ -212,6 +260,10 @@ const shared_ptr<Light>& PathTracer::importanceSampleLight
  Color3&                                     cosBSDFDivPDF,
  Point3&                                     lightPosition) const {
 
+    if (m_lightTree.size() > 0) {
+        return importanceSampleLightTree(lightArray, w_o, surfel, sequenceIndex, rayIndex, raysPerPixel, biradiance, cosBSDFDivPDF, lightPosition);
+    }
+
     const Point3&  X = surfel->position;
     const Vector3& n = surfel->shadingNormal;
     
@@ -329,6 +381,93 @@ const shared_ptr<Light>& PathTracer::importanceSampleLight
 }
 
 
+const shared_ptr<Light>& PathTracer::importanceSampleLightTree
+(const Array<shared_ptr<Light>>&             lightArray,
+ const Vector3&                              w_o,
+ const shared_ptr<Surfel>&                   surfel,
+ int                                         sequenceIndex,
+ int                                         rayIndex,
+ int                                         raysPerPixel,
+ Biradiance3&                                biradiance,
+ Color3&                                     cosBSDFDivPDF,
+ Point3&                                     lightPosition) const {
+
+    // Returned for emissive triangles
+    static const shared_ptr<Light> noLight;
+
+    const Point3&  X = surfel->position;
+    const Vector3& n = surfel->shadingNormal;
+    Random& rng = Random::threadCommon();
+
+    biradiance = Biradiance3::zero();
+    cosBSDFDivPDF = Color3::zero();
+    lightPosition = X;
+
+    float pdfValue;
+    const int e = m_lightTree.sample(X, n, rng.uniform(), pdfValue);
+    if ((e == -1) || (pdfValue <= 0.0f)) {
+        // Nothing can illuminate X
+        return noLight;
+    }
+
+    if (e < lightArray.size()) {
+        const shared_ptr<Light>& light = lightArray[e];
+
+        float areaTimesPDFValue;
+        lightPosition = sampleOneLight(light, X, n, sequenceIndex, e, rayIndex, raysPerPixel, areaTimesPDFValue);
+        biradiance = light->biradiance(X, lightPosition);
+        if (areaTimesPDFValue != 0.0f) {
+            biradiance /= areaTimesPDFValue;
+        }
+
+        if (visibleAreaLight(light)) {
+            biradiance *= m_options.areaLightDirectFraction;
+        }
+    } else {
+        // Uniformly distributed point on an emissive triangle
+        const int triIndex = m_emissiveTriIndex[e - lightArray.size()];
+        const Tri& tri = (*m_triTree)[triIndex];
+        float u = rng.uniform();
+        float v = rng.uniform();
+        if (u + v > 1.0f) {
+            u = 1.0f - u;
+            v = 1.0f - v;
+        }
+
+        shared_ptr<Surfel> lightSurfel;
+        tri.sample(u, v, triIndex, m_triTree->vertexArray(), false, lightSurfel);
+        if (notNull(lightSurfel)) {
+            lightPosition = lightSurfel->position;
+            const Vector3& delta = X - lightPosition;
+            const float d2 = delta.squaredLength();
+            if (d2 > 0.0f) {
+                const Vector3& w = delta / sqrtf(d2);
+                float cosLight = lightSurfel->geometricNormal.dot(w);
+                if (tri.twoSided()) {
+                    cosLight = fabsf(cosLight);
+                }
+                if (cosLight > 0.0f) {
+                    // Dividing by the probability density 1 / area of choosing this point
+                    biradiance = lightSurfel->emittedRadiance(w) * (cosLight * tri.area() / d2) * m_options.areaLightDirectFraction;
+                }
+            }
+        }
+    }
+
+    debugAssertM(biradiance.min() >= 0.0f, "Negative biradiance for light");
+    if (biradiance.nonZero()) {
+        const Vector3& w_i = (lightPosition - X).direction();
+        const Color3& f = surfel->finiteScatteringDensity(w_i, w_o);
+        debugAssertM(f.min() >= 0.0f, "Negative finiteScatteringDensity");
+        cosBSDFDivPDF = f * (fabsf(w_i.dot(n)) / pdfValue);
+    }
+
+    debugAssertM(cosBSDFDivPDF.isFinite(), "Infinite/NaN BSDF");
+    debugAssertM(biradiance.isFinite(), "Infinite/NaN biradiance");
+    return (e < lightArray.size()) ? lightArray[e] : noLight;
+}
+
+
 void PathTracer::computeDirectIllumination
 (const Array<shared_ptr<Surfel>>&    surfelBuffer, 
  const Array<shared_ptr<Light>>&     lightArray,
@@ -343,13 +482,46 @@ void PathTracer::computeDirectIllumination
 
     const float epsilon = 1e-3f;
 
+    // Indirect rays also find the skybox, except after the last scattering event
+    const bool scatterAfter = (currentPathDepth < options.maxScatteringEvents - 1);
+    const float environmentProbability = m_environmentSampleProbability;
+
     runConcurrently(0, surfelBuffer.size(), [&](int i) {
         const shared_ptr<Surfel>& surfel = surfelBuffer[i];
 
         debugAssert(notNull(surfel));
 
-        Point3      lightPosition;
         Radiance3&  L_sd = directBuffer[i];
+        const Vector3& w_o = -rayBuffer[i].direction();
+
+        if ((environmentProbability > 0.0f) && ((environmentProbability == 1.0f) || (Random::threadCommon().uniform() < environmentProbability))) {
+            // Sample the skybox
+            float pdfValue;
+            const Vector3& w_i = m_environmentSampler->sample(Random::threadCommon(), pdfValue);
+            const float cosTheta = fabsf(w_i.dot(surfel->shadingNormal));
+
+            // Balance heuristic against the chance that scatterRays() chooses the same direction,
+            // using the cosine as a proxy for the BSDF's sampling density. scatterRays() applies
+            // the complementary weight through BufferSet::skyWeight.
+            const float scatterPDF = scatterAfter ? cosTheta / pif() : 0.0f;
+            const float pdfSum = environmentProbability * pdfValue + scatterPDF;
+            L_sd = Radiance3::zero();
+            if (pdfSum > 0.0f) {
+                L_sd = m_environmentSampler->cubeMap()->bilinear(w_i) * surfel->finiteScatteringDensity(w_i, w_o) * (cosTheta / pdfSum);
+            }
+
+            if (L_sd.nonZero()) {
+                debugAssertM(L_sd.min() >= 0.0f, "Negative direct light");
+                const Point3& overSurface = surfel->position + surfel->geometricNormal * (epsilon * sign(w_i.dot(surfel->geometricNormal)));
+                shadowRayBuffer[i] = Ray::fromOriginAndDirection(overSurface, w_i, epsilon);
+            } else {
+                shadowRayBuffer[i] = s_degenerateRay;
+                L_sd = Radiance3::zero();
+            }
+            return;
+        }
+
+        Point3      lightPosition;
         Biradiance3 biradiance;
         Color3      cosBSDFDivPDF;
 
@@ -357,8 +529,12 @@ void PathTracer::computeDirectIllumination
         int surfelIndex = int(pixelCoord.x + pixelCoord.y * radianceImageWidth);
         // Compute the surfel index before surfel compaction to ensure the low
         // discrepancy samples are not accidentally correlated.
-        const shared_ptr<Light>& light = importanceSampleLight(lightArray, -rayBuffer[i].direction(), surfel, surfelIndex * options.maxScatteringEvents + currentPathDepth, currentRayIndex, options.raysPerPixel, biradiance, cosBSDFDivPDF, lightPosition);
+        const shared_ptr<Light>& light = importanceSampleLight(lightArray, w_o, surfel, surfelIndex * options.maxScatteringEvents + currentPathDepth, currentRayIndex, options.raysPerPixel, biradiance, cosBSDFDivPDF, lightPosition);
         L_sd = biradiance * cosBSDFDivPDF;
+        if (environmentProbability > 0.0f) {
+            // Lights were chosen instead of the skybox
+            L_sd /= 1.0f - environmentProbability;
+        }
 
         // Cast shadow rays from the light to the surface for more coherence in scenes
         // with few lights (i.e., where many pixels are casting from the same lights)
@@ -369,7 +545,8 @@ void PathTracer::computeDirectIllumination
         if (L_sd.nonZero()) {
             debugAssertM(L_sd.min() >= 0.0f, "Negative direct light");
 
-            if (light->shadowsEnabled()) {
+            // Emissive triangles (which have no Light) always cast shadows
+            if (isNull(light) || light->shadowsEnabled()) {
                 // Generate shadow ray
                 const Point3& overSurface = surfel->position + surfel->geometricNormal * epsilon;
                 const Vector3& delta = overSurface - lightPosition;
@@ -450,9 +627,11 @@ void PathTracer::scatterRays
     int                                     raysPerPixel,
     Array<Ray>&                             rayBuffer,
     Array<Color3>&                          modulationBuffer,
-    Array<bool>&                            impulseRay) const {
+    Array<bool>&                            impulseRay,
+    Array<float>&                           skyWeight) const {
     
     static const float epsilon = 1e-4f;
+    const float environmentProbability = m_environmentSampleProbability;
 
     runConcurrently(0, surfelBuffer.size(), [&](int i) {
         const shared_ptr<Surfel>& surfel = surfelBuffer[i];
@@ -460,6 +639,7 @@ void PathTracer::scatterRays
 
         // Direction that the light went OUT, eventually towards the eye
         const Vector3& w_o = -rayBuffer[i].direction();
+        skyWeight[i] = 1.0f;
 
         // sample the pdf of (BRDF * cos)
 
@@ -506,6 +686,16 @@ void PathTracer::scatterRays
 
 
             modulationBuffer[i] *= weight;
+
+            // Complement of the weight that computeDirectIllumination() gave the skybox
+            if ((environmentProbability > 0.0f) && ! impulseRay[i]) {
+                const float scatterPDF = fabsf(w_i.dot(surfel->shadingNormal)) / pif();
+                const float pdfSum = environmentProbability * m_environmentSampler->pdf(w_i) + scatterPDF;
+                if (pdfSum > 0.0f) {
+                    skyWeight[i] = scatterPDF / pdfSum;
+                }
+            }
+
             rayBuffer[i] = Ray::fromOriginAndDirection(surfel->position + surfel->geometricNormal * epsilon * sign(w_i.dot(surfel->geometricNormal)), w_i);
         }
     });
@@ -547,6 +737,7 @@ void PathTracer::traceBuffer
         buffers.modulation.setAll(Color3::one());
     }
     buffers.impulseRay.setAll(lightEmissiveOnFirstHit);
+    buffers.skyWeight.setAll(1.0f);
     
     // Zero the output
     System::memset(output, 0, sizeof(Radiance3) * buffers.size());
@@ -594,6 +785,85 @@ void PathTracer::prepare
         m_environmentMap = m_scene->environmentMapAsCubeMap();
     }
 
+    // Emissive triangles are sampled along with the lights unless all emitters are left to indirect rays
+    const bool sampleEmissiveTriangles = m_options.sampleEmissiveTriangles && (m_options.areaLightDirectFraction > 0.0f);
+    if (sampleEmissiveTriangles && (m_emissiveTriBuildTime != m_triTree->lastBuildTime())) {
+        findEmissiveTriangles();
+    }
+    m_sampleEmissiveTriangles = sampleEmissiveTriangles && (m_emissiveTriIndex.size() > 0);
+
+    if (m_sampleEmissiveTriangles || (directLightArray.size() > m_options.maxLightsForExhaustiveSampling)) {
+        Array<LightTree::Emitter> emitterArray;
+        emitterArray.reserve(directLightArray.size() + (m_sampleEmissiveTriangles ? m_emissiveTriEmitter.size() : 0));
+        for (const shared_ptr<Light>& light : directLightArray) {
+            emitterArray.append(lightEmitter(light));
+        }
+        if (m_sampleEmissiveTriangles) {
+            emitterArray.append(m_emissiveTriEmitter);
+        }
+
+        // Only rebuild when something moved
+        if (! sameEmitters(emitterArray, m_lightTree.emitterArray())) {
+            m_lightTree.setEmitters(emitterArray);
+        }
+    } else {
+        m_lightTree.clear();
+    }
+
+    if (m_options.sampleEnvironment && notNull(m_skybox)) {
+        if (isNull(m_environmentSampler) || (m_environmentSampler->cubeMap() != m_skybox)) {
+            m_environmentSampler = CubeMapSampler::create(m_skybox);
+        }
+    } else {
+        m_environmentSampler = nullptr;
+    }
+
+    if (isNull(m_environmentSampler) || m_environmentSampler->black()) {
+        m_environmentSampleProbability = 0.0f;
+    } else {
+        // Split direct illumination samples evenly between the skybox and the lights
+        m_environmentSampleProbability = ((directLightArray.size() > 0) || (m_lightTree.size() > 0)) ? 0.5f : 1.0f;
+    }
+}
+
+
+void PathTracer::findEmissiveTriangles() const {
+    const Array<Tri>& triArray = m_triTree->triArray();
+    const CPUVertexArray& vertexArray = m_triTree->vertexArray();
+
+    Array<LightTree::Emitter> emitterArray;
+    emitterArray.resize(triArray.size());
+    runConcurrently(0, triArray.size(), [&](int t) {
+        const Tri& tri = triArray[t];
+        LightTree::Emitter& emitter = emitterArray[t];
+        emitter.power = 0.0f;
+
+        const shared_ptr<UniversalMaterial>& material = dynamic_pointer_cast<UniversalMaterial>(tri.material());
+        if (notNull(material) && ! material->emissive().isBlack() && (tri.area() > 0.0f)) {
+            tri.getBounds(vertexArray, emitter.bounds);
+            emitter.axis = tri.normal(vertexArray);
+            emitter.thetaO = tri.twoSided() ? pif() : 0.0f;
+            emitter.thetaE = float(halfPi());
+            // Lambertian emitter with the average emitted radiance over the whole area
+            emitter.power = 4.0f * pif() * material->emissive().mean().sum() * tri.area();
+        }
+    }, ! m_options.multithreaded);
+
+    m_emissiveTriIndex.fastClear();
+    m_emissiveTriEmitter.fastClear();
+    for (int t = 0; t < emitterArray.size(); ++t) {
+        if (emitterArray[t].power > 0.0f) {
+            m_emissiveTriIndex.append(t);
+            m_emissiveTriEmitter.append(emitterArray[t]);
+        }
+    }
+
+    m_emissiveTriBuildTime = m_triTree->lastBuildTime();
+}
+
+
+bool PathTracer::isSampledEmissiveTriangle(int triIndex) const {
+    return m_sampleEmissiveTriangles && std::binary_search(m_emissiveTriIndex.begin(), m_emissiveTriIndex.end(), triIndex);
 }
 
 
@@ -630,7 +900,7 @@ void PathTracer::traceBufferInternal
             });
         }
 
-        addEmissive(buffers.ray, buffers.surfel, buffers.impulseRay, buffers.modulation, output, buffers.outputIndex, radianceImage, buffers.outputCoord);
+        addEmissive(buffers.ray, buffers.surfel, buffers.impulseRay, buffers.skyWeight, buffers.modulation, output, buffers.outputIndex, radianceImage, buffers.outputCoord);
 
         // Compact buffers by removing paths that terminated (missed the entire scene)
         // This must be done serially.
@@ -642,7 +912,7 @@ void PathTracer::traceBufferInternal
         } // for i
 
         // Direct lighting
-        if (directLightArray.size() > 0) {
+        if ((directLightArray.size() > 0) || (m_lightTree.size() > 0) || (m_environmentSampleProbability > 0.0f)) {
             computeDirectIllumination(buffers.surfel, directLightArray, buffers.ray, scatteringEvents, currentRayIndex, m_options, buffers.outputCoord, radianceImageWidth, buffers.direct, buffers.shadowRay);
             m_triTree->intersectRays(buffers.shadowRay, buffers.lightShadowed, TriTree::COHERENT_RAY_HINT | TriTree::DO_NOT_CULL_BACKFACES | TriTree::OCCLUSION_TEST_ONLY);
             shade(buffers.surfel, buffers.ray, buffers.shadowRay, buffers.lightShadowed, buffers.direct, buffers.modulation, output, buffers.outputIndex, radianceImage, buffers.outputCoord);
@@ -650,7 +920,7 @@ void PathTracer::traceBufferInternal
 
         // Indirect lighting rays (don't compute on the last scattering event)
         if (scatteringEvents < m_options.maxScatteringEvents - 1) {
-            scatterRays(buffers.surfel, indirectLightArray, scatteringEvents, currentRayIndex, m_options.raysPerPixel, buffers.ray, buffers.modulation, buffers.impulseRay);
+            scatterRays(buffers.surfel, indirectLightArray, scatteringEvents, currentRayIndex, m_options.raysPerPixel, buffers.ray, buffers.modulation, buffers.impulseRay, buffers.skyWeight);
         }
     } // for scattering events
 
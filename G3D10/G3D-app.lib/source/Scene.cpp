@@ -29,6 +29,7 @@
 #include "G3D-app/FontModel.h"
 #include "G3D-app/VoxelModel.h"
 #include "G3D-app/SoundEntity.h"
+#include "G3D-base/Thread.h"
 
 using namespace G3D::units;
 
@@ -238,6 +239,7 @@ void Scene::clear() {
     m_entityTable.clear();
     m_entityArray.fastClear();
     m_cameraArray.fastClear();
+    m_visibleEntityArray.fastClear();
     m_localLightingEnvironment = LightingEnvironment();
     m_localLightingEnvironment.ambientOcclusion = old;
     m_skybox.reset();
@@ -345,6 +347,10 @@ Any Scene::load(const String& scene, const LoadOptions& loadOptions) {
         }
     }
 
+    if (loadOptions.prefetchModels) {
+        prefetchModels();
+    }
+
     // Instantiate the entities
     // Try for both the current and extended format entity group names...intended to support using #include to merge
     // different files with entitys in them
@@ -360,6 +366,9 @@ Any Scene::load(const String& scene, const LoadOptions& loadOptions) {
         } // if this entity group name exists
     } 
 
+    // Release any prefetched models that no entity used
+    ArticulatedModel::clearPrefetched();
+
     
     shared_ptr<Texture> skyboxTexture = Texture::whiteCube();
 
@@ -458,6 +467,43 @@ void Scene::getVisibleBounds(AABox& box) const {
 }
 
 
+void Scene::prefetchModels() {
+    // Only prefetch models that createModel() will load with ArticulatedModel
+    const LazyModelFactory* factory = m_modelFactory.getPointer("ArticulatedModel");
+    const bool defaultFactory = notNull(factory) && (*factory == static_cast<LazyModelFactory>(&ArticulatedModel::lazyCreate));
+
+    Array<ArticulatedModel::Specification> specificationArray;
+    for (Any::AnyTable::Iterator it = m_modelsAny.table().begin(); it.isValid(); ++it) {
+        const Any& v = it->value;
+        if (v.type() == Any::STRING) {
+            specificationArray.append(ArticulatedModel::Specification(v));
+        } else if (defaultFactory) {
+            const String& modelClassName = v.name().substr(0, v.name().find("::"));
+            if (modelClassName == "ArticulatedModel") {
+                specificationArray.append(ArticulatedModel::Specification(v));
+            }
+        }
+    }
+
+    if (specificationArray.size() == 0) {
+        return;
+    }
+
+    Array<ArticulatedModel::PrefetchTiming> timingArray;
+    const RealTime start = System::time();
+    ArticulatedModel::prefetch(specificationArray, timingArray);
+    const RealTime wallTime = System::time() - start;
+
+    RealTime parseTime = 0.0;
+    for (const ArticulatedModel::PrefetchTiming& timing : timingArray) {
+        logPrintf("Scene::prefetchModels() parsed %s in %.1f ms\n", timing.filename.c_str(), timing.parseTime * 1000.0);
+        parseTime += timing.parseTime;
+    }
+    logPrintf("Scene::prefetchModels() parsed %d model files in %.1f ms (%.1f ms serial, %.1fx)\n",
+              timingArray.size(), wallTime * 1000.0, parseTime * 1000.0, (wallTime > 0.0) ? parseTime / wallTime : 1.0);
+}
+
+
 lazy_ptr<Model> Scene::createModel(const Any& v, const String& name) {
     v.verify(! m_modelTable.containsKey(name), "A model named '" + name + "' already exists in this scene.");
 
@@ -574,6 +620,7 @@ void Scene::remove(const shared_ptr<Entity>& entity) {
 
     const shared_ptr<VisibleEntity>& visible = dynamic_pointer_cast<VisibleEntity>(entity);
     if (notNull(visible)) {
+        m_visibleEntityArray.fastRemove(m_visibleEntityArray.findIndex(visible));
         m_lastVisibleChangeTime = System::time();
     }
 
@@ -601,6 +648,7 @@ shared_ptr<Entity> Scene::insert(const shared_ptr<Entity>& entity) {
     
     const shared_ptr<VisibleEntity>& visible = dynamic_pointer_cast<VisibleEntity>(entity);
     if (notNull(visible)) {
+        m_visibleEntityArray.append(visible);
         m_lastVisibleChangeTime = System::time();
     }
 
@@ -653,6 +701,39 @@ shared_ptr<Entity> Scene::createEntity(const String& entityType, const String& n
 
 
 void Scene::onPose(Array<shared_ptr<Surface> >& surfaceArray) {
+    // Re-pose the changed VisibleEntitys that allow it concurrently. Posing an ArticulatedModel
+    // writes to scratch tables on the model, so Entitys that share a Model are posed by the same task.
+    // On a single core, the extra pass would only cost time.
+    m_poseQueue.fastClear();
+    if (std::thread::hardware_concurrency() > 1) {
+        for (const shared_ptr<VisibleEntity>& entity : m_visibleEntityArray) {
+            if (! entity->poseCacheValid() && entity->canPoseConcurrently()) {
+                m_poseQueue.append(entity.get());
+            }
+        }
+    }
+
+    if (m_poseQueue.size() > 1) {
+        std::sort(m_poseQueue.begin(), m_poseQueue.end(), [](const VisibleEntity* a, const VisibleEntity* b) {
+            return a->model().get() < b->model().get();
+        });
+
+        m_poseGroupStart.fastClear();
+        for (int i = 0; i < m_poseQueue.size(); ++i) {
+            if ((i == 0) || (m_poseQueue[i]->model() != m_poseQueue[i - 1]->model())) {
+                m_poseGroupStart.append(i);
+            }
+        }
+        m_poseGroupStart.append(m_poseQueue.size());
+
+        runConcurrently(0, m_poseGroupStart.size() - 1, [this](int g) {
+            for (int i = m_poseGroupStart[g]; i < m_poseGroupStart[g + 1]; ++i) {
+                m_poseQueue[i]->updatePoseCache();
+            }
+        });
+    }
+
+    // Everything else poses here, in order. VisibleEntitys with current caches only append.
     for (int e = 0; e < m_entityArray.size(); ++e) {
         m_entityArray[e]->onPose(surfaceArray);
     }
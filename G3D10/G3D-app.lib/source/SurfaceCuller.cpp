@@ -0,0 +1,300 @@
+/**
+  \file G3D-app.lib/source/SurfaceCuller.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-base/platform.h"
+#include "G3D-base/Thread.h"
+#include "G3D-base/AABox.h"
+#include "G3D-base/Sphere.h"
+#include "G3D-base/Plane.h"
+#include "G3D-base/Frustum.h"
+#include "G3D-base/Float4.h"
+#include "G3D-app/SurfaceCuller.h"
+#include "G3D-app/Surface.h"
+
+namespace G3D {
+
+namespace {
+
+/** A plane as n.x + offset >= 0 for the inside */
+class CullPlane {
+public:
+    float       n[3];
+    float       offset;
+
+    CullPlane() {}
+    CullPlane(const Plane& p) {
+        const Vector3& normal = p.normal();
+        n[0] = normal.x; n[1] = normal.y; n[2] = normal.z;
+        offset = p.distance(Vector3::zero());
+    }
+};
+
+
+/** World-space view data precomputed once per cull() call */
+class CullView {
+public:
+    /** From Projection::getClipPlanes, for the sphere test */
+    SmallArray<CullPlane, 6>    spherePlane;
+
+    /** From the Frustum faces, for the box test */
+    SmallArray<CullPlane, 6>    boxPlane;
+
+    /** Finite frustum vertices in world space */
+    SmallArray<Point3, 8>       finiteVertex;
+
+    /** Directions of frustum vertices at infinity */
+    SmallArray<Vector3, 8>      infiniteDirection;
+
+    CullView() {}
+
+    CullView(const SurfaceCuller::View& view) {
+        Array<Plane> clipPlanes;
+        view.projection.getClipPlanes(view.viewport, clipPlanes);
+        for (const Plane& p : clipPlanes) {
+            spherePlane.append(CullPlane(view.frame.toWorldSpace(p)));
+        }
+
+        Frustum frustum;
+        view.projection.frustum(view.viewport, frustum);
+        frustum = view.frame.toWorldSpace(frustum);
+        for (int f = 0; f < frustum.faceArray.size(); ++f) {
+            boxPlane.append(CullPlane(frustum.faceArray[f].plane));
+        }
+        for (int i = 0; i < frustum.vertexPos.size(); ++i) {
+            const Vector4& v = frustum.vertexPos[i];
+            if (v.w == 0) {
+                infiniteDirection.append(v.xyz());
+            } else {
+                finiteVertex.append(v.xyz() / v.w);
+            }
+        }
+    }
+};
+
+} // anonymous namespace
+
+
+void SurfaceCuller::setSurfaces(const Array<shared_ptr<Surface>>& surfaceArray, bool previous) {
+    m_surfaceArray = surfaceArray;
+
+    const int n = surfaceArray.size();
+    const int padded = (n + 3) & ~3;
+    for (Array<float>* a : {&m_sphereX, &m_sphereY, &m_sphereZ, &m_sphereRadius, &m_boxX, &m_boxY, &m_boxZ}) {
+        a->resize(padded, false);
+    }
+    for (int a = 0; a < 9; ++a) {
+        m_boxAxis[a].resize(padded, false);
+    }
+    m_flags.resize(padded, false);
+
+    // The virtual calls dominate, so gather in parallel
+    runConcurrently(0, padded, [&](int i) {
+        if (i >= n) {
+            // Padding lanes are never visible
+            m_sphereX[i] = m_sphereY[i] = m_sphereZ[i] = m_sphereRadius[i] = 0.0f;
+            m_boxX[i] = m_boxY[i] = m_boxZ[i] = 0.0f;
+            for (int a = 0; a < 9; ++a) {
+                m_boxAxis[a][i] = 0.0f;
+            }
+            m_flags[i] = EMPTY_BOX;
+            return;
+        }
+
+        const shared_ptr<Surface>& surface = surfaceArray[i];
+        CFrame frame;
+        Sphere sphere;
+        AABox box;
+        surface->getCoordinateFrame(frame, previous);
+        surface->getObjectSpaceBoundingSphere(sphere, previous);
+        surface->getObjectSpaceBoundingBox(box, previous);
+
+        sphere = frame.toWorldSpace(sphere);
+        m_sphereX[i] = sphere.center.x;
+        m_sphereY[i] = sphere.center.y;
+        m_sphereZ[i] = sphere.center.z;
+        m_sphereRadius[i] = sphere.radius;
+
+        uint8 flags = 0;
+        if (box.isEmpty()) {
+            flags = EMPTY_BOX;
+        } else if (! box.isFinite()) {
+            flags = INFINITE_BOX;
+        }
+        m_flags[i] = flags;
+
+        if (flags == 0) {
+            const Point3& center = frame.pointToWorldSpace(box.center());
+            const Vector3& halfExtent = box.extent() * 0.5f;
+            m_boxX[i] = center.x;
+            m_boxY[i] = center.y;
+            m_boxZ[i] = center.z;
+            for (int a = 0; a < 3; ++a) {
+                const Vector3& axis = frame.rotation.column(a) * halfExtent[a];
+                for (int c = 0; c < 3; ++c) {
+                    m_boxAxis[3 * a + c][i] = axis[c];
+                }
+            }
+        } else {
+            m_boxX[i] = m_boxY[i] = m_boxZ[i] = 0.0f;
+            for (int a = 0; a < 9; ++a) {
+                m_boxAxis[a][i] = 0.0f;
+            }
+        }
+    });
+}
+
+
+void SurfaceCuller::computeVisibility(const Array<View>& viewArray, Array<uint32>& visibilityMask, bool singleThread) const {
+    alwaysAssertM(viewArray.size() <= MAX_VIEWS_PER_PASS, "Too many views for one pass");
+
+    Array<CullView> cullViewArray;
+    for (const View& view : viewArray) {
+        cullViewArray.append(CullView(view));
+    }
+
+    const int numGroups = (size() + 3) / 4;
+    visibilityMask.resize(numGroups * 4, false);
+
+    // Groups of four surfaces per task batch, so that each task works on whole cache lines
+    static const int GROUPS_PER_TASK = 64;
+    const int numTasks = (numGroups + GROUPS_PER_TASK - 1) / GROUPS_PER_TASK;
+    const Float4 zero(0.0f), posInf(finf()), negInf(-finf());
+
+    runConcurrently(0, numTasks, [&](int task) {
+        const int groupEnd = min(numGroups, (task + 1) * GROUPS_PER_TASK);
+        for (int group = task * GROUPS_PER_TASK; group < groupEnd; ++group) {
+            const int i = group * 4;
+
+            const Float4 sx = Float4::load(m_sphereX.getCArray() + i);
+            const Float4 sy = Float4::load(m_sphereY.getCArray() + i);
+            const Float4 sz = Float4::load(m_sphereZ.getCArray() + i);
+            const Float4 negRadius = zero - Float4::load(m_sphereRadius.getCArray() + i);
+
+            const Float4 bx = Float4::load(m_boxX.getCArray() + i);
+            const Float4 by = Float4::load(m_boxY.getCArray() + i);
+            const Float4 bz = Float4::load(m_boxZ.getCArray() + i);
+            Float4 axis[9];
+            for (int a = 0; a < 9; ++a) {
+                axis[a] = Float4::load(m_boxAxis[a].getCArray() + i);
+            }
+
+            int alwaysCulled = 0, boxTestable = 0;
+            for (int lane = 0; lane < 4; ++lane) {
+                alwaysCulled |= (m_flags[i + lane] & EMPTY_BOX) ? (1 << lane) : 0;
+                boxTestable  |= (m_flags[i + lane] == 0) ? (1 << lane) : 0;
+            }
+
+            uint32 mask[4] = {0, 0, 0, 0};
+            for (int v = 0; v < cullViewArray.size(); ++v) {
+                const CullView& view = cullViewArray[v];
+
+                // Sphere against the clip planes
+                Float4 sphereCulled(zero);
+                for (int j = 0; j < view.spherePlane.size(); ++j) {
+                    const CullPlane& p = view.spherePlane[j];
+                    const Float4 d = sx * Float4(p.n[0]) + sy * Float4(p.n[1]) + sz * Float4(p.n[2]) + Float4(p.offset);
+                    sphereCulled = sphereCulled | (d < negRadius);
+                }
+
+                int culled = sphereCulled.bits() | alwaysCulled;
+                if (((culled | ~boxTestable) & 15) != 15) {
+                    // Box corners against the frustum planes: the farthest corner along the
+                    // normal is the center plus the projected half-extents
+                    Float4 boxCulled(zero);
+                    for (int j = 0; j < view.boxPlane.size(); ++j) {
+                        const CullPlane& p = view.boxPlane[j];
+                        const Float4 nx(p.n[0]), ny(p.n[1]), nz(p.n[2]);
+                        Float4 r = (axis[0] * nx + axis[1] * ny + axis[2] * nz).abs();
+                        r = r + (axis[3] * nx + axis[4] * ny + axis[5] * nz).abs();
+                        r = r + (axis[6] * nx + axis[7] * ny + axis[8] * nz).abs();
+                        const Float4 d = bx * nx + by * ny + bz * nz + Float4(p.offset);
+                        boxCulled = boxCulled | ((d + r) < zero);
+                    }
+
+                    // Frustum vertices against the box face planes
+                    for (int a = 0; a < 3; ++a) {
+                        const Float4& ax = axis[3 * a], & ay = axis[3 * a + 1], & az = axis[3 * a + 2];
+                        const Float4 lengthSquared = ax * ax + ay * ay + az * az;
+                        const Float4 center = ax * bx + ay * by + az * bz;
+
+                        Float4 lo(posInf), hi(negInf);
+                        for (int j = 0; j < view.finiteVertex.size(); ++j) {
+                            const Point3& P = view.finiteVertex[j];
+                            const Float4 s = ax * Float4(P.x) + ay * Float4(P.y) + az * Float4(P.z);
+                            lo = Float4::min(lo, s);
+                            hi = Float4::max(hi, s);
+                        }
+                        for (int j = 0; j < view.infiniteDirection.size(); ++j) {
+                            const Vector3& D = view.infiniteDirection[j];
+                            const Float4 s = ax * Float4(D.x) + ay * Float4(D.y) + az * Float4(D.z);
+                            lo = Float4::select(s <= zero, negInf, lo);
+                            hi = Float4::select(s >= zero, posInf, hi);
+                        }
+
+                        // Degenerate (flat) axes have no face plane
+                        const Float4 separated = (lo >= (center + lengthSquared)) | (hi <= (center - lengthSquared));
+                        boxCulled = boxCulled | (separated & (lengthSquared > zero));
+                    }
+
+                    culled |= boxCulled.bits() & boxTestable;
+                }
+
+                for (int lane = 0; lane < 4; ++lane) {
+                    if ((culled & (1 << lane)) == 0) {
+                        mask[lane] |= 1u << v;
+                    }
+                }
+            }
+
+            for (int lane = 0; lane < 4; ++lane) {
+                visibilityMask[i + lane] = mask[lane];
+            }
+        }
+    }, singleThread);
+
+    visibilityMask.resize(size(), false);
+}
+
+
+void SurfaceCuller::cull(const Array<View>& viewArray, Array<Array<shared_ptr<Surface>>>& visibleArray, bool singleThread) const {
+    visibleArray.resize(viewArray.size());
+
+    for (int first = 0; first < viewArray.size(); first += MAX_VIEWS_PER_PASS) {
+        const int count = min(MAX_VIEWS_PER_PASS, viewArray.size() - first);
+        Array<View> passArray;
+        for (int v = 0; v < count; ++v) {
+            passArray.append(viewArray[first + v]);
+        }
+        computeVisibility(passArray, m_visibilityMask, singleThread);
+
+        // Each view gathers into its own array, so the views can run concurrently
+        runConcurrently(0, count, [&](int v) {
+            Array<shared_ptr<Surface>>& visible = visibleArray[first + v];
+            const uint32 bit = 1u << v;
+            for (int i = 0; i < m_surfaceArray.size(); ++i) {
+                if (m_visibilityMask[i] & bit) {
+                    visible.append(m_surfaceArray[i]);
+                }
+            }
+        }, singleThread || (count == 1));
+    }
+}
+
+
+void SurfaceCuller::cull(const View& view, Array<shared_ptr<Surface>>& visible, bool singleThread) const {
+    Array<View> viewArray;
+    viewArray.append(view);
+    computeVisibility(viewArray, m_visibilityMask, singleThread);
+    for (int i = 0; i < m_surfaceArray.size(); ++i) {
+        if (m_visibilityMask[i]) {
+            visible.append(m_surfaceArray[i]);
+        }
+    }
+}
+
+} // namespace G3D
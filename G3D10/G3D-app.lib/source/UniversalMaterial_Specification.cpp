@@ -332,6 +332,18 @@ size_t UniversalMaterial::Specification::hashCode() const {
 }
 
 
+void UniversalMaterial::Specification::prefetchTextures() const {
+    const Texture::Specification* textureSpecArray[] = {&m_lambertian, &m_glossy, &m_transmissive, &m_emissive, &m_bump.texture};
+    for (const Texture::Specification* t : textureSpecArray) {
+        // Only cached textures will be found again by create(). Pseudo-textures such as <white>
+        // do not read a file.
+        if (t->cachable && ! t->filename.empty() && ! beginsWith(t->filename, "<")) {
+            Texture::create(*t);
+        }
+    }
+}
+
+
 Component4 UniversalMaterial::Specification::loadLambertian() const {
     if (notNull(m_lambertianTex)) {
         return Component4(m_lambertianTex);
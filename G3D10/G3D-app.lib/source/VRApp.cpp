@@ -37,6 +37,8 @@ VRApp::VRApp(const GApp::Settings& settings) :
     m_hudWidth(2.0f),
     m_hudBackgroundColor(Color3::black(), 0.15f) {
 
+    alwaysAssertM(! settings.pipeline.enabled, "VRApp does not support GApp::Settings::Pipeline");
+
     // Optimize ray casts for teleportation
     Model::setUseOptimizedIntersect(true);
     
@@ -2,7 +2,7 @@
   \file G3D-app.lib/source/VideoInput.cpp
 
   G3D Innovation Engine http://casual-effects.com/g3d
-  Copyright 2000-2019, Morgan McGuire
+  Copyright 2000-2020, Morgan McGuire
   All rights reserved
   Available under the BSD License
 */
@@ -12,6 +12,7 @@
 #include "G3D-app/VideoInput.h"
 #include "G3D-gfx/Texture.h"
 #include "G3D-base/CPUPixelTransferBuffer.h"
+#include <algorithm>
 #include <thread>
 
 #ifdef G3D_NO_FFMPEG
@@ -32,11 +33,13 @@ namespace G3D {
 // helper used by VideoInput and VideoOutput to capture error logs from ffmpeg
 void initFFmpegLogger();
 
-shared_ptr<VideoInput> VideoInput::fromFile(const String& filename) {
+shared_ptr<VideoInput> VideoInput::fromFile(const String& filename, const ImageFormat* format) {
     shared_ptr<VideoInput> vi(new VideoInput);
 
     try {
-        vi->initialize(filename);
+        if (! vi->initialize(filename, format)) {
+            vi.reset();
+        }
     } catch (const String& s) {
         // TODO: Throw the exception
         debugAssertM(false, s);(void)s;
@@ -48,17 +51,22 @@ shared_ptr<VideoInput> VideoInput::fromFile(const String& filename) {
 
 VideoInput::VideoInput() : 
     m_quitThread(false),
+    m_frames(MAX_QUEUED_FRAMES),
+    m_recycledFrames(MAX_QUEUED_FRAMES * 2),
+    m_frameFormat(nullptr),
+    m_skipUntilTimestamp(AV_NOPTS_VALUE),
+    m_lastDecodedTimestamp(AV_NOPTS_VALUE),
     m_avFormatContext(nullptr),
     m_avCodecContext(nullptr),
     m_avStream(nullptr),
-    m_avResizeContext(nullptr) {
+    m_avResizeContext(nullptr),
+    m_avDecodingFrame(nullptr) {
 
 }
 
 VideoInput::~VideoInput() {
     // shutdown decoding thread
-    m_quitThread = true;
-    m_thread.wait();
+    stopDecoding();
 
     if (m_avCodecContext) {
         avcodec_close(m_avCodecContext);
@@ -73,9 +81,11 @@ VideoInput::~VideoInput() {
         sws_freeContext(m_avResizeContext);
         m_avResizeContext = nullptr;
     }
+
+    av_frame_free(&m_avDecodingFrame);
 }
 
-bool VideoInput::initialize(const String& filename) {
+bool VideoInput::initialize(const String& filename, const ImageFormat* format) {
     initFFmpegLogger();
 
     // initialize list of available muxers/demuxers and codecs in ffmpeg
@@ -88,7 +98,7 @@ bool VideoInput::initialize(const String& filename) {
 
     avformat_find_stream_info(m_avFormatContext, nullptr);
     for (int streamIdx = 0; streamIdx < (int)m_avFormatContext->nb_streams; ++streamIdx) {
-        if (m_avFormatContext->streams[streamIdx]->codec->codec_type == AVMEDIA_TYPE_VIDEO) {
+        if (m_avFormatContext->streams[streamIdx]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
             m_avStream = m_avFormatContext->streams[streamIdx];
             break;
         }
@@ -103,9 +113,13 @@ bool VideoInput::initialize(const String& filename) {
         return false;
     }
 
-    if (avcodec_copy_context(m_avCodecContext, m_avStream->codec) < 0) {
+    if (avcodec_parameters_to_context(m_avCodecContext, m_avStream->codecpar) < 0) {
         return false;
     }
+    m_avCodecContext->framerate = av_guess_frame_rate(m_avFormatContext, m_avStream, nullptr);
+
+    // Let the codec pick its number of slice/frame threads; 4K streams need them
+    m_avCodecContext->thread_count = 0;
 
     // Initialize the codecc
     AVCodec* codec = avcodec_find_decoder(m_avCodecContext->codec_id);
@@ -113,15 +127,31 @@ bool VideoInput::initialize(const String& filename) {
         return false;
     }
 
-    // Create resize context since the parameters shouldn't change throughout the video
-    m_avResizeContext = sws_getContext(m_avCodecContext->width, m_avCodecContext->height, m_avCodecContext->pix_fmt, 
-                                       m_avCodecContext->width, m_avCodecContext->height, AV_PIX_FMT_RGB24, SWS_BILINEAR, nullptr, nullptr, nullptr);
-    if (! m_avResizeContext) {
-        return false;
+    const bool yuv = notNull(format) && (format->code == ImageFormat::CODE_YUV420_PLANAR);
+    m_frameFormat = yuv ? ImageFormat::YUV420_PLANAR() : ImageFormat::RGB8();
+
+    // Create resize context since the parameters shouldn't change throughout the video.
+    // The common 4:2:0 formats are copied directly when producing YUV.
+    const bool nativeYUV = yuv && ((m_avCodecContext->pix_fmt == AV_PIX_FMT_YUV420P) || (m_avCodecContext->pix_fmt == AV_PIX_FMT_YUVJ420P));
+    if (! nativeYUV) {
+        m_avResizeContext = sws_getContext(m_avCodecContext->width, m_avCodecContext->height, m_avCodecContext->pix_fmt, 
+                                           m_avCodecContext->width, m_avCodecContext->height, yuv ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_RGB24, SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (! m_avResizeContext) {
+            return false;
+        }
+    }
+
+    m_avDecodingFrame = av_frame_alloc();
+
+    // Start the keyframe index with the container's own index, if it has one
+    for (int i = 0; i < m_avStream->nb_index_entries; ++i) {
+        if (m_avStream->index_entries[i].flags & AVINDEX_KEYFRAME) {
+            addKeyframe(m_avStream->index_entries[i].timestamp);
+        }
     }
     
     // everything is setup and ready to be decoded
-    m_thread = std::async(std::launch::async, VideoInput::decode, this);
+    startDecoding();
     return true;
 }
 
@@ -143,7 +173,7 @@ RealTime VideoInput::length() const {
 
 bool VideoInput::finished() const {
     const bool threadFinished = (m_thread.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
-    return threadFinished && (m_frames.size() == 0);
+    return threadFinished && m_frames.empty();
 }
 
 const ImageFormat* VideoInput::imageFormat() {
@@ -151,15 +181,24 @@ const ImageFormat* VideoInput::imageFormat() {
 }
 
 shared_ptr<CPUPixelTransferBuffer> VideoInput::nextFrame() {
-    shared_ptr<CPUPixelTransferBuffer> buffer;
-    m_frames.popFront(buffer);
-    return buffer;
+    DecodedFrame decoded;
+    m_frames.tryPop(decoded);
+    return decoded.buffer;
+}
+
+void VideoInput::recycleFrame(const shared_ptr<CPUPixelTransferBuffer>& frame) {
+    if (notNull(frame) && (frame->format() == m_frameFormat) && (frame->width() == width()) && (frame->height() == height())) {
+        // Drop it if enough buffers are already waiting
+        m_recycledFrames.tryPush(frame);
+    }
 }
 
 bool VideoInput::nextFrame(shared_ptr<Texture> frame) {
-    shared_ptr<CPUPixelTransferBuffer> buffer;
-    if (m_frames.popFront(buffer)) {
-        if (frame->format() == ImageFormat::SRGB8() || frame->format() == ImageFormat::RGB8()) {
+    DecodedFrame decoded;
+    bool copied = false;
+    if (m_frames.tryPop(decoded)) {
+        const shared_ptr<CPUPixelTransferBuffer>& buffer = decoded.buffer;
+        if ((m_frameFormat == ImageFormat::RGB8()) && (frame->format() == ImageFormat::SRGB8() || frame->format() == ImageFormat::RGB8())) {
             if (frame->width() == width() && frame->height() == height()) {
                 // update existing texture
                 glBindTexture(frame->openGLTextureTarget(), frame->openGLID());
@@ -171,80 +210,250 @@ bool VideoInput::nextFrame(shared_ptr<Texture> frame) {
                 buffer->unmap();
 
                 glBindTexture(frame->openGLTextureTarget(), GL_NONE);
-                return true;
+                copied = true;
             }
         }
+        recycleFrame(buffer);
     }
-    return false;
+    return copied;
 }
 
 bool VideoInput::nextFrame(shared_ptr<PixelTransferBuffer> frame) {
-    shared_ptr<CPUPixelTransferBuffer> buffer;
-    if (m_frames.popFront(buffer)) {
-        if (frame->format() == ImageFormat::SRGB8() || frame->format() == ImageFormat::RGB8()) {
+    DecodedFrame decoded;
+    bool copied = false;
+    if (m_frames.tryPop(decoded)) {
+        const shared_ptr<CPUPixelTransferBuffer>& buffer = decoded.buffer;
+        const bool formatMatches = (m_frameFormat == ImageFormat::RGB8()) ?
+            (frame->format() == ImageFormat::SRGB8() || frame->format() == ImageFormat::RGB8()) :
+            (frame->format() == m_frameFormat);
+        if (formatMatches) {
             if (frame->width() == width() && frame->height() == height()) {
                 // copy frame
-                memcpy(frame->mapWrite(), buffer->mapRead(), buffer->size());
+                System::memcpy(frame->mapWrite(), buffer->mapRead(), buffer->size());
                 frame->unmap();
                 buffer->unmap();
-                return true;
+                copied = true;
             }
         }
+        recycleFrame(buffer);
     }
-    return false;
+    return copied;
 }
 
-bool VideoInput::decode(VideoInput* vi) {
-    // todo: adjust this based on stream fps
-    const int maxFrames = 5;
+shared_ptr<CPUPixelTransferBuffer> VideoInput::allocateFrame() {
+    shared_ptr<CPUPixelTransferBuffer> buffer;
+    if (! m_recycledFrames.tryPop(buffer)) {
+        buffer = CPUPixelTransferBuffer::create(width(), height(), m_frameFormat);
+    }
+    return buffer;
+}
 
-    while (! vi->m_quitThread) {
+void VideoInput::copyDecodedFrame(CPUPixelTransferBuffer* buffer) {
+    const AVFrame* src = m_avDecodingFrame;
+    const int w = m_avCodecContext->width;
+    const int h = m_avCodecContext->height;
+    uint8* dst = (uint8*)buffer->mapWrite();
+
+    if (m_frameFormat == ImageFormat::RGB8()) {
+        // Convert the image from its native format to RGB
+        uint8_t* destPlanes[] = { dst };
+        int destStrides[] = { (int)buffer->stride() };
+        sws_scale(m_avResizeContext, src->data, src->linesize, 0, h, destPlanes, destStrides);
+    } else {
+        // YUV420_PLANAR is the full-resolution Y plane followed by the half-resolution U and V planes
+        uint8_t* destPlanes[] = { dst, dst + w * h, dst + w * h + (w / 2) * (h / 2) };
+        int destStrides[] = { w, w / 2, w / 2 };
+        if (notNull(m_avResizeContext)) {
+            sws_scale(m_avResizeContext, src->data, src->linesize, 0, h, destPlanes, destStrides);
+        } else {
+            for (int p = 0; p < 3; ++p) {
+                const int rows = (p == 0) ? h : h / 2;
+                for (int y = 0; y < rows; ++y) {
+                    System::memcpy(destPlanes[p] + y * destStrides[p], src->data[p] + y * src->linesize[p], destStrides[p]);
+                }
+            }
+        }
+    }
+
+    buffer->unmap();
+}
 
-        // check of frame queue is full
-        if (vi->m_frames.size() >= maxFrames) {
-            // todo: adjust this based on stream fps
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-            continue;
+void VideoInput::addKeyframe(int64 timestamp) {
+    if (timestamp == AV_NOPTS_VALUE) {
+        return;
+    }
+
+    m_keyframeLock.lock();
+    if ((m_keyframeTimestamps.size() == 0) || (m_keyframeTimestamps.last() < timestamp)) {
+        // The common case while decoding
+        m_keyframeTimestamps.append(timestamp);
+    } else {
+        const int64* begin = m_keyframeTimestamps.getCArray();
+        const int64* end = begin + m_keyframeTimestamps.size();
+        const int64* it = std::lower_bound(begin, end, timestamp);
+        if (*it != timestamp) {
+            m_keyframeTimestamps.insert(int(it - begin), timestamp);
         }
+    }
+    m_keyframeLock.unlock();
+}
 
-        AVPacket packet;
-        av_init_packet(&packet);
+void VideoInput::startDecoding() {
+    m_quitThread = false;
+    m_thread = std::async(std::launch::async, VideoInput::decode, this);
+}
 
-        // decode next frame
-        if (av_read_frame(vi->m_avFormatContext, &packet) < 0) {
-            // return on error or end of file
-            av_free_packet(&packet);
-            break;
+void VideoInput::stopDecoding() {
+    if (! m_thread.valid()) {
+        return;
+    }
+
+    m_quitThread = true;
+
+    // The decoder pushes at most one more frame before it notices the request,
+    // and may be waiting for room for it
+    Array<DecodedFrame> queued;
+    DecodedFrame decoded;
+    if (m_frames.tryPop(decoded)) {
+        queued.append(decoded);
+    }
+    m_thread.wait();
+    m_thread = std::future<bool>();
+
+    while (m_frames.tryPop(decoded)) {
+        queued.append(decoded);
+    }
+    requeue(queued);
+}
+
+void VideoInput::requeue(const Array<DecodedFrame>& frames) {
+    for (const DecodedFrame& f : frames) {
+        if (! m_frames.tryPush(f)) {
+            // The decoder pushes this first when it restarts
+            debugAssert(isNull(m_unqueuedFrame.buffer));
+            m_unqueuedFrame = f;
         }
+    }
+}
 
-        // ignore frames other than our video frame
-        if (packet.stream_index == vi->m_avStream->index) {
-            AVFrame* decodingFrame = av_frame_alloc();
+bool VideoInput::seek(RealTime time) {
+    stopDecoding();
 
-            // decode the frame
-            int completedFrame = 0;
-            avcodec_decode_video2(vi->m_avCodecContext, decodingFrame, &completedFrame, &packet);
+    const AVRational timeBase = m_avStream->time_base;
+    const int64 startTime = (m_avStream->start_time == AV_NOPTS_VALUE) ? 0 : m_avStream->start_time;
+    const int64 target = startTime + int64(time / av_q2d(timeBase));
 
-            // we have a valid frame, let's use it!
-            if (completedFrame != 0) {
-                shared_ptr<CPUPixelTransferBuffer> buffer = CPUPixelTransferBuffer::create(vi->m_avCodecContext->width, vi->m_avCodecContext->height, ImageFormat::RGB8());
+    // Accept the frame that is on screen at time, even if its timestamp is slightly earlier
+    const int64 halfFrame = (fps() > 0) ? int64(0.5 / (fps() * av_q2d(timeBase))) : 0;
+    m_skipUntilTimestamp = target - halfFrame;
 
-                uint8_t* destPlanes[] = { (uint8_t*)buffer->mapWrite() };
-                int destStrides[] = { (int)buffer->stride() };
+    // Keep queued frames at or after the target
+    Array<DecodedFrame> queued, kept;
+    DecodedFrame decoded;
+    while (m_frames.tryPop(decoded)) {
+        queued.append(decoded);
+    }
+    if (notNull(m_unqueuedFrame.buffer)) {
+        queued.append(m_unqueuedFrame);
+        m_unqueuedFrame = DecodedFrame();
+    }
+    for (const DecodedFrame& f : queued) {
+        if (f.timestamp >= m_skipUntilTimestamp) {
+            kept.append(f);
+        } else {
+            recycleFrame(f.buffer);
+        }
+    }
 
-                // Convert the image from its native format to RGB
-                sws_scale(vi->m_avResizeContext, decodingFrame->data, decodingFrame->linesize, 0, vi->m_avCodecContext->height, destPlanes, destStrides);
-                
-                buffer->unmap();
+    // The latest keyframe at or before the target
+    int64 keyframe = AV_NOPTS_VALUE;
+    m_keyframeLock.lock();
+    {
+        const int64* begin = m_keyframeTimestamps.getCArray();
+        const int64* end = begin + m_keyframeTimestamps.size();
+        const int64* it = std::upper_bound(begin, end, target);
+        if (it != begin) {
+            keyframe = *(it - 1);
+        }
+    }
+    m_keyframeLock.unlock();
+
+    // Decoding forward within the current group of pictures is cheaper than a seek,
+    // which would restart at the same keyframe. Bound the distance for containers
+    // whose keyframes are only discovered while decoding.
+    const bool decodeForward =
+        (m_lastDecodedTimestamp != AV_NOPTS_VALUE) &&
+        (target >= m_lastDecodedTimestamp) &&
+        ((keyframe == AV_NOPTS_VALUE) || (keyframe <= m_lastDecodedTimestamp)) &&
+        ((target - m_lastDecodedTimestamp) * av_q2d(timeBase) < 2.0);
+
+    bool success = true;
+    if (decodeForward) {
+        requeue(kept);
+    } else {
+        for (const DecodedFrame& f : kept) {
+            recycleFrame(f.buffer);
+        }
+        success = (av_seek_frame(m_avFormatContext, m_avStream->index, (keyframe == AV_NOPTS_VALUE) ? target : keyframe, AVSEEK_FLAG_BACKWARD) >= 0);
+        avcodec_flush_buffers(m_avCodecContext);
+        m_lastDecodedTimestamp = AV_NOPTS_VALUE;
+    }
+
+    startDecoding();
+    return success;
+}
+
+bool VideoInput::decode(VideoInput* vi) {
+    AVPacket* packet = av_packet_alloc();
+    bool endOfFile = false;
+
+    if (notNull(vi->m_unqueuedFrame.buffer)) {
+        vi->m_frames.waitPush(vi->m_unqueuedFrame);
+        vi->m_unqueuedFrame = DecodedFrame();
+    }
 
-                vi->m_frames.pushBack(buffer);
+    while (! vi->m_quitThread) {
+        const int ret = avcodec_receive_frame(vi->m_avCodecContext, vi->m_avDecodingFrame);
+
+        if (ret == AVERROR(EAGAIN)) {
+            // The decoder needs another packet
+            if (av_read_frame(vi->m_avFormatContext, packet) < 0) {
+                // End of file or error: drain the frames that the decoder is holding
+                if (endOfFile) {
+                    break;
+                }
+                endOfFile = true;
+                avcodec_send_packet(vi->m_avCodecContext, nullptr);
+            } else {
+                // ignore packets other than our video stream
+                if (packet->stream_index == vi->m_avStream->index) {
+                    if (packet->flags & AV_PKT_FLAG_KEY) {
+                        vi->addKeyframe((packet->pts != AV_NOPTS_VALUE) ? packet->pts : packet->dts);
+                    }
+                    avcodec_send_packet(vi->m_avCodecContext, packet);
+                }
+                av_packet_unref(packet);
             }
+        } else if (ret < 0) {
+            // AVERROR_EOF after the last frame, or a decoding error
+            break;
+        } else {
+            DecodedFrame decoded;
+            decoded.timestamp = vi->m_avDecodingFrame->best_effort_timestamp;
+            vi->m_lastDecodedTimestamp = decoded.timestamp;
 
-            av_frame_free(&decodingFrame);
-        }   
+            if ((decoded.timestamp == AV_NOPTS_VALUE) || (vi->m_skipUntilTimestamp == AV_NOPTS_VALUE) || (decoded.timestamp >= vi->m_skipUntilTimestamp)) {
+                decoded.buffer = vi->allocateFrame();
+                vi->copyDecodedFrame(decoded.buffer.get());
 
-        av_free_packet(&packet);
+                // Sleeps until the consumer makes room; stopDecoding() also makes room
+                vi->m_frames.waitPush(decoded);
+            }
+            av_frame_unref(vi->m_avDecodingFrame);
+        }
     }
+
+    av_packet_free(&packet);
     return true;
 }
 
@@ -2,7 +2,7 @@
   \file G3D-app.lib/source/VideoOutput.cpp
 
   G3D Innovation Engine http://casual-effects.com/g3d
-  Copyright 2000-2019, Morgan McGuire
+  Copyright 2000-2020, Morgan McGuire
   All rights reserved
   Available under the BSD License
 */
@@ -15,19 +15,18 @@
 #include "G3D-gfx/GLPixelTransferBuffer.h"
 #include "G3D-app/VideoOutput.h"
 #include "G3D-app/VideoInput.h"
+#include <thread>
 
 #ifdef G3D_NO_FFMPEG
     #pragma message("Warning: FFMPEG and VideoOutput are disabled in this build (" __FILE__ ")") 
 #else
 
 extern "C" {
-    #include "libavfilter/buffersink.h"
-    #include "libavfilter/buffersrc.h"
     #include "libavformat/avformat.h"
     #include "libavformat/avio.h"
     #include "libavcodec/avcodec.h"
     #include "libavutil/avutil.h"
-    #include "libavutil/opt.h"
+    #include "libavutil/pixdesc.h"
     #include "libswscale/swscale.h"
 }
 
@@ -84,7 +83,31 @@ void VideoOutput::Settings::setBitrateQuality(float quality) {
 }
 
 VideoOutput::Settings::Settings()
-    : width(0), height(0), fps(0), bitrate(0), flipVertical(false), encoder(Encoder::DEFAULT()) {}
+    : width(0), height(0), fps(0), bitrate(0), flipVertical(false), queueLength(4), dropFramesWhenBusy(false), encoder(Encoder::DEFAULT()) {}
+
+
+/** The AVPixelFormat for the layout of \a format, which need not be RGB8 */
+static AVPixelFormat avPixelFormat(const ImageFormat* format) {
+    switch (format->code) {
+    case ImageFormat::CODE_RGB8:
+    case ImageFormat::CODE_SRGB8:
+        return AV_PIX_FMT_RGB24;
+
+    case ImageFormat::CODE_RGBA8:
+    case ImageFormat::CODE_SRGBA8:
+        return AV_PIX_FMT_RGBA;
+
+    case ImageFormat::CODE_BGR8:
+        return AV_PIX_FMT_BGR24;
+
+    case ImageFormat::CODE_BGRA8:
+        return AV_PIX_FMT_BGRA;
+
+    default:
+        debugAssertM(false, "VideoOutput: unsupported frame format " + format->name() + ", interpreting as RGB8");
+        return AV_PIX_FMT_RGB24;
+    }
+}
 
 shared_ptr<VideoOutput> VideoOutput::create(const String& filename, const Settings& settings) {
     shared_ptr<VideoOutput> vo = createShared<VideoOutput>(filename, settings);
@@ -117,13 +140,13 @@ VideoOutput::VideoOutput(const String& filename, const Settings& settings)
     , m_settings(settings)
     , m_isFinished(false)
     , m_framecount(0)
+    , m_droppedFrameCount(0)
     , m_avFormatContext(nullptr)
     , m_avVideoContext(nullptr)
     , m_avVideoStream(nullptr)
     , m_avOptions(nullptr)
-    , m_avBufferSrc(nullptr)
-    , m_avBufferSink(nullptr)
-    , m_avFilterGraph(nullptr)
+    , m_avEncodeFrame(nullptr)
+    , m_swsSourceFormat(AV_PIX_FMT_NONE)
 {
 }
 
@@ -138,7 +161,6 @@ bool VideoOutput::initialize() {
 
     // initialize list of available muxers/demuxers and codecs in ffmpeg
     av_register_all();
-    avfilter_register_all();
 
     // validate settings
     if (!validSettings()) {
@@ -262,74 +284,29 @@ bool VideoOutput::initialize() {
         return false;
     }
 
-    // create filter graph
-    m_avFilterGraph = avfilter_graph_alloc();
-    if (m_avFilterGraph == nullptr) {
-        debugPrintf("VideoOutput: could not create filter graph\n");
-        return false;
-    }
-
-    // create source (buffer) and output(buffersink)
-    const AVFilter *buffersrc = avfilter_get_by_name("buffer");
-    const AVFilter *buffersink = avfilter_get_by_name("buffersink");
-
-    // create source filter
-    String args = format("video_size=%dx%d:pix_fmt=%d:time_base=1/%d", m_settings.width, m_settings.height, AV_PIX_FMT_RGB24, m_settings.fps);
-    ret = avfilter_graph_create_filter(&m_avBufferSrc, buffersrc, "in", args.c_str(), nullptr, m_avFilterGraph);
-    if (ret < 0) {
-        debugPrintf("VideoOutput: could not create in filter\n");
-        return false;
-    }
-
-    // create output filterm_avBufferSrc
-    ret = avfilter_graph_create_filter(&m_avBufferSink, buffersink, "out", nullptr, nullptr, m_avFilterGraph);
-    if (ret < 0) {
-        debugPrintf("VideoOutput: could not create out filter\n");
-        return false;
-    }
-
-    // set output format
-    AVPixelFormat fmts[] = { m_avVideoContext->pix_fmt, AV_PIX_FMT_NONE };
-    ret = av_opt_set_int_list(m_avBufferSink, "pix_fmts", fmts, AV_PIX_FMT_NONE, AV_OPT_SEARCH_CHILDREN);
+    // frame in the codec's pixel format, which the converters write and the codec reads
+    av_frame_free(&m_avEncodeFrame);
+    m_avEncodeFrame = av_frame_alloc();
+    m_avEncodeFrame->format = m_avVideoContext->pix_fmt;
+    m_avEncodeFrame->width = m_settings.width;
+    m_avEncodeFrame->height = m_settings.height;
+    ret = av_frame_get_buffer(m_avEncodeFrame, 0);
     if (ret < 0) {
-        debugPrintf("VideoOutput: could not set options\n");
+        debugPrintf("VideoOutput: could not allocate frame\n");
         return false;
     }
 
-    AVFilterInOut *outputs = avfilter_inout_alloc();
-    AVFilterInOut *inputs = avfilter_inout_alloc();
-
-    outputs->name = av_strdup("in");
-    outputs->filter_ctx = m_avBufferSrc;
-    outputs->pad_idx = 0;
-    outputs->next = nullptr;
-
-    inputs->name = av_strdup("out");
-    inputs->filter_ctx = m_avBufferSink;
-    inputs->pad_idx = 0;
-    inputs->next = nullptr;
-
-    String filters;
-    if (m_settings.flipVertical) {
-        filters = "vflip";
-    }
-    
-    ret = avfilter_graph_parse_ptr(m_avFilterGraph, "null", &inputs, &outputs, nullptr);
-    if (ret < 0) {
-        avfilter_inout_free(&inputs);
-        avfilter_inout_free(&outputs);
-        debugPrintf("VideoOutput: could parse graph\n");
-        return false;
+    if (m_settings.queueLength > 0) {
+        m_freeFrameQueue.reset(new MPMCQueue<PendingFrame*>(m_settings.queueLength));
+        // Room for every frame plus the null frame that stops the thread
+        m_pendingFrameQueue.reset(new MPMCQueue<PendingFrame*>(m_settings.queueLength + 1));
+        for (int i = 0; i < m_settings.queueLength; ++i) {
+            m_framePool.append(new PendingFrame());
+            m_freeFrameQueue->tryPush(m_framePool.last());
+        }
+        m_encoderThread = std::async(std::launch::async, VideoOutput::encode, this);
     }
 
-    ret = avfilter_graph_config(m_avFilterGraph, nullptr);
-    avfilter_inout_free(&inputs);
-    avfilter_inout_free(&outputs);
-
-    if (ret < 0) {
-        debugPrintf("VideoOutput: could configure graph\n");
-        return false;
-    }
     return true;
 }
     
@@ -338,6 +315,19 @@ void VideoOutput::shutdown() {
     // check if destroying before commit()
     abort();
 
+    for (SwsContext* context : m_swsContextArray) {
+        sws_freeContext(context);
+    }
+    m_swsContextArray.clear();
+
+    av_frame_free(&m_avEncodeFrame);
+
+    for (PendingFrame* frame : m_framePool) {
+        System::alignedFree(frame->data);
+        delete frame;
+    }
+    m_framePool.clear();
+
     if (m_avVideoContext) {
         avcodec_free_context(&m_avVideoContext);
     }
@@ -403,102 +393,155 @@ void VideoOutput::encodeFrame(const uint8* pixels, const ImageFormat* format) {
         return;
     }
 
-    AVFrame* frame = av_frame_alloc();
-    frame->format = AV_PIX_FMT_RGB24;
-    frame->width = m_settings.width;
-    frame->height = m_settings.height;
-
-    int ret = av_frame_get_buffer(frame, 0);
-    if (ret >= 0) {
-        av_frame_make_writable(frame);
-
-        // copy each line individually to accomodate padding in the AVFrame buffer for alignment
-        const int sourceLineSize = frame->width * ImageFormat::RGB8()->cpuBitsPerPixel / 8;
-        runConcurrently(0, frame->height, [&](int y) {
-            memcpy(frame->data[0] + (y * frame->linesize[0]), pixels + (y * sourceLineSize), sourceLineSize);
-        });
-
-        frame->pts = ++m_framecount;
-
-        ret = av_buffersrc_add_frame_flags(m_avBufferSrc, frame, AV_BUFFERSRC_FLAG_KEEP_REF);
-        if (ret >= 0) {
-            AVFrame* filteredFrame = av_frame_alloc();
-            while (1) {
-                ret = av_buffersink_get_frame(m_avBufferSink, filteredFrame);
-                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-                    break;
-                }
-
-                if (ret >= 0) {
-                    ret = avcodec_send_frame(m_avVideoContext, filteredFrame);
-                    av_frame_unref(filteredFrame);
-
-                    if (ret >= 0) {
-                        AVPacket* packet = av_packet_alloc();
-                        while (ret >= 0) {
-                            ret = avcodec_receive_packet(m_avVideoContext, packet);
-                            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-                                break;
-                            }
-
-                            if (ret >= 0) {
-                                av_packet_rescale_ts(packet, m_avVideoContext->time_base, m_avVideoStream->time_base);
-                                packet->stream_index = m_avVideoStream->index;
-
-                                ret = av_interleaved_write_frame(m_avFormatContext, packet);
-                                av_packet_unref(packet);
-                                debugAssert(ret >= 0);
-                            }
-                        }
-
-                        av_packet_free(&packet);
-                    }
-                }
-            }
-            av_frame_free(&filteredFrame);
-        }
+    const AVPixelFormat pixelFormat = avPixelFormat(format);
+    const size_t rowBytes = size_t(m_settings.width) * av_get_bits_per_pixel(av_pix_fmt_desc_get(pixelFormat)) / 8;
+    const int64 pts = ++m_framecount;
+
+    if (m_settings.queueLength == 0) {
+        encodePixels(pixels, pixelFormat, rowBytes, pts);
+        return;
+    }
+
+    PendingFrame* frame = nullptr;
+    const bool haveFrame = m_settings.dropFramesWhenBusy ? m_freeFrameQueue->tryPop(frame) : m_freeFrameQueue->waitPop(frame);
+    if (! haveFrame) {
+        ++m_droppedFrameCount;
+        return;
     }
 
-    av_frame_free(&frame);
+    const size_t bytes = rowBytes * m_settings.height;
+    if (frame->capacity < bytes) {
+        System::alignedFree(frame->data);
+        frame->data = (uint8*)System::alignedMalloc(bytes, 64);
+        frame->capacity = bytes;
+    }
+    System::memcpy(frame->data, pixels, bytes);
+    frame->rowBytes = rowBytes;
+    frame->pixelFormat = pixelFormat;
+    frame->pts = pts;
+
+    // Never full: there is room for every frame in the pool
+    m_pendingFrameQueue->tryPush(frame);
 }
 
 
-void VideoOutput::commit() {
-    m_isFinished = true;
+void VideoOutput::encode(VideoOutput* vo) {
+    PendingFrame* frame = nullptr;
+    while (vo->m_pendingFrameQueue->waitPop(frame) && notNull(frame)) {
+        vo->encodePixels(frame->data, frame->pixelFormat, frame->rowBytes, frame->pts);
+        vo->m_freeFrameQueue->tryPush(frame);
+    }
+}
 
-    AVFrame* filteredFrame = nullptr;
 
-    // flush the filter graph first to make sure no new frames there
-    int ret = av_buffersrc_add_frame_flags(m_avBufferSrc, nullptr, AV_BUFFERSRC_FLAG_KEEP_REF);
-    if (ret >= 0) {
-        filteredFrame = av_frame_alloc();
+void VideoOutput::stopEncoderThread(bool discard) {
+    if (! m_encoderThread.valid()) {
+        return;
+    }
 
-        ret = av_buffersink_get_frame(m_avBufferSink, filteredFrame);
-        if (ret < 0) {
-            // no new frame, so set to nullptr to flush the encoder
-            av_frame_free(&filteredFrame);
+    if (discard) {
+        PendingFrame* frame = nullptr;
+        while (m_pendingFrameQueue->tryPop(frame)) {
+            m_freeFrameQueue->tryPush(frame);
         }
     }
 
-    ret = avcodec_send_frame(m_avVideoContext, filteredFrame);
-    av_frame_free(&filteredFrame);
+    m_pendingFrameQueue->waitPush(nullptr);
+    m_encoderThread.wait();
+    m_encoderThread = std::future<void>();
+}
 
-    if (ret >= 0) {
-        AVPacket* packet = av_packet_alloc();
-        while (ret >= 0) {
-            ret = avcodec_receive_packet(m_avVideoContext, packet);
 
-            if (ret >= 0) {
-                av_packet_rescale_ts(packet, m_avVideoContext->time_base, m_avVideoStream->time_base);
-                packet->stream_index = m_avVideoStream->index;
+void VideoOutput::convertPixels(const uint8* pixels, int pixelFormat, size_t rowBytes) {
+    const int width = m_settings.width;
+    const int height = m_settings.height;
+    const AVPixFmtDescriptor* dstDesc = av_pix_fmt_desc_get(m_avVideoContext->pix_fmt);
 
-                ret = av_interleaved_write_frame(m_avFormatContext, packet);
-                av_packet_unref(packet);
-                debugAssert(ret >= 0);
-            }
+    if (pixelFormat != m_swsSourceFormat) {
+        for (SwsContext* context : m_swsContextArray) {
+            sws_freeContext(context);
+        }
+        m_swsContextArray.fastClear();
+        m_swsBandStart.fastClear();
+
+        // Bands must start on chroma rows of the destination. There is no
+        // vertical scaling, so each band converts independently.
+        const int alignment = 1 << dstDesc->log2_chroma_h;
+        const int numBands = clamp(int(std::thread::hardware_concurrency()), 1, max(1, height / 64));
+        const int bandHeight = ((height / numBands) / alignment) * alignment;
+        for (int b = 0; b < numBands; ++b) {
+            const int y0 = b * bandHeight;
+            const int y1 = (b == numBands - 1) ? height : (y0 + bandHeight);
+            m_swsBandStart.append(y0);
+            m_swsContextArray.append(sws_getContext(width, y1 - y0, AVPixelFormat(pixelFormat), width, y1 - y0, m_avVideoContext->pix_fmt, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr));
+        }
+        m_swsBandStart.append(height);
+        m_swsSourceFormat = pixelFormat;
+    }
+
+    runConcurrently(0, m_swsContextArray.size(), [&](int b) {
+        const int y0 = m_swsBandStart[b];
+        const int y1 = m_swsBandStart[b + 1];
+
+        // A negative stride reads the rows bottom to top
+        const uint8* src[4] = { nullptr, nullptr, nullptr, nullptr };
+        int srcStride[4] = { 0, 0, 0, 0 };
+        if (m_settings.flipVertical) {
+            src[0] = pixels + (height - 1 - y0) * rowBytes;
+            srcStride[0] = -int(rowBytes);
+        } else {
+            src[0] = pixels + y0 * rowBytes;
+            srcStride[0] = int(rowBytes);
+        }
+
+        uint8* dst[4] = { nullptr, nullptr, nullptr, nullptr };
+        for (int p = 0; (p < 4) && notNull(m_avEncodeFrame->data[p]); ++p) {
+            const int rowShift = ((p == 1) || (p == 2)) ? dstDesc->log2_chroma_h : 0;
+            dst[p] = m_avEncodeFrame->data[p] + (y0 >> rowShift) * m_avEncodeFrame->linesize[p];
         }
 
-        av_packet_free(&packet);
+        sws_scale(m_swsContextArray[b], src, srcStride, 0, y1 - y0, dst, m_avEncodeFrame->linesize);
+    });
+}
+
+
+void VideoOutput::encodePixels(const uint8* pixels, int pixelFormat, size_t rowBytes, int64 pts) {
+    // The codec may still reference the previous frame's buffer
+    if (av_frame_make_writable(m_avEncodeFrame) < 0) {
+        return;
+    }
+
+    convertPixels(pixels, pixelFormat, rowBytes);
+    m_avEncodeFrame->pts = pts;
+
+    if (avcodec_send_frame(m_avVideoContext, m_avEncodeFrame) >= 0) {
+        writeEncodedPackets();
+    }
+}
+
+
+void VideoOutput::writeEncodedPackets() {
+    AVPacket* packet = av_packet_alloc();
+    while (avcodec_receive_packet(m_avVideoContext, packet) >= 0) {
+        av_packet_rescale_ts(packet, m_avVideoContext->time_base, m_avVideoStream->time_base);
+        packet->stream_index = m_avVideoStream->index;
+
+        const int ret = av_interleaved_write_frame(m_avFormatContext, packet);
+        av_packet_unref(packet);
+        (void)ret;
+        debugAssert(ret >= 0);
+    }
+    av_packet_free(&packet);
+}
+
+
+void VideoOutput::commit() {
+    stopEncoderThread(false);
+    m_isFinished = true;
+
+    // flush the encoder
+    if (avcodec_send_frame(m_avVideoContext, nullptr) >= 0) {
+        writeEncodedPackets();
     }
 
     // write the trailer to create a valid file
@@ -508,6 +551,7 @@ void VideoOutput::commit() {
 }
 
 void VideoOutput::abort() {
+    stopEncoderThread(true);
     m_isFinished = true;
     if (m_avFormatContext && m_avFormatContext->pb) {
         avio_closep(&m_avFormatContext->pb);
@@ -75,7 +75,7 @@ shared_ptr<VisibleEntity> VisibleEntity::create
 }
 
 
-VisibleEntity::VisibleEntity() : Entity(), m_visible(true) {
+VisibleEntity::VisibleEntity() : Entity(), m_visible(true), m_poseCacheTime(0) {
     m_canCauseCollisions = true;
 }
 
@@ -211,6 +211,10 @@ void VisibleEntity::simulatePose(SimTime absoluteTime, SimTime deltaTime) {
 
         const shared_ptr<ArticulatedModel>& artModel = dynamic_pointer_cast<ArticulatedModel>(m_model);
         if (isNaN(deltaTime) || (deltaTime > 0)) {
+            // The previous pose changes on the step after an animated one, even if the pose does not
+            if (artPreviousPose->frameTable != artPose->frameTable) {
+                m_lastChangeTime = System::time();
+            }
             artPreviousPose->frameTable = artPose->frameTable;
             artPreviousPose->uniformTable = artPose->uniformTable;
             if (notNull(artPose->uniformTable)) {
@@ -262,16 +266,39 @@ void VisibleEntity::poseModel(Array<shared_ptr<Surface> >& surfaceArray) const {
 }
 
 
-void VisibleEntity::onPose(Array<shared_ptr<Surface> >& surfaceArray) {
+bool VisibleEntity::canPoseConcurrently() const {
+    return notNull(m_model) && m_model->canPoseConcurrently();
+}
+
+
+bool VisibleEntity::poseCacheValid() const {
+    return (m_lastChangeTime < m_poseCacheTime) &&
+        (m_poseCacheModel == m_model) &&
+        (m_poseCachePose == m_pose) &&
+        (m_poseCachePreviousPose == m_previousPose) &&
+        (m_poseCacheFrame == m_frame) &&
+        (m_poseCachePreviousFrame == m_previousFrame);
+}
+
+
+void VisibleEntity::updatePoseCache() {
+    if (poseCacheValid()) {
+        return;
+    }
 
     // We have to pose in order to compute bounds that are used for selection in the editor
-    // and collisions in simulation, so pose anyway if not visible,
-    // but then roll back.
+    // and collisions in simulation, so pose anyway if not visible.
     debugAssert(isFinite(m_frame.translation.x));
     debugAssert(! isNaN(m_frame.rotation[0][0]));
-    const int oldLen = surfaceArray.size();
 
-    poseModel(surfaceArray);
+    m_poseCache.fastClear();
+    poseModel(m_poseCache);
+    m_poseCacheModel         = m_model;
+    m_poseCachePose          = m_pose;
+    m_poseCachePreviousPose  = m_previousPose;
+    m_poseCacheFrame         = m_frame;
+    m_poseCachePreviousFrame = m_previousFrame;
+
     const bool boundsChangedSincePreviousFrame = (m_frame != m_previousFrame) || (notNull(m_pose) && m_pose->differentBounds(m_previousPose));
 
     // Compute bounds for objects that moved
@@ -285,10 +312,10 @@ void VisibleEntity::onPose(Array<shared_ptr<Surface> >& surfaceArray) {
         m_lastBoxBoundArray.fastClear();
 
         // Look at all surfaces produced
-        for (int i = oldLen; i < surfaceArray.size(); ++i) {
+        for (int i = 0; i < m_poseCache.size(); ++i) {
             AABox b;
             Sphere s;
-            const shared_ptr<Surface>& surf = surfaceArray[i];
+            const shared_ptr<Surface>& surf = m_poseCache[i];
 
             // body to world transformation for the surface
             CoordinateFrame cframe;
@@ -326,12 +353,19 @@ void VisibleEntity::onPose(Array<shared_ptr<Surface> >& surfaceArray) {
         m_lastBoundsTime = System::time();
     }
 
-    if (! m_visible) {
-        // Discard my surfaces if I'm invisible; they were only needed for bounds
-        surfaceArray.resize(oldLen, false);
+    m_poseCacheTime = System::time();
+}
+
+
+void VisibleEntity::onPose(Array<shared_ptr<Surface> >& surfaceArray) {
+    updatePoseCache();
+
+    if (m_visible) {
+        surfaceArray.append(m_poseCache);
     }
 }
 
+
 #if 0
 void VisibleEntity::debugDrawVisualization(RenderDevice* rd, VisualizationMode mode) {
     alwaysAssertM(mode == SKELETON, "Bounds visualization not implemented");
@@ -19,6 +19,7 @@
 #include <assert.h>
 #include "G3D-base/G3DString.h"
 #include <vector>
+#include <functional>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <stdio.h>
@@ -43,11 +44,62 @@ namespace G3D {
     #define G3D_ALLOW_UNALIGNED_WRITES
 #endif
 
+namespace _internal {
+
+/**
+  Layout of the chunked zlib format written by BinaryOutput::compress().
+  Each chunk is an independent zlib stream, so chunks can be inflated in
+  parallel and a byte range can be read without inflating the rest of the file:
+
+  <pre>
+    uint32  MARKER
+    uint32  VERSION
+    chunks                      numChunks zlib streams
+    index                       numChunks x (uint64 offset, uint32 compressedBytes, uint32 uncompressedBytes)
+    trailer                     uint64 uncompressedLength, uint32 chunkSize, uint32 numChunks,
+                                uint64 indexOffset, uint32 MAGIC
+  </pre>
+
+  All fields are in the file endian and offsets are from the start of the
+  compressed data. The single-block format begins with its uncompressed size,
+  which is always less than MARKER, so the two formats are distinguished by
+  their first four bytes.
+*/
+class CompressedChunkFormat {
+public:
+    static constexpr uint32 MARKER              = 0xFFFFFFFF;
+    static constexpr uint32 VERSION             = 1;
+    /** "G3DZ" */
+    static constexpr uint32 MAGIC               = 0x5A443347;
+    static constexpr int    HEADER_BYTES        = 8;
+    static constexpr int    INDEX_ENTRY_BYTES   = 16;
+    static constexpr int    TRAILER_BYTES       = 28;
+
+    class Chunk {
+    public:
+        uint64      offset;
+        uint32      compressedBytes;
+        uint32      uncompressedBytes;
+    };
+
+    int64           uncompressedLength;
+    uint32          chunkSize;
+    uint64          indexOffset;
+    Array<Chunk>    chunkArray;
+
+    CompressedChunkFormat() : uncompressedLength(0), chunkSize(0), indexOffset(0) {}
+};
+
+} // namespace _internal
+
 /**
  Sequential or random access byte-order independent binary file access.
- Files compressed with zlib and beginning with an unsigned 32-bit int
- size are transparently decompressed when the compressed = true flag is
- specified to the constructor.
+ Files compressed with zlib by BinaryOutput::compress() are transparently
+ decompressed when the compressed = true flag is specified to the
+ constructor. Both the chunked format and the older single-block format
+ (an unsigned 32-bit int size followed by one zlib stream) are read.
+ Chunks are inflated in parallel, and the range constructor inflates only
+ the chunks that it needs.
 
  For every readX method there are also versions that operate on a whole
  Array, std::vector, or C-array.  e.g. readFloat32(Array<float32>& array, n)
@@ -133,6 +185,18 @@ private:
 
     /** Buffer is compressed; replace it with a decompressed version */
     void decompress();
+
+    /** Allocates and returns the decompressed contents of \a data, in either compressed format */
+    static uint8* inflate(const uint8* data, int64 dataLen, G3DEndian endian, int64& length, const String& filename);
+
+    /** Parses the trailer and index of chunked data that is \a dataLen bytes long.
+        \a read(offset, bytes, dst) copies compressed bytes and returns false if it fails.
+        Returns false if the data is not in the chunked format. */
+    static bool readChunkIndex(int64 dataLen, G3DEndian endian, const std::function<bool (int64, int64, uint8*)>& read, _internal::CompressedChunkFormat& layout);
+
+    /** Inflates chunks [first, last] in parallel into \a dst. \a compressed holds the
+        compressed data beginning at offset \a compressedStart. */
+    static void inflateChunks(const _internal::CompressedChunkFormat& layout, int first, int last, const uint8* compressed, int64 compressedStart, uint8* dst, const String& filename);
 public:
 
     /** false, constant to use with the copyMemory option */
@@ -151,6 +215,22 @@ public:
         G3DEndian           fileEndian,
         bool                compressed = false);
 
+    /**
+       Reads bytes [\a start, \a start + \a length) of the decompressed contents
+       of \a filename, which must have been written with BinaryOutput::compress().
+       Position 0 of this BinaryInput is \a start in the decompressed file and
+       the range is clamped to the end of the file.
+
+       For the chunked format, only the index and the chunks that overlap the range
+       are read from disk and inflated. Files in the single-block format and files
+       inside zipfiles are decompressed completely and then trimmed.
+    */
+    BinaryInput(
+        const String&  filename,
+        G3DEndian           fileEndian,
+        int64               start,
+        int64               length);
+
     /**
      Creates input stream from an in memory source.
      Unless you specify copyMemory = false, the data is copied
@@ -42,7 +42,7 @@ namespace G3D {
  Any method call can trigger an out of memory error (thrown as char*) 
  when writing to "<memory>" instead of a file.
 
- Compressed writing and seeking backwards is not supported for huge files
+ Seeking backwards is not supported for huge files
  (i.e., BinaryOutput may have to dump the contents to disk if they 
  exceed available RAM).
  */
@@ -110,8 +110,14 @@ private:
     BinaryOutput& operator=(const BinaryOutput&);
     bool operator==(const BinaryOutput&);
 
+    /** Writes the single-block compressed format */
+    void compressSingleBlock(int level);
+
 public:
 
+    /** Default chunkSize for compress() */
+    static constexpr int DEFAULT_COMPRESSION_CHUNK_SIZE = 1024 * 1024;
+
     /**
      You must call setEndian() if you use this (memory) constructor.
      */
@@ -128,18 +134,25 @@ public:
 
     ~BinaryOutput();
     
-    /** Compresses the data in the buffer in place, 
-        preceeding it with a little-endian uint32 indicating 
-        the uncompressed size.
+    /** Compresses the data in place with zlib.
 
-        Call immediately before commit().
+        By default the data is split into independently compressed chunks that
+        are compressed in parallel and followed by an index (see
+        _internal::CompressedChunkFormat), so that BinaryInput can inflate them
+        in parallel and read a byte range without inflating the whole file.
+        Huge files (ones where the data was already written to disk) are
+        streamed back from disk and compressed in batches of chunks.
 
-        Cannot be used for huge files (ones where the data
-        was already written to disk)-- will throw char*.
+        When \a chunkSize is 0, writes the older single-block format: the data
+        as one zlib stream, preceded by a uint32 indicating the uncompressed size.
+        That format cannot be used for huge files-- will throw char*.
+
+        Call immediately before commit().
 
         \param level Compression level.  0 = fast, low compression; 9 = slow, high compression
+        \param chunkSize Uncompressed bytes per chunk
      */
-    void compress(int level = 9);
+    void compress(int level = 9, int chunkSize = DEFAULT_COMPRESSION_CHUNK_SIZE);
 
     /** True if no errors have been encountered.*/
     bool ok() const;
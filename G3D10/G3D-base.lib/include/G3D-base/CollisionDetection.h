@@ -1121,6 +1121,30 @@ public:
         const Sphere&           sphere,
         const Box&              box);
 
+    /**
+     Batch version of fixedSolidSphereIntersectsFixedSolidSphere that tests
+     sphere1[i] against sphere2[i] for 0 <= i < count, four pairs at a time with SIMD.
+
+     @param result Array of count elements that receives the results
+     */
+    static void fixedSolidSphereIntersectsFixedSolidSphere(
+        const Sphere*           sphere1,
+        const Sphere*           sphere2,
+        int                     count,
+        bool*                   result);
+
+    /**
+     Batch version of fixedSolidSphereIntersectsFixedSolidBox that tests
+     sphere[i] against box[i] for 0 <= i < count, four pairs at a time with SIMD.
+
+     @param result Array of count elements that receives the results
+     */
+    static void fixedSolidSphereIntersectsFixedSolidBox(
+        const Sphere*           sphere,
+        const Box*              box,
+        int                     count,
+        bool*                   result);
+
     static bool fixedSolidSphereIntersectsFixedTriangle(
         const Sphere&           sphere,
         const Triangle&         triangle);
@@ -0,0 +1,108 @@
+/**
+  \file G3D-base.lib/include/G3D-base/CubeMapSampler.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_CubeMapSampler_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/ReferenceCount.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/Vector3.h"
+
+namespace G3D {
+
+class CubeMap;
+class Random;
+
+/**
+  \brief Chooses directions in proportion to the radiance of a CubeMap, for
+  next-event estimation towards an environment such as a sky with a small,
+  bright sun.
+
+  The faces are divided into a grid of at most maxResolution x maxResolution
+  cells each. A cell is chosen from an alias table in O(1) time, and then the
+  direction is chosen uniformly within the cell. Each cell's weight is the
+  largest radiance of the cube map texels that it covers or that border it
+  (so that bilinear filtering cannot bring light into a cell that is never
+  chosen), times the cell's solid angle. A cell entry holds everything
+  needed to sample it and evaluate pdf(), so each query reads one 16-byte
+  entry.
+
+  The sampler is immutable after creation, so one instance may be shared by
+  all threads.
+
+  \sa PathTracer, CubeMap
+*/
+class CubeMapSampler : public ReferenceCountedObject {
+protected:
+
+    /** Alias table entry for one cell */
+    class Cell {
+    public:
+        /** Keep this cell if the fractional part of the random index is less than threshold */
+        float       threshold = 1.0f;
+
+        /** Cell chosen otherwise */
+        int         alias = 0;
+
+        /** Probability of choosing this cell */
+        float       probability = 0.0f;
+
+        /** Probability of choosing the alias cell */
+        float       aliasProbability = 0.0f;
+    };
+
+    shared_ptr<CubeMap> m_cubeMap;
+
+    /** Cells per face edge */
+    int                 m_resolution;
+
+    /** 6 * m_resolution^2 cells, in face-major then row-major order */
+    Array<Cell>         m_cell;
+
+    bool                m_black;
+
+    CubeMapSampler(const shared_ptr<CubeMap>& cubeMap, int maxResolution);
+
+    /** Direction to the point (s, t) on [-1, 1]^2 of \a face, which is not normalized */
+    static Vector3 faceDirection(int face, float s, float t);
+
+    /** Solid angle probability density for a cell with probability \a cellProbability at (s, t) */
+    float density(float cellProbability, float s, float t) const;
+
+public:
+
+    /** \param maxResolution Bounds the number of cells per face edge, and thus the memory
+        (16 bytes per cell) and build time. Cube maps larger than this are prefiltered by
+        taking the maximum over each cell. */
+    static shared_ptr<CubeMapSampler> create(const shared_ptr<CubeMap>& cubeMap, int maxResolution = 256);
+
+    const shared_ptr<CubeMap>& cubeMap() const {
+        return m_cubeMap;
+    }
+
+    /** True if the cube map had no radiance, in which case directions are chosen
+        uniformly over the sphere */
+    bool black() const {
+        return m_black;
+    }
+
+    /** Cells per face edge */
+    int resolution() const {
+        return m_resolution;
+    }
+
+    /** Chooses a unit direction. Its radiance is cubeMap()->bilinear(w).
+        \param pdfValue Solid angle probability density with which the direction was chosen */
+    Vector3 sample(Random& rng, float& pdfValue) const;
+
+    /** Solid angle probability density with which sample() chooses \a w, which need not be unit length */
+    float pdf(const Vector3& w) const;
+};
+
+} // namespace G3D
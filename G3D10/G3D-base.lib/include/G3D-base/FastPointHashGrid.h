@@ -17,6 +17,8 @@
 #include "G3D-base/AABox.h"
 #include "G3D-base/Sphere.h"
 #include "FastPODTable.h"
+#include "G3D-base/KNearestHeap.h"
+#include "G3D-base/Thread.h"
 
 #ifdef CURRENT
 #undef CURRENT
@@ -477,6 +479,127 @@ public:
     }
 
 
+    /** Appends all values that are contained within the \a sphere. */
+    void getIntersectingMembers(const Sphere& sphere, Array<Value>& result) const {
+        for (SphereIterator it = begin(sphere); it.isValid(); ++it) {
+            result.append(*it);
+        }
+    }
+
+
+    /**
+      Runs getIntersectingMembers() for each sphere in parallel. The grid must not be mutated during the call.
+
+      \param resultArray Resized to sphereArray.size(); the results for each sphere are appended to the corresponding element.
+     */
+    void getIntersectingMembers(const Array<Sphere>& sphereArray, Array<Array<Value>>& resultArray, bool singleThread = false) const {
+        resultArray.resize(sphereArray.size());
+        runConcurrently(0, sphereArray.size(), [&](int i) {
+            getIntersectingMembers(sphereArray[i], resultArray[i]);
+        }, singleThread);
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////
+
+    /**
+      \brief Finds the \a k values closest to \a point that are within \a maxRadius of it.
+
+      Visits cells in cubic shells of increasing size around the cell containing
+      \a point and stops as soon as the next shell cannot contain anything closer
+      than the current k-th nearest value, so no search radius has to be guessed.
+      When \a maxRadius is infinite and there are fewer than \a k values, every
+      occupied shell out to the farthest value is visited.
+
+      \param maxRadius May be finf()
+      \param result The results are appended to this array, nearest first
+      \param squaredDistance The squared distance of each result is appended to this array
+     */
+    void kNearest(const Point3& point, int k, float maxRadius, Array<Value>& result, Array<float>& squaredDistance) const {
+        KNearestHeap<Value> heap(k, maxRadius);
+        kNearest(point, heap);
+        heap.getResults(result, squaredDistance);
+    }
+
+
+    /** \copydoc kNearest(const Point3&, int, float, Array<Value>&, Array<float>&) const */
+    void kNearest(const Point3& point, int k, float maxRadius, Array<Value>& result) const {
+        KNearestHeap<Value> heap(k, maxRadius);
+        kNearest(point, heap);
+        heap.getResults(result);
+    }
+
+
+    /**
+      Runs kNearest() for each point in parallel. The grid must not be mutated during the call.
+
+      \param resultArray Resized to pointArray.size(); the results for each point are appended to the corresponding element.
+     */
+    void kNearest(const Array<Point3>& pointArray, int k, float maxRadius, Array<Array<Value>>& resultArray, bool singleThread = false) const {
+        resultArray.resize(pointArray.size());
+        runConcurrently(0, pointArray.size(), [&](int i) {
+            kNearest(pointArray[i], k, maxRadius, resultArray[i]);
+        }, singleThread);
+    }
+
+protected:
+
+    /** Considers every value in the cell at \a key */
+    void considerCell(const Vector4int16& key, const Point3& point, KNearestHeap<Value>& heap, int& numVisited) const {
+        const ValueArray* array = m_table->getPointer(key);
+        if (notNull(array)) {
+            for (const Value& v : *array) {
+                Point3 pos;
+                PosFunc::getPosition(v, pos);
+                heap.consider((pos - point).squaredLength(), v);
+            }
+            numVisited += array->size();
+        }
+    }
+
+
+    void kNearest(const Point3& point, KNearestHeap<Value>& heap) const {
+        if (m_size == 0) {
+            return;
+        }
+
+        const Vector4int16 center = toCell(point);
+        int numVisited = 0;
+
+        // Cells are addressed by int16, so no shell is larger than this
+        static const int MAX_SHELL = 1 << 16;
+        for (int r = 0; r <= MAX_SHELL; ++r) {
+            // Visit the cells whose Chebyshev distance from the center cell is exactly r
+            for (int dz = -r; dz <= r; ++dz) {
+                for (int dy = -r; dy <= r; ++dy) {
+                    const bool onFace = (abs(dz) == r) || (abs(dy) == r);
+                    const int dxStep = onFace ? 1 : max(2 * r, 1);
+                    for (int dx = -r; dx <= r; dx += dxStep) {
+                        considerCell(Vector4int16(int16(center.x + dx), int16(center.y + dy), int16(center.z + dz), 0), point, heap, numVisited);
+                    }
+                }
+            }
+
+            if (numVisited >= m_size) {
+                return;
+            }
+
+            // Every unvisited value is outside the box covered by shells 0..r
+            float bound = finf();
+            const Point3 lo = Point3(float(center.x - r), float(center.y - r), float(center.z - r)) * m_metersPerCell;
+            const Point3 hi = Point3(float(center.x + r + 1), float(center.y + r + 1), float(center.z + r + 1)) * m_metersPerCell;
+            for (int a = 0; a < 3; ++a) {
+                bound = min(bound, point[a] - lo[a], hi[a] - point[a]);
+            }
+
+            if (square(max(bound, 0.0f)) > heap.squaredBound()) {
+                return;
+            }
+        }
+    }
+
+public:
+
+
     void debugPrintStatistics() const {
         m_table->debugPrintStatus();
 
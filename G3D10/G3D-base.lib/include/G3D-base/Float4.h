@@ -0,0 +1,108 @@
+/**
+  \file G3D-base.lib/include/G3D-base/Float4.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_Float4_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/g3dmath.h"
+#include <cstring>
+
+#ifndef G3D_ARM
+#   include <xmmintrin.h>
+#endif
+
+namespace G3D {
+
+/** \brief Four floats processed in lockstep, for batched geometric tests.
+
+    Comparisons produce all-ones or all-zero bit masks in each lane, as with SSE.
+    Compiles to SSE on x86 and to scalar loops elsewhere.
+
+    \sa SurfaceCuller, CollisionDetection */
+class Float4 {
+public:
+#ifndef G3D_ARM
+    __m128      v;
+
+    Float4() {}
+    Float4(__m128 v) : v(v) {}
+    explicit Float4(float s) : v(_mm_set1_ps(s)) {}
+
+    static Float4 load(const float* p) { return Float4(_mm_loadu_ps(p)); }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+
+    Float4 operator+(const Float4& b) const { return Float4(_mm_add_ps(v, b.v)); }
+    Float4 operator-(const Float4& b) const { return Float4(_mm_sub_ps(v, b.v)); }
+    Float4 operator*(const Float4& b) const { return Float4(_mm_mul_ps(v, b.v)); }
+    Float4 operator/(const Float4& b) const { return Float4(_mm_div_ps(v, b.v)); }
+    Float4 operator&(const Float4& b) const { return Float4(_mm_and_ps(v, b.v)); }
+    Float4 operator|(const Float4& b) const { return Float4(_mm_or_ps(v, b.v)); }
+    Float4 operator<(const Float4& b) const { return Float4(_mm_cmplt_ps(v, b.v)); }
+    Float4 operator<=(const Float4& b) const { return Float4(_mm_cmple_ps(v, b.v)); }
+    Float4 operator>(const Float4& b) const { return Float4(_mm_cmpgt_ps(v, b.v)); }
+    Float4 operator>=(const Float4& b) const { return Float4(_mm_cmpge_ps(v, b.v)); }
+
+    static Float4 min(const Float4& a, const Float4& b) { return Float4(_mm_min_ps(a.v, b.v)); }
+    static Float4 max(const Float4& a, const Float4& b) { return Float4(_mm_max_ps(a.v, b.v)); }
+
+    /** Lanes of \a a where \a mask is set, \a b elsewhere */
+    static Float4 select(const Float4& mask, const Float4& a, const Float4& b) {
+        return Float4(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)));
+    }
+
+    Float4 abs() const { return Float4(_mm_andnot_ps(_mm_set1_ps(-0.0f), v)); }
+
+    /** Correctly rounded, so it matches sqrtf in each lane */
+    Float4 sqrt() const { return Float4(_mm_sqrt_ps(v)); }
+
+    /** Bit i is set if lane i's mask is set */
+    int bits() const { return _mm_movemask_ps(v); }
+#else
+    float       v[4];
+
+    Float4() {}
+    explicit Float4(float s) { v[0] = v[1] = v[2] = v[3] = s; }
+
+    static Float4 load(const float* p) { Float4 r; for (int i = 0; i < 4; ++i) { r.v[i] = p[i]; } return r; }
+    void store(float* p) const { for (int i = 0; i < 4; ++i) { p[i] = v[i]; } }
+
+    static float maskValue(bool b) { const uint32 u = b ? 0xFFFFFFFF : 0; float f; memcpy(&f, &u, 4); return f; }
+    static bool isSet(float f) { uint32 u; memcpy(&u, &f, 4); return u != 0; }
+
+#   define G3D_FLOAT4_OP(op, expr) \
+    Float4 operator op(const Float4& b) const { Float4 r; for (int i = 0; i < 4; ++i) { const float x = v[i]; const float y = b.v[i]; r.v[i] = (expr); } return r; }
+
+    G3D_FLOAT4_OP(+, x + y)
+    G3D_FLOAT4_OP(-, x - y)
+    G3D_FLOAT4_OP(*, x * y)
+    G3D_FLOAT4_OP(/, x / y)
+    G3D_FLOAT4_OP(&, maskValue(isSet(x) && isSet(y)))
+    G3D_FLOAT4_OP(|, maskValue(isSet(x) || isSet(y)))
+    G3D_FLOAT4_OP(<, maskValue(x < y))
+    G3D_FLOAT4_OP(<=, maskValue(x <= y))
+    G3D_FLOAT4_OP(>, maskValue(x > y))
+    G3D_FLOAT4_OP(>=, maskValue(x >= y))
+#   undef G3D_FLOAT4_OP
+
+    static Float4 min(const Float4& a, const Float4& b) { Float4 r; for (int i = 0; i < 4; ++i) { r.v[i] = G3D::min(a.v[i], b.v[i]); } return r; }
+    static Float4 max(const Float4& a, const Float4& b) { Float4 r; for (int i = 0; i < 4; ++i) { r.v[i] = G3D::max(a.v[i], b.v[i]); } return r; }
+
+    static Float4 select(const Float4& mask, const Float4& a, const Float4& b) {
+        Float4 r; for (int i = 0; i < 4; ++i) { r.v[i] = isSet(mask.v[i]) ? a.v[i] : b.v[i]; } return r;
+    }
+
+    Float4 abs() const { Float4 r; for (int i = 0; i < 4; ++i) { r.v[i] = fabsf(v[i]); } return r; }
+
+    Float4 sqrt() const { Float4 r; for (int i = 0; i < 4; ++i) { r.v[i] = sqrtf(v[i]); } return r; }
+
+    int bits() const { int b = 0; for (int i = 0; i < 4; ++i) { b |= isSet(v[i]) ? (1 << i) : 0; } return b; }
+#endif
+};
+
+} // namespace G3D
@@ -59,6 +59,7 @@
 #include "G3D-base/Projection.h"
 #include "G3D-base/PhysicsFrame.h"
 #include "G3D-base/PhysicsFrameSpline.h"
+#include "G3D-base/QuantizedPhysicsFrame.h"
 #include "G3D-base/Plane.h"
 #include "G3D-base/Line.h"
 #include "G3D-base/Ray.h"
@@ -99,6 +100,7 @@
 #include "G3D-base/BumpMapPreprocess.h"
 #include "G3D-base/CubeFace.h"
 #include "G3D-base/Line2D.h"
+#include "G3D-base/MPMCQueue.h"
 #include "G3D-base/ThreadsafeQueue.h"
 #include "G3D-base/network.h"
 #include "G3D-base/FrameName.h"
@@ -110,7 +112,9 @@
 #include "G3D-base/EqualsTrait.h"
 #include "G3D-base/Image.h"
 #include "G3D-base/CubeMap.h"
+#include "G3D-base/CubeMapSampler.h"
 #include "G3D-base/CollisionDetection.h"
+#include "G3D-base/Float4.h"
 #include "G3D-base/Intersect.h"
 #include "G3D-base/Log.h"
 #include "G3D-base/serialize.h"
@@ -134,6 +138,7 @@
 #include "G3D-base/vectorMath.h"
 #include "G3D-base/Rect2D.h"
 #include "G3D-base/KDTree.h"
+#include "G3D-base/KNearestHeap.h"
 #include "G3D-base/PointKDTree.h"
 #include "G3D-base/TextOutput.h"
 #include "G3D-base/MeshBuilder.h"
@@ -150,6 +155,7 @@
 #include "G3D-base/Image3unorm8.h"
 #include "G3D-base/Image4.h"
 #include "G3D-base/Image4unorm8.h"
+#include "G3D-base/ImageResampler.h"
 #include "G3D-base/filter.h"
 #include "G3D-base/WeakCache.h"
 #include "G3D-base/Pointer.h"
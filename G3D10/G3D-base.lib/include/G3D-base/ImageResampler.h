@@ -0,0 +1,107 @@
+/**
+  \file G3D-base.lib/include/G3D-base/ImageResampler.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_ImageResampler_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/enumclass.h"
+#include "G3D-base/WrapMode.h"
+
+namespace G3D {
+
+class Image;
+class Image4;
+
+/**
+  \brief Resizes images and builds MIP chains on the CPU with separable
+  windowed-sinc or box filters.
+
+  Use this where Texture::generateMipMaps is unavailable, e.g., in offline
+  tools on machines without a GPU, or where a better filter than the GPU's
+  box filter is wanted.
+
+  Each image is filtered horizontally and then vertically. Both passes
+  process one RGBA pixel per SIMD operation and run concurrently on
+  tiles of the image. When Specification::sRGB is set, color is decoded
+  to linear before filtering and encoded afterwards, so that averages are
+  of light and not of encoded values. When Specification::alphaWeighted is
+  set, color is premultiplied by alpha while filtering, so that the color
+  of transparent pixels does not bleed into their neighbors.
+
+  \code
+  ImageResampler::Specification spec;
+  spec.sRGB = true;
+  Array<shared_ptr<Image>> mipArray;
+  ImageResampler::generateMipMaps(Image::fromFile("albedo.png"), mipArray, spec);
+  \endcode
+
+  \sa Image, Image4, Texture::generateMipMaps
+*/
+class ImageResampler {
+public:
+
+    G3D_DECLARE_ENUM_CLASS(Filter,
+        /** Averages the source pixels under each destination pixel. Fastest. Blurs when magnifying. */
+        BOX,
+
+        /** Lanczos windowed sinc. Sharp, with slight ringing at edges. */
+        LANCZOS,
+
+        /** Kaiser windowed sinc. Less ringing than LANCZOS at the same radius. */
+        KAISER);
+
+    class Specification {
+    public:
+        Filter          filter = Filter::LANCZOS;
+
+        /** Half-width of the LANCZOS and KAISER filters, in destination pixels when
+            minifying and in source pixels when magnifying */
+        float           radius = 3.0f;
+
+        /** Shape of the Kaiser window. Larger values blur more and ring less. */
+        float           kaiserAlpha = 4.0f;
+
+        /** If true, the RGB channels are sRGB encoded and are filtered in linear space.
+            Alpha is always linear. */
+        bool            sRGB = false;
+
+        /** If true, color is weighted by alpha while filtering. The result has
+            straight (not premultiplied) alpha either way. */
+        bool            alphaWeighted = true;
+
+        /** How to read beyond the edges of the source. CLAMP or TILE. */
+        WrapMode        wrapMode = WrapMode::CLAMP;
+
+        Specification() {}
+    };
+
+    /** Returns \a src resampled to \a width x \a height */
+    static shared_ptr<Image4> resize(const shared_ptr<Image4>& src, int width, int height, const Specification& specification = Specification());
+
+    /** Returns \a src resampled to \a width x \a height, in the format of \a src */
+    static shared_ptr<Image> resize(const shared_ptr<Image>& src, int width, int height, const Specification& specification = Specification());
+
+    /** Sets \a mipArray to \a src followed by each smaller level of its MIP chain,
+        ending at 1 x 1. Each level is half the size of the previous one, rounded
+        down, and is filtered from the previous level. */
+    static void generateMipMaps(const shared_ptr<Image4>& src, Array<shared_ptr<Image4>>& mipArray, const Specification& specification = Specification());
+
+    /** As above, with each level in the format of \a src */
+    static void generateMipMaps(const shared_ptr<Image>& src, Array<shared_ptr<Image>>& mipArray, const Specification& specification = Specification());
+
+    /** Computes the MIP chains of the six faces of a cube map, which must be square and
+        of equal size. mipArray[level][face] uses the order of \a faceArray.
+
+        Faces are filtered independently with WrapMode::CLAMP, so filters do not
+        cross the edges of the cube. */
+    static void generateCubeMapMipMaps(const Array<shared_ptr<Image4>>& faceArray, Array<Array<shared_ptr<Image4>>>& mipArray, const Specification& specification = Specification());
+};
+
+} // namespace G3D
@@ -26,6 +26,7 @@
 #include "G3D-base/BinaryOutput.h"
 #include "G3D-base/CollisionDetection.h"
 #include "G3D-base/BoundsTrait.h"
+#include "G3D-base/Thread.h"
 #include <algorithm>
 
 // If defined, in debug mode the tree is checked for consistency
@@ -227,9 +228,9 @@ protected:
         }
     };
 
-    /** Returns the bounds of the sub array. Used by makeNode. */
+    /** Returns the bounds of the sub array. Used by buildFlat. */
     static AABox computeBounds(
-        const Array<Handle*>& point, 
+        const Handle* const*  point, 
         int                   beginIndex,
         int                   endIndex) {
     
@@ -698,150 +699,230 @@ protected:
     };
 
 
-    /**
-     Recursively subdivides the subarray.
-    
-     Clears the source array as soon as it is no longer needed.
+    /** Node of the flattened tree that balance() produces. Nodes are in
+        depth-first order, so the low child of node i is always node i + 1.
+        The values of each node are contiguous in m_flatHandle and m_flatBounds. */
+    class FlatNode {
+    public:
+        /** As Node::splitBounds */
+        AABox               splitBounds;
+        float               splitLocation;
+        uint8               splitAxis;
+        bool                hasLowChild;
 
-     Call assignSplitBounds() on the root node after making a tree.
-     */
-    Node* makeNode(
-        Array<Handle*>& source, 
-        int valuesPerNode, 
-        int numMeanSplits,
-        Array<Handle*>& temp)  {
+        /** -1 if there is no high child */
+        int                 highChild;
+        int                 firstValue;
+        int                 numValues;
+    };
 
-        Node* node = nullptr;
-        
-        if (source.size() <= valuesPerNode) {
-            // Make a new leaf node
-            node = new Node(source);
-            
-            // Set the pointers in the memberTable
-            for (int i = 0; i < source.size(); ++i) {
-                memberTable.set(Member(source[i]), node);
+    /** balance() builds subtrees with more values than this concurrently */
+    enum {PARALLEL_BUILD_SIZE = 8192};
+
+    /** Size of each record written by serializeFlatStructure() */
+    enum {FLAT_STRUCTURE_RECORD_SIZE = 36};
+
+    /** Reorders handle[begin, end) into the values strictly below \a splitLocation
+        along \a splitAxis, the values that straddle it, and the values strictly above it. */
+    static void partition(
+        Handle**            handle,
+        int                 begin,
+        int                 end,
+        Vector3::Axis       splitAxis,
+        float               splitLocation,
+        int&                ltEnd,
+        int&                gtBegin) {
+
+        int i = begin;
+        ltEnd = begin;
+        gtBegin = end;
+        while (i < gtBegin) {
+            const AABox& bounds = handle[i]->bounds;
+            if (bounds.high()[splitAxis] < splitLocation) {
+                std::swap(handle[ltEnd], handle[i]);
+                ++ltEnd;
+                ++i;
+            } else if (bounds.low()[splitAxis] > splitLocation) {
+                --gtBegin;
+                std::swap(handle[i], handle[gtBegin]);
+            } else {
+                ++i;
             }
-            source.clear();
-            
-        } else {
-            // Make a new internal node
-            node = new Node();
-            
-            const AABox& bounds = computeBounds(source, 0, source.size() - 1);
-            const Vector3& extent = bounds.high() - bounds.low();
-            
-            Vector3::Axis splitAxis = extent.primaryAxis();
-            
-            float splitLocation;
+        }
+    }
 
-            // Arrays for holding the children
-            Array<Handle*> lt, gt;
-                
-            if (numMeanSplits <= 0) {
-
-                source.medianPartition(lt, node->valueArray, gt, temp, CenterComparator(splitAxis));
-
-                // Choose the split location to be the center of whatever fell in the center
-                splitLocation = node->valueArray[0]->center[splitAxis];
-
-                // Some of the elements in the lt or gt array might really overlap the split location.
-                // Move them as needed.
-                for (int i = 0; i < lt.size(); ++i) {
-                    const AABox& bounds = lt[i]->bounds;
-                    if ((bounds.low()[splitAxis] <= splitLocation) && (bounds.high()[splitAxis] >= splitLocation)) {
-                        node->valueArray.append(lt[i]);
-                        // Remove this element and process the new one that
-                        // is swapped in in its place.
-                        lt.fastRemove(i); --i;
-                    }
-                }
+    /**
+     Recursively subdivides handle[begin, end) in place and appends the subtree
+     to nodeArray in depth-first order. Each node's values end up contiguous, between
+     those of its low and high children. Child indices are relative to the start of
+     nodeArray.
 
-                for (int i = 0; i < gt.size(); ++i) {
-                    const AABox& bounds = gt[i]->bounds;
-                    if ((bounds.low()[splitAxis] <= splitLocation) && (bounds.high()[splitAxis] >= splitLocation)) {
-                        node->valueArray.append(gt[i]);
-                        // Remove this element and process the new one that
-                        // is swapped in in its place.
-                        gt.fastRemove(i); --i;
-                    }
-                }            
-
-                if ((node->valueArray.size() > (source.size() / 2)) &&
-                    (source.size() > 6)) {
-                    // This was a bad partition; we ended up putting the splitting plane right in the middle of most of the 
-                    // objects.  We could try to split on a different axis, or use a different partition (e.g., the extents mean, 
-                    // or geometric mean).  This implementation falls back on the extents mean, since that case is already handled 
-                    // below.
-                    numMeanSplits = 1;
-                }
-            }
+     Large subtrees are built concurrently, the high child into a separate array
+     that is then appended.
+     */
+    static void buildFlat(
+        Handle**            handle,
+        int                 begin,
+        int                 end,
+        const AABox&        splitBounds,
+        int                 valuesPerNode,
+        int                 numMeanSplits,
+        Array<FlatNode>&    nodeArray) {
+
+        // nodeArray may be reallocated by the children, so refer to this node by index
+        const int index = nodeArray.size();
+        {
+            FlatNode& node     = nodeArray.next();
+            node.splitBounds   = splitBounds;
+            node.splitLocation = 0;
+            node.splitAxis     = Vector3::X_AXIS;
+            node.hasLowChild   = false;
+            node.highChild     = -1;
+            node.firstValue    = begin;
+            node.numValues     = end - begin;
+        }
 
-            // Note: numMeanSplits may have been increased by the code in the previous case above in order to
-            // force a re-partition.
+        if (end - begin <= valuesPerNode) {
+            // Leaf node
+            return;
+        }
 
-            if (numMeanSplits > 0) {
-                // Split along the mean
-                splitLocation = 
-                    bounds.high()[splitAxis] * 0.5f + 
-                    bounds.low()[splitAxis] * 0.5f;
-                
-                debugAssertM(isFinite(splitLocation),
-                            "Internal error: split location must be finite.");
+        const AABox& bounds = computeBounds(handle, begin, end - 1);
+        const Vector3& extent = bounds.high() - bounds.low();
+        const Vector3::Axis splitAxis = extent.primaryAxis();
+
+        float splitLocation = 0;
+        int ltEnd = begin, gtBegin = end;
+
+        if (numMeanSplits <= 0) {
+            // Choose the split location to be the center of the median value
+            const int median = (begin + end) / 2;
+            std::nth_element(handle + begin, handle + median, handle + end, [splitAxis](const Handle* a, const Handle* b) {
+                return a->center[splitAxis] < b->center[splitAxis];
+            });
+            splitLocation = handle[median]->center[splitAxis];
+            partition(handle, begin, end, splitAxis, splitLocation, ltEnd, gtBegin);
+
+            if ((gtBegin - ltEnd > (end - begin) / 2) && (end - begin > 6)) {
+                // This was a bad partition; we ended up putting the splitting plane right in the middle of most of the 
+                // objects. Fall back on the extents mean.
+                numMeanSplits = 1;
+            }
+        }
 
-                source.partition(nullptr, lt, node->valueArray, gt, Comparator(splitAxis, splitLocation));
+        if (numMeanSplits > 0) {
+            // Split along the mean
+            splitLocation = 
+                bounds.high()[splitAxis] * 0.5f + 
+                bounds.low()[splitAxis] * 0.5f;
 
-                // The Comparator ensures that elements are strictly on the correct side of the split
-            }
+            debugAssertM(isFinite(splitLocation),
+                         "Internal error: split location must be finite.");
 
+            partition(handle, begin, end, splitAxis, splitLocation, ltEnd, gtBegin);
+        }
 
-#           if defined(G3D_DEBUG) && defined(VERIFY_TREE)
-                debugAssert(lt.size() + node->valueArray.size() + gt.size() == source.size());
-                // Verify that all objects ended up on the correct side of the split.
-                // (i.e., make sure that the Array partition was correct) 
-                for (int i = 0; i < lt.size(); ++i) {
-                    const AABox& bounds  = lt[i]->bounds;
-                    debugAssert(bounds.high()[splitAxis] < splitLocation);
+#       if defined(G3D_DEBUG) && defined(VERIFY_TREE)
+            for (int i = begin; i < end; ++i) {
+                const AABox& b = handle[i]->bounds;
+                if (i < ltEnd) {
+                    debugAssert(b.high()[splitAxis] < splitLocation);
+                } else if (i >= gtBegin) {
+                    debugAssert(b.low()[splitAxis] > splitLocation);
+                } else {
+                    debugAssert((b.low()[splitAxis] <= splitLocation) && (b.high()[splitAxis] >= splitLocation));
                 }
+            }
+#       endif
 
-                for (int i = 0; i < gt.size(); ++i) {
-                    const AABox& bounds  = gt[i]->bounds;
-                    debugAssert(bounds.low()[splitAxis] > splitLocation);
-                }
+        {
+            FlatNode& node     = nodeArray[index];
+            node.splitAxis     = uint8(splitAxis);
+            node.splitLocation = splitLocation;
+            node.hasLowChild   = (ltEnd > begin);
+            node.firstValue    = ltEnd;
+            node.numValues     = gtBegin - ltEnd;
+        }
 
-                for (int i = 0; i < node->valueArray.size(); ++i) {
-                    const AABox& bounds  = node->valueArray[i]->bounds;
-                    debugAssert(bounds.high()[splitAxis] >= splitLocation);
-                    debugAssert(bounds.low()[splitAxis] <= splitLocation);
-                }
-#           endif
+        AABox childBounds[2];
+        splitBounds.split(splitAxis, splitLocation, childBounds[0], childBounds[1]);
 
-            // The source array is no longer needed
-            source.clear();
+        const bool hasLowChild  = (ltEnd > begin);
+        const bool hasHighChild = (end > gtBegin);
 
-            node->splitAxis = splitAxis;
-            node->splitLocation = splitLocation;
+        if (hasLowChild && hasHighChild && (end - begin > PARALLEL_BUILD_SIZE)) {
+            Array<FlatNode> highArray;
+            runConcurrently(0, 2, [&](int c) {
+                if (c == 0) {
+                    buildFlat(handle, begin, ltEnd, childBounds[0], valuesPerNode, numMeanSplits - 1, nodeArray);
+                } else {
+                    buildFlat(handle, gtBegin, end, childBounds[1], valuesPerNode, numMeanSplits - 1, highArray);
+                }
+            });
 
-            // Update the bounds array and member table
-            node->boundsArray.resize(node->valueArray.size());
-            for (int i = 0; i < node->valueArray.size(); ++i) {
-                Handle* v = node->valueArray[i];
-                node->boundsArray[i] = v->bounds;
-                memberTable.set(Member(v), node);
+            const int offset = nodeArray.size();
+            for (FlatNode& node : highArray) {
+                if (node.highChild != -1) {
+                    node.highChild += offset;
+                }
             }
-
-            if (lt.size() > 0) {            
-                node->child[0] = makeNode(lt, valuesPerNode, numMeanSplits - 1, temp);
+            nodeArray[index].highChild = offset;
+            nodeArray.append(highArray);
+        } else {
+            if (hasLowChild) {
+                buildFlat(handle, begin, ltEnd, childBounds[0], valuesPerNode, numMeanSplits - 1, nodeArray);
             }
-            
-            if (gt.size() > 0) {
-                node->child[1] = makeNode(gt, valuesPerNode, numMeanSplits - 1, temp);
+            if (hasHighChild) {
+                nodeArray[index].highChild = nodeArray.size();
+                buildFlat(handle, gtBegin, end, childBounds[1], valuesPerNode, numMeanSplits - 1, nodeArray);
             }
-            
         }
-        
+    }
+
+    /** Recursively builds the pointer tree for flat node \a n, setting
+        pointers for members in the memberTable */
+    Node* unflatten(int n) {
+        const FlatNode& flat = m_flatNodeArray[n];
+        Node* node = new Node();
+        node->splitBounds   = flat.splitBounds;
+        node->splitAxis     = Vector3::Axis(flat.splitAxis);
+        node->splitLocation = flat.splitLocation;
+
+        node->valueArray.resize(flat.numValues);
+        node->boundsArray.resize(flat.numValues);
+        for (int v = 0; v < flat.numValues; ++v) {
+            Handle* h = m_flatHandle[flat.firstValue + v];
+            node->valueArray[v]  = h;
+            node->boundsArray[v] = m_flatBounds[flat.firstValue + v];
+            memberTable.set(Member(h), node);
+        }
+
+        if (flat.hasLowChild) {
+            node->child[0] = unflatten(n + 1);
+        }
+        if (flat.highChild != -1) {
+            node->child[1] = unflatten(flat.highChild);
+        }
         return node;
     }
 
+    /** Converts the flat tree to the pointer tree, which insert() and remove() modify.
+        Does nothing if the flat tree is not valid. */
+    void unflatten() {
+        if (m_flatValid) {
+            debugAssert(root == nullptr);
+            root = unflatten(0);
+            invalidateFlat();
+        }
+    }
+
+    void invalidateFlat() {
+        m_flatValid = false;
+        m_flatNodeArray.fastClear();
+        m_flatHandle.fastClear();
+        m_flatBounds.fastClear();
+    }
+
     /**
      Recursively clone the passed in node tree, setting
      pointers for members in the memberTable as appropriate.
@@ -876,24 +957,53 @@ protected:
     /** Maps members to the node containing them */
     MemberTable             memberTable;
 
+    /** nullptr while the flat tree is valid */
     Node*                   root;
 
+    /** True from balance() until the next insert() or remove(). While true,
+        the tree is stored only in the flat arrays, which queries traverse
+        without chasing pointers. */
+    bool                    m_flatValid;
+    Array<FlatNode>         m_flatNodeArray;
+
+    /** Values of the flat tree, grouped by node */
+    Array<Handle*>          m_flatHandle;
+
+    /** Bounds of each handle in m_flatHandle */
+    Array<AABox>            m_flatBounds;
+
 public:
 
     /** To construct a balanced tree, insert the elements and then call
       KDTree::balance(). */
-    KDTree() : root(nullptr) {}
+    KDTree() : root(nullptr), m_flatValid(false) {}
 
 
-    KDTree(const KDTree& src) : root(nullptr) {
+    KDTree(const KDTree& src) : root(nullptr), m_flatValid(false) {
         *this = src;
     }
 
 
     KDTree& operator=(const KDTree& src) {
-        delete root;
-        // Clone tree takes care of filling out the memberTable.
-        root = cloneTree(src.root);
+        if (this == &src) {
+            return *this;
+        }
+
+        clear();
+        if (src.m_flatValid) {
+            m_flatNodeArray = src.m_flatNodeArray;
+            m_flatBounds    = src.m_flatBounds;
+            m_flatHandle.resize(src.m_flatHandle.size());
+            for (int i = 0; i < m_flatHandle.size(); ++i) {
+                Handle* h = new Handle(*src.m_flatHandle[i]);
+                m_flatHandle[i] = h;
+                memberTable.set(Member(h), nullptr);
+            }
+            m_flatValid = true;
+        } else if (src.root != nullptr) {
+            // Clone tree takes care of filling out the memberTable.
+            root = cloneTree(src.root);
+        }
         return *this;
     }
 
@@ -921,6 +1031,7 @@ public:
         // Delete the tree structure itself
         delete root;
         root = nullptr;
+        invalidateFlat();
     }
 
     int size() const {
@@ -938,6 +1049,7 @@ public:
             return;
         }
 
+        unflatten();
         Handle* h = new Handle(value);
 
         if (root == nullptr) {
@@ -961,6 +1073,7 @@ public:
         than inserting each element in turn.  You still need to balance
         the tree at the end.*/
     void insert(const Array<T>& valueArray) {
+        unflatten();
         if (root == nullptr) {
             // Optimized case for an empty tree; don't bother
             // searching or reallocating the root node's valueArray
@@ -1014,6 +1127,8 @@ public:
             "Tried to remove an element from a "
             "KDTree that was not present");
 
+        unflatten();
+
         // Get the list of elements at the node
         Handle h(value);
         Member m(&h);
@@ -1086,46 +1201,38 @@ public:
      creates a full oct-tree, which tends to optimize peak performance at the expense of
      average performance.  It tends to have better clustering behavior when
      members are not uniformly distributed.
+
+     Large subtrees are built concurrently. The result is laid out
+     contiguously in memory for the queries, until the next insert() or
+     remove() converts it back to a tree of nodes.
      */
     void balance(int valuesPerNode = 5, int numMeanSplits = 3) {
-        if (root == nullptr) {
+        if ((root == nullptr) && ! m_flatValid) {
             // Tree is empty
             return;
         }
 
-        // Get all handles and delete the old tree structure
-        Node* oldRoot = root;
-        for (int c = 0; c < 2; ++c) {
-            if (root->child[c] != nullptr) {
-                root->child[c]->getHandles(root->valueArray);
-
-                // Delete the child; this will delete all structure below it
-                delete root->child[c];
-                root->child[c] = nullptr;
+        if (! m_flatValid) {
+            // Gather all handles from the member table and delete the old tree structure
+            m_flatHandle.fastClear();
+            m_flatHandle.reserve(memberTable.size());
+            for (typename MemberTable::Iterator it = memberTable.begin(); it != memberTable.end(); ++it) {
+                m_flatHandle.append(it->key.handle);
+                it->value = nullptr;
             }
+            delete root;
+            root = nullptr;
         }
 
-        Array<Handle*> temp;
-        // Make a new root.  Work with a copy of the value array because 
-        // makeNode clears the source array as it progresses
-        Array<Handle*> copy(oldRoot->valueArray);
-        root = makeNode(copy, valuesPerNode, numMeanSplits, temp);
+        // Lay the tree out in the flat arrays, starting with unbounded space
+        m_flatNodeArray.fastClear();
+        buildFlat(m_flatHandle.getCArray(), 0, m_flatHandle.size(), AABox::large(), valuesPerNode, numMeanSplits, m_flatNodeArray);
 
-        // Throw away the old root node
-        delete oldRoot;
-        oldRoot = nullptr;
-
-        // Walk the tree, assigning splitBounds.  We start with unbounded
-        // space.  This will override the current member table.
-        const AABox& LARGE = AABox::large();
-        root->assignSplitBounds(LARGE);
-
-#       ifdef _DEBUG
-        {
-            // Ensure that the balanced tree is still correct
-            root->verifyNode(LARGE.low(), LARGE.high());
-        }
-#       endif
+        m_flatBounds.resize(m_flatHandle.size());
+        runConcurrently(0, m_flatHandle.size(), [&](int i) {
+            m_flatBounds[i] = m_flatHandle[i]->bounds;
+        });
+        m_flatValid = true;
     }
 
 
@@ -1184,6 +1291,51 @@ protected:
         }
     }
 
+    /** Flat layout version of getIntersectingMembers for planes */
+    void getIntersectingMembersFlat(
+        const Array<Plane>&         plane,
+        Array<T*>&                  members,
+        int                         n,
+        uint32                      parentMask) const {
+
+        const FlatNode& node = m_flatNodeArray[n];
+        Handle* const* handle = m_flatHandle.getCArray() + node.firstValue;
+        int dummy;
+
+        if (parentMask == 0) {
+            // None of these planes can cull anything
+            for (int v = node.numValues - 1; v >= 0; --v) {
+                members.append(&(handle[v]->value));
+            }
+
+            if (node.hasLowChild) {
+                getIntersectingMembersFlat(plane, members, n + 1, 0);
+            }
+            if (node.highChild != -1) {
+                getIntersectingMembersFlat(plane, members, node.highChild, 0);
+            }
+        } else {
+
+            // Test values at this node against remaining planes
+            const AABox* bounds = m_flatBounds.getCArray() + node.firstValue;
+            for (int v = node.numValues - 1; v >= 0; --v) {
+                if (! bounds[v].culledBy(plane, dummy, parentMask)) {
+                    members.append(&(handle[v]->value));
+                }
+            }
+
+            const int child[2] = {node.hasLowChild ? n + 1 : -1, node.highChild};
+            for (int c = 0; c < 2; ++c) {
+                uint32 childMask = 0xFFFFFF;
+                if ((child[c] != -1) &&
+                    ! m_flatNodeArray[child[c]].splitBounds.culledBy(plane, dummy, parentMask, childMask)) {
+                    // This node was not culled
+                    getIntersectingMembersFlat(plane, members, child[c], childMask);
+                }
+            }
+        }
+    }
+
 public:
 
     /**
@@ -1191,16 +1343,16 @@ public:
       @param members The results are appended to this array.
      */
     void getIntersectingMembers(const Array<Plane>& plane, Array<T*>& members) const {
-        if (root == nullptr) {
-            return;
+        if (m_flatValid) {
+            getIntersectingMembersFlat(plane, members, 0, 0xFFFFFF);
+        } else if (root != nullptr) {
+            getIntersectingMembers(plane, members, root, 0xFFFFFF);
         }
-
-        getIntersectingMembers(plane, members, root, 0xFFFFFF);
     }
 
     void getIntersectingMembers(const Array<Plane>& plane, Array<T>& members) const {
         Array<T*> temp;
-        getIntersectingMembers(plane, temp, root, 0xFFFFFF);
+        getIntersectingMembers(plane, temp);
         for (int i = 0; i < temp.size(); ++i) {
             members.append(*temp[i]);
         }
@@ -1258,7 +1410,7 @@ public:
         AABox           box;
 
         /** Node that we're currently looking at.  Undefined if isEnd
-            is true. */
+            is true or the tree is flat. */
         Node*           node;
 
         /** Nodes waiting to be processed */
@@ -1268,15 +1420,24 @@ public:
         // caller uses post increment (which they shouldn't!).
         Array<Node*>    stack;
 
+        /** The tree, if it is flat, otherwise nullptr */
+        const TreeType* flatTree;
+
+        /** Index of the flat node that we're currently looking at */
+        int             flatNode;
+
+        /** Flat nodes waiting to be processed */
+        Array<int>      flatStack;
+
         /** The next index of current->valueArray to return. 
             Undefined when isEnd is true.*/
         int             nextValueArrayIndex;
 
-        BoxIntersectionIterator() : isEnd(true) {}
+        BoxIntersectionIterator() : isEnd(true), node(nullptr), flatTree(nullptr), flatNode(-1) {}
         
         BoxIntersectionIterator(const AABox& b, const Node* root) : 
            isEnd(root == nullptr), box(b), 
-           node(const_cast<Node*>(root)), nextValueArrayIndex(-1) {
+           node(const_cast<Node*>(root)), flatTree(nullptr), flatNode(-1), nextValueArrayIndex(-1) {
 
            // We intentionally start at the "-1" index of the current
            // node so we can use the preincrement operator to move
@@ -1286,6 +1447,64 @@ public:
            ++(*this);
         }
 
+        BoxIntersectionIterator(const AABox& b, const TreeType* tree) : 
+           isEnd(false), box(b), node(nullptr), flatTree(tree), flatNode(0), nextValueArrayIndex(-1) {
+           ++(*this);
+        }
+
+        /** Number of values at the current node */
+        int numValues() const {
+            return (flatTree != nullptr) ? flatTree->m_flatNodeArray[flatNode].numValues : node->valueArray.length();
+        }
+
+        const AABox& valueBounds(int v) const {
+            return (flatTree != nullptr) ? flatTree->m_flatBounds[flatTree->m_flatNodeArray[flatNode].firstValue + v] : node->boundsArray[v];
+        }
+
+        Handle* valueHandle(int v) const {
+            return (flatTree != nullptr) ? flatTree->m_flatHandle[flatTree->m_flatNodeArray[flatNode].firstValue + v] : node->valueArray[v];
+        }
+
+        /** Pushes the children of the current node that overlap the box, then
+            pops the next node. Returns false when there are no more nodes. */
+        bool nextNode() {
+            if (flatTree != nullptr) {
+                const FlatNode& current = flatTree->m_flatNodeArray[flatNode];
+                if ((current.highChild != -1) &&
+                    (box.high()[current.splitAxis] > current.splitLocation)) {
+                    flatStack.push(current.highChild);
+                }
+                if (current.hasLowChild &&
+                    (box.low()[current.splitAxis] < current.splitLocation)) {
+                    flatStack.push(flatNode + 1);
+                }
+                if (flatStack.length() > 0) {
+                    flatNode = flatStack.pop();
+                    return true;
+                }
+            } else {
+                // If the right child overlaps the box, push it onto the stack for
+                // processing.
+                if ((node->child[1] != nullptr) &&
+                    (box.high()[node->splitAxis] > node->splitLocation)) {
+                    stack.push(node->child[1]);
+                }
+                
+                // If the left child overlaps the box, push it onto the stack for
+                // processing.
+                if ((node->child[0] != nullptr) &&
+                    (box.low()[node->splitAxis] < node->splitLocation)) {
+                    stack.push(node->child[0]);
+                }
+                
+                if (stack.length() > 0) {
+                    node = stack.pop();
+                    return true;
+                }
+            }
+            return false;
+        }
+
     public:
 
         inline bool operator!=(const BoxIntersectionIterator& other) const {
@@ -1302,8 +1521,10 @@ public:
                 // silly; users shouldn't call == on iterators in general unless
                 // one of them is the end iterator.
                 if ((box != other.box) || (node != other.node) || 
+                    (flatTree != other.flatTree) || (flatNode != other.flatNode) ||
                     (nextValueArrayIndex != other.nextValueArrayIndex) ||
-                    (stack.length() != other.stack.length())) {
+                    (stack.length() != other.stack.length()) ||
+                    (flatStack.length() != other.flatStack.length())) {
                     return false;
                 }
 
@@ -1313,6 +1534,11 @@ public:
                         return false;
                     }
                 }
+                for (int i = 0; i < flatStack.length(); ++i) {
+                    if (flatStack[i] != other.flatStack[i]) {
+                        return false;
+                    }
+                }
 
                 // We failed to find a difference; they must be the same
                 return true;
@@ -1329,30 +1555,14 @@ public:
             while (! isEnd && ! foundIntersection) {
 
                 // Search for the next node if we've exhausted this one
-                while ((! isEnd) &&  (nextValueArrayIndex >= node->valueArray.length())) {
+                while ((! isEnd) && (nextValueArrayIndex >= numValues())) {
                     // If we entered this loop, then the iterator has exhausted the elements at 
                     // node (possibly because it just switched to a child node with no members).
                     // This loop continues until it finds a node with members or reaches
                     // the end of the whole intersection search.
-                    
-                    // If the right child overlaps the box, push it onto the stack for
-                    // processing.
-                    if ((node->child[1] != nullptr) &&
-                        (box.high()[node->splitAxis] > node->splitLocation)) {
-                        stack.push(node->child[1]);
-                    }
-                    
-                    // If the left child overlaps the box, push it onto the stack for
-                    // processing.
-                    if ((node->child[0] != nullptr) &&
-                        (box.low()[node->splitAxis] < node->splitLocation)) {
-                        stack.push(node->child[0]);
-                    }
-                    
-                    if (stack.length() > 0) {
+                    if (nextNode()) {
                         // Go on to the next node (which may be either one of the ones we 
                         // just pushed, or one from farther back the tree).
-                        node = stack.pop();
                         nextValueArrayIndex = 0;
                     } else {
                         // That was the last node; we're done iterating
@@ -1361,8 +1571,8 @@ public:
                 }
                 
                 // Search for the next intersection at this node until we run out of children
-                while (! isEnd && ! foundIntersection && (nextValueArrayIndex < node->valueArray.length())) {
-                    if (box.intersects(node->boundsArray[nextValueArrayIndex])) {
+                while (! isEnd && ! foundIntersection && (nextValueArrayIndex < numValues())) {
+                    if (box.intersects(valueBounds(nextValueArrayIndex))) {
                         foundIntersection = true;
                     } else {
                         ++nextValueArrayIndex;
@@ -1393,21 +1603,21 @@ public:
             to a member */
         const T& operator*() const {
             alwaysAssertM(! isEnd, "Can't dereference the end element of an iterator");
-            return node->valueArray[nextValueArrayIndex]->value;
+            return valueHandle(nextValueArrayIndex)->value;
         }
 
         /** Overloaded dereference operator so the iterator can masquerade as a pointer
             to a member */
         T const * operator->() const {
             alwaysAssertM(! isEnd, "Can't dereference the end element of an iterator");
-            return &(stack.last()->valueArray[nextValueArrayIndex]->value);
+            return &(valueHandle(nextValueArrayIndex)->value);
         }
 
         /** Overloaded cast operator so the iterator can masquerade as a pointer
             to a member */
         operator T*() const {
             alwaysAssertM(! isEnd, "Can't dereference the end element of an iterator");
-            return &(stack.last()->valueArray[nextValueArrayIndex]->value);
+            return &(valueHandle(nextValueArrayIndex)->value);
         }
     };
 
@@ -1416,7 +1626,11 @@ public:
      Iterates through the members that intersect the box
      */
     BoxIntersectionIterator beginBoxIntersection(const AABox& box) const {
-        return BoxIntersectionIterator(box, root);
+        if (m_flatValid) {
+            return BoxIntersectionIterator(box, this);
+        } else {
+            return BoxIntersectionIterator(box, root);
+        }
     }
 
     BoxIntersectionIterator endBoxIntersection() const {
@@ -1429,10 +1643,11 @@ public:
      See also KDTree::beginBoxIntersection.
      */
     void getIntersectingMembers(const AABox& box, Array<T*>& members) const {
-        if (root == nullptr) {
-            return;
+        if (m_flatValid) {
+            getIntersectingMembersFlat(0, box, Sphere(Vector3::zero(), 0), members, false);
+        } else if (root != nullptr) {
+            root->getIntersectingMembers(box, Sphere(Vector3::zero(), 0), members, false);
         }
-        root->getIntersectingMembers(box, Sphere(Vector3::zero(), 0), members, false);
     }
 
     void getIntersectingMembers(const AABox& box, Array<T>& members) const {
@@ -1444,6 +1659,131 @@ public:
     }
 
 
+protected:
+
+    /** Flat layout version of Node::getIntersectingMembers */
+    void getIntersectingMembersFlat(
+        int                 n,
+        const AABox&        box,
+        const Sphere&       sphere,
+        Array<T*>&          members,
+        bool                useSphere) const {
+
+        const FlatNode& node = m_flatNodeArray[n];
+
+        // Test all values at this node
+        const AABox* bounds = m_flatBounds.getCArray() + node.firstValue;
+        Handle* const* handle = m_flatHandle.getCArray() + node.firstValue;
+        for (int v = 0; v < node.numValues; ++v) {
+            if (bounds[v].intersects(box) &&
+                (! useSphere || bounds[v].intersects(sphere))) {
+                members.append(&(handle[v]->value));
+            }
+        }
+
+        // The low child immediately follows this node
+        if (node.hasLowChild && (box.low()[node.splitAxis] < node.splitLocation)) {
+            getIntersectingMembersFlat(n + 1, box, sphere, members, useSphere);
+        }
+
+        if ((node.highChild != -1) && (box.high()[node.splitAxis] > node.splitLocation)) {
+            getIntersectingMembersFlat(node.highChild, box, sphere, members, useSphere);
+        }
+    }
+
+    /** Returns true if the ray starts in or enters \a bounds within \a distance. Equivalent to
+        the test in Node::intersects, but computed with slabs, which is much faster.
+        \param invDirection ray.invDirection() */
+    static bool rayReaches(const Ray& ray, const Vector3& invDirection, const AABox& bounds, float distance) {
+        float tEnter = 0.0f;
+        float tExit  = distance;
+        for (int a = 0; a < 3; ++a) {
+            const float origin = ray.origin()[a];
+            if (ray.direction()[a] == 0.0f) {
+                // Parallel to this slab
+                if ((origin < bounds.low()[a]) || (origin > bounds.high()[a])) {
+                    return false;
+                }
+            } else {
+                float t0 = (bounds.low()[a] - origin) * invDirection[a];
+                float t1 = (bounds.high()[a] - origin) * invDirection[a];
+                if (t0 > t1) {
+                    std::swap(t0, t1);
+                }
+                tEnter = G3D::max(tEnter, t0);
+                tExit  = G3D::min(tExit, t1);
+                if (tEnter > tExit) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /** Flat layout version of Node::intersectRay */
+    template<typename RayCallback>
+    void intersectRayFlat(
+        int                 n,
+        const Ray&          ray, 
+        const Vector3&      invDirection,
+        RayCallback&        intersectCallback, 
+        float&              distance,
+        bool                intersectCallbackIsFast) const {
+
+        const FlatNode& node = m_flatNodeArray[n];
+        if (! rayReaches(ray, invDirection, node.splitBounds, distance)) {
+            // The ray doesn't hit this node, so it can't hit the children of the node.
+            return;
+        }
+
+        // Test for intersection against every object at this node.
+        const AABox* bounds = m_flatBounds.getCArray() + node.firstValue;
+        Handle* const* handle = m_flatHandle.getCArray() + node.firstValue;
+        for (int v = 0; v < node.numValues; ++v) {
+            if (intersectCallbackIsFast || rayReaches(ray, invDirection, bounds[v], distance)) {
+                intersectCallback(ray, handle[v]->value, distance);
+            }
+        }
+
+        // Visit the child on the ray origin's side of the splitting plane first; see Node::intersectRay
+        const int axis = node.splitAxis;
+        const int child[2] = {node.hasLowChild ? n + 1 : -1, node.highChild};
+        int firstChild = -1;
+        int secondChild = -1;
+
+        if (ray.origin()[axis] < node.splitLocation) {
+            firstChild = 0;
+            if (ray.direction()[axis] > 0) {
+                secondChild = 1;
+            }
+        } else if (ray.origin()[axis] > node.splitLocation) {
+            firstChild = 1;
+            if (ray.direction()[axis] < 0) {
+                secondChild = 0;
+            }
+        } else if (ray.direction()[axis] < 0) {
+            firstChild = 0;
+        } else if (ray.direction()[axis] > 0) {
+            firstChild = 1;
+        }
+
+        if ((firstChild != -1) && (child[firstChild] != -1)) {
+            intersectRayFlat(child[firstChild], ray, invDirection, intersectCallback, distance, intersectCallbackIsFast);
+        }
+
+        if ((ray.direction()[axis] != 0) &&
+            ((node.splitLocation - ray.origin()[axis]) / ray.direction()[axis] > distance)) {
+            // There was an intersection before the splitting plane
+            return;
+        }
+
+        if ((secondChild != -1) && (child[secondChild] != -1)) {
+            intersectRayFlat(child[secondChild], ray, invDirection, intersectCallback, distance, intersectCallbackIsFast);
+        }
+    }
+
+public:
+
     /**
      Invoke a callback for every member along a ray until the closest intersection is found.
 
@@ -1509,7 +1849,11 @@ public:
         float& distance,
         bool intersectCallbackIsFast = false) const {
         
-        root->intersectRay(ray, intersectCallback, distance, intersectCallbackIsFast);
+        if (m_flatValid) {
+            intersectRayFlat(0, ray, ray.invDirection(), intersectCallback, distance, intersectCallbackIsFast);
+        } else if (root != nullptr) {
+            root->intersectRay(ray, intersectCallback, distance, intersectCallbackIsFast);
+        }
     }
 
 
@@ -1520,13 +1864,17 @@ public:
       @param members The results are appended to this array.
      */
     void getIntersectingMembers(const Sphere& sphere, Array<T*>& members) const {
-        if (root == nullptr) {
+        if ((root == nullptr) && ! m_flatValid) {
             return;
         }
 
         AABox box;
         sphere.getBounds(box);
-        root->getIntersectingMembers(box, sphere, members, true);
+        if (m_flatValid) {
+            getIntersectingMembersFlat(0, box, sphere, members, true);
+        } else {
+            root->getIntersectingMembers(box, sphere, members, true);
+        }
     }
 
     void getIntersectingMembers(const Sphere& sphere, Array<T>& members) const {
@@ -1537,19 +1885,95 @@ public:
         }
     }
 
+protected:
+
+    /** Flat layout version of Node::serializeStructure */
+    void serializeStructureFlat(int n, BinaryOutput& bo) const {
+        const FlatNode& node = m_flatNodeArray[n];
+        bo.writeUInt8(1);
+        node.splitBounds.serialize(bo);
+        serialize(Vector3::Axis(node.splitAxis), bo);
+        bo.writeFloat32(node.splitLocation);
+
+        if (node.hasLowChild) {
+            serializeStructureFlat(n + 1, bo);
+        } else {
+            bo.writeUInt8(0);
+        }
+
+        if (node.highChild != -1) {
+            serializeStructureFlat(node.highChild, bo);
+        } else {
+            bo.writeUInt8(0);
+        }
+    }
+
+public:
+
     /**
       Stores the locations of the splitting planes (the structure but not the content)
       so that the tree can be quickly rebuilt from a previous configuration without 
       calling balance.
      */
     void serializeStructure(BinaryOutput& bo) const {
-        Node::serializeStructure(root, bo);
+        if (m_flatValid) {
+            serializeStructureFlat(0, bo);
+        } else {
+            Node::serializeStructure(root, bo);
+        }
     }
 
-    /** Clears the member table */
+    /**
+      As serializeStructure(), but in the flat layout of a balanced tree:
+      the four bytes "KDTF", the number of nodes as an int32, and then one
+      record of FLAT_STRUCTURE_RECORD_SIZE bytes per node in depth-first
+      order. Each record is the node's split bounds as six float32s (low, then
+      high), splitLocation as a float32, the index of the high child as an
+      int32 (-1 if none), the split axis as a uint8, a uint8 that is 1 if the
+      node has a low child, which is always the next record, and two zero bytes.
+
+      Because the records have fixed size and no pointers, a file written in
+      the machine's byte order can be memory mapped and traversed in place.
+
+      The tree must be balanced and unmodified since, or empty.
+     */
+    void serializeFlatStructure(BinaryOutput& bo) const {
+        debugAssertM(m_flatValid || (root == nullptr), "The tree must be balanced before serializeFlatStructure()");
+        bo.writeBytes("KDTF", 4);
+        bo.writeInt32(m_flatNodeArray.size());
+        for (const FlatNode& node : m_flatNodeArray) {
+            node.splitBounds.serialize(bo);
+            bo.writeFloat32(node.splitLocation);
+            bo.writeInt32(node.highChild);
+            bo.writeUInt8(node.splitAxis);
+            bo.writeUInt8(node.hasLowChild ? 1 : 0);
+            bo.writeUInt16(0);
+        }
+    }
+
+    /** Clears the member table. Reads either serializeStructure() or serializeFlatStructure() data. */
     void deserializeStructure(BinaryInput& bi) {
         clear();
-        root = Node::deserializeStructure(bi);
+
+        const int64 start = bi.getPosition();
+        if ((bi.getLength() - start >= 4) && (bi.readUInt8() == 'K') && (bi.readUInt8() == 'D') && (bi.readUInt8() == 'T') && (bi.readUInt8() == 'F')) {
+            // The flat tree has no values; insert() converts it back to nodes
+            m_flatNodeArray.resize(bi.readInt32());
+            for (FlatNode& node : m_flatNodeArray) {
+                node.splitBounds.deserialize(bi);
+                node.splitLocation = bi.readFloat32();
+                node.highChild     = bi.readInt32();
+                node.splitAxis     = bi.readUInt8();
+                node.hasLowChild   = (bi.readUInt8() != 0);
+                bi.skip(2);
+                node.firstValue    = 0;
+                node.numValues     = 0;
+            }
+            m_flatValid = (m_flatNodeArray.size() > 0);
+        } else {
+            bi.setPosition(start);
+            root = Node::deserializeStructure(bi);
+        }
     }
 
     /**
@@ -0,0 +1,105 @@
+/**
+  \file G3D-base.lib/include/G3D-base/KNearestHeap.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_KNearestHeap_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/Array.h"
+#include <algorithm>
+
+namespace G3D {
+
+/**
+  \brief Bounded max-heap of the \a k closest values seen so far, used by the
+  k-nearest-neighbor queries of PointKDTree, PointHashGrid, and FastPointHashGrid.
+
+  Stores pointers to the values, so the underlying data structure must not be
+  mutated until getResults() is called.
+
+  Spatial data structures call squaredBound() to prune: once the heap is full,
+  no value farther than the current k-th nearest can enter it.
+ */
+template<class Value>
+class KNearestHeap {
+private:
+
+    class Entry {
+    public:
+        float           squaredDistance;
+        const Value*    value;
+
+        Entry() {}
+        Entry(float d, const Value* v) : squaredDistance(d), value(v) {}
+
+        /** Max-heap on distance */
+        bool operator<(const Entry& other) const {
+            return squaredDistance < other.squaredDistance;
+        }
+    };
+
+    Array<Entry, 32>    m_heap;
+    int                 m_k;
+    float               m_maxSquaredDistance;
+
+public:
+
+    /** \param maxRadius Values farther than this are never returned. May be inf(). */
+    KNearestHeap(int k, float maxRadius) : m_k(k), m_maxSquaredDistance(square(maxRadius)) {
+        debugAssertM(k >= 0, "k must be non-negative");
+        m_heap.reserve(k);
+    }
+
+    int size() const {
+        return m_heap.size();
+    }
+
+    bool full() const {
+        return m_heap.size() >= m_k;
+    }
+
+    /** Values at a squared distance greater than this cannot enter the heap */
+    float squaredBound() const {
+        return full() ? ((m_k > 0) ? m_heap[0].squaredDistance : -1.0f) : m_maxSquaredDistance;
+    }
+
+    /** Inserts \a value if it is among the k nearest seen so far */
+    void consider(float squaredDistance, const Value& value) {
+        if (squaredDistance > m_maxSquaredDistance) {
+            return;
+        } else if (! full()) {
+            m_heap.append(Entry(squaredDistance, &value));
+            std::push_heap(m_heap.begin(), m_heap.end());
+        } else if ((m_k > 0) && (squaredDistance < m_heap[0].squaredDistance)) {
+            std::pop_heap(m_heap.begin(), m_heap.end());
+            m_heap.last() = Entry(squaredDistance, &value);
+            std::push_heap(m_heap.begin(), m_heap.end());
+        }
+    }
+
+    /** Appends the values nearest-first. Destroys the heap. */
+    void getResults(Array<Value>& values, Array<float>& squaredDistance) {
+        std::sort_heap(m_heap.begin(), m_heap.end());
+        for (const Entry& e : m_heap) {
+            values.append(*e.value);
+            squaredDistance.append(e.squaredDistance);
+        }
+        m_heap.fastClear();
+    }
+
+    /** Appends the values nearest-first. Destroys the heap. */
+    void getResults(Array<Value>& values) {
+        std::sort_heap(m_heap.begin(), m_heap.end());
+        for (const Entry& e : m_heap) {
+            values.append(*e.value);
+        }
+        m_heap.fastClear();
+    }
+};
+
+} // namespace G3D
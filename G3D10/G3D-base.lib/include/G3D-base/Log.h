@@ -46,8 +46,50 @@ void logLazyPrintf(const char* fmt, ...);
  is the "common log" and can be accessed with the static
  method common().  If you access common() and a common log
  does not yet exist, one is created for you.
+
+ By default every call writes and flushes the file before returning.
+ When constructed with Settings::asynchronous = true, each calling thread
+ instead appends its message to its own lock-free ring buffer and a single
+ background thread drains all of the buffers in timestamp order, writing
+ each batch with one call. Use flush() to force pending messages to disk,
+ e.g., before an intentional crash. The destructor and the G3D shutdown
+ hook flush automatically.
  */
 class Log {
+public:
+
+    class Settings {
+    public:
+        /** If true, messages are buffered per thread and written by a
+            background thread. Default is false. */
+        bool        asynchronous;
+
+        /** Size of the ring buffer allocated for each thread that logs in
+            asynchronous mode. Rounded up to a power of two. Default is 64 kB. */
+        size_t      threadBufferBytes;
+
+        /** If true, a message that does not fit in a full ring buffer is
+            discarded and counted instead of blocking the calling thread
+            until the writer catches up. Default is false. */
+        bool        dropWhenFull;
+
+        /** Maximum time between background writes in asynchronous mode. Default is 10 ms. */
+        int         flushIntervalMilliseconds;
+
+        /** Prefix each line written in asynchronous mode with the elapsed time
+            and a small integer identifying the logging thread. Default is true. */
+        bool        decorate;
+
+        Settings() :
+            asynchronous(false),
+            threadBufferBytes(64 * 1024),
+            dropWhenFull(false),
+            flushIntervalMilliseconds(10),
+            decorate(true) {}
+    };
+
+    class AsyncWriter;
+
 private:
 
     /**
@@ -57,8 +99,19 @@ private:
 
     String                  filename;
 
+    Settings                m_settings;
+
+    /** nullptr unless m_settings.asynchronous */
+    AsyncWriter*            m_asyncWriter;
+
     static Log*             commonLog;
 
+    /** Enqueues on the asynchronous writer if there is one, otherwise
+        writes directly to the file. The two pieces form a single message. */
+    void write(const char* data, size_t len, const char* suffix, size_t suffixLen, bool flush);
+
+    void writeToFile(const char* data, size_t len, bool flush);
+
 public:
 
     /**
@@ -67,15 +120,27 @@ public:
      "c:/temp/log.txt" instead.
 
      */
-    Log(const String& filename = "log.txt");
+    Log(const String& filename = "log.txt", const Settings& settings = Settings());
 
     virtual ~Log();
 
     /**
-     Returns the handle to the file log.
+     Returns the handle to the file log. In asynchronous mode, call flush()
+     before writing to it directly to preserve ordering.
      */
     FILE* getFile() const;
 
+    const Settings& settings() const {
+        return m_settings;
+    }
+
+    /** Blocks until every message submitted before this call has been
+        written and flushed to disk. Safe to call from any thread. */
+    void flush();
+
+    /** Number of messages discarded because of Settings::dropWhenFull */
+    size_t droppedMessageCount() const;
+
     /**
      Marks the beginning of a logfile section.
      */
@@ -95,7 +160,10 @@ public:
     static Log* common();
 
     /** Creates the common log with the specified filename */
-    static Log* common(const String& filename);
+    static Log* common(const String& filename, const Settings& settings = Settings());
+
+    /** Flushes the common log if it exists, without creating one. */
+    static void flushCommon();
 
     static String getCommonLogFilename();
 
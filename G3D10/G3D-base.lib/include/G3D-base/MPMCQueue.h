@@ -0,0 +1,341 @@
+/**
+  \file G3D-base.lib/include/G3D-base/MPMCQueue.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_base_MPMCQueue_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/g3dmath.h"
+#include "G3D-base/System.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace G3D {
+
+namespace _internal {
+
+/** \brief Threads blocked until a lock-free queue changes state.
+
+    Signalling costs one fence and one load when no thread is waiting, so
+    the queue operations never take the mutex on the fast path. Waiters
+    register before retrying their operation, and signallers check for
+    waiters after completing theirs, so a wakeup cannot be lost between
+    the two. */
+class QueueWaiters {
+private:
+    std::atomic<int>            m_count;
+    std::mutex                  m_mutex;
+    std::condition_variable     m_condition;
+
+public:
+
+    QueueWaiters() : m_count(0) {}
+
+    /** Call after making the state change that waiters are looking for */
+    void notify(bool all) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_count.load(std::memory_order_relaxed) > 0) {
+            // Waiters are either before their retry, or inside wait()
+            { std::lock_guard<std::mutex> guard(m_mutex); }
+            if (all) {
+                m_condition.notify_all();
+            } else {
+                m_condition.notify_one();
+            }
+        }
+    }
+
+    /** Calls \a attempt until it returns true or \a timeout seconds elapse.
+        Returns the final result of \a attempt. */
+    template<class Attempt>
+    bool wait(Attempt attempt, RealTime timeout) {
+        if (attempt()) {
+            return true;
+        } else if (timeout <= 0) {
+            return false;
+        }
+
+        const bool forever = ! isFinite(timeout) || (timeout > 1e9);
+        const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(forever ? 0.0 : timeout));
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        bool success = attempt();
+        while (! success) {
+            if (forever) {
+                m_condition.wait(lock);
+            } else if (m_condition.wait_until(lock, deadline) == std::cv_status::timeout) {
+                success = attempt();
+                break;
+            }
+            success = attempt();
+        }
+
+        m_count.fetch_sub(1, std::memory_order_relaxed);
+        return success;
+    }
+};
+
+} // namespace _internal
+
+
+/**
+  \brief Bounded, lock-free, multiple-producer multiple-consumer FIFO queue.
+
+  This is Dmitry Vyukov's ring buffer: each cell carries a sequence number
+  that tells producers and consumers whether it is free for the current lap
+  around the ring, so every operation is one compare-and-swap on the
+  push or pop index plus plain loads and stores. The two indices are on
+  separate cache lines so that producers and consumers do not contend with
+  each other.
+
+  tryPush() and tryPop() never block. waitPush() and waitPop() sleep on a
+  condition variable when the queue is full or empty; that mutex is only
+  touched when some thread is actually waiting.
+
+  Elements pushed by one thread are popped in the order that it pushed them.
+  Elements pushed concurrently by different threads have no defined order.
+
+  \sa ThreadsafeQueue, Queue
+*/
+template<class T>
+class MPMCQueue {
+public:
+
+    /** Alignment of the indices, to avoid false sharing */
+    enum { CACHE_LINE_BYTES = 64 };
+
+private:
+
+    class Cell {
+    public:
+        std::atomic<size_t>     sequence;
+        alignas(T) uint8        storage[sizeof(T)];
+
+        T* value() {
+            return reinterpret_cast<T*>(storage);
+        }
+    };
+
+    Cell*                                       m_cell;
+    const size_t                                m_mask;
+
+    alignas(CACHE_LINE_BYTES) std::atomic<size_t> m_pushIndex;
+    alignas(CACHE_LINE_BYTES) std::atomic<size_t> m_popIndex;
+
+    alignas(CACHE_LINE_BYTES) _internal::QueueWaiters m_consumerWaiters;
+    _internal::QueueWaiters                     m_producerWaiters;
+
+    // Not copyable
+    MPMCQueue(const MPMCQueue&);
+    MPMCQueue& operator=(const MPMCQueue&);
+
+    /** Claims up to \a maxCount consecutive cells for pushing. Returns the number claimed
+        and sets \a first to the index of the first one. */
+    size_t claimPush(size_t maxCount, size_t& first) {
+        size_t pos = m_pushIndex.load(std::memory_order_relaxed);
+        while (true) {
+            size_t n = 0;
+            while ((n < maxCount) && (m_cell[(pos + n) & m_mask].sequence.load(std::memory_order_acquire) == pos + n)) {
+                ++n;
+            }
+
+            if (n > 0) {
+                if (m_pushIndex.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                    first = pos;
+                    return n;
+                }
+            } else if (intptr_t(m_cell[pos & m_mask].sequence.load(std::memory_order_acquire) - pos) < 0) {
+                // The cell still holds the value from the previous lap
+                return 0;
+            } else {
+                // Another producer claimed it
+                pos = m_pushIndex.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /** Claims up to \a maxCount consecutive published cells for popping */
+    size_t claimPop(size_t maxCount, size_t& first) {
+        size_t pos = m_popIndex.load(std::memory_order_relaxed);
+        while (true) {
+            size_t n = 0;
+            while ((n < maxCount) && (m_cell[(pos + n) & m_mask].sequence.load(std::memory_order_acquire) == pos + n + 1)) {
+                ++n;
+            }
+
+            if (n > 0) {
+                if (m_popIndex.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                    first = pos;
+                    return n;
+                }
+            } else if (intptr_t(m_cell[pos & m_mask].sequence.load(std::memory_order_acquire) - (pos + 1)) < 0) {
+                // Empty, or the producer of this cell has not finished yet
+                return 0;
+            } else {
+                pos = m_popIndex.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void publishPush(size_t pos) {
+        m_cell[pos & m_mask].sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    void takeValue(size_t pos, T& v) {
+        Cell& cell = m_cell[pos & m_mask];
+        v = std::move(*cell.value());
+        cell.value()->~T();
+        cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+    }
+
+    template<class V>
+    bool pushValue(V&& v) {
+        size_t pos = 0;
+        if (claimPush(1, pos) == 0) {
+            return false;
+        }
+        new (m_cell[pos & m_mask].value()) T(std::forward<V>(v));
+        publishPush(pos);
+        m_consumerWaiters.notify(false);
+        return true;
+    }
+
+public:
+
+    /** \param capacity Rounded up to a power of two */
+    explicit MPMCQueue(int capacity = 1024) :
+        m_cell(nullptr),
+        m_mask(size_t(ceilPow2(max(capacity, 2))) - 1),
+        m_pushIndex(0),
+        m_popIndex(0) {
+
+        m_cell = (Cell*)System::alignedMalloc(sizeof(Cell) * (m_mask + 1), CACHE_LINE_BYTES);
+        for (size_t i = 0; i <= m_mask; ++i) {
+            new (&m_cell[i].sequence) std::atomic<size_t>(i);
+        }
+    }
+
+    ~MPMCQueue() {
+        clear();
+        for (size_t i = 0; i <= m_mask; ++i) {
+            m_cell[i].sequence.~atomic<size_t>();
+        }
+        System::alignedFree(m_cell);
+    }
+
+    int capacity() const {
+        return int(m_mask + 1);
+    }
+
+    /** Returns false without blocking if the queue is full */
+    bool tryPush(const T& v) {
+        return pushValue(v);
+    }
+
+    bool tryPush(T&& v) {
+        return pushValue(std::move(v));
+    }
+
+    /** Returns false without blocking if the queue is empty */
+    bool tryPop(T& v) {
+        size_t pos = 0;
+        if (claimPop(1, pos) == 0) {
+            return false;
+        }
+        takeValue(pos, v);
+        m_producerWaiters.notify(false);
+        return true;
+    }
+
+    /** Blocks until there is room for \a v or \a timeout seconds elapse.
+        Returns true if \a v was pushed. */
+    bool waitPush(const T& v, RealTime timeout = finf()) {
+        return m_producerWaiters.wait([&]() { return tryPush(v); }, timeout);
+    }
+
+    /** Blocks until an element is available or \a timeout seconds elapse.
+        Returns true if \a v was read. */
+    bool waitPop(T& v, RealTime timeout = finf()) {
+        return m_consumerWaiters.wait([&]() { return tryPop(v); }, timeout);
+    }
+
+    /** Pushes as many of the \a count elements of \a v as fit, claiming the
+        cells with a single compare-and-swap when they are free. Returns the
+        number pushed, which are always a prefix of \a v. */
+    int tryPushBatch(const T* v, int count) {
+        int pushed = 0;
+        while (pushed < count) {
+            size_t first = 0;
+            const size_t n = claimPush(size_t(count - pushed), first);
+            if (n == 0) {
+                break;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                new (m_cell[(first + i) & m_mask].value()) T(v[pushed + int(i)]);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                publishPush(first + i);
+            }
+            pushed += int(n);
+        }
+
+        if (pushed > 0) {
+            m_consumerWaiters.notify(pushed > 1);
+        }
+        return pushed;
+    }
+
+    /** Pops up to \a maxCount elements into \a v, in order. Returns the number popped. */
+    int tryPopBatch(T* v, int maxCount) {
+        int popped = 0;
+        while (popped < maxCount) {
+            size_t first = 0;
+            const size_t n = claimPop(size_t(maxCount - popped), first);
+            if (n == 0) {
+                break;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                takeValue(first + i, v[popped + int(i)]);
+            }
+            popped += int(n);
+        }
+
+        if (popped > 0) {
+            m_producerWaiters.notify(popped > 1);
+        }
+        return popped;
+    }
+
+    /** Pops and destroys all elements */
+    void clear() {
+        T v;
+        while (tryPop(v)) {}
+    }
+
+    /** Note that by the time the method has returned, the value may be incorrect. */
+    int size() const {
+        const size_t popIndex = m_popIndex.load(std::memory_order_relaxed);
+        const size_t pushIndex = m_pushIndex.load(std::memory_order_relaxed);
+        const intptr_t n = intptr_t(pushIndex - popIndex);
+        return int(G3D::min(G3D::max(n, intptr_t(0)), intptr_t(m_mask + 1)));
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+};
+
+} // namespace G3D
@@ -346,54 +346,14 @@ private:
         return isNegative ? -i : i;
     }
 
-    /** Substantially (2x) faster than sscanf */
+    /** Correctly rounded and substantially faster than sscanf. \sa parseFloat */
     float readFloat() {
-        // Consume leading sign
-        const bool isNegative = (*nextCharacter == '-');
-        if (isNegative || (*nextCharacter == '+')) {
-            consumeCharacter();
-        }
-
-        // Read the integer part
-        float f = float(readUnsignedInt());
-
-        // Read optional fractional part
-        if (*nextCharacter == '.') {
-            // Consume the decimal
-            consumeCharacter();
-
-            // Read the fractional part
-            int i = 0;
-            int magnitude = 1;
-
-            // Avoid overflowing the integer
-            const int MAX_MAGNITUDE = 10000000;
-            while ((remainingCharacters > 0) && isDigitFast(*nextCharacter) && (magnitude < MAX_MAGNITUDE)) {
-                magnitude *= 10;
-                i = i * 10 + (*nextCharacter) - '0';
-                --remainingCharacters;
-                ++nextCharacter;
-            }
-
-            // Read the excess characters
-            while ((remainingCharacters > 0) && isDigitFast(*nextCharacter)) {
-                --remainingCharacters;
-                ++nextCharacter;
-            }
-
-            const float fracPart = float(i) / float(magnitude);
-        
-            f += fracPart;
-        }
-
-        // Read optional exponent
-        if (*nextCharacter == 'e') {
-            consumeCharacter();
-            const int e = readInt();
-            f *= powf(10.0f, float(e));
-        }
-
-        return isNegative ? -f : f;
+        float f = 0.0f;
+        const char* stop = parseFloat(nextCharacter, nextCharacter + remainingCharacters, f);
+        debugAssertM(stop != nextCharacter, format("Expected a number and found '%c'", *nextCharacter));
+        remainingCharacters -= int(stop - nextCharacter);
+        nextCharacter = stop;
+        return f;
     }
 
     /** Reads until newline and removes leading and trailing space (ignores comments) */
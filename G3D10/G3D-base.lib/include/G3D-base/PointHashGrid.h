@@ -19,6 +19,8 @@
 #include "G3D-base/AABox.h"
 #include "G3D-base/Sphere.h"
 #include "G3D-base/SmallArray.h"
+#include "G3D-base/KNearestHeap.h"
+#include "G3D-base/Thread.h"
 
 namespace G3D {
 
@@ -829,6 +831,107 @@ public:
     }
 
 
+    /**
+      Runs getIntersectingMembers() for each sphere in parallel. It is an error to mutate the PointHashGrid during the call.
+
+      \param resultArray Resized to sphereArray.size(); the results for each sphere are appended to the corresponding element.
+     */
+    void getIntersectingMembers(const Array<Sphere>& sphereArray, Array<Array<Value>>& resultArray, bool singleThread = false) const {
+        resultArray.resize(sphereArray.size());
+        runConcurrently(0, sphereArray.size(), [&](int i) {
+            getIntersectingMembers(sphereArray[i], resultArray[i]);
+        }, singleThread);
+    }
+
+
+    /**
+      \brief Finds the \a k values closest to \a point that are within \a maxRadius of it.
+
+      Visits cells in cubic shells of increasing size around the cell containing
+      \a point and stops as soon as the next shell cannot contain anything closer
+      than the current k-th nearest value.
+
+      \param maxRadius May be finf()
+      \param result The results are appended to this array, nearest first
+      \param squaredDistance The squared distance of each result is appended to this array
+     */
+    void kNearest(const Point3& point, int k, float maxRadius, Array<Value>& result, Array<float>& squaredDistance) const {
+        KNearestHeap<Value> heap(k, maxRadius);
+        kNearest(point, heap);
+        heap.getResults(result, squaredDistance);
+    }
+
+
+    /** \copydoc kNearest(const Point3&, int, float, Array<Value>&, Array<float>&) const */
+    void kNearest(const Point3& point, int k, float maxRadius, Array<Value>& result) const {
+        KNearestHeap<Value> heap(k, maxRadius);
+        kNearest(point, heap);
+        heap.getResults(result);
+    }
+
+
+    /**
+      Runs kNearest() for each point in parallel. It is an error to mutate the PointHashGrid during the call.
+
+      \param resultArray Resized to pointArray.size(); the results for each point are appended to the corresponding element.
+     */
+    void kNearest(const Array<Point3>& pointArray, int k, float maxRadius, Array<Array<Value>>& resultArray, bool singleThread = false) const {
+        resultArray.resize(pointArray.size());
+        runConcurrently(0, pointArray.size(), [&](int i) {
+            kNearest(pointArray[i], k, maxRadius, resultArray[i]);
+        }, singleThread);
+    }
+
+private:
+
+    void kNearest(const Point3& point, KNearestHeap<Value>& heap) const {
+        if (m_size == 0) {
+            return;
+        }
+
+        Point3int32 center;
+        getCellCoord(point, center);
+        int numVisited = 0;
+
+        for (int r = 0; true; ++r) {
+            // Visit the cells whose Chebyshev distance from the center cell is exactly r
+            Point3int32 d;
+            for (d.z = -r; d.z <= r; ++d.z) {
+                for (d.y = -r; d.y <= r; ++d.y) {
+                    const bool onFace = (abs(d.z) == r) || (abs(d.y) == r);
+                    const int dxStep = onFace ? 1 : max(2 * r, 1);
+                    for (d.x = -r; d.x <= r; d.x += dxStep) {
+                        const Cell* cell = m_data.getPointer(center + d);
+                        if (notNull(cell)) {
+                            for (int i = 0; i < cell->size(); ++i) {
+                                const Entry& entry = (*cell)[i];
+                                heap.consider((entry.position - point).squaredLength(), entry.value);
+                            }
+                            numVisited += cell->size();
+                        }
+                    }
+                }
+            }
+
+            if (numVisited >= m_size) {
+                return;
+            }
+
+            // Every unvisited value is outside the box covered by shells 0..r
+            float bound = finf();
+            for (int a = 0; a < 3; ++a) {
+                bound = min(bound, point[a] - float(center[a] - r) * m_cellWidth, float(center[a] + r + 1) * m_cellWidth - point[a]);
+            }
+
+            if (square(max(bound, 0.0f)) > heap.squaredBound()) {
+                return;
+            }
+        }
+    }
+
+public:
+
+
     ///////////////////////////////////////////////////////////////////////////
     ///////////////////////////////////////////////////////////////////////////
 
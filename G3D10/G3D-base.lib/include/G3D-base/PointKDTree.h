@@ -24,6 +24,8 @@
 #include "G3D-base/CollisionDetection.h"
 #include "G3D-base/Frustum.h"
 #include "G3D-base/PositionTrait.h"
+#include "G3D-base/KNearestHeap.h"
+#include "G3D-base/Thread.h"
 #include <algorithm>
 
 namespace G3D {
@@ -553,20 +555,74 @@ protected:
         return dst;
     }
 
+    /** Node of the flattened tree that balance() produces for the
+        read-only queries. Nodes are in depth-first order, so the low
+        child of node i is always node i + 1. Values of each node are
+        contiguous in m_flatPosition and m_flatValue. */
+    class FlatNode {
+    public:
+        float               splitLocation;
+        uint8               splitAxis;
+        bool                hasLowChild;
+
+        /** -1 if there is no high child */
+        int                 highChild;
+        int                 firstValue;
+        int                 numValues;
+    };
+
+    /** Recursively appends \a node and its children to the flat arrays */
+    void flatten(const Node* node) {
+        const int index = m_flatNodeArray.size();
+        FlatNode& flat = m_flatNodeArray.next();
+        flat.splitLocation = node->splitLocation;
+        flat.splitAxis     = uint8(node->splitAxis);
+        flat.hasLowChild   = (node->child[0] != nullptr);
+        flat.highChild     = -1;
+        flat.firstValue    = m_flatValue.size();
+        flat.numValues     = node->valueArray.size();
+        for (const Handle& h : node->valueArray) {
+            m_flatPosition.append(h.position());
+            m_flatValue.append(h.value);
+        }
+
+        if (node->child[0] != nullptr) {
+            flatten(node->child[0]);
+        }
+        if (node->child[1] != nullptr) {
+            // The array may have been reallocated, so reindex
+            m_flatNodeArray[index].highChild = m_flatNodeArray.size();
+            flatten(node->child[1]);
+        }
+    }
+
+    void invalidateFlat() {
+        m_flatValid = false;
+        m_flatNodeArray.fastClear();
+        m_flatPosition.fastClear();
+        m_flatValue.fastClear();
+    }
+
     /** Maps members to the node containing them */
     typedef Table<T, Node*, HashFunc, EqualsFunc> MemberTable;
     MemberTable             memberTable;
 
     Node*                   root;
 
+    /** True when the flat arrays match the tree, i.e., nothing has changed since balance() */
+    bool                    m_flatValid;
+    Array<FlatNode>         m_flatNodeArray;
+    Array<Vector3>          m_flatPosition;
+    Array<T>                m_flatValue;
+
 public:
 
     /** To construct a balanced tree, insert the elements and then call
       PointKDTree::balance(). */
-    PointKDTree() : root(nullptr) {}
+    PointKDTree() : root(nullptr), m_flatValid(false) {}
 
 
-    PointKDTree(const PointKDTree& src) : root(nullptr) {
+    PointKDTree(const PointKDTree& src) : root(nullptr), m_flatValid(false) {
         *this = src;
     }
 
@@ -575,6 +631,10 @@ public:
         delete root;
         // Clone tree takes care of filling out the memberTable.
         root = cloneTree(src.root);
+        m_flatValid     = src.m_flatValid;
+        m_flatNodeArray = src.m_flatNodeArray;
+        m_flatPosition  = src.m_flatPosition;
+        m_flatValue     = src.m_flatValue;
         return *this;
     }
 
@@ -590,11 +650,13 @@ public:
         memberTable.clear();
         delete root;
         root = nullptr;
+        invalidateFlat();
     }
 
     /** Removes all elements of the set while maintaining the structure of the tree */
     void clearData() {
         memberTable.clear();
+        invalidateFlat();
         Array<Node*> stack;
         stack.push(root);
         while (stack.size() > 0) {
@@ -626,6 +688,7 @@ public:
         }
 
         Handle h(value);
+        invalidateFlat();
 
         if (root == nullptr) {
             // This is the first node; create a root node
@@ -648,6 +711,7 @@ public:
     void insert(const Array<T>& valueArray) {
         // Pre-size the member table to avoid multiple allocations
         memberTable.setSizeHint(valueArray.size() + size());
+        invalidateFlat();
 
         if (root == nullptr) {
             // Optimized case for an empty tree; don't bother
@@ -695,6 +759,7 @@ public:
             "Tried to remove an element from a "
             "PointKDTree that was not present");
 
+        invalidateFlat();
         Array<Handle>& list = memberTable[value]->valueArray;
 
         // Find the element and remove it
@@ -770,6 +835,13 @@ public:
 #       ifdef _DEBUG
             root->verifyNode(Vector3::minFinite(), Vector3::maxFinite());
 #       endif
+
+        // Lay out a read-only copy for the queries
+        m_flatNodeArray.reserve(memberTable.size() / max(valuesPerNode / 2, 1) + 1);
+        m_flatPosition.reserve(memberTable.size());
+        m_flatValue.reserve(memberTable.size());
+        flatten(root);
+        m_flatValid = true;
     }
 
 private:
@@ -1075,11 +1147,150 @@ public:
 
         AABox box;
         sphere.getBounds(box);
-        root->getIntersectingMembers(box, sphere, members);
+        if (m_flatValid) {
+            getIntersectingMembersFlat(0, box, sphere, members);
+        } else {
+            root->getIntersectingMembers(box, sphere, members);
+        }
+    }
 
+
+    /**
+      Runs getIntersectingMembers(const Sphere&, Array<T>&) for each sphere in parallel.
+      The tree must not be mutated during the call.
+
+      \param membersArray Resized to sphereArray.size(); the results for each sphere are appended to the corresponding element.
+     */
+    void getIntersectingMembers(const Array<Sphere>& sphereArray, Array<Array<T>>& membersArray, bool singleThread = false) const {
+        membersArray.resize(sphereArray.size());
+        runConcurrently(0, sphereArray.size(), [&](int i) {
+            getIntersectingMembers(sphereArray[i], membersArray[i]);
+        }, singleThread);
+    }
+
+
+    /**
+      \brief Finds the \a k members closest to \a point that are within \a maxRadius of it.
+
+      Keeps a bounded max-heap of the best candidates and skips every subtree
+      that is farther from \a point than the current k-th nearest member, so
+      the cost does not depend on guessing a search radius. Fastest after
+      balance(), which lays the tree out contiguously in memory.
+
+      \param maxRadius May be finf()
+      \param members The results are appended to this array, nearest first
+      \param squaredDistance The squared distance of each result is appended to this array
+     */
+    void kNearest(const Point3& point, int k, float maxRadius, Array<T>& members, Array<float>& squaredDistance) const {
+        KNearestHeap<T> heap(k, maxRadius);
+        kNearest(point, heap);
+        heap.getResults(members, squaredDistance);
     }
 
 
+    /** \copydoc kNearest(const Point3&, int, float, Array<T>&, Array<float>&) const */
+    void kNearest(const Point3& point, int k, float maxRadius, Array<T>& members) const {
+        KNearestHeap<T> heap(k, maxRadius);
+        kNearest(point, heap);
+        heap.getResults(members);
+    }
+
+
+    /**
+      Runs kNearest() for each point in parallel. The tree must not be mutated during the call.
+
+      \param membersArray Resized to pointArray.size(); the results for each point are appended to the corresponding element.
+     */
+    void kNearest(const Array<Point3>& pointArray, int k, float maxRadius, Array<Array<T>>& membersArray, bool singleThread = false) const {
+        membersArray.resize(pointArray.size());
+        runConcurrently(0, pointArray.size(), [&](int i) {
+            kNearest(pointArray[i], k, maxRadius, membersArray[i]);
+        }, singleThread);
+    }
+
+private:
+
+    /** Flat layout version of Node::getIntersectingMembers for spheres */
+    void getIntersectingMembersFlat(int n, const AABox& sphereBounds, const Sphere& sphere, Array<T>& members) const {
+        const FlatNode& node = m_flatNodeArray[n];
+
+        const float r2 = square(sphere.radius);
+        const Vector3 center = sphere.center;
+        const Vector3* position = m_flatPosition.getCArray() + node.firstValue;
+        for (int v = 0; v < node.numValues; ++v) {
+            if ((center - position[v]).squaredLength() <= r2) {
+                members.append(m_flatValue[node.firstValue + v]);
+            }
+        }
+
+        if (node.hasLowChild && (sphereBounds.low()[node.splitAxis] < node.splitLocation)) {
+            getIntersectingMembersFlat(n + 1, sphereBounds, sphere, members);
+        }
+
+        if ((node.highChild >= 0) && (sphereBounds.high()[node.splitAxis] > node.splitLocation)) {
+            getIntersectingMembersFlat(node.highChild, sphereBounds, sphere, members);
+        }
+    }
+
+
+    void kNearest(const Point3& point, KNearestHeap<T>& heap) const {
+        if (root == nullptr) {
+            return;
+        } else if (m_flatValid) {
+            kNearestFlat(0, point, heap);
+        } else {
+            kNearest(root, point, heap);
+        }
+    }
+
+
+    void kNearestFlat(int n, const Point3& point, KNearestHeap<T>& heap) const {
+        const FlatNode& node = m_flatNodeArray[n];
+
+        const Vector3* position = m_flatPosition.getCArray() + node.firstValue;
+        const T* value = m_flatValue.getCArray() + node.firstValue;
+        for (int v = 0; v < node.numValues; ++v) {
+            heap.consider((point - position[v]).squaredLength(), value[v]);
+        }
+
+        // Visit the side containing the point first, so that the far side can usually be pruned
+        const float d = point[node.splitAxis] - node.splitLocation;
+        const int lowChild = node.hasLowChild ? n + 1 : -1;
+        const int nearChild = (d < 0) ? lowChild : node.highChild;
+        const int farChild  = (d < 0) ? node.highChild : lowChild;
+
+        if (nearChild >= 0) {
+            kNearestFlat(nearChild, point, heap);
+        }
+
+        if ((farChild >= 0) && (square(d) <= heap.squaredBound())) {
+            kNearestFlat(farChild, point, heap);
+        }
+    }
+
+
+    /** Used when the tree has been mutated since balance() */
+    static void kNearest(const Node* node, const Point3& point, KNearestHeap<T>& heap) {
+        for (const Handle& h : node->valueArray) {
+            heap.consider((point - h.position()).squaredLength(), h.value);
+        }
+
+        const float d = point[node->splitAxis] - node->splitLocation;
+        const Node* nearChild = node->child[(d < 0) ? 0 : 1];
+        const Node* farChild  = node->child[(d < 0) ? 1 : 0];
+
+        if (nearChild != nullptr) {
+            kNearest(nearChild, point, heap);
+        }
+
+        if ((farChild != nullptr) && (square(d) <= heap.squaredBound())) {
+            kNearest(farChild, point, heap);
+        }
+    }
+
+public:
+
+
     /**
       Stores the locations of the splitting planes (the structure but not the content)
       so that the tree can be quickly rebuilt from a previous configuration without 
@@ -0,0 +1,95 @@
+/**
+  \file G3D-base.lib/include/G3D-base/QuantizedPhysicsFrame.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_QuantizedPhysicsFrame_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/PhysicsFrame.h"
+
+namespace G3D {
+
+class BinaryOutput;
+class BinaryInput;
+
+/**
+  \brief A PhysicsFrame rounded to fixed point for compact bit-packed
+  transmission, e.g., by EntityReplicator.
+
+  The translation is stored in units of Format::translationPrecision. The
+  rotation uses the "smallest three" encoding: the largest-magnitude component
+  of the unit quaternion is dropped and the other three are stored in
+  Format::rotationBits each.
+
+  Frames that quantize identically compare equal, so equality is a
+  change test that ignores changes below the transmitted precision.
+
+  The serialize methods must be called between BinaryOutput::beginBits and
+  BinaryOutput::endBits (or the corresponding BinaryInput methods).
+
+  \sa PhysicsFrame, BinaryOutput::writeBits
+*/
+class QuantizedPhysicsFrame {
+public:
+
+    class Format {
+    public:
+        /** Meters per translation unit */
+        float       translationPrecision = 1.0f / 1024.0f;
+
+        /** Bits per stored quaternion component, at most 10 */
+        int         rotationBits = 10;
+
+        Format() {}
+        Format(float translationPrecision, int rotationBits) :
+            translationPrecision(translationPrecision), rotationBits(rotationBits) {}
+    };
+
+    int32           translation[3];
+
+    /** Bits 30-31 are the index of the dropped component. The low 30 bits are
+        the three stored components, Format::rotationBits each. */
+    uint32          rotation;
+
+    QuantizedPhysicsFrame() : rotation(0) {
+        translation[0] = translation[1] = translation[2] = 0;
+    }
+
+    QuantizedPhysicsFrame(const PhysicsFrame& frame, const Format& format = Format());
+
+    PhysicsFrame toPhysicsFrame(const Format& format = Format()) const;
+
+    bool operator==(const QuantizedPhysicsFrame& other) const {
+        return (translation[0] == other.translation[0]) && (translation[1] == other.translation[1]) &&
+            (translation[2] == other.translation[2]) && (rotation == other.rotation);
+    }
+
+    bool operator!=(const QuantizedPhysicsFrame& other) const {
+        return ! (*this == other);
+    }
+
+    /** Writes the whole frame. Small translations take fewer bits. */
+    void serializeBits(BinaryOutput& b, const Format& format = Format()) const;
+
+    void deserializeBits(BinaryInput& b, const Format& format = Format());
+
+    /** Writes only the differences from \a baseline, which the reader must also have.
+        An unchanged frame takes 4 bits and each changed translation axis takes
+        bits proportional to the log of the motion. */
+    void serializeDeltaBits(const QuantizedPhysicsFrame& baseline, BinaryOutput& b, const Format& format = Format()) const;
+
+    void deserializeDeltaBits(const QuantizedPhysicsFrame& baseline, BinaryInput& b, const Format& format = Format());
+
+    /** Writes a signed integer as a 5-bit length followed by its zigzag encoding,
+        so that values near zero take few bits */
+    static void writeSignedBits(BinaryOutput& b, int32 value);
+
+    static int32 readSignedBits(BinaryInput& b);
+};
+
+} // namespace G3D
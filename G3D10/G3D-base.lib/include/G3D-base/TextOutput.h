@@ -209,6 +209,10 @@ public:
 
     void writeBoolean(bool b);
 
+    /** Writes the shortest string that TextInput reads back as the same value.
+        Values that are exactly representable as float (the common case for data
+        that originated as float) are written with float precision, so 0.1f appears
+        as "0.1" instead of "0.10000000149011612". \sa formatShortest */
     void writeNumber(double n);
 
     void writeNumber(int n);
@@ -2,7 +2,7 @@
   \file G3D-base.lib/include/G3D-base/ThreadsafeQueue.h
 
   G3D Innovation Engine http://casual-effects.com/g3d
-  Copyright 2000-2019, Morgan McGuire
+  Copyright 2000-2020, Morgan McGuire
   All rights reserved
   Available under the BSD License
 */
@@ -11,47 +11,150 @@
 
 #include "G3D-base/platform.h"
 #include "G3D-base/Thread.h"
+#include "G3D-base/Array.h"
 #include "G3D-base/Queue.h"
+#include "G3D-base/MPMCQueue.h"
 
 namespace G3D {
 
-/** A queue whose methods are synchronized with respect to each other.
-    \sa Queue, Spinlock */
+/** \brief An unbounded queue whose methods are synchronized with respect to each other.
+
+    pushBack() and popFront() are lock-free while the queue holds fewer than
+    ringCapacity elements: they operate on an MPMCQueue. Elements that do not fit
+    spill into a Spinlock-protected Queue, and pushBack() keeps appending there
+    until consumers have drained it, so that each producer's elements stay in
+    order.
+
+    pushFront() and popBack() do not fit a FIFO ring. They move the contents of
+    the ring into the spill Queue under the lock and operate on it, so they are
+    much slower than pushBack() and popFront().
+
+    \sa Queue, MPMCQueue, Spinlock */
 template<class T>
 class ThreadsafeQueue {
 private:
-    mutable Spinlock    m_mutex;
-    Queue<T>            m_data;
+    MPMCQueue<T>                m_ring;
+
+    mutable Spinlock            m_mutex;
+
+    /** Elements that were pushed while the ring was full. All are newer than those in m_ring. Protected by m_mutex. */
+    Queue<T>                    m_overflow;
+
+    /** m_overflow.size() plus the number of pushFront() and popBack() calls in progress.
+        While nonzero, pushBack() appends to m_overflow. */
+    std::atomic<int>            m_overflowCount;
+
+    _internal::QueueWaiters     m_consumerWaiters;
+
+    // Not copyable
+    ThreadsafeQueue(const ThreadsafeQueue&);
+    ThreadsafeQueue& operator=(const ThreadsafeQueue&);
+
+    /** Moves all elements of the ring to the front of m_overflow. Call with m_mutex locked
+        and m_overflowCount already incremented, so that no new element enters the ring. */
+    void drainRingIntoOverflow() {
+        Queue<T> older;
+        T v;
+        while (m_ring.tryPop(v)) {
+            older.pushBack(v);
+        }
+        m_overflowCount.fetch_add(older.size(), std::memory_order_release);
+        while (older.size() > 0) {
+            m_overflow.pushFront(older.popBack());
+        }
+    }
+
+    bool tryPopFront(T& v) {
+        if (m_ring.tryPop(v)) {
+            return true;
+        } else if (m_overflowCount.load(std::memory_order_acquire) == 0) {
+            return false;
+        }
+
+        bool read = false;
+        m_mutex.lock();
+        if (m_overflow.size() > 0) {
+            v = m_overflow.popFront();
+            m_overflowCount.fetch_sub(1, std::memory_order_release);
+            read = true;
+        } else {
+            // A pushFront() or popBack() moved the elements, or they were
+            // appended to the ring after the first attempt
+            read = m_ring.tryPop(v);
+        }
+        m_mutex.unlock();
+        return read;
+    }
 
 public:
 
+    /** \param ringCapacity Number of elements that can be queued before pushBack() takes a lock */
+    explicit ThreadsafeQueue(int ringCapacity = 256) : m_ring(ringCapacity), m_overflowCount(0) {}
+
     void clear() {
         m_mutex.lock();
-        m_data.clear();
+        m_ring.clear();
+        m_overflowCount.fetch_sub(m_overflow.size(), std::memory_order_release);
+        m_overflow.clear();
         m_mutex.unlock();
     }
 
     void pushBack(const T& v) {
-        m_mutex.lock();
-        m_data.pushBack(v);
-        m_mutex.unlock();
+        if ((m_overflowCount.load(std::memory_order_acquire) > 0) || ! m_ring.tryPush(v)) {
+            m_mutex.lock();
+            m_overflow.pushBack(v);
+            m_overflowCount.fetch_add(1, std::memory_order_release);
+            m_mutex.unlock();
+        }
+        m_consumerWaiters.notify(false);
+    }
+
+    /** Pushes all of \a v in order, as a batch when they fit in the ring */
+    void pushBack(const Array<T>& v) {
+        int pushed = 0;
+        if (m_overflowCount.load(std::memory_order_acquire) == 0) {
+            pushed = m_ring.tryPushBatch(v.getCArray(), v.size());
+        }
+        if (pushed < v.size()) {
+            m_mutex.lock();
+            for (int i = pushed; i < v.size(); ++i) {
+                m_overflow.pushBack(v[i]);
+            }
+            m_overflowCount.fetch_add(v.size() - pushed, std::memory_order_release);
+            m_mutex.unlock();
+        }
+        m_consumerWaiters.notify(v.size() > 1);
     }
 
     void pushFront(const T& v) {
         m_mutex.lock();
-        m_data.pushFront(v);
+        m_overflowCount.fetch_add(1, std::memory_order_acq_rel);
+        drainRingIntoOverflow();
+        m_overflow.pushFront(v);
         m_mutex.unlock();
+        m_consumerWaiters.notify(false);
     }
 
     /** Returns true if v was actually read */
     bool popFront(T& v) {
-        bool read = false;
-        m_mutex.lock();
-        if (m_data.size() > 0) {
-            v = m_data.popFront();
-            read = true;
+        return tryPopFront(v);
+    }
+
+    /** Blocks until an element is available or \a timeout seconds elapse.
+        Returns true if v was actually read. */
+    bool waitPopFront(T& v, RealTime timeout = finf()) {
+        return m_consumerWaiters.wait([&]() { return tryPopFront(v); }, timeout);
+    }
+
+    /** Appends up to \a maxCount elements to \a v. Returns the number read. */
+    int popFront(Array<T>& v, int maxCount) {
+        const int oldSize = v.size();
+        v.resize(oldSize + maxCount, false);
+        int read = m_ring.tryPopBatch(v.getCArray() + oldSize, maxCount);
+        while ((read < maxCount) && tryPopFront(v[oldSize + read])) {
+            ++read;
         }
-        m_mutex.unlock();
+        v.resize(oldSize + read, false);
         return read;
     }
 
@@ -59,10 +162,14 @@ public:
     bool popBack(T& v) {
         bool read = false;
         m_mutex.lock();
-        if (m_data.size() > 0) {
-            v = m_data.popBack();
+        m_overflowCount.fetch_add(1, std::memory_order_acq_rel);
+        drainRingIntoOverflow();
+        if (m_overflow.size() > 0) {
+            v = m_overflow.popBack();
+            m_overflowCount.fetch_sub(1, std::memory_order_release);
             read = true;
         }
+        m_overflowCount.fetch_sub(1, std::memory_order_release);
         m_mutex.unlock();
         return read;
     }
@@ -70,7 +177,7 @@ public:
     /** Note that by the time the method has returned, the value may be incorrect. */
     int size() const {
         m_mutex.lock();
-        int i = m_data.size();
+        const int i = m_ring.size() + m_overflow.size();
         m_mutex.unlock();
         return i;
     }
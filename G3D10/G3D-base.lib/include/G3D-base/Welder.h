@@ -58,6 +58,9 @@ public:
      Mutates geometry, texCoord, and indexArray so that the output has
      collocated vertices collapsed (welded).
 
+     Neighbor searches and normal smoothing run on multiple threads. The
+     output does not depend on the number of threads.
+
      @param vertices Input and output
      @param textureCoords Input and output
      @param normals Output only
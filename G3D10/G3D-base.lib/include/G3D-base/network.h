@@ -77,27 +77,28 @@ RealTime networkCommunicationInterval();
 
 /**
   If NOT using G3D's internal threaded networking, you must invoke this periodically to service
-  the receiving side network connections.  Receiving messages will only update
-  inside this call--all other network calls queue for processing.
+  the network connections.  Receiving messages will only update
+  inside this call--all other network calls queue for processing. This also
+  invokes serviceNetworkSender().
 
-  If using G3D's internal threaded networking, this is automatically called continuously on 
-  a separate thread. 
+  If using G3D's internal threaded networking, this is automatically called on 
+  a separate thread whenever a message arrives or is submitted for sending. That
+  thread blocks on all sockets at once while the network is idle.
 
    \sa setNetworkCommunicationInterval, G3D::G3DSpecification::threadedNetwork
 */
 void serviceNetwork();
 
 /**
-  If NOT using G3D's internal threaded networking, you must invoke this periodically to service
-  the sending side network connections. Sending messages will only update
-  inside this call--all other network calls queue for processing.
+  Hands all messages submitted by NetSendConnection::send to the network and
+  flushes them. Messages to the same peer are coalesced into as few packets as
+  possible.
 
-  If using G3D's internal threaded networking, this is automatically called continuously on
-  a separate thread.
+  Invoked by serviceNetwork().
 
-   \sa setNetworkCommunicationInterval, G3D::G3DSpecification::threadedNetwork
+   \sa G3D::G3DSpecification::threadedNetwork
 */
-void serviceNetworkSender(const G3D::NetChannel &channel);
+void serviceNetworkSender();
 
 
 /** Iterates through new messages on a NetConnection.
@@ -403,9 +404,11 @@ public:
     /** Includes a header.  The header should be fairly small to avoid increasing latency during the extra copies required. */
     void send(NetMessageType type, BinaryOutput& bo, BinaryOutput& header, NetChannel channel = 0);
 
-    void submitToSendQueues(const _internal::NetMessage& message);
+    /** Queues \a message for the next serviceNetworkSender() and wakes the network thread */
+    void submitToSendQueue(const _internal::NetMessage& message);
 
-    void shutdownSenderThreads();
+    /** Destroys this connection's messages that have not yet been handed to the network */
+    void discardQueuedMessages();
 
     /** Address of the other side of the connection */
     virtual NetAddress address() const;
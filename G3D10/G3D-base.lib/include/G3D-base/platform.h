@@ -312,6 +312,10 @@ namespace G3D {
         /** Name that Log::common() and logPrintf() use */
         const char* logFilename = "log.txt";
 
+        /** If true, Log::common() buffers messages per thread and writes them
+            on a background thread. See G3D::Log::Settings::asynchronous. Default: false. */
+        bool asynchronousLog = false;
+
         /** Scale used by G3D::GuiWindow::pixelScale.
             If -1, the scale automatically is chosen by the GuiWindow based on the 
             primary display resolution. 4k = 2x, 8k = 4x */
@@ -247,6 +247,47 @@ void buildPrefixTree(const Array<String>& list, DepthFirstTreeBuilder<String>& t
 /** Convert from ASCII to utf-8 encoding, adapted from https://everything2.com/title/Converting+ASCII+to+UTF-8 */
 void toUTF8(const String& s, Array<char>& result);
 
+/** Size of the buffer required by formatShortest(), including the terminating NUL */
+enum { SHORTEST_NUMBER_BUFFER_SIZE = 32 };
+
+/**
+  \brief Writes the shortest decimal string that parses back to exactly \a x.
+
+  Unlike printf("%g"), which keeps six significant digits, the result always
+  round-trips. Unlike "%.9g", it contains no more digits than necessary,
+  so 0.1f is written as "0.1". Infinities are written as "inf" and "-inf",
+  and NaN as "nan".
+
+  \param buffer Must hold at least SHORTEST_NUMBER_BUFFER_SIZE characters. NUL terminated on return.
+  \return The number of characters written, not counting the terminating NUL.
+
+  \sa parseDouble, TextOutput::writeNumber
+ */
+int formatShortest(float x, char* buffer);
+
+/** \copydoc formatShortest(float, char*) */
+int formatShortest(double x, char* buffer);
+
+/**
+  \brief Parses a decimal number (optional sign, digits, optional fraction,
+  optional exponent, or "inf"/"infinity"/"nan") from the beginning of
+  [\a begin, \a end).
+
+  Correctly rounded. Numbers with at most 15 significant digits and
+  small exponents, which covers almost all text data, are converted
+  exactly with a single multiply or divide without calling the C library.
+  Does not require \a end to point to a NUL.
+
+  \return One past the last character consumed, or \a begin if there
+  is no number there, in which case \a x is unchanged.
+
+  \sa formatShortest, TextInput::parseNumber
+ */
+const char* parseDouble(const char* begin, const char* end, double& x);
+
+/** \copydoc parseDouble */
+const char* parseFloat(const char* begin, const char* end, float& x);
+
 }; // namespace
 
 #endif
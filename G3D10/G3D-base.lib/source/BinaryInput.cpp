@@ -13,9 +13,11 @@
 #include "G3D-base/fileutils.h"
 #include "G3D-base/Log.h"
 #include "G3D-base/FileSystem.h"
+#include "G3D-base/Thread.h"
 #include "../../external/zlib.lib/include/zlib.h"
 #include "../../external/zip.lib/include/zip.h"
 #include <cstring>
+#include <atomic>
 
 namespace G3D {
 
@@ -56,18 +58,9 @@ BinaryInput::BinaryInput(
     setEndian(dataEndian);
 
     if (compressed) {
-        // Read the decompressed size from the first 4 bytes
-        m_length = readUInt32FromBuffer(data, m_swapBytes);
-
         debugAssert(m_freeBuffer);
-        m_buffer = (uint8*)System::alignedMalloc(m_length, 16);
-
-        unsigned long L = (unsigned long)m_length;
-        // Decompress with zlib
-        int64 result = uncompress(m_buffer, &L, data + 4, (uLong)dataLen - 4);
-        m_length = L;
-        m_bufferLength = L;
-        debugAssert(result == Z_OK); (void)result;
+        m_buffer = inflate(data, dataLen, dataEndian, m_length, m_filename);
+        m_bufferLength = m_length;
 
     } else {
         m_length = dataLen;
@@ -200,6 +193,115 @@ BinaryInput::BinaryInput
 	}
 }
 
+BinaryInput::BinaryInput
+(const String&  filename,
+    G3DEndian           fileEndian,
+    int64               start,
+    int64               length) :
+    m_filename(filename),
+    m_bitPos(0),
+    m_bitString(0),
+    m_beginEndBits(0),
+    m_alreadyRead(0),
+    m_length(0),
+    m_bufferLength(0),
+    m_buffer(nullptr),
+    m_pos(0),
+    m_freeBuffer(true) {
+
+    setEndian(fileEndian);
+    debugAssert((start >= 0) && (length >= 0));
+
+    _internal::CompressedChunkFormat layout;
+    std::FILE* file = nullptr;
+    String zipfile, internalFile;
+    if (! FileSystem::inZipfile(m_filename, zipfile, internalFile)) {
+        file = FileSystem::fopen(m_filename.c_str(), "rb");
+        if (isNull(file)) {
+            throw format("File not found: \"%s\"", m_filename.c_str());
+        }
+    }
+
+    const std::function<bool (int64, int64, uint8*)> read = [&](int64 offset, int64 bytes, uint8* dst) {
+#       ifdef G3D_WINDOWS
+            const bool sought = (_fseeki64(file, offset, SEEK_SET) == 0);
+#       else
+            const bool sought = (fseeko(file, (off_t)offset, SEEK_SET) == 0);
+#       endif
+        return sought && (std::fread(dst, 1, (size_t)bytes, file) == (size_t)bytes);
+    };
+
+    bool chunked = false;
+    if (notNull(file)) {
+        #       ifdef G3D_WINDOWS
+            _fseeki64(file, 0, SEEK_END);
+            const int64 fileLength = _ftelli64(file);
+#       else
+            fseeko(file, 0, SEEK_END);
+            const int64 fileLength = (int64)ftello(file);
+#       endif
+        try {
+            chunked = readChunkIndex(fileLength, fileEndian, read, layout);
+        } catch (...) {
+            FileSystem::fclose(file);
+            throw;
+        }
+    }
+
+    if (! chunked) {
+        if (notNull(file)) {
+            FileSystem::fclose(file);
+        }
+
+        // Inflate everything and keep the requested range
+        BinaryInput whole(filename, fileEndian, true);
+        start  = min(start, whole.m_length);
+        m_length = m_bufferLength = min(length, whole.m_length - start);
+        m_buffer = (uint8*)System::alignedMalloc(max(m_length, (int64)1), 16);
+        System::memcpy(m_buffer, whole.m_buffer + start, (size_t)m_length);
+        return;
+    }
+
+    start = min(start, layout.uncompressedLength);
+    m_length = m_bufferLength = min(length, layout.uncompressedLength - start);
+    if (m_length == 0) {
+        FileSystem::fclose(file);
+        m_buffer = (uint8*)System::alignedMalloc(1, 16);
+        return;
+    }
+
+    // The chunks overlapping the range are contiguous on disk
+    const int first = int(start / layout.chunkSize);
+    const int last  = int((start + m_length - 1) / layout.chunkSize);
+    const int64 compressedStart = (int64)layout.chunkArray[first].offset;
+    const int64 compressedBytes = (int64)layout.chunkArray[last].offset + layout.chunkArray[last].compressedBytes - compressedStart;
+
+    uint8* compressed = (uint8*)System::alignedMalloc(max(compressedBytes, (int64)1), 16);
+    const bool readCompressed = read(compressedStart, compressedBytes, compressed);
+    FileSystem::fclose(file); file = nullptr;
+    if (! readCompressed) {
+        System::alignedFree(compressed);
+        throw format("Could not read \"%s\"", m_filename.c_str());
+    }
+
+    const int64 inflatedLength = (int64)(last - first) * layout.chunkSize + layout.chunkArray[last].uncompressedBytes;
+    m_buffer = (uint8*)System::alignedMalloc(inflatedLength, 16);
+    try {
+        inflateChunks(layout, first, last, compressed, compressedStart, m_buffer, m_filename);
+    } catch (...) {
+        System::alignedFree(compressed);
+        throw;
+    }
+    System::alignedFree(compressed);
+
+    // Shift the range to the front of the buffer
+    const int64 skip = start - (int64)first * layout.chunkSize;
+    if (skip > 0) {
+        memmove(m_buffer, m_buffer + skip, (size_t)m_length);
+    }
+}
+
+
 BinaryInput::~BinaryInput() {
 
     if (m_freeBuffer) {
@@ -227,29 +329,142 @@ void BinaryInput::decompress() {
     // Decompress
     // Use the existing buffer as the source, allocate
     // a new buffer to use as the destination.
-    
-    int64 tempLength = m_length;
-    m_length = readUInt32FromBuffer(m_buffer, m_swapBytes);
-    
-    // The file couldn't have better than 500:1 compression
-    alwaysAssertM(m_length < m_bufferLength * 500, "Compressed file header is corrupted");
-    
     uint8* tempBuffer = m_buffer;
-    m_buffer = (uint8*)System::alignedMalloc(m_length, 16);
-    
-    debugAssert(m_buffer);
     debugAssert(isValidHeapPointer(tempBuffer));
-    debugAssert(isValidHeapPointer(m_buffer));
-    
-    unsigned long L = (unsigned long)m_length;
-    int64 result = (int64)uncompress(m_buffer, &L, tempBuffer + 4, (uLong)tempLength - 4);
-    m_length = L;
+
+    m_buffer = inflate(tempBuffer, m_length, m_fileEndian, m_length, m_filename);
     m_bufferLength = m_length;
     
-    debugAssertM(result == Z_OK, "BinaryInput/zlib detected corruption in " + m_filename); 
+    System::alignedFree(tempBuffer);
+}
+
+
+uint8* BinaryInput::inflate(const uint8* data, int64 dataLen, G3DEndian endian, int64& length, const String& filename) {
+    const bool swapBytes = (endian != System::machineEndian());
+    alwaysAssertM(dataLen >= 4, "Compressed file header is corrupted");
+
+    _internal::CompressedChunkFormat layout;
+    const bool chunked = readChunkIndex(dataLen, endian, [&](int64 offset, int64 bytes, uint8* dst) {
+        System::memcpy(dst, data + offset, (size_t)bytes);
+        return true;
+    }, layout);
+
+    if (chunked) {
+        length = layout.uncompressedLength;
+        uint8* buffer = (uint8*)System::alignedMalloc(max(length, (int64)1), 16);
+        if (isNull(buffer)) {
+            throw "Not enough memory to decompress file.";
+        }
+        inflateChunks(layout, 0, layout.chunkArray.size() - 1, data, 0, buffer, filename);
+        return buffer;
+    }
+
+    // Single-block layout: the decompressed size is in the first 4 bytes
+    length = readUInt32FromBuffer(data, swapBytes);
+
+    // The file couldn't have better than 500:1 compression
+    alwaysAssertM(length < dataLen * 500, "Compressed file header is corrupted");
+
+    uint8* buffer = (uint8*)System::alignedMalloc(length, 16);
+    debugAssert(buffer);
+    debugAssert(isValidHeapPointer(buffer));
+
+    unsigned long L = (unsigned long)length;
+    int64 result = (int64)uncompress(buffer, &L, data + 4, (uLong)dataLen - 4);
+    length = L;
+
+    debugAssertM(result == Z_OK, "BinaryInput/zlib detected corruption in " + filename); 
     (void)result;
+
+    return buffer;
+}
+
+
+bool BinaryInput::readChunkIndex(int64 dataLen, G3DEndian endian, const std::function<bool (int64, int64, uint8*)>& read, _internal::CompressedChunkFormat& layout) {
+    typedef _internal::CompressedChunkFormat Format;
+
+    uint8 header[Format::HEADER_BYTES];
+    if ((dataLen < Format::HEADER_BYTES + Format::TRAILER_BYTES) || ! read(0, Format::HEADER_BYTES, header)) {
+        return false;
+    }
+
+    BinaryInput headerInput(header, Format::HEADER_BYTES, endian, false, NO_COPY);
+    if (headerInput.readUInt32() != Format::MARKER) {
+        return false;
+    }
     
-    System::alignedFree(tempBuffer);
+    const uint32 version = headerInput.readUInt32();
+    if (version != Format::VERSION) {
+        throw format("Unsupported compressed file version %u", version);
+    }
+
+    uint8 trailer[Format::TRAILER_BYTES];
+    if (! read(dataLen - Format::TRAILER_BYTES, Format::TRAILER_BYTES, trailer)) {
+        throw "Could not read the compressed file index";
+    }
+
+    BinaryInput trailerInput(trailer, Format::TRAILER_BYTES, endian, false, NO_COPY);
+    layout.uncompressedLength = (int64)trailerInput.readUInt64();
+    layout.chunkSize          = trailerInput.readUInt32();
+    const uint32 numChunks    = trailerInput.readUInt32();
+    layout.indexOffset        = trailerInput.readUInt64();
+    const uint32 magic        = trailerInput.readUInt32();
+
+    const int64 indexBytes = (int64)numChunks * Format::INDEX_ENTRY_BYTES;
+    if ((magic != Format::MAGIC) ||
+        (layout.indexOffset < (uint64)Format::HEADER_BYTES) ||
+        ((int64)layout.indexOffset + indexBytes + Format::TRAILER_BYTES != dataLen) ||
+        ((numChunks > 0) && (layout.chunkSize == 0))) {
+        throw "Compressed file index is corrupted";
+    }
+
+    Array<uint8> indexData;
+    indexData.resize((int)indexBytes);
+    if ((indexBytes > 0) && ! read((int64)layout.indexOffset, indexBytes, indexData.getCArray())) {
+        throw "Could not read the compressed file index";
+    }
+
+    BinaryInput indexInput(indexData.getCArray(), indexBytes, endian, false, NO_COPY);
+    layout.chunkArray.resize((int)numChunks);
+    int64 total = 0;
+    for (uint32 c = 0; c < numChunks; ++c) {
+        Format::Chunk& chunk = layout.chunkArray[(int)c];
+        chunk.offset            = indexInput.readUInt64();
+        chunk.compressedBytes   = indexInput.readUInt32();
+        chunk.uncompressedBytes = indexInput.readUInt32();
+        total += chunk.uncompressedBytes;
+
+        if ((chunk.offset + chunk.compressedBytes > layout.indexOffset) ||
+            (chunk.uncompressedBytes > layout.chunkSize) ||
+            ((c + 1 < numChunks) && (chunk.uncompressedBytes != layout.chunkSize))) {
+            throw "Compressed file index is corrupted";
+        }
+    }
+
+    if (total != layout.uncompressedLength) {
+        throw "Compressed file index is corrupted";
+    }
+
+    return true;
+}
+
+
+void BinaryInput::inflateChunks(const _internal::CompressedChunkFormat& layout, int first, int last, const uint8* compressed, int64 compressedStart, uint8* dst, const String& filename) {
+    std::atomic<bool> corrupt(false);
+
+    runConcurrently(first, last + 1, [&](int c) {
+        const _internal::CompressedChunkFormat::Chunk& chunk = layout.chunkArray[c];
+        uLongf L = (uLongf)chunk.uncompressedBytes;
+        const int result = uncompress(dst + (int64)(c - first) * layout.chunkSize, &L,
+                                      compressed + ((int64)chunk.offset - compressedStart), (uLong)chunk.compressedBytes);
+        if ((result != Z_OK) || (L != chunk.uncompressedBytes)) {
+            corrupt = true;
+        }
+    });
+
+    if (corrupt) {
+        throw "BinaryInput/zlib detected corruption in " + filename;
+    }
 }
 
 
@@ -516,7 +731,7 @@ uint32 BinaryInput::readBits(int numBits) {
 
     uint32 out = 0;
 
-    const int total = numBits;
+    int shift = 0;
     while (numBits > 0) {
         if (m_bitPos > 7) {
             // Consume a new byte for reading.  We do this at the beginning
@@ -525,14 +740,16 @@ uint32 BinaryInput::readBits(int numBits) {
             m_bitString = readUInt8();
         }
 
-        // Slide the lowest bit of the bitString into
-        // the correct position.
-        out |= (m_bitString & 1) << (total - numBits);
+        // Slide as many of the remaining bits of the current byte as
+        // are needed into the correct position.
+        const int n = min(numBits, 8 - m_bitPos);
+        out |= (m_bitString & ((1u << n) - 1)) << shift;
 
         // Shift over to the next bit
-        m_bitString = m_bitString >> 1;
-        ++m_bitPos;
-        --numBits;
+        m_bitString = m_bitString >> n;
+        m_bitPos += n;
+        shift += n;
+        numBits -= n;
     }
 
     return out;
@@ -14,8 +14,10 @@
 #include "G3D-base/stringutils.h"
 #include "G3D-base/Array.h"
 #include "G3D-base/Log.h"
+#include "G3D-base/Thread.h"
 #include "../../external/zlib.lib/include/zlib.h"
 #include <cstring>
+#include <atomic>
 
 #ifdef G3D_LINUX
 #    include <errno.h>
@@ -272,11 +274,142 @@ bool BinaryOutput::ok() const {
 }
 
 
-void BinaryOutput::compress(int level) {
+void BinaryOutput::compress(int level, int chunkSize) {
+    debugAssertM(! m_committed, "Cannot compress after committing.");
+    if (chunkSize <= 0) {
+        compressSingleBlock(level);
+        return;
+    }
+
+    typedef _internal::CompressedChunkFormat Format;
+    level = iClamp(level, 0, 9);
+
+    const int64 uncompressedLength = m_alreadyWritten + (int64)m_bufferLen;
+    const int64 numChunks = (uncompressedLength + chunkSize - 1) / chunkSize;
+    alwaysAssertM(numChunks < 0xFFFFFFFF, "Too many chunks to compress; use a larger chunkSize.");
+
+    // Huge files are read back from disk and compressed into a
+    // temporary file that then replaces this one.
+    const bool huge = (m_alreadyWritten > 0);
+    const String& outFilename = huge ? (m_filename + ".compress") : String("<memory>");
+    BinaryOutput out(outFilename, m_fileEndian);
+
+    FILE* disk = nullptr;
+    if (huge) {
+        disk = FileSystem::fopen(m_filename.c_str(), "rb");
+        if (isNull(disk)) {
+            throw "Could not read back a huge file to compress it.";
+        }
+    }
+
+    out.writeUInt32(Format::MARKER);
+    out.writeUInt32(Format::VERSION);
+
+    // Chunks are compressed in parallel, a batch at a time so that
+    // huge files need only a bounded amount of temporary memory.
+    static const int BATCH_SIZE = 64;
+    Array<Format::Chunk>    chunkArray;
+    Array<Array<uint8>>     stagingArray;
+    Array<Array<uint8>>     compressedArray;
+    Array<const uint8*>     sourceArray;
+    chunkArray.resize((size_t)numChunks);
+    stagingArray.resize(BATCH_SIZE);
+    compressedArray.resize(BATCH_SIZE);
+    sourceArray.resize(BATCH_SIZE);
+
+    for (int64 batchStart = 0; batchStart < numChunks; batchStart += BATCH_SIZE) {
+        const int count = (int)min((int64)BATCH_SIZE, numChunks - batchStart);
+
+        for (int i = 0; i < count; ++i) {
+            Format::Chunk& chunk = chunkArray[(int)batchStart + i];
+            const int64 begin = (batchStart + i) * chunkSize;
+            const int64 end   = min(begin + chunkSize, uncompressedLength);
+            chunk.uncompressedBytes = (uint32)(end - begin);
+
+            if (begin >= m_alreadyWritten) {
+                // Still in memory
+                sourceArray[i] = m_buffer + (begin - m_alreadyWritten);
+            } else {
+                // Chunks are visited in order, so the disk is read sequentially
+                Array<uint8>& staging = stagingArray[i];
+                staging.resize(chunk.uncompressedBytes, false);
+                const size_t fromDisk = (size_t)(min(end, m_alreadyWritten) - begin);
+                if (fread(staging.getCArray(), 1, fromDisk, disk) != fromDisk) {
+                    FileSystem::fclose(disk);
+                    throw "Could not read back a huge file to compress it.";
+                }
+                if (end > m_alreadyWritten) {
+                    System::memcpy(staging.getCArray() + fromDisk, m_buffer, (size_t)(end - m_alreadyWritten));
+                }
+                sourceArray[i] = staging.getCArray();
+            }
+        }
+
+        std::atomic<bool> failed(false);
+        runConcurrently(0, count, [&](int i) {
+            Format::Chunk& chunk = chunkArray[(int)batchStart + i];
+            Array<uint8>& compressed = compressedArray[i];
+            uLongf L = compressBound(chunk.uncompressedBytes);
+            compressed.resize(L, false);
+            if (compress2(compressed.getCArray(), &L, sourceArray[i], chunk.uncompressedBytes, level) != Z_OK) {
+                failed = true;
+            }
+            chunk.compressedBytes = (uint32)L;
+        });
+        alwaysAssertM(! failed, "zlib compression failed");
+
+        for (int i = 0; i < count; ++i) {
+            Format::Chunk& chunk = chunkArray[(int)batchStart + i];
+            chunk.offset = (uint64)out.position();
+            out.writeBytes(compressedArray[i].getCArray(), chunk.compressedBytes);
+        }
+    }
+
+    if (notNull(disk)) {
+        FileSystem::fclose(disk);
+        disk = nullptr;
+    }
+
+    const int64 indexOffset = out.position();
+    for (int c = 0; c < chunkArray.size(); ++c) {
+        out.writeUInt64(chunkArray[c].offset);
+        out.writeUInt32(chunkArray[c].compressedBytes);
+        out.writeUInt32(chunkArray[c].uncompressedBytes);
+    }
+    out.writeUInt64((uint64)uncompressedLength);
+    out.writeUInt32((uint32)chunkSize);
+    out.writeUInt32((uint32)numChunks);
+    out.writeUInt64((uint64)indexOffset);
+    out.writeUInt32(Format::MAGIC);
+
+    // Adopt the compressed data. For huge files, what out has
+    // already dumped to disk replaces this file's contents and
+    // commit() appends the rest.
+    System::free(m_buffer);
+    m_buffer         = out.m_buffer;
+    m_bufferLen      = out.m_bufferLen;
+    m_maxBufferLen   = out.m_maxBufferLen;
+    m_alreadyWritten = out.m_alreadyWritten;
+    m_pos            = m_bufferLen;
+    out.m_buffer       = nullptr;
+    out.m_bufferLen    = 0;
+    out.m_maxBufferLen = 0;
+
+    if (huge) {
+        FileSystem::removeFile(m_filename);
+        if (m_alreadyWritten > 0) {
+            FileSystem::rename(outFilename, m_filename);
+        } else {
+            FileSystem::removeFile(outFilename);
+        }
+    }
+}
+
+
+void BinaryOutput::compressSingleBlock(int level) {
     if (m_alreadyWritten > 0) {
         throw "Cannot compress huge files (part of this file has already been written to disk).";
     }
-    debugAssertM(! m_committed, "Cannot compress after committing.");
     alwaysAssertM(m_bufferLen < 0xFFFFFFFF, "Compress only works for 32-bit files.");
 
     // This is the worst-case size, as mandated by zlib
@@ -521,12 +654,13 @@ void BinaryOutput::beginBits() {
 void BinaryOutput::writeBits(uint32 value, int numBits) {
 
     while (numBits > 0) {
-        // Extract the current bit of value and
-        // insert it into the current byte
-        m_bitString |= (value & 1) << m_bitPos;
-        ++m_bitPos;
-        value = value >> 1;
-        --numBits;
+        // Insert as many of the low bits of value as fit
+        // into the current byte
+        const int n = min(numBits, 8 - m_bitPos);
+        m_bitString |= (value & ((1u << n) - 1)) << m_bitPos;
+        m_bitPos += n;
+        value = value >> n;
+        numBits -= n;
 
         if (m_bitPos > 7) {
             // We've reached the end of this byte
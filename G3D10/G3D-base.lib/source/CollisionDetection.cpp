@@ -17,6 +17,7 @@
 #include "G3D-base/Line.h"
 #include "G3D-base/LineSegment.h"
 #include "G3D-base/Sphere.h"
+#include "G3D-base/Float4.h"
 #include "G3D-base/Box.h"
 #include "G3D-base/Triangle.h"
 #include "G3D-base/Vector3.h"
@@ -2207,6 +2208,86 @@ bool CollisionDetection::fixedSolidSphereIntersectsFixedSolidBox(
 }
 
 
+void CollisionDetection::fixedSolidSphereIntersectsFixedSolidSphere(
+    const Sphere*           sphere1,
+    const Sphere*           sphere2,
+    int                     count,
+    bool*                   result) {
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // Gather one Float4 per field
+        float field[2][4][4];
+        for (int j = 0; j < 4; ++j) {
+            const Sphere* s[2] = {sphere1 + i + j, sphere2 + i + j};
+            for (int k = 0; k < 2; ++k) {
+                field[k][0][j] = s[k]->center.x;
+                field[k][1][j] = s[k]->center.y;
+                field[k][2][j] = s[k]->center.z;
+                field[k][3][j] = s[k]->radius;
+            }
+        }
+
+        const Float4 dx = Float4::load(field[0][0]) - Float4::load(field[1][0]);
+        const Float4 dy = Float4::load(field[0][1]) - Float4::load(field[1][1]);
+        const Float4 dz = Float4::load(field[0][2]) - Float4::load(field[1][2]);
+        const Float4 r  = Float4::load(field[0][3]) + Float4::load(field[1][3]);
+        const int bits = (dx * dx + dy * dy + dz * dz < r * r).bits();
+        for (int j = 0; j < 4; ++j) {
+            result[i + j] = ((bits >> j) & 1) != 0;
+        }
+    }
+
+    for (; i < count; ++i) {
+        result[i] = fixedSolidSphereIntersectsFixedSolidSphere(sphere1[i], sphere2[i]);
+    }
+}
+
+
+void CollisionDetection::fixedSolidSphereIntersectsFixedSolidBox(
+    const Sphere*           sphere,
+    const Box*              box,
+    int                     count,
+    bool*                   result) {
+
+    // The squared distance from the sphere center to the box, which is zero inside of it,
+    // is the sum over the box axes of the squared distance beyond the face along that axis
+    const Float4 zero(0.0f);
+    for (int i = 0; i < count; i += 4) {
+        const int n = min(4, count - i);
+        float d[3][4], axis[3][3][4], halfExtent[3][4], radius[4];
+        for (int j = 0; j < 4; ++j) {
+            // Repeat the last pair to fill a partial batch
+            const int k = i + min(j, n - 1);
+            const Vector3& delta = sphere[k].center - box[k].center();
+            radius[j] = sphere[k].radius;
+            for (int a = 0; a < 3; ++a) {
+                const Vector3& u = box[k].axis(a);
+                d[a][j] = delta[a];
+                halfExtent[a][j] = box[k].extent(a) * 0.5f;
+                for (int c = 0; c < 3; ++c) {
+                    axis[a][c][j] = u[c];
+                }
+            }
+        }
+
+        const Float4 dx = Float4::load(d[0]), dy = Float4::load(d[1]), dz = Float4::load(d[2]);
+        Float4 distanceSquared = zero;
+        for (int a = 0; a < 3; ++a) {
+            const Float4 t = dx * Float4::load(axis[a][0]) + dy * Float4::load(axis[a][1]) + dz * Float4::load(axis[a][2]);
+            const Float4 excess = Float4::max(t.abs() - Float4::load(halfExtent[a]), zero);
+            distanceSquared = distanceSquared + excess * excess;
+        }
+
+        const Float4 r = Float4::load(radius);
+        const int bits = (distanceSquared <= r * r).bits();
+        for (int j = 0; j < n; ++j) {
+            result[i + j] = ((bits >> j) & 1) != 0;
+        }
+    }
+}
+
+
 bool CollisionDetection::movingSpherePassesThroughFixedBox(
     const Sphere&           sphere,
     const Vector3&          velocity,
@@ -0,0 +1,188 @@
+/**
+  \file G3D-base.lib/source/CubeMapSampler.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-base/CubeMapSampler.h"
+#include "G3D-base/CubeMap.h"
+#include "G3D-base/Color3.h"
+#include "G3D-base/Random.h"
+#include "G3D-base/Thread.h"
+
+namespace G3D {
+
+shared_ptr<CubeMapSampler> CubeMapSampler::create(const shared_ptr<CubeMap>& cubeMap, int maxResolution) {
+    return createShared<CubeMapSampler>(cubeMap, maxResolution);
+}
+
+
+Vector3 CubeMapSampler::faceDirection(int face, float s, float t) {
+    // Matches the face numbering of CubeFace and the axis order of CubeMap
+    const int axis = face >> 1;
+    Vector3 w;
+    w[axis] = (face & 1) ? -1.0f : 1.0f;
+    w[(axis + 1) % 3] = s;
+    w[(axis + 2) % 3] = t;
+    return w;
+}
+
+
+float CubeMapSampler::density(float cellProbability, float s, float t) const {
+    // The solid angle of an area element on the face at (s, t) is dA / (1 + s^2 + t^2)^(3/2)
+    const float r2 = 1.0f + square(s) + square(t);
+    return cellProbability * square(0.5f * float(m_resolution)) * r2 * sqrtf(r2);
+}
+
+
+CubeMapSampler::CubeMapSampler(const shared_ptr<CubeMap>& cubeMap, int maxResolution) :
+    m_cubeMap(cubeMap), m_black(false) {
+
+    debugAssert(notNull(cubeMap));
+    const int cubeSize = cubeMap->size();
+    m_resolution = max(1, min(cubeSize, maxResolution));
+    const int N = m_resolution;
+    const int numCells = 6 * N * N;
+    m_cell.resize(numCells);
+
+    // Weight of each cell: the maximum luminance of the cube map texels that overlap it
+    // or border it, times its solid angle. The border texels may be on adjacent faces.
+    Array<double> weight;
+    weight.resize(numCells);
+    const float cellSize = 2.0f / float(N);
+    const float texelSize = 2.0f / float(cubeSize);
+    runConcurrently(0, numCells, [&](int c) {
+        const int face = c / (N * N);
+        const int i = c % N;
+        const int j = (c / N) % N;
+
+        const int lowI = (i * cubeSize) / N - 1;
+        const int highI = ((i + 1) * cubeSize + N - 1) / N;
+        const int lowJ = (j * cubeSize) / N - 1;
+        const int highJ = ((j + 1) * cubeSize + N - 1) / N;
+
+        float L = 0.0f;
+        for (int q = lowJ; q <= highJ; ++q) {
+            const float t = (float(q) + 0.5f) * texelSize - 1.0f;
+            for (int p = lowI; p <= highI; ++p) {
+                const float s = (float(p) + 0.5f) * texelSize - 1.0f;
+                L = max(L, cubeMap->nearest(faceDirection(face, s, t)).average());
+            }
+        }
+
+        const float s = (float(i) + 0.5f) * cellSize - 1.0f;
+        const float t = (float(j) + 0.5f) * cellSize - 1.0f;
+        const float r2 = 1.0f + square(s) + square(t);
+        weight[c] = double(L) * square(cellSize) / (double(r2) * sqrt(double(r2)));
+    });
+
+    double total = 0.0;
+    for (const double w : weight) {
+        total += w;
+    }
+
+    if (! (total > 0.0)) {
+        // Nothing to importance sample; fall back to solid angle
+        m_black = true;
+        total = 0.0;
+        for (int c = 0; c < numCells; ++c) {
+            const float s = (float(c % N) + 0.5f) * cellSize - 1.0f;
+            const float t = (float((c / N) % N) + 0.5f) * cellSize - 1.0f;
+            const float r2 = 1.0f + square(s) + square(t);
+            weight[c] = 1.0 / (double(r2) * sqrt(double(r2)));
+            total += weight[c];
+        }
+    }
+
+    // Vose's alias method. Each scaled weight is the cell's share of a slot of size 1.
+    Array<double> scaled;
+    scaled.resize(numCells);
+    Array<int> small, large;
+    for (int c = 0; c < numCells; ++c) {
+        m_cell[c].probability = float(weight[c] / total);
+        scaled[c] = weight[c] * double(numCells) / total;
+        if (scaled[c] < 1.0) {
+            small.append(c);
+        } else {
+            large.append(c);
+        }
+    }
+
+    while ((small.size() > 0) && (large.size() > 0)) {
+        const int s = small.pop(false);
+        const int l = large.last();
+        m_cell[s].threshold = float(scaled[s]);
+        m_cell[s].alias = l;
+
+        // l donates the rest of s's slot
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop(false);
+            small.append(l);
+        }
+    }
+
+    // Whatever remains fills its own slot, up to roundoff
+    for (const int c : small) {
+        m_cell[c].threshold = 1.0f;
+        m_cell[c].alias = c;
+    }
+    for (const int c : large) {
+        m_cell[c].threshold = 1.0f;
+        m_cell[c].alias = c;
+    }
+
+    for (Cell& cell : m_cell) {
+        cell.aliasProbability = m_cell[cell.alias].probability;
+    }
+}
+
+
+Vector3 CubeMapSampler::sample(Random& rng, float& pdfValue) const {
+    const int N = m_resolution;
+
+    const float x = rng.uniform() * float(m_cell.size());
+    const int slot = min(int(x), m_cell.size() - 1);
+    const Cell& cell = m_cell[slot];
+
+    int c;
+    float probability;
+    if (x - float(slot) < cell.threshold) {
+        c = slot;
+        probability = cell.probability;
+    } else {
+        c = cell.alias;
+        probability = cell.aliasProbability;
+    }
+
+    // Uniformly distributed point in the cell
+    const int face = c / (N * N);
+    const float cellSize = 2.0f / float(N);
+    const float s = (float(c % N) + rng.uniform()) * cellSize - 1.0f;
+    const float t = (float((c / N) % N) + rng.uniform()) * cellSize - 1.0f;
+
+    pdfValue = density(probability, s, t);
+    return faceDirection(face, s, t).direction();
+}
+
+
+float CubeMapSampler::pdf(const Vector3& w) const {
+    const int N = m_resolution;
+    const int axis = w.primaryAxis();
+    const float a = fabsf(w[axis]);
+    if (! (a > 0.0f)) {
+        return 0.0f;
+    }
+
+    const int face = axis * 2 + ((w[axis] < 0.0f) ? 1 : 0);
+    const float s = w[(axis + 1) % 3] / a;
+    const float t = w[(axis + 2) % 3] / a;
+    const int i = clamp(int((s + 1.0f) * 0.5f * float(N)), 0, N - 1);
+    const int j = clamp(int((t + 1.0f) * 0.5f * float(N)), 0, N - 1);
+
+    return density(m_cell[(face * N + j) * N + i].probability, s, t);
+}
+
+} // namespace G3D
@@ -0,0 +1,424 @@
+/**
+  \file G3D-base.lib/source/ImageResampler.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-base/ImageResampler.h"
+#include "G3D-base/Image.h"
+#include "G3D-base/Image4.h"
+#include "G3D-base/Float4.h"
+#include "G3D-base/System.h"
+#include "G3D-base/Thread.h"
+
+namespace G3D {
+
+/** Rows per task of the horizontal pass */
+static const int ROW_BLOCK    = 16;
+
+/** Size of the tiles of the vertical pass. Each tile reads the same few source rows
+    for all of its destination rows, so the tiles are narrow enough to keep them in cache. */
+static const int TILE_WIDTH   = 256;
+static const int TILE_HEIGHT  = 16;
+
+/** Entries in the sRGB conversion tables, which are linearly interpolated */
+static const int SRGB_TABLE_SIZE = 4096;
+
+static float sinc(float x) {
+    if (fabsf(x) < 1e-6f) {
+        return 1.0f;
+    }
+    x *= pif();
+    return sinf(x) / x;
+}
+
+
+/** Modified Bessel function of the first kind, order zero */
+static float besselI0(float x) {
+    // Power series; converges quickly for the arguments used by the Kaiser window
+    float sum = 1.0f, term = 1.0f;
+    const float y = x * x * 0.25f;
+    for (int k = 1; k < 32; ++k) {
+        term *= y / float(k * k);
+        sum += term;
+        if (term < sum * 1e-8f) {
+            break;
+        }
+    }
+    return sum;
+}
+
+
+/** The filter's support (half-width) in its own units */
+static float filterSupport(const ImageResampler::Specification& specification) {
+    return (specification.filter == ImageResampler::Filter::BOX) ? 0.5f : specification.radius;
+}
+
+
+static float evaluateFilter(const ImageResampler::Specification& specification, float x) {
+    x = fabsf(x);
+    switch (specification.filter) {
+    case ImageResampler::Filter::BOX:
+        return (x <= 0.5f) ? 1.0f : 0.0f;
+
+    case ImageResampler::Filter::LANCZOS:
+        return (x < specification.radius) ? sinc(x) * sinc(x / specification.radius) : 0.0f;
+
+    case ImageResampler::Filter::KAISER:
+    default:
+        if (x < specification.radius) {
+            const float t = x / specification.radius;
+            return sinc(x) * besselI0(specification.kaiserAlpha * sqrtf(1.0f - t * t)) / besselI0(specification.kaiserAlpha);
+        } else {
+            return 0.0f;
+        }
+    }
+}
+
+
+/** Filter taps for each destination pixel along one axis */
+class ResampleKernel {
+public:
+    /** Taps per destination pixel */
+    int             taps;
+
+    /** Source pixel of each tap, already wrapped. dstSize * taps. */
+    Array<int>      index;
+
+    /** Normalized weight of each tap. dstSize * taps. */
+    Array<float>    weight;
+
+    ResampleKernel(int srcSize, int dstSize, const ImageResampler::Specification& specification) {
+        // When minifying, the filter widens to cover the source pixels under each destination pixel
+        const float scale   = float(dstSize) / float(srcSize);
+        const float stretch = max(1.0f, 1.0f / scale);
+        const float support = filterSupport(specification) * stretch;
+
+        taps = iCeil(support * 2.0f) + 1;
+        index.resize(dstSize * taps);
+        weight.resize(dstSize * taps);
+
+        for (int i = 0; i < dstSize; ++i) {
+            // Pixel centers are at half-integers
+            const float center = (float(i) + 0.5f) / scale - 0.5f;
+            const int first = iCeil(center - support);
+
+            float sum = 0.0f;
+            for (int k = 0; k < taps; ++k) {
+                const int j = first + k;
+                const float w = evaluateFilter(specification, (float(j) - center) / stretch);
+                index[i * taps + k]  = (specification.wrapMode == WrapMode::TILE) ? iWrap(j, srcSize) : iClamp(j, 0, srcSize - 1);
+                weight[i * taps + k] = w;
+                sum += w;
+            }
+
+            if (sum != 0.0f) {
+                for (int k = 0; k < taps; ++k) {
+                    weight[i * taps + k] /= sum;
+                }
+            }
+        }
+    }
+};
+
+
+/** Filters \a src along x into \a dst, which has the same height */
+static void resampleHorizontal(const Float4* src, int srcWidth, Float4* dst, int dstWidth, int height, const ImageResampler::Specification& specification) {
+    const ResampleKernel kernel(srcWidth, dstWidth, specification);
+    const int taps = kernel.taps;
+
+    runConcurrently(0, iCeil(float(height) / ROW_BLOCK), [&](int block) {
+        const int yEnd = min(height, (block + 1) * ROW_BLOCK);
+        for (int y = block * ROW_BLOCK; y < yEnd; ++y) {
+            const float* srcRow = reinterpret_cast<const float*>(src + size_t(y) * srcWidth);
+            float* dstRow = reinterpret_cast<float*>(dst + size_t(y) * dstWidth);
+            const int* index = kernel.index.getCArray();
+            const float* weight = kernel.weight.getCArray();
+
+            for (int x = 0; x < dstWidth; ++x, index += taps, weight += taps) {
+                Float4 sum(0.0f);
+                for (int k = 0; k < taps; ++k) {
+                    sum = sum + Float4::load(srcRow + index[k] * 4) * Float4(weight[k]);
+                }
+                sum.store(dstRow + x * 4);
+            }
+        }
+    });
+}
+
+
+/** Filters \a src along y into \a dst, which has the same width */
+static void resampleVertical(const Float4* src, int srcHeight, Float4* dst, int dstHeight, int width, const ImageResampler::Specification& specification) {
+    const ResampleKernel kernel(srcHeight, dstHeight, specification);
+    const int taps = kernel.taps;
+    const int tilesPerRow = iCeil(float(width) / TILE_WIDTH);
+    const int numTiles = tilesPerRow * iCeil(float(dstHeight) / TILE_HEIGHT);
+
+    runConcurrently(0, numTiles, [&](int tile) {
+        const int x0   = (tile % tilesPerRow) * TILE_WIDTH;
+        const int xEnd = min(width, x0 + TILE_WIDTH);
+        const int y0   = (tile / tilesPerRow) * TILE_HEIGHT;
+        const int yEnd = min(dstHeight, y0 + TILE_HEIGHT);
+
+        for (int y = y0; y < yEnd; ++y) {
+            float* dstRow = reinterpret_cast<float*>(dst + size_t(y) * width);
+            for (int x = x0; x < xEnd; ++x) {
+                Float4(0.0f).store(dstRow + x * 4);
+            }
+
+            // Accumulate whole source rows, which vectorizes across x
+            for (int k = 0; k < taps; ++k) {
+                const float w = kernel.weight[y * taps + k];
+                if (w != 0.0f) {
+                    const Float4 weight(w);
+                    const float* srcRow = reinterpret_cast<const float*>(src + size_t(kernel.index[y * taps + k]) * width);
+                    for (int x = x0; x < xEnd; ++x) {
+                        (Float4::load(dstRow + x * 4) + Float4::load(srcRow + x * 4) * weight).store(dstRow + x * 4);
+                    }
+                }
+            }
+        }
+    });
+}
+
+
+/** Resamples premultiplied linear pixels. \a temp holds the intermediate result when both axes change. */
+static void resample(const Array<Float4>& src, int srcWidth, int srcHeight, Array<Float4>& dst, int dstWidth, int dstHeight, Array<Float4>& temp, const ImageResampler::Specification& specification) {
+    debugAssert(src.size() == srcWidth * srcHeight);
+
+    // Clearing first keeps resize() from copying the old contents when it grows the buffer
+    dst.fastClear();
+    dst.resize(dstWidth * dstHeight, false);
+
+    if (srcWidth == dstWidth) {
+        if (srcHeight == dstHeight) {
+            System::memcpy(dst.getCArray(), src.getCArray(), sizeof(Float4) * src.size());
+        } else {
+            resampleVertical(src.getCArray(), srcHeight, dst.getCArray(), dstHeight, dstWidth, specification);
+        }
+    } else if (srcHeight == dstHeight) {
+        resampleHorizontal(src.getCArray(), srcWidth, dst.getCArray(), dstWidth, srcHeight, specification);
+    } else {
+        // Filter the axis that shrinks the most first, so that the second pass does less work
+        if (float(dstWidth) / srcWidth <= float(dstHeight) / srcHeight) {
+            temp.fastClear();
+            temp.resize(dstWidth * srcHeight, false);
+            resampleHorizontal(src.getCArray(), srcWidth, temp.getCArray(), dstWidth, srcHeight, specification);
+            resampleVertical(temp.getCArray(), srcHeight, dst.getCArray(), dstHeight, dstWidth, specification);
+        } else {
+            temp.fastClear();
+            temp.resize(srcWidth * dstHeight, false);
+            resampleVertical(src.getCArray(), srcHeight, temp.getCArray(), dstHeight, srcWidth, specification);
+            resampleHorizontal(temp.getCArray(), srcWidth, dst.getCArray(), dstWidth, dstHeight, specification);
+        }
+    }
+}
+
+
+static float sRGBToLinear(float c) {
+    return (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+
+static float linearToSRGB(float c) {
+    return (c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+
+/** Applies \a f to values on [0, 1] by interpolating a table, which is much faster than powf */
+class TransferTable {
+public:
+    float   table[SRGB_TABLE_SIZE + 1];
+    float   (*function)(float);
+
+    TransferTable(float (*f)(float)) : function(f) {
+        for (int i = 0; i <= SRGB_TABLE_SIZE; ++i) {
+            table[i] = f(float(i) / SRGB_TABLE_SIZE);
+        }
+    }
+
+    float operator()(float c) const {
+        if ((c >= 0.0f) && (c < 1.0f)) {
+            const float x = c * SRGB_TABLE_SIZE;
+            const int i = int(x);
+            return lerp(table[i], table[i + 1], x - float(i));
+        } else {
+            return function(c);
+        }
+    }
+};
+
+
+static const TransferTable& decodeSRGB() {
+    static const TransferTable table(sRGBToLinear);
+    return table;
+}
+
+
+static const TransferTable& encodeSRGB() {
+    static const TransferTable table(linearToSRGB);
+    return table;
+}
+
+
+/** Converts \a src to the premultiplied linear form in which it is filtered */
+static void prepare(const Color4* src, int numPixels, Array<Float4>& dst, const ImageResampler::Specification& specification) {
+    // Float4's constructor does not initialize, so resizing only allocates
+    dst.resize(numPixels, false);
+    Color4* out = reinterpret_cast<Color4*>(dst.getCArray());
+    const TransferTable& decode = decodeSRGB();
+    runConcurrently(0, iCeil(float(numPixels) / (ROW_BLOCK * TILE_WIDTH)), [&](int block) {
+        const int end = min(numPixels, (block + 1) * ROW_BLOCK * TILE_WIDTH);
+        for (int i = block * ROW_BLOCK * TILE_WIDTH; i < end; ++i) {
+            Color4 c = src[i];
+            if (specification.sRGB) {
+                c.r = decode(c.r);
+                c.g = decode(c.g);
+                c.b = decode(c.b);
+            }
+            if (specification.alphaWeighted) {
+                c.r *= c.a;
+                c.g *= c.a;
+                c.b *= c.a;
+            }
+            out[i] = c;
+        }
+    });
+}
+
+
+/** Inverse of prepare() */
+static shared_ptr<Image4> finish(const Array<Float4>& pixel, int width, int height, const ImageResampler::Specification& specification) {
+    const shared_ptr<Image4>& dst = Image4::createEmpty(width, height, specification.wrapMode);
+    Color4* out = dst->getCArray();
+    const Color4* src = reinterpret_cast<const Color4*>(pixel.getCArray());
+    const int numPixels = width * height;
+    const TransferTable& encode = encodeSRGB();
+
+    runConcurrently(0, iCeil(float(numPixels) / (ROW_BLOCK * TILE_WIDTH)), [&](int block) {
+        const int end = min(numPixels, (block + 1) * ROW_BLOCK * TILE_WIDTH);
+        for (int i = block * ROW_BLOCK * TILE_WIDTH; i < end; ++i) {
+            Color4 c = src[i];
+            if (specification.alphaWeighted) {
+                const float invA = (c.a > 0.0f) ? 1.0f / c.a : 0.0f;
+                c.r *= invA;
+                c.g *= invA;
+                c.b *= invA;
+            }
+
+            // Remove the ringing of the negative lobes where values must be nonnegative
+            c.a = clamp(c.a, 0.0f, 1.0f);
+            if (specification.sRGB) {
+                c.r = encode(max(c.r, 0.0f));
+                c.g = encode(max(c.g, 0.0f));
+                c.b = encode(max(c.b, 0.0f));
+            }
+            out[i] = c;
+        }
+    });
+
+    return dst;
+}
+
+
+static shared_ptr<Image4> toImage4(const shared_ptr<Image>& src) {
+    const shared_ptr<Image4>& dst = Image4::createEmpty(src->width(), src->height(), WrapMode::CLAMP);
+    Color4* out = dst->getCArray();
+    const int width = src->width();
+    runConcurrently(0, src->height(), [&](int y) {
+        for (int x = 0; x < width; ++x) {
+            src->get(Point2int32(x, y), out[y * width + x]);
+        }
+    });
+    return dst;
+}
+
+
+static shared_ptr<Image> toImage(const shared_ptr<Image4>& src, const ImageFormat* format) {
+    const shared_ptr<Image>& dst = Image::create(src->width(), src->height(), format);
+    const Color4* in = src->getCArray();
+    const int width = src->width();
+    runConcurrently(0, src->height(), [&](int y) {
+        for (int x = 0; x < width; ++x) {
+            dst->set(Point2int32(x, y), in[y * width + x]);
+        }
+    });
+    return dst;
+}
+
+
+shared_ptr<Image4> ImageResampler::resize(const shared_ptr<Image4>& src, int width, int height, const Specification& specification) {
+    debugAssert((width > 0) && (height > 0));
+    debugAssertM((specification.wrapMode == WrapMode::CLAMP) || (specification.wrapMode == WrapMode::TILE), "Unsupported wrap mode");
+
+    Array<Float4> linear, result, temp;
+    prepare(src->getCArray(), src->width() * src->height(), linear, specification);
+    resample(linear, src->width(), src->height(), result, width, height, temp, specification);
+    return finish(result, width, height, specification);
+}
+
+
+shared_ptr<Image> ImageResampler::resize(const shared_ptr<Image>& src, int width, int height, const Specification& specification) {
+    return toImage(resize(toImage4(src), width, height, specification), src->format());
+}
+
+
+void ImageResampler::generateMipMaps(const shared_ptr<Image4>& src, Array<shared_ptr<Image4>>& mipArray, const Specification& specification) {
+    debugAssertM((specification.wrapMode == WrapMode::CLAMP) || (specification.wrapMode == WrapMode::TILE), "Unsupported wrap mode");
+
+    mipArray.fastClear();
+    mipArray.append(src);
+
+    // Each level is filtered from the previous one without leaving linear premultiplied space
+    Array<Float4> level, next, temp;
+    int width = src->width(), height = src->height();
+    prepare(src->getCArray(), width * height, level, specification);
+
+    while ((width > 1) || (height > 1)) {
+        const int nextWidth = max(1, width / 2), nextHeight = max(1, height / 2);
+        resample(level, width, height, next, nextWidth, nextHeight, temp, specification);
+        mipArray.append(finish(next, nextWidth, nextHeight, specification));
+
+        Array<Float4>::swap(level, next);
+        width = nextWidth;
+        height = nextHeight;
+    }
+}
+
+
+void ImageResampler::generateMipMaps(const shared_ptr<Image>& src, Array<shared_ptr<Image>>& mipArray, const Specification& specification) {
+    Array<shared_ptr<Image4>> mipArray4;
+    generateMipMaps(toImage4(src), mipArray4, specification);
+
+    mipArray.fastClear();
+    mipArray.append(src);
+    for (int i = 1; i < mipArray4.size(); ++i) {
+        mipArray.append(toImage(mipArray4[i], src->format()));
+    }
+}
+
+
+void ImageResampler::generateCubeMapMipMaps(const Array<shared_ptr<Image4>>& faceArray, Array<Array<shared_ptr<Image4>>>& mipArray, const Specification& specification) {
+    debugAssert(faceArray.size() == 6);
+
+    Specification faceSpecification = specification;
+    faceSpecification.wrapMode = WrapMode::CLAMP;
+
+    mipArray.clear();
+    for (int face = 0; face < faceArray.size(); ++face) {
+        debugAssertM((faceArray[face]->width() == faceArray[0]->width()) && (faceArray[face]->height() == faceArray[0]->width()),
+            "Cube map faces must be square and of equal size");
+
+        Array<shared_ptr<Image4>> faceMipArray;
+        generateMipMaps(faceArray[face], faceMipArray, faceSpecification);
+
+        mipArray.resize(faceMipArray.size());
+        for (int level = 0; level < faceMipArray.size(); ++level) {
+            mipArray[level].append(faceMipArray[level]);
+        }
+    }
+}
+
+} // namespace G3D
@@ -13,7 +13,14 @@
 #include "G3D-base/Array.h"
 #include "G3D-base/fileutils.h"
 #include "G3D-base/FileSystem.h"
+#include "G3D-base/g3dmath.h"
 #include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #ifdef G3D_WINDOWS
 #   pragma warning(disable : 4091)
@@ -40,9 +47,395 @@ void logLazyPrintf(const char* fmt, ...) {
     va_end(arg_list);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+
+/** Variable-length message records in a power-of-two byte ring. The thread that
+    owns the ring is the only producer. Consumers are serialized by
+    Log::AsyncWriter::m_drainMutex, so a single acquire/release index pair
+    suffices and neither side ever takes a lock. */
+class LogRing {
+public:
+    struct Header {
+        /** Since the Log was created */
+        int64               nanoseconds;
+        uint32              length;
+        uint32              padding;
+    };
+
+    /** Read by the consumer when it interleaves messages from several rings */
+    class Record {
+    public:
+        int64               nanoseconds;
+        LogRing*            ring;
+        int                 offset;
+        int                 length;
+    };
+
+private:
+
+    /** Next byte the producer will write. Monotonically increasing; wrapped by m_mask. */
+    alignas(64) std::atomic<size_t> m_head;
+
+    /** Next byte the consumer will read. */
+    alignas(64) std::atomic<size_t> m_tail;
+
+    /** Producer's last observation of m_tail, kept on its own cache line so that
+        the common case of a ring with free space never touches m_tail. */
+    alignas(64) size_t              m_cachedTail;
+
+    const size_t                    m_capacity;
+    const size_t                    m_mask;
+    Array<uint8>                    m_data;
+
+    void copyIn(size_t pos, const void* src, size_t len) {
+        const size_t offset = pos & m_mask;
+        const size_t first = min(len, m_capacity - offset);
+        memcpy(m_data.getCArray() + offset, src, first);
+        memcpy(m_data.getCArray(), (const uint8*)src + first, len - first);
+    }
+
+    void copyOut(size_t pos, void* dst, size_t len) const {
+        const size_t offset = pos & m_mask;
+        const size_t first = min(len, m_capacity - offset);
+        memcpy(dst, m_data.getCArray() + offset, first);
+        memcpy((uint8*)dst + first, m_data.getCArray(), len - first);
+    }
+
+public:
+
+    const std::thread::id           threadID;
+
+    /** Small integer printed in decorated output */
+    const int                       threadIndex;
+
+    /** Set when the owning thread exits. The ring is released once it is empty. */
+    std::atomic<bool>               abandoned;
+
+    /** Consumer state for line decoration */
+    bool                            atLineStart;
+
+    LogRing(size_t capacity, int index) :
+        m_head(0), m_tail(0), m_cachedTail(0),
+        m_capacity(capacity), m_mask(capacity - 1),
+        threadID(std::this_thread::get_id()),
+        threadIndex(index),
+        abandoned(false),
+        atLineStart(true) {
+        debugAssert(isPow2(int(capacity)));
+        m_data.resize(capacity);
+    }
+
+    /** Largest payload that a single record can carry */
+    size_t maxPayload() const {
+        return m_capacity / 2 - sizeof(Header);
+    }
+
+    /** Called only by the owning thread. Returns false if there is not enough space. */
+    bool tryPush(int64 nanoseconds, const char* a, size_t aLen, const char* b, size_t bLen) {
+        const size_t need = sizeof(Header) + aLen + bLen;
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (m_capacity - (head - m_cachedTail) < need) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (m_capacity - (head - m_cachedTail) < need) {
+                return false;
+            }
+        }
+
+        const Header header = { nanoseconds, uint32(aLen + bLen), 0 };
+        copyIn(head, &header, sizeof(Header));
+        copyIn(head + sizeof(Header), a, aLen);
+        copyIn(head + sizeof(Header) + aLen, b, bLen);
+        m_head.store(head + need, std::memory_order_release);
+        return true;
+    }
+
+    /** Fraction of the ring in use, as seen by the producer */
+    bool moreThanHalfFull() const {
+        return (m_head.load(std::memory_order_relaxed) - m_cachedTail) > m_capacity / 2;
+    }
+
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_relaxed);
+    }
+
+    /** Consumer side. Appends all complete records to \a records, with their payload
+        bytes copied to the end of \a payload. */
+    void drain(Array<Record>& records, Array<char>& payload) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t head = m_head.load(std::memory_order_acquire);
+
+        while (tail != head) {
+            Header header;
+            copyOut(tail, &header, sizeof(Header));
+            tail += sizeof(Header);
+
+            Record& r = records.next();
+            r.nanoseconds = header.nanoseconds;
+            r.ring = this;
+            r.offset = payload.size();
+            r.length = int(header.length);
+
+            payload.resize(payload.size() + header.length, false);
+            copyOut(tail, payload.getCArray() + r.offset, header.length);
+            tail += header.length;
+        }
+
+        m_tail.store(tail, std::memory_order_release);
+    }
+};
+
+
+/** Per-thread pointer to the ring for the most recently used asynchronous Log. */
+class ThreadLogRing {
+public:
+    uint64                  writerID = 0;
+    shared_ptr<LogRing>     ring;
+
+    ~ThreadLogRing() {
+        if (notNull(ring)) {
+            ring->abandoned = true;
+        }
+    }
+};
+
+static thread_local ThreadLogRing t_logRing;
+
+
+class Log::AsyncWriter {
+private:
+
+    static std::atomic<uint64>      s_nextID;
+
+    /** Distinguishes writers in the thread-local cache even if an address is reused */
+    const uint64                    m_id;
+
+    Log*                            m_log;
+    const Settings                  m_settings;
+    const size_t                    m_ringCapacity;
+    const std::chrono::steady_clock::time_point m_startTime;
+
+    /** Protects m_ringArray and m_nextThreadIndex. Taken only when a thread logs
+        for the first time and by the consumer. */
+    std::mutex                      m_registryMutex;
+    Array<shared_ptr<LogRing>>      m_ringArray;
+    int                             m_nextThreadIndex;
+
+    /** Serializes consumers (the background thread and explicit flush() calls) */
+    std::mutex                      m_drainMutex;
+    Array<LogRing::Record>          m_recordArray;
+    Array<char>                     m_payload;
+    Array<char>                     m_output;
+    size_t                          m_droppedReported;
+
+    std::mutex                      m_wakeMutex;
+    std::condition_variable         m_wakeCondition;
+    std::condition_variable         m_spaceAvailableCondition;
+    bool                            m_wakeRequested;
+    bool                            m_stop;
+
+    std::atomic<size_t>             m_dropped;
+
+    std::thread                     m_thread;
+
+    LogRing* ringForCurrentThread() {
+        if (t_logRing.writerID == m_id) {
+            return t_logRing.ring.get();
+        }
+
+        shared_ptr<LogRing> ring;
+        {
+            std::lock_guard<std::mutex> lock(m_registryMutex);
+            const std::thread::id me = std::this_thread::get_id();
+            for (const shared_ptr<LogRing>& r : m_ringArray) {
+                if ((r->threadID == me) && ! r->abandoned) {
+                    ring = r;
+                    break;
+                }
+            }
+
+            if (isNull(ring)) {
+                ring = std::make_shared<LogRing>(m_ringCapacity, m_nextThreadIndex);
+                ++m_nextThreadIndex;
+                m_ringArray.append(ring);
+            }
+        }
+
+        t_logRing.writerID = m_id;
+        t_logRing.ring = ring;
+        return ring.get();
+    }
+
+    void requestWake() {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_wakeRequested = true;
+        }
+        m_wakeCondition.notify_one();
+    }
+
+    void appendOutput(const char* s, size_t len) {
+        const int old = m_output.size();
+        m_output.resize(old + len, false);
+        memcpy(m_output.getCArray() + old, s, len);
+    }
+
+    /** Copies the record into m_output, decorating the start of each line */
+    void formatRecord(const LogRing::Record& r) {
+        const char* s = m_payload.getCArray() + r.offset;
+        const char* end = s + r.length;
+        LogRing* ring = r.ring;
+
+        while (s < end) {
+            if (ring->atLineStart && m_settings.decorate) {
+                char prefix[64];
+                const int n = snprintf(prefix, sizeof(prefix), "[%11.6f T%-2d] ", double(r.nanoseconds) * 1e-9, ring->threadIndex);
+                appendOutput(prefix, size_t(n));
+            }
+
+            const char* newline = (const char*)memchr(s, '\n', end - s);
+            const char* stop = newline ? newline + 1 : end;
+            appendOutput(s, stop - s);
+            ring->atLineStart = notNull(newline);
+            s = stop;
+        }
+    }
+
+    void threadMain() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m_wakeMutex);
+                m_wakeCondition.wait_for(lock, std::chrono::milliseconds(m_settings.flushIntervalMilliseconds),
+                                         [this] { return m_wakeRequested || m_stop; });
+                m_wakeRequested = false;
+                if (m_stop) {
+                    return;
+                }
+            }
+            drain();
+        }
+    }
+
+public:
+
+    AsyncWriter(Log* log, const Settings& settings) :
+        m_id(++s_nextID),
+        m_log(log),
+        m_settings(settings),
+        m_ringCapacity(size_t(ceilPow2(int(max(settings.threadBufferBytes, size_t(1024)))))),
+        m_startTime(std::chrono::steady_clock::now()),
+        m_nextThreadIndex(0),
+        m_droppedReported(0),
+        m_wakeRequested(false),
+        m_stop(false),
+        m_dropped(0) {
+
+        m_thread = std::thread([this] { threadMain(); });
+    }
+
+    ~AsyncWriter() {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_stop = true;
+        }
+        m_wakeCondition.notify_one();
+        m_thread.join();
+        drain();
+    }
+
+    size_t droppedCount() const {
+        return m_dropped.load();
+    }
+
+    /** Called on the logging thread */
+    void submit(const char* a, size_t aLen, const char* b, size_t bLen) {
+        const int64 nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_startTime).count();
+        LogRing* ring = ringForCurrentThread();
+
+        if (aLen + bLen > ring->maxPayload()) {
+            // Split very long messages. Each piece is still ordered within this thread.
+            const size_t first = min(aLen, ring->maxPayload());
+            submit(a, first, nullptr, 0);
+            if (first < aLen) {
+                submit(a + first, aLen - first, b, bLen);
+            } else {
+                submit(b, bLen, nullptr, 0);
+            }
+            return;
+        }
+
+        while (! ring->tryPush(nanoseconds, a, aLen, b, bLen)) {
+            if (m_settings.dropWhenFull) {
+                ++m_dropped;
+                return;
+            }
+
+            // Block until the writer frees space
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wakeRequested = true;
+            m_wakeCondition.notify_one();
+            m_spaceAvailableCondition.wait_for(lock, std::chrono::milliseconds(1));
+        }
+
+        if (ring->moreThanHalfFull()) {
+            requestWake();
+        }
+    }
+
+    /** Writes every message that was submitted before this call. Safe from any thread. */
+    void drain() {
+        std::lock_guard<std::mutex> drainLock(m_drainMutex);
+
+        Array<shared_ptr<LogRing>> ringArray;
+        {
+            std::lock_guard<std::mutex> lock(m_registryMutex);
+            ringArray = m_ringArray;
+        }
+
+        m_recordArray.fastClear();
+        m_payload.fastClear();
+        for (const shared_ptr<LogRing>& ring : ringArray) {
+            ring->drain(m_recordArray, m_payload);
+        }
+        m_spaceAvailableCondition.notify_all();
+
+        const size_t dropped = m_dropped.load();
+        if ((m_recordArray.size() > 0) || (dropped != m_droppedReported)) {
+            // Interleave threads by time. Records from one thread are already in order.
+            std::stable_sort(m_recordArray.begin(), m_recordArray.end(),
+                             [](const LogRing::Record& a, const LogRing::Record& b) { return a.nanoseconds < b.nanoseconds; });
+
+            m_output.fastClear();
+            for (const LogRing::Record& r : m_recordArray) {
+                formatRecord(r);
+            }
+
+            if (dropped != m_droppedReported) {
+                const String& note = format("[Log dropped %d messages because a thread buffer was full]\n", int(dropped - m_droppedReported));
+                appendOutput(note.c_str(), note.size());
+                m_droppedReported = dropped;
+            }
+
+            m_log->writeToFile(m_output.getCArray(), m_output.size(), true);
+        }
+
+        // Release buffers of threads that have exited
+        std::lock_guard<std::mutex> lock(m_registryMutex);
+        for (int i = 0; i < m_ringArray.size(); ++i) {
+            if (m_ringArray[i]->abandoned && m_ringArray[i]->empty()) {
+                m_ringArray.fastRemove(i);
+                --i;
+            }
+        }
+    }
+};
+
+std::atomic<uint64> Log::AsyncWriter::s_nextID(0);
+
+//////////////////////////////////////////////////////////////////////////////
+
 Log* Log::commonLog = nullptr;
 
-Log::Log(const String& filename) {
+Log::Log(const String& filename, const Settings& settings) : m_settings(settings), m_asyncWriter(nullptr) {
     this->filename = filename;
 
     logFile = FileSystem::fopen(filename.c_str(), "w");
@@ -51,7 +444,7 @@ Log::Log(const String& filename) {
         String drive, base, ext;
         Array<String> path;
         parseFilename(filename, drive, path, base, ext);
-        String logName = base + ((ext != "") ? ("." + ext) : ""); 
+        String logName = base + ((ext != "") ? ("." + ext) : "");
 
         // Write time is greater than 1ms.  This may be a network drive.... try another file.
         #ifdef G3D_WINDOWS
@@ -72,6 +465,10 @@ Log::Log(const String& filename) {
     fprintf(logFile, "Start: %s\n", ctime(&t));
     fflush(logFile);
 
+    if (m_settings.asynchronous) {
+        m_asyncWriter = new AsyncWriter(this, m_settings);
+    }
+
     if (commonLog == nullptr) {
         commonLog = this;
     }
@@ -81,12 +478,16 @@ Log::Log(const String& filename) {
 Log::~Log() {
     section("Shutdown");
     println("Closing log file");
-    
+
     // Make sure we don't leave a dangling pointer
     if (Log::commonLog == this) {
         Log::commonLog = nullptr;
     }
 
+    // Stops the background thread after writing everything still queued
+    delete m_asyncWriter;
+    m_asyncWriter = nullptr;
+
     if (logFile) {
         FileSystem::fclose(logFile);
     }
@@ -98,6 +499,20 @@ FILE* Log::getFile() const {
 }
 
 
+void Log::flush() {
+    if (notNull(m_asyncWriter)) {
+        m_asyncWriter->drain();
+    } else if (logFile) {
+        fflush(logFile);
+    }
+}
+
+
+size_t Log::droppedMessageCount() const {
+    return notNull(m_asyncWriter) ? m_asyncWriter->droppedCount() : 0;
+}
+
+
 Log* Log::common() {
     if (commonLog == nullptr) {
         commonLog = new Log();
@@ -106,54 +521,102 @@ Log* Log::common() {
 }
 
 
-Log* Log::common(const String& filename) {
+Log* Log::common(const String& filename, const Settings& settings) {
     if (! commonLog || commonLog->filename != filename) {
         alwaysAssertM(isNull(commonLog), "Common log already exists");
-        commonLog = new Log(filename);
+        commonLog = new Log(filename, settings);
     }
     return commonLog;
 }
 
 
+void Log::flushCommon() {
+    if (notNull(commonLog)) {
+        commonLog->flush();
+    }
+}
+
+
 String Log::getCommonLogFilename() {
     return common()->filename;
 }
 
 
+void Log::writeToFile(const char* data, size_t len, bool flush) {
+    if (logFile) {
+        fwrite(data, 1, len, logFile);
+        if (flush) {
+            fflush(logFile);
+        }
+    }
+}
+
+
+void Log::write(const char* data, size_t len, const char* suffix, size_t suffixLen, bool flush) {
+    if (notNull(m_asyncWriter)) {
+        m_asyncWriter->submit(data, len, suffix, suffixLen);
+    } else {
+        writeToFile(data, len, flush && (suffixLen == 0));
+        if (suffixLen > 0) {
+            writeToFile(suffix, suffixLen, flush);
+        }
+    }
+}
+
+
 void Log::section(const String& s) {
-    fprintf(logFile, "_____________________________________________________\n");
-    fprintf(logFile, "\n    ###    %s    ###\n\n", s.c_str());
+    const String& text = "_____________________________________________________\n\n    ###    " + s + "    ###\n\n";
+    write(text.c_str(), text.size(), nullptr, 0, false);
 }
 
 
 void Log::printf(const char* fmt, ...) {
     va_list arg_list;
     va_start(arg_list, fmt);
-    print(vformat(fmt, arg_list));
+    vprintf(fmt, arg_list);
     va_end(arg_list);
 }
 
 
 void Log::vprintf(const char* fmt, va_list argPtr) {
-    vfprintf(logFile, fmt, argPtr);
-    fflush(logFile);
+    if (isNull(m_asyncWriter)) {
+        vfprintf(logFile, fmt, argPtr);
+        fflush(logFile);
+        return;
+    }
+
+    // Format on the stack for the common case of a short message
+    char buffer[1024];
+    va_list argCopy;
+    va_copy(argCopy, argPtr);
+    const int len = vsnprintf(buffer, sizeof(buffer), fmt, argPtr);
+    if ((len >= 0) && (len < int(sizeof(buffer)))) {
+        write(buffer, size_t(len), nullptr, 0, true);
+    } else {
+        const String& s = vformat(fmt, argCopy);
+        write(s.c_str(), s.size(), nullptr, 0, true);
+    }
+    va_end(argCopy);
 }
 
 
 void Log::lazyvprintf(const char* fmt, va_list argPtr) {
-    vfprintf(logFile, fmt, argPtr);
+    if (isNull(m_asyncWriter)) {
+        vfprintf(logFile, fmt, argPtr);
+    } else {
+        // Asynchronous writes are always lazy
+        vprintf(fmt, argPtr);
+    }
 }
 
 
 void Log::print(const String& s) {
-    fprintf(logFile, "%s", s.c_str());
-    fflush(logFile);
+    write(s.c_str(), s.size(), nullptr, 0, true);
 }
 
 
 void Log::println(const String& s) {
-    fprintf(logFile, "%s\n", s.c_str());
-    fflush(logFile);
+    write(s.c_str(), s.size(), "\n", 1, true);
 }
 
 }
@@ -0,0 +1,153 @@
+/**
+  \file G3D-base.lib/source/QuantizedPhysicsFrame.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-base/QuantizedPhysicsFrame.h"
+#include "G3D-base/BinaryOutput.h"
+#include "G3D-base/BinaryInput.h"
+
+namespace G3D {
+
+/** Translations are clamped to this many units so that the difference of two of them
+    has a zigzag encoding of at most 31 bits, which writeSignedBits can represent */
+static const int32 MAX_TRANSLATION = (1 << 29) - 1;
+
+/** Range of the three smallest components of a unit quaternion */
+static const float MAX_COMPONENT = 0.70710678f;
+
+QuantizedPhysicsFrame::QuantizedPhysicsFrame(const PhysicsFrame& frame, const Format& format) {
+    debugAssert((format.rotationBits > 0) && (format.rotationBits <= 10));
+
+    for (int a = 0; a < 3; ++a) {
+        translation[a] = iRound(clamp(double(frame.translation[a]) / format.translationPrecision, -double(MAX_TRANSLATION), double(MAX_TRANSLATION)));
+    }
+
+    Quat q = frame.rotation;
+    q.unitize();
+
+    // Drop the largest component. q and -q are the same rotation, so choose the sign
+    // that makes it positive and reconstruct it from the others.
+    int largest = 0;
+    for (int i = 1; i < 4; ++i) {
+        if (fabsf(q[i]) > fabsf(q[largest])) {
+            largest = i;
+        }
+    }
+    const float sign = (q[largest] < 0.0f) ? -1.0f : 1.0f;
+
+    const int maxValue = (1 << format.rotationBits) - 1;
+    rotation = uint32(largest) << 30;
+    for (int i = 0, j = 0; i < 4; ++i) {
+        if (i != largest) {
+            const float unit = (q[i] * sign / MAX_COMPONENT) * 0.5f + 0.5f;
+            const uint32 value = uint32(iClamp(iRound(unit * maxValue), 0, maxValue));
+            rotation |= value << (j * format.rotationBits);
+            ++j;
+        }
+    }
+}
+
+
+PhysicsFrame QuantizedPhysicsFrame::toPhysicsFrame(const Format& format) const {
+    PhysicsFrame frame;
+    for (int a = 0; a < 3; ++a) {
+        frame.translation[a] = float(double(translation[a]) * format.translationPrecision);
+    }
+
+    const int largest = int(rotation >> 30);
+    const uint32 mask = (1u << format.rotationBits) - 1;
+    const float maxValue = float(mask);
+    float sumSquares = 0.0f;
+    Quat& q = frame.rotation;
+    for (int i = 0, j = 0; i < 4; ++i) {
+        if (i != largest) {
+            const float unit = float((rotation >> (j * format.rotationBits)) & mask) / maxValue;
+            q[i] = (unit * 2.0f - 1.0f) * MAX_COMPONENT;
+            sumSquares += square(q[i]);
+            ++j;
+        }
+    }
+    q[largest] = sqrtf(max(0.0f, 1.0f - sumSquares));
+    q.unitize();
+
+    return frame;
+}
+
+
+void QuantizedPhysicsFrame::writeSignedBits(BinaryOutput& b, int32 value) {
+    const uint32 zigzag = (uint32(value) << 1) ^ uint32(value >> 31);
+    const int numBits = highestBit(zigzag) + 1;
+    debugAssertM(numBits < 32, "Value out of range");
+    b.writeBits(numBits, 5);
+    b.writeBits(zigzag, numBits);
+}
+
+
+int32 QuantizedPhysicsFrame::readSignedBits(BinaryInput& b) {
+    const int numBits = int(b.readBits(5));
+    const uint32 zigzag = b.readBits(numBits);
+    return int32(zigzag >> 1) ^ -int32(zigzag & 1);
+}
+
+
+void QuantizedPhysicsFrame::serializeBits(BinaryOutput& b, const Format& format) const {
+    for (int a = 0; a < 3; ++a) {
+        writeSignedBits(b, translation[a]);
+    }
+    b.writeBits(rotation >> 30, 2);
+    b.writeBits(rotation & 0x3FFFFFFF, 3 * format.rotationBits);
+}
+
+
+void QuantizedPhysicsFrame::deserializeBits(BinaryInput& b, const Format& format) {
+    for (int a = 0; a < 3; ++a) {
+        translation[a] = readSignedBits(b);
+    }
+    rotation = b.readBits(2) << 30;
+    rotation |= b.readBits(3 * format.rotationBits);
+}
+
+
+void QuantizedPhysicsFrame::serializeDeltaBits(const QuantizedPhysicsFrame& baseline, BinaryOutput& b, const Format& format) const {
+    // One bit per translation axis and one for the rotation, then the changed values
+    uint32 changed = 0;
+    for (int a = 0; a < 3; ++a) {
+        changed |= (translation[a] != baseline.translation[a]) ? (1 << a) : 0;
+    }
+    changed |= (rotation != baseline.rotation) ? 8 : 0;
+    b.writeBits(changed, 4);
+
+    for (int a = 0; a < 3; ++a) {
+        if ((changed & (1 << a)) != 0) {
+            writeSignedBits(b, translation[a] - baseline.translation[a]);
+        }
+    }
+
+    // The components of a rotation are not coherent across a change of the dropped
+    // component, so send the whole rotation
+    if ((changed & 8) != 0) {
+        b.writeBits(rotation >> 30, 2);
+        b.writeBits(rotation & 0x3FFFFFFF, 3 * format.rotationBits);
+    }
+}
+
+
+void QuantizedPhysicsFrame::deserializeDeltaBits(const QuantizedPhysicsFrame& baseline, BinaryInput& b, const Format& format) {
+    const uint32 changed = b.readBits(4);
+    for (int a = 0; a < 3; ++a) {
+        translation[a] = baseline.translation[a] + (((changed & (1 << a)) != 0) ? readSignedBits(b) : 0);
+    }
+
+    if ((changed & 8) != 0) {
+        rotation = b.readBits(2) << 30;
+        rotation |= b.readBits(3 * format.rotationBits);
+    } else {
+        rotation = baseline.rotation;
+    }
+}
+
+} // namespace G3D
@@ -45,6 +45,17 @@ bool TextInput::parseBoolean(const String& _string) {
 
 
 double TextInput::parseNumber(const String& s) {
+    {
+        // Fast path for ordinary decimal numbers, which may carry a C float suffix
+        const char* begin = s.c_str();
+        const char* end = begin + s.length();
+        double n;
+        const char* stop = parseDouble(begin, end, n);
+        if ((stop != begin) && ((stop == end) || ((stop + 1 == end) && ((*stop == 'f') || (*stop == 'F'))))) {
+            return n;
+        }
+    }
+
     if (s == "-1.#IND00" || s == "-1.#IND" || s == "nan" || s == "NaN" || s == "1.#QNAN") {
         return nan();
     }
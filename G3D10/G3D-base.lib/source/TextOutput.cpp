@@ -11,6 +11,7 @@
 #include "G3D-base/Log.h"
 #include "G3D-base/fileutils.h"
 #include "G3D-base/FileSystem.h"
+#include "G3D-base/stringutils.h"
 
 namespace G3D {
 
@@ -124,8 +125,21 @@ void TextOutput::writeBoolean(bool b) {
     this->printf("%s ", b ? option.trueSymbol.c_str() : option.falseSymbol.c_str());
 }
 
+/** Writes the shortest representation of \a n to \a buffer, at float precision
+    if that is exact. Returns the length. */
+static int formatNumber(double n, char* buffer) {
+    const float f = float(n);
+    return (double(f) == n) ? formatShortest(f, buffer) : formatShortest(n, buffer);
+}
+
+
 void TextOutput::writeNumber(double n) {
-    this->printf("%g ", n);
+    // Bypass printf: a number contains no newlines to convert
+    char buffer[SHORTEST_NUMBER_BUFFER_SIZE + 1];
+    int len = formatNumber(n, buffer);
+    buffer[len] = ' ';
+    ++len;
+    wordWrapIndentAppend(String(buffer, len));
 }
 
 
@@ -138,13 +152,16 @@ void TextOutput::writeCNumber(double n, bool space, bool minimal) {
     if (space) {
         writeNumber(n);
     } else {
-        this->printf("%g", n);
+        char buffer[SHORTEST_NUMBER_BUFFER_SIZE];
+        const int len = formatNumber(n, buffer);
+        wordWrapIndentAppend(String(buffer, len));
     }
 }
 
 
 void TextOutput::writeCNumber(float n, bool space, bool minimal) {
-    const String& s = format("%g", n);
+    char buffer[SHORTEST_NUMBER_BUFFER_SIZE];
+    const String s(buffer, formatShortest(n, buffer));
     if (s.find_first_of(".e") == String::npos) {
         if (minimal) {
             if (s == "-0") {
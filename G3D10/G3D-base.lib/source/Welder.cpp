@@ -10,77 +10,161 @@
 #include "G3D-base/platform.h"
 #include "G3D-base/Vector2.h"
 #include "G3D-base/Vector3.h"
+#include "G3D-base/Vector3int32.h"
 #include "G3D-base/Sphere.h"
-#include "G3D-base/PointHashGrid.h"
+#include "G3D-base/AABox.h"
 #include "G3D-base/Welder.h"
-#include "G3D-base/Stopwatch.h" // for profiling
-#include "G3D-base/AreaMemoryManager.h"
+#include "G3D-base/Thread.h"
 #include "G3D-base/Any.h"
 #include "G3D-base/stringutils.h"
 #include "G3D-base/BinaryInput.h"
 #include "G3D-base/BinaryOutput.h"
 
-namespace G3D { namespace _internal{
+namespace G3D { namespace _internal {
 
 // Uncomment to print information that can help with performance
 // profiling.
 //#define VERBOSE
 
-/** Used by WeldHelper2::smoothNormals. */
-class VN {
+/** A point index tagged with its grid cell. Sorts in the order that
+    PointHashGrid iterators visit points: cells in Z,Y,X-major order, and
+    points within a cell in insertion (index) order. */
+class CellIndex {
 public:
-    Vector3         vertex;
-    Vector3         normal;
+    Point3int32     cell;
+    int             index;
+
+    CellIndex() : index(0) {}
+    CellIndex(const Point3int32& c, int i) : cell(c), index(i) {}
 
-    VN() {}
-    VN(const Vector3& v, const Vector3& n) : vertex(v), normal(n) {}
+    bool operator<(const CellIndex& other) const {
+        if (cell.z != other.cell.z) { return cell.z < other.cell.z; }
+        if (cell.y != other.cell.y) { return cell.y < other.cell.y; }
+        if (cell.x != other.cell.x) { return cell.x < other.cell.x; }
+        return index < other.index;
+    }
+
+    /** Must match PointHashGrid::getCellCoord */
+    static void getCellCoord(const Point3& pos, float invCellWidth, Point3int32& cellCoord) {
+        for (int a = 0; a < 3; ++a) {
+            cellCoord[a] = iFloor(pos[a] * invCellWidth);
+        }
+    }
 };
 
-/** Used by WeldHelper::getIndex to maintain a list of vertices by location. */
-class VNTi {
-public:
-    Vector3         vertex;
-    Vector3         normal;
-    Vector2         texCoord;
-    int             index;
 
-    VNTi() : index(0) {}
+/**
+ A spatial hash over a fixed array of points, built by sorting the points by
+ bucket rather than by inserting them into a hash table, so that
+ construction is parallel, queries are read-only, and each cell lookup is
+ a single array access.
+ */
+class SortedPointGrid {
+private:
+
+    class Entry {
+    public:
+        Point3          position;
+        Point3int32     cell;
+        int             index;
+    };
 
-    VNTi(const Vector3& v, const Vector3& n, const Vector2& t, int i) : 
-        vertex(v), normal(n), texCoord(t), index(i) {}
-};
+    float                   m_invCellWidth;
+    uint32                  m_bucketMask;
 
+    /** Sorted by bucket and then by index */
+    Array<Entry>            m_entry;
 
-}} // G3D
+    /** m_bucketStart[b] is the first element of m_entry in bucket b. Has one extra
+        element at the end. */
+    Array<int>              m_bucketStart;
 
-template <> struct HashTrait <G3D::_internal::VN> {
-    static size_t hashCode(const G3D::_internal::VN& k) { return static_cast<size_t>(k.vertex.hashCode()); }
-};
-template <> struct HashTrait <G3D::_internal::VNTi> {
-    static size_t hashCode(const G3D::_internal::VNTi& k) { return static_cast<size_t>(k.vertex.hashCode()); }
-};
+    uint32 bucket(const Point3int32& cell) const {
+        return ((uint32(cell.x) * 73856093u) ^ (uint32(cell.y) * 19349663u) ^ (uint32(cell.z) * 83492791u)) & m_bucketMask;
+    }
 
+public:
 
-template<> struct EqualsTrait <G3D::_internal::VN> {
-    static bool equals(const G3D::_internal::VN& a, const G3D::_internal::VN& b) { return a.vertex == b.vertex; }
-};
-template<> struct EqualsTrait <G3D::_internal::VNTi> {
-    static bool equals(const G3D::_internal::VNTi& a, const G3D::_internal::VNTi& b) { return a.vertex == b.vertex; }
-};
+    SortedPointGrid(const Array<Point3>& point, float cellWidth) : m_invCellWidth(1.0f / cellWidth) {
+        const int numBuckets = ceilPow2(uint32(max(point.size(), 1)));
+        m_bucketMask = uint32(numBuckets - 1);
+
+        Array<uint64> key;
+        key.resize(point.size());
+        runConcurrently(0, point.size(), [&](int i) {
+            Point3int32 cell;
+            CellIndex::getCellCoord(point[i], m_invCellWidth, cell);
+            key[i] = (uint64(bucket(cell)) << 32) | uint64(i);
+        });
+        tbb::parallel_sort(key.begin(), key.end());
+
+        m_entry.resize(point.size());
+        runConcurrently(0, point.size(), [&](int k) {
+            Entry& entry = m_entry[k];
+            entry.index = int(key[k] & 0xFFFFFFFF);
+            entry.position = point[entry.index];
+            CellIndex::getCellCoord(entry.position, m_invCellWidth, entry.cell);
+        });
+
+        m_bucketStart.resize(numBuckets + 1);
+        int k = 0;
+        for (int b = 0; b <= numBuckets; ++b) {
+            while ((k < key.size()) && (int(key[k] >> 32) < b)) {
+                ++k;
+            }
+            m_bucketStart[b] = k;
+        }
+    }
 
-template<> struct PositionTrait<G3D::_internal::VN> {
-    static void getPosition(const G3D::_internal::VN& v, G3D::Vector3& p) { p = v.vertex; }
+    /** Calls visit(i) for each point i < \a stopBefore within \a sphere, in no
+        particular order. Thread-safe. */
+    template<class Visit>
+    void forEachInSphere(const Sphere& sphere, int stopBefore, Visit visit) const {
+        AABox box;
+        sphere.getBounds(box);
+        Point3int32 lo, hi;
+        CellIndex::getCellCoord(box.low(), m_invCellWidth, lo);
+        CellIndex::getCellCoord(box.high(), m_invCellWidth, hi);
+
+        Point3int32 c;
+        for (c.z = lo.z; c.z <= hi.z; ++c.z) {
+            for (c.y = lo.y; c.y <= hi.y; ++c.y) {
+                for (c.x = lo.x; c.x <= hi.x; ++c.x) {
+                    const uint32 b = bucket(c);
+                    for (int k = m_bucketStart[b]; k < m_bucketStart[b + 1]; ++k) {
+                        const Entry& entry = m_entry[k];
+                        if (entry.index >= stopBefore) {
+                            // The rest of the bucket has larger indices
+                            break;
+                        } else if ((entry.cell == c) && sphere.contains(entry.position)) {
+                            visit(entry.index);
+                        }
+                    }
+                }
+            }
+        }
+    }
 };
-template<> struct PositionTrait<G3D::_internal::VNTi> {
-    static void getPosition(const G3D::_internal::VNTi& v, G3D::Vector3& p) { p = v.vertex; }
+
+
+/** A point index sorted by the hash code of its position, to group identical
+    positions the way that Table<Point3, ...> does. */
+class HashedIndex {
+public:
+    size_t          hashCode;
+    int             index;
+
+    bool operator<(const HashedIndex& other) const {
+        return (hashCode < other.hashCode) || ((hashCode == other.hashCode) && (index < other.index));
+    }
 };
 
-namespace G3D { namespace _internal {
 
 class WeldHelper {
 private:
-    /** Used by getIndex and updateTriLists. Deallocating this is slow. */
-    PointHashGrid<VNTi>     weldGrid;
+
+    /** Number of vertices per task */
+    static const int        BLOCK_SIZE = 2048;
 
     Array<Vector3>*         outputVertexArray;
     Array<Vector3>*         outputNormalArray;
@@ -93,51 +177,46 @@ private:
 
     float                   normalSmoothingAngle;
 
-    /**
-     Returns the index of the vertex in 
-     outputVertexArray/outputNormalArray/outputTexCoordArray
-     that is within the global tolerances of v,n,t. If there 
-     is no such vertex, adds it to the arrays and returns that index.
-
-     Called from updateTriLists().
-     */
-    int getIndex(const Vector3& v, const Vector3& n, const Vector2& t) {
-        PointHashGrid<VNTi>::SphereIterator it = 
-                weldGrid.begin(Sphere(v, vertexWeldRadius));
-
-        if (n.isZero()) {
-            // Don't bother trying to match the surface normal, since this vertex has no surface normal.
-            while (it.isValid()) {
-                if ((t - it->texCoord).squaredLength() <= texCoordWeldRadius2) {
-                    // This is the vertex
-                    return it->index;
-                }
-                ++it;
-            }
-        } else {
-            while (it.isValid()) {
-                if (((n - it->normal).squaredLength() <= normalWeldRadius2) &&
-                    ((t - it->texCoord).squaredLength() <= texCoordWeldRadius2)) {
-                    // This is the vertex
-                    return it->index;
-                }
-                ++it;
-            }
-        }
+    /** True if unrolled vertex \a w can be welded to unrolled vertex \a u,
+        given that they are within the vertexWeldRadius. */
+    bool canWeld(int u, int w, const Array<Vector3>& normalArray, const Array<Vector2>& texCoordArray) const {
+        const Vector3& n = normalArray[u];
+        const Vector2& t = texCoordArray[u];
 
-        // Note that a sliver triangle processed before its neighbors may reach here
-        // with a zero length normal.
+        // Don't bother trying to match the surface normal if this vertex has no surface normal.
+        return (n.isZero() || ((n - normalArray[w]).squaredLength() <= normalWeldRadius2)) &&
+            ((t - texCoordArray[w]).squaredLength() <= texCoordWeldRadius2);
+    }
 
-        // The vertex does not exist. Create it.
-        const int i = outputVertexArray->size();
-        outputVertexArray->append(v);
-        outputNormalArray->append(n);
-        outputTexCoordArray->append(t);
 
-        // Store in the grid so that it will be remembered.
-        weldGrid.insert(VNTi(v, n, t, i));
+    /**
+     Sets \a neighbor to the vertices w < \a stopBefore within vertexWeldRadius
+     of vertex \a u for which accept(w) is true, sorted into the order in which a
+     PointHashGrid with cell width 1 / \a invOrderCellWidth would visit them.
 
-        return i;
+     The original sequential implementation searched such grids, so that order
+     determines both the floating-point summation order of smoothed normals and
+     which candidate a vertex is welded to.
+     */
+    template<class Accept>
+    void findNeighbors
+    (const SortedPointGrid&     grid,
+     const Array<Point3>&       vertexArray,
+     int                        u,
+     int                        stopBefore,
+     float                      invOrderCellWidth,
+     Accept                     accept,
+     Array<CellIndex>&          neighbor) const {
+
+        neighbor.fastClear();
+        grid.forEachInSphere(Sphere(vertexArray[u], vertexWeldRadius), stopBefore, [&](int w) {
+            if (accept(w)) {
+                CellIndex& c = neighbor.next();
+                CellIndex::getCellCoord(vertexArray[w], invOrderCellWidth, c.cell);
+                c.index = w;
+            }
+        });
+        std::sort(neighbor.begin(), neighbor.end());
     }
 
 
@@ -145,10 +224,18 @@ private:
      Updates each indexArray to refer to vertices in the
      outputVertexArray.
 
+     Each vertex u welds to the first earlier output vertex (in grid
+     order) within the global tolerances of its position, normal, and
+     texCoord, or else becomes a new output vertex. Finding the
+     candidates is the expensive part and runs in parallel; choosing
+     among them is sequential, since it depends on which earlier
+     vertices became output vertices.
+
      Called from process()
      */
     void updateTriLists
     (Array<Array<int>*>&         indexArrayArray, 
+     const SortedPointGrid&      grid,
      const Array<Vector3>&       vertexArray,
      const Array<Vector3>&       normalArray,
      const Array<Vector2>&       texCoordArray) {
@@ -156,11 +243,39 @@ private:
 #       ifdef VERBOSE
             debugPrintf("WeldHelper::updateTriLists\n");
 #       endif
-          
-        // Compute a hash grid so that we can find neighbors quickly.
-        // It begins empty and is extended as the tri lists are iterated
-        // through.
-        weldGrid.clear();
+
+        const int numVertices = vertexArray.size();
+
+        // The sequential implementation searched a PointHashGrid with this cell width
+        const float invWeldCellWidth = 1.0f / max(vertexWeldRadius, 0.1f);
+
+        // Candidate welds for each vertex, in grid order. candidateEnd[u] is the
+        // end of u's candidates within the array for its block.
+        const int numBlocks = (numVertices + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        Array<Array<int>> blockCandidateArray;
+        blockCandidateArray.resize(numBlocks);
+        Array<int> candidateEnd;
+        candidateEnd.resize(numVertices);
+
+        runConcurrently(0, numBlocks, [&](int b) {
+            Array<int>& candidate = blockCandidateArray[b];
+            Array<CellIndex> neighbor;
+            const int stop = min(numVertices, (b + 1) * BLOCK_SIZE);
+            for (int u = b * BLOCK_SIZE; u < stop; ++u) {
+                findNeighbors(grid, vertexArray, u, u, invWeldCellWidth, [&](int w) {
+                    return canWeld(u, w, normalArray, texCoordArray);
+                }, neighbor);
+
+                for (const CellIndex& c : neighbor) {
+                    candidate.append(c.index);
+                }
+                candidateEnd[u] = candidate.size();
+            }
+        });
+
+        // Index of each vertex in the output arrays, or -1 if it was welded to another
+        Array<int> outputIndex;
+        outputIndex.resize(numVertices);
 
         // Process all triLists
         int numTriLists = indexArrayArray.size();
@@ -171,18 +286,29 @@ private:
 
                 // For all vertices in this list
                 for (int v = 0; v < triList.size(); ++v) {
-                    // This vertex mapped to u in the flatVertexArray
-                    triList[v] = getIndex(vertexArray[u], normalArray[u], texCoordArray[u]);
+                    const Array<int>& candidate = blockCandidateArray[u / BLOCK_SIZE];
+                    const int start = (u % BLOCK_SIZE == 0) ? 0 : candidateEnd[u - 1];
 
-                    /*
-    #           ifdef G3D_DEBUG
-                {
-                    int i = triList[v];
-                    Vector3 N = normalArray[i];
-                    debugAssertM(N.length() > 0.9f, "Produced non-unit normal");
-                }
-    #           endif
-                */
+                    int index = -1;
+                    for (int c = start; (c < candidateEnd[u]) && (index == -1); ++c) {
+                        index = outputIndex[candidate[c]];
+                    }
+
+                    if (index == -1) {
+                        // Note that a sliver triangle processed before its neighbors may reach here
+                        // with a zero length normal.
+
+                        // The vertex does not exist. Create it.
+                        index = outputVertexArray->size();
+                        outputVertexArray->append(vertexArray[u]);
+                        outputNormalArray->append(normalArray[u]);
+                        outputTexCoordArray->append(texCoordArray[u]);
+                        outputIndex[u] = index;
+                    } else {
+                        outputIndex[u] = -1;
+                    }
+
+                    triList[v] = index;
                     ++u;
                 }
             }
@@ -229,7 +355,9 @@ private:
         debugAssertM(vertexArray.size() % 3 == 0, "Input is not a triangle soup");
         debugAssertM(faceNormalArray.size() == 0, "Output must start empty.");
 
-        for (int v = 0; v < vertexArray.size(); v += 3) {
+        faceNormalArray.resize(vertexArray.size());
+        runConcurrently(0, vertexArray.size() / 3, [&](int f) {
+            const int v = 3 * f;
             const Vector3& e0 = vertexArray[v + 1] - vertexArray[v];
             const Vector3& e1 = vertexArray[v + 2] - vertexArray[v];
 
@@ -238,17 +366,40 @@ private:
             // multiplying very small edges
             const Vector3& n  = (e0.cross(e1 * 256.0f)).directionOrZero();
 
-            // Append the normal once per vertex.
-            faceNormalArray.append(n, n, n);
+            // Store the normal once per vertex.
+            faceNormalArray[v] = faceNormalArray[v + 1] = faceNormalArray[v + 2] = n;
+        });
+    }
+
+    /** Returns the direction of \a sum, unless that is indeterminate or
+        would make the normal point away from \a original. */
+    static Vector3 smoothedNormal(const Vector3& original, const Vector3& sum) {
+        const Vector3& average = sum.directionOrZero();
+
+        const bool indeterminate = average.isZero();
+        // Never "smooth" a normal so far that it points backwards
+        const bool backFacing    = original.dot(average) < 0;
+                
+        if (indeterminate || backFacing) {
+            // Revert to the face normal
+            return original;
+        } else {
+            // Average available normals
+            return average;
         }
     }
 
     /**
      Computes @a smoothNormalArray, whose elements are those of normalArray averaged
      with neighbors within the angular cutoff.
+
+     Each vertex is independent, so this runs in parallel. Neighbors are summed
+     in the same order as the sequential implementation, so the results are
+     bit-identical.
      */
     void smoothNormals
-    (const Array<Point3>& vertexArray, 
+    (const SortedPointGrid& grid,
+     const Array<Point3>& vertexArray, 
      const Array<Vector3>& normalArray, 
      Array<Vector3>&       smoothNormalArray) {
         if (normalSmoothingAngle <= 0) {
@@ -260,9 +411,6 @@ private:
             debugPrintf("WeldHelper::smoothNormals\n");
 #       endif
 
-        // Create an area memory manager for fast deallocation
-        shared_ptr<MemoryManager> mm = AreaMemoryManager::create(iRound(sizeof(VN) * normalArray.size() * 1.5));
-
         const float cosThresholdAngle = (float)cos(normalSmoothingAngle);
 
         debugAssert(vertexArray.size() == normalArray.size());
@@ -274,48 +422,46 @@ private:
                 debugPrintf("Taking fast path\n");
 #           endif
 
-            // Maximum expected faces that meet at a vertex
-            static const int k = 8;
-
-            // Maps vertices to the indices of normals at that vertex
-            Table<Point3, SmallArray<Vector3, k> > normalTable;
-            for (int v = 0; v < vertexArray.size(); ++v) {
-                bool ignore = false;
-                SmallArray<Vector3, k>& list = normalTable.getCreate(vertexArray[v], ignore);
-                list.append(normalArray[v]);
+            // Group vertices at identical positions by sorting on the hash code.
+            // Within each group the vertices remain in index order.
+            Array<HashedIndex> order;
+            order.resize(vertexArray.size());
+            runConcurrently(0, vertexArray.size(), [&](int v) {
+                order[v].hashCode = HashTrait<Point3>::hashCode(vertexArray[v]);
+                order[v].index = v;
+            });
+            tbb::parallel_sort(order.begin(), order.end());
+
+            Array<int> runStart;
+            for (int i = 0; i < order.size(); ++i) {
+                if ((i == 0) || (order[i].hashCode != order[i - 1].hashCode)) {
+                    runStart.append(i);
+                }
             }
-
-            for (int v = 0; v < vertexArray.size(); ++v) {
-                Vector3 sum;
-
-                const Vector3& original = normalArray[v];
-
-                const SmallArray<Vector3, k>& list = normalTable[vertexArray[v]];
-
-                for (int i = 0; i < list.size(); ++i) {
-                    const Vector3& N = list[i];
-                    const float cosAngle = N.dot(original);
-
-                    if (cosAngle > cosThresholdAngle) {
-                        // This normal is close enough to consider.  Avoid underflow by scaling up
-                        sum += (N * 256.0f);
+            runStart.append(order.size());
+
+            runConcurrently(0, runStart.size() - 1, [&](int r) {
+                for (int i = runStart[r]; i < runStart[r + 1]; ++i) {
+                    const int v = order[i].index;
+                    const Vector3& original = normalArray[v];
+
+                    Vector3 sum;
+                    for (int j = runStart[r]; j < runStart[r + 1]; ++j) {
+                        const int w = order[j].index;
+                        if (vertexArray[w] == vertexArray[v]) {
+                            const Vector3& N = normalArray[w];
+                            const float cosAngle = N.dot(original);
+
+                            if (cosAngle > cosThresholdAngle) {
+                                // This normal is close enough to consider.  Avoid underflow by scaling up
+                                sum += (N * 256.0f);
+                            }
+                        }
                     }
-                }
 
-                const Vector3& average = sum.directionOrZero();
-
-                const bool indeterminate = average.isZero();
-                // Never "smooth" a normal so far that it points backwards
-                const bool backFacing    = original.dot(average) < 0;
-                
-                if (indeterminate || backFacing) {
-                    // Revert to the face normal
-                    smoothNormalArray[v] = original;
-                } else {
-                    // Average available normals
-                    smoothNormalArray[v] = average;
+                    smoothNormalArray[v] = smoothedNormal(original, sum);
                 }
-            }
+            });
 
         } else {
             // Non-zero vertex normal welding
@@ -324,49 +470,34 @@ private:
                             vertexWeldRadius);
 #           endif
 
-            // Compute a hash grid so that we can find neighbors quickly.
             alwaysAssertM(vertexWeldRadius > 0, "Cannot smooth with zero vertex weld radius");
-            PointHashGrid<VN> grid(vertexWeldRadius, mm);
-            for (int v = 0; v < normalArray.size(); ++v) {
-                grid.insert(VN(vertexArray[v], normalArray[v]));
-            }
-            
-            // OPT: this step could be done on multiple threads
-            for (int v = 0; v < normalArray.size(); ++v) {            
-                // Compute the sum of all nearby normals within the cutoff angle.
-                // Search within the vertexWeldRadius, since those are the vertices
-                // that will collapse to the same point.
-                PointHashGrid<VN>::SphereIterator it = 
-                    grid.begin(Sphere(vertexArray[v], vertexWeldRadius));
-                
-                Vector3 sum;
-                
-                const Vector3& original = normalArray[v];
-                while (it.isValid()) {
-                    const Vector3& N = it->normal;
-                    const float cosAngle = N.dot(original);
-                    
-                    if (cosAngle > cosThresholdAngle) {
-                        // This normal is close enough to consider.  Avoid underflow by scaling up
-                        sum += (N * 256.0f);
+
+            // The sequential implementation summed in the order of a PointHashGrid with this cell width
+            const float invSmoothCellWidth = 1.0f / vertexWeldRadius;
+
+            const int numVertices = normalArray.size();
+            runConcurrently(0, (numVertices + BLOCK_SIZE - 1) / BLOCK_SIZE, [&](int b) {
+                Array<CellIndex> neighbor;
+                const int stop = min(numVertices, (b + 1) * BLOCK_SIZE);
+                for (int v = b * BLOCK_SIZE; v < stop; ++v) {
+                    // Compute the sum of all nearby normals within the cutoff angle.
+                    // Search within the vertexWeldRadius, since those are the vertices
+                    // that will collapse to the same point.
+                    const Vector3& original = normalArray[v];
+                    findNeighbors(grid, vertexArray, v, numVertices, invSmoothCellWidth, [&](int w) {
+                        // This normal is close enough to consider
+                        return normalArray[w].dot(original) > cosThresholdAngle;
+                    }, neighbor);
+
+                    Vector3 sum;
+                    for (const CellIndex& c : neighbor) {
+                        // Avoid underflow by scaling up
+                        sum += (normalArray[c.index] * 256.0f);
                     }
-                    ++it;
-                }
-                
-                const Vector3& average = sum.directionOrZero();
-                
-                const bool indeterminate = average.isZero();
-                // Never "smooth" a normal so far that it points backwards
-                const bool backFacing    = original.dot(average) < 0;
                 
-                if (indeterminate || backFacing) {
-                    // Revert to the face normal
-                    smoothNormalArray[v] = original;
-                } else {
-                    // Average available normals
-                    smoothNormalArray[v] = average;
+                    smoothNormalArray[v] = smoothedNormal(original, sum);
                 }
-            }
+            });
         }
     }
 
@@ -409,7 +540,6 @@ public:
                 "Input arrays are not parallel.");
         }
 
-        // Create an area memory manager for fast deallocation
         Array<Vector3> unrolledVertexArray;
         Array<Vector3> unrolledFaceNormalArray;
         Array<Vector3> unrolledSmoothNormalArray;
@@ -441,14 +571,18 @@ public:
         // each vertex. The output array has the same length as the input.
         computeFaceNormals(unrolledVertexArray, unrolledFaceNormalArray);
 
+        // Both neighbor searches use vertexWeldRadius. With cells several times
+        // larger, most searches touch only one or two cells.
+        const SortedPointGrid grid(unrolledVertexArray, max(8.0f * vertexWeldRadius, 0.001f));
+
         // Compute smooth normals at vertices.
         if (unrolledFaceNormalArray.size() > 0) {
-            smoothNormals(unrolledVertexArray, unrolledFaceNormalArray, unrolledSmoothNormalArray);
+            smoothNormals(grid, unrolledVertexArray, unrolledFaceNormalArray, unrolledSmoothNormalArray);
             unrolledFaceNormalArray.clear();
         }
 
         // Regenerate the triangle lists
-        updateTriLists(indexArrayArray, unrolledVertexArray, unrolledSmoothNormalArray, unrolledTexCoordArray);
+        updateTriLists(indexArrayArray, grid, unrolledVertexArray, unrolledSmoothNormalArray, unrolledTexCoordArray);
 
         if (! hasTexCoords) {
             // Throw away the generated texCoords
@@ -457,7 +591,6 @@ public:
     }
 
     WeldHelper(float vertRadius) :
-        weldGrid(max(vertRadius, 0.1f), AreaMemoryManager::create()),
         vertexWeldRadius(vertRadius) {
     }
 
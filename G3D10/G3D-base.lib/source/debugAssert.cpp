@@ -152,6 +152,8 @@ bool _handleDebugAssert_(
 
     // Log the error
     Log::common()->print(String("\n**************************\n\n") + dialogTitle + "\n" + dialogText);
+    // The program may be about to terminate
+    Log::common()->flush();
 
     const int result = G3D::prompt(dialogTitle.c_str(), dialogText.c_str(), (const char**)choices, 3, useGuiPrompt);
 
@@ -196,6 +198,8 @@ bool _handleErrorCheck_(
 
     // Log the error
     Log::common()->print(String("\n**************************\n\n") + dialogTitle + "\n" + dialogText);
+    // The program may be about to terminate
+    Log::common()->flush();
     #ifdef G3D_WINDOWS
         DWORD lastErr = GetLastError();
         (void)lastErr;
@@ -355,14 +359,12 @@ String debugPrintf(const char* fmt ...) {
 }
 
 String consolePrint(const String& s) {
-    FILE* L = Log::common()->getFile();
-    fprintf(L, "%s", s.c_str());
+    Log::common()->print(s);
 
     if (consolePrintHook()) {
         consolePrintHook()(s);
     }
 
-    fflush(L);
     return s;
 }
 
@@ -25,6 +25,7 @@ namespace _internal {
 }
 
 static void G3DCleanupHook() {
+    Log::flushCommon();
     _internal::cleanupNetwork();
     System::cleanup();
 }
@@ -34,7 +35,9 @@ void initG3D(const G3DSpecification& spec) {
     
     if (! initialized) {
         initialized = true;
-        Log::common(spec.logFilename);
+        Log::Settings logSettings;
+        logSettings.asynchronous = spec.asynchronousLog;
+        Log::common(spec.logFilename, logSettings);
         _internal::g3dInitializationSpecification() = spec;
         atexit(&G3DCleanupHook);
         
@@ -10,6 +10,7 @@
 #include "G3D-base/network.h"
 #include "G3D-base/units.h"
 #include "G3D-base/ThreadsafeQueue.h"
+#include "G3D-base/SmallArray.h"
 #include <mutex>
 #include <thread>
 #ifdef G3D_OSX
@@ -81,22 +82,38 @@ static std::atomic_int  s_backlog;
 static std::mutex                   s_allServerAndClientConnectionMutex;
 static Array< weak_ptr<NetServer> > s_allServers;
 
+/** Sockets of the hosts of s_allServers and s_allClientConnections as of the last
+    serviceNetwork(). Protected by s_allServerAndClientConnectionMutex. */
+static Array<ENetSocket>            s_hostSocketArray;
+
 /** Protects enet calls from crashing when called in parallel */
 static  std::mutex                  s_enet_command_ThreadMutex;
 
-typedef Table<NetChannel, shared_ptr<ThreadsafeQueue<_internal::NetMessage>>> ChannelSendQueueTable;
-static ChannelSendQueueTable m_sendQueueTable;
+/** Protects s_outgoingMessageArray. Held while the messages are handed to enet,
+    so that a connection can discard its messages before destroying its host. */
+static std::mutex                   s_outgoingMessageMutex;
 
-typedef Table<NetChannel, shared_ptr<std::thread>> ChannelSenderThreadTable;
-static ChannelSenderThreadTable m_senderThreadsTable;
+/** Messages submitted by NetSendConnection::send and not yet handed to enet, in submission order */
+static Array<_internal::NetMessage> s_outgoingMessageArray;
 
 static std::mutex s_networkThreadMutex;
 static std::thread s_networkThread;
 static std::atomic_bool s_shutdownNetworkThread(false);
 
-static std::mutex s_networkSenderThreadMutex;
-static std::thread s_networkSenderThread;
-static std::atomic_bool s_shutdownNetworkSenderThread(false);
+/** Loopback datagram socket on which the network thread waits alongside the enet
+    host sockets, so that submitted messages and new hosts wake it immediately. */
+static ENetSocket       s_wakeSocket = ENET_SOCKET_NULL;
+static _ENetAddress     s_wakeAddress;
+
+/** True if a wake datagram is in flight, so that a burst of sends wakes the network thread once */
+static std::atomic_bool s_wakePending(false);
+
+/** Longest time that the network thread blocks while any host exists. This bounds
+    the delay of enet's timer-driven work: retransmission, pings, and timeouts. */
+static const uint32 MAX_HOST_WAIT_MILLISECONDS = 10;
+
+/** Longest time that the network thread blocks while no host exists */
+static const uint32 MAX_IDLE_WAIT_MILLISECONDS = 1000;
 
 
 namespace _internal {
@@ -302,7 +319,7 @@ protected:
     void onDisconnect()
     {
         NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "NetClientSideConnection::onDisconnect()");
-        shutdownSenderThreads(); // stop all sender threads
+        discardQueuedMessages();
 
         if (m_status != DISCONNECTED)
         {
@@ -438,8 +455,8 @@ protected:
 
         NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "NetServerSideConnection::onDisconnect()");
 
-        // stop per-channel sender threads
-        shutdownSenderThreads();
+        // Drop messages that can no longer be delivered
+        discardQueuedMessages();
 
         // The caller has dropped all pointers to the 
         // server, thus closing the connection.
@@ -478,16 +495,19 @@ static int32 backlogForHost(ENetHost* host) {
 void serviceNetwork() {
     // Process the G3D send queue first, filling the enet communication queues in a
     // threadsafe fashion. This way, servicing the host below can empty these queues.
+    serviceNetworkSender();
 
     int32 b = 0;
 
     // Service all server enet hosts (and flush those that are gone)
     s_allServerAndClientConnectionMutex.lock(); // protect from adding a host while the following code is executed
+    s_hostSocketArray.fastClear();
 
     for (int i = 0; i < s_allServers.length(); ++i) {
         const shared_ptr<NetServer> &s = s_allServers[i].lock();
         if (notNull(s) && notNull(s->m_enetHost)) {
             b += backlogForHost(s->m_enetHost);
+            s_hostSocketArray.append(s->m_enetHost->socket);
             s->serviceHost();
         } else
         {
@@ -503,6 +523,7 @@ void serviceNetwork() {
         const shared_ptr<_internal::NetClientSideConnection> &c = s_allClientConnections[i].lock();
         if (notNull(c) && notNull(c->m_enetHost)) {
             b += backlogForHost(c->m_enetHost);
+            s_hostSocketArray.append(c->m_enetHost->socket);
             c->serviceHost();
         } else
         {
@@ -519,54 +540,101 @@ void serviceNetwork() {
     s_backlog = b;
 }
 
-void serviceNetworkSender(const G3D::NetChannel &channel)
-{
-    // check if queue exists for this channel
-    if (m_sendQueueTable.containsKey(channel))
-    {
-        const shared_ptr<ThreadsafeQueue<_internal::NetMessage>> &queue = m_sendQueueTable.get(channel); // get queue
-        _internal::NetMessage message; // new message
-        
-        // empty single message at a time from queue
-        while (queue->popFront(message))
-        {
-            // make sure host does exist
-            //debugAssert(notNull(message.enetHost)); // if (host disappears?)
-            if (!message.enetHost)
-            {
-                queue->clear();
-                NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "WARNING message.enetHost is null ! queue for channel %d cleared", (int)channel);
-                break;
-            }
+void serviceNetworkSender() {
+    std::lock_guard<std::mutex> guard(s_outgoingMessageMutex);
+    if (s_outgoingMessageArray.size() == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> enetGuard(s_enet_command_ThreadMutex);
+
+    // Queue every message with enet before flushing, so that messages to the same
+    // peer are coalesced into as few datagrams as enet's MTU allows
+    SmallArray<ENetHost*, 8> hostArray;
+    for (_internal::NetMessage& message : s_outgoingMessageArray) {
+        if (isNull(message.enetPeer)) {
+            // Must be a NetSendConnection broadcast message
+            enet_host_broadcast(message.enetHost, message.channel, message.header);
+            enet_host_broadcast(message.enetHost, message.channel, message.packet);
+        } else if (message.enetPeer->state != ENET_PEER_STATE_CONNECTED) {
+            // The peer disconnected after this was submitted. enet did not take
+            // ownership of the packets.
+            message.destroy();
+            continue;
+        } else {
+            enet_peer_send(message.enetPeer, message.channel, message.header);
+            enet_peer_send(message.enetPeer, message.channel, message.packet);
+        }
 
-            // debug output
-            NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "sending message on channel %d in thread", channel);
+        if (! hostArray.contains(message.enetHost)) {
+            hostArray.push(message.enetHost);
+        }
+    }
+    s_outgoingMessageArray.fastClear();
 
-            s_enet_command_ThreadMutex.lock(); // lock mutex for enet commands
+    for (int h = 0; h < hostArray.size(); ++h) {
+        enet_host_flush(hostArray[h]);
+    }
+}
 
-            if (isNull(message.enetPeer))
-            {
-                //printf("enet_host_broadcast\n");
-                // Must be a NetSendConnection broadcast message
-                enet_host_broadcast(message.enetHost, message.channel, message.header);
-                enet_host_broadcast(message.enetHost, message.channel, message.packet);
-            }
-            else {
-                //printf("enet_peer_send\n");
-                enet_peer_send(message.enetPeer, message.channel, message.header);
-                enet_peer_send(message.enetPeer, message.channel, message.packet);
-            }
-            enet_host_flush(message.enetHost);
 
-            s_enet_command_ThreadMutex.unlock(); // unlock mutex for enet commands
+/** Destroys the queued messages to \a enetPeer, or to every peer of \a enetHost if \a enetPeer is null */
+static void discardOutgoingMessages(ENetHost* enetHost, ENetPeer* enetPeer) {
+    std::lock_guard<std::mutex> guard(s_outgoingMessageMutex);
+    for (int i = 0; i < s_outgoingMessageArray.size(); ++i) {
+        _internal::NetMessage& message = s_outgoingMessageArray[i];
+        if (notNull(enetPeer) ? (message.enetPeer == enetPeer) : (message.enetHost == enetHost)) {
+            message.destroy();
+            // Preserve the order of the remaining messages
+            s_outgoingMessageArray.remove(i);
+            --i;
         }
     }
-    else
+}
+
+
+/** Wakes the network thread from waitForNetworkEvents() */
+static void wakeNetworkThread() {
+    if ((s_wakeSocket != ENET_SOCKET_NULL) && ! s_wakePending.exchange(true)) {
+        uint8 byte = 0;
+        ENetBuffer buffer;
+        buffer.data = &byte;
+        buffer.dataLength = 1;
+        enet_socket_send(s_wakeSocket, &s_wakeAddress, &buffer, 1);
+    }
+}
+
+
+/** Blocks the network thread until a host socket has incoming data, wakeNetworkThread()
+    is called, or enet needs to run its timers. Replaces polling enet_host_service,
+    which cannot wait on multiple hosts at once. */
+static void waitForNetworkEvents() {
+    ENetSocketSet readSet;
+    ENET_SOCKETSET_EMPTY(readSet);
+    ENET_SOCKETSET_ADD(readSet, s_wakeSocket);
+    ENetSocket maxSocket = s_wakeSocket;
+    bool anyHost = false;
+
     {
-        NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "sender thread : sender queue for channel %d does not exist !", (int)channel); // inform that queue does not exist 
-        System::sleep(0.5); // wait some time
+        // New hosts wake this thread, so that serviceNetwork() adds their sockets
+        std::lock_guard<std::mutex> guard(s_allServerAndClientConnectionMutex);
+        for (const ENetSocket socket : s_hostSocketArray) {
+            ENET_SOCKETSET_ADD(readSet, socket);
+            maxSocket = max(maxSocket, socket);
+        }
+        anyHost = (s_hostSocketArray.size() > 0);
     }
 
+    enet_socketset_select(maxSocket, &readSet, nullptr, anyHost ? MAX_HOST_WAIT_MILLISECONDS : MAX_IDLE_WAIT_MILLISECONDS);
+
+    // Consume the wake datagrams before clearing the flag, so that a wake
+    // requested after this point sends a new datagram
+    uint8 byte[16];
+    ENetBuffer buffer;
+    buffer.data = byte;
+    buffer.dataLength = sizeof(byte);
+    while (enet_socket_receive(s_wakeSocket, nullptr, &buffer, 1) > 0) {}
+    s_wakePending = false;
 }
 
 
@@ -608,20 +676,28 @@ void initializeNetwork() {
 
 static void maybeStartNetworkReceiverThread()
 {
+    if (! _internal::g3dInitializationSpecification().threadedNetworking) {
+        return;
+    }
+
     s_networkThreadMutex.lock();
     if (!s_networkThread.joinable()) {
+        s_wakeSocket = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+        const _ENetAddress loopback = toENetAddress(NetAddress(0x7F000001, 0));
+        enet_socket_bind(s_wakeSocket, &loopback);
+        enet_socket_get_address(s_wakeSocket, &s_wakeAddress);
+        enet_socket_set_option(s_wakeSocket, ENET_SOCKOPT_NONBLOCK, 1);
+
         s_networkThread = std::thread([]() {
-            NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "starting network receiver thread");
+            NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "starting network thread");
             while (!s_shutdownNetworkThread)
             {
-                serviceNetwork();
+                waitForNetworkEvents();
 
-                // Yield, since we can't access enet's internal select() call to make it process
-                // multiple hosts at once and sleep until one is needed
-                System::sleep(0); 
-                //Sleep(16); // 60 Hz
+                // Sends and receives for all hosts
+                serviceNetwork();
             }
-            NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "network receiver stopped !");
+            NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "network thread stopped !");
         });
     }
     s_networkThreadMutex.unlock();
@@ -634,9 +710,13 @@ void cleanupNetwork()
 {
     if (s_networkThread.joinable())
     {
-        NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "stopping network receiver thread");
+        NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "stopping network thread");
         s_shutdownNetworkThread = true;
+        s_wakePending = false;
+        wakeNetworkThread();
         s_networkThread.join();
+        enet_socket_destroy(s_wakeSocket);
+        s_wakeSocket = ENET_SOCKET_NULL;
     }
 
 #   ifdef G3D_WINDOWS
@@ -730,6 +810,9 @@ shared_ptr<NetServer> NetServer::create
     shared_ptr<NetServer> n(new NetServer(host));
 
     s_allServers.append(n);
+
+    // Add the new host to the set that the network thread waits on
+    wakeNetworkThread();
     return n;
 }
 
@@ -775,6 +858,7 @@ void NetServer::stop() {
         }
     }
 
+    discardOutgoingMessages(m_enetHost, nullptr);
     enet_host_destroy(m_enetHost);
     m_enetHost = nullptr;
 }
@@ -859,59 +943,17 @@ static ENetPacket* makeHeader(NetMessageType type, NetChannel channel, BinaryOut
     }
 }
 
-void NetSendConnection::submitToSendQueues(const _internal::NetMessage& message)
-{
-    if (!m_sendQueueTable.containsKey(message.channel))
+void NetSendConnection::submitToSendQueue(const _internal::NetMessage& message) {
     {
-        NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "creating sender queue for channel %d", message.channel);
-        shared_ptr<ThreadsafeQueue<_internal::NetMessage>> q(new ThreadsafeQueue<_internal::NetMessage>); // maybe better shared_ptr ?
-        m_sendQueueTable.set(message.channel, q);
-
-        // start send thread
-        const G3D::NetChannel &c = message.channel;
-        std::shared_ptr <std::thread> sendThread (new std::thread([c](){
-            NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "starting network sender thread for channel %d", c);
-            while (!s_shutdownNetworkSenderThread)
-            {
-                serviceNetworkSender(c);
-
-                // Yield, since we can't access enet's internal select() call to make it process
-                // multiple hosts at once and sleep until one is needed
-                
-                System::sleep(G3D::RealTime(0.008)); // 120 Hz
-                //System::sleep(G3D::RealTime(0.016)); // 60 Hz
-                //Sleep(16); // 60 Hz
-            }
-        }));
-
-        // add thread to table
-        m_senderThreadsTable.set(message.channel, sendThread);
+        std::lock_guard<std::mutex> guard(s_outgoingMessageMutex);
+        s_outgoingMessageArray.append(message);
     }
-    
-    // queue message
-    m_sendQueueTable.get(message.channel)->pushBack(message);
+    wakeNetworkThread();
 }
 
-void NetSendConnection::shutdownSenderThreads()
-{
-    // shutdown sender threads
-    s_shutdownNetworkSenderThread = true;
-     
-    NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "NetSendConnection::shutdownSenderThreads()");
 
-    const G3D::Array<G3D::NetChannel> &keys = m_senderThreadsTable.getKeys();
-    for (auto k : keys)
-    {
-        if (m_senderThreadsTable.get(k)->joinable())
-        {
-            NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "stopping network sender thread for channel %d", k);
-            m_senderThreadsTable.get(k)->join();
-        }
-    }
-    // reset threads and queues
-    m_senderThreadsTable.clear(); // delete all entries from sender
-    m_sendQueueTable.clear(); // delete all sender queues
-    
+void NetSendConnection::discardQueuedMessages() {
+    discardOutgoingMessages(m_enetHost, m_enetPeer);
 }
 
 
@@ -931,7 +973,7 @@ void NetSendConnection::send(NetMessageType type, const void* bytes, size_t size
             addCallback(dynamic_pointer_cast<NetSendConnection>(shared_from_this()), packet, memoryManager, bytes);
         }
 
-        submitToSendQueues(_internal::NetMessage(packet, makeHeader(type, channel, header), m_enetPeer, m_enetHost));
+        submitToSendQueue(_internal::NetMessage(packet, makeHeader(type, channel, header), m_enetPeer, m_enetHost));
     }
     else
     {
@@ -961,7 +1003,7 @@ void NetSendConnection::send(NetMessageType type, BinaryOutput& bo, BinaryOutput
         ENetPacket* packet = enet_packet_create(nullptr, size_t(bo.size()), ENET_PACKET_FLAG_RELIABLE);
         bo.commit(packet->data);
 
-        submitToSendQueues(_internal::NetMessage(packet, makeHeader(type, channel, header), m_enetPeer, m_enetHost));
+        submitToSendQueue(_internal::NetMessage(packet, makeHeader(type, channel, header), m_enetPeer, m_enetHost));
     }
     else
     {
@@ -1108,7 +1150,8 @@ shared_ptr<NetConnection> NetConnection::connectToServer
     s_allClientConnections.append(connection); // remember connection list of client connections
     NETWORK_DEBUG_PRINT(VERB_INFORMATIVE, "Number of pending client connections %d", (int)s_allClientConnections.size());
 
-    s_shutdownNetworkSenderThread = false;
+    // Add the new host to the set that the network thread waits on
+    wakeNetworkThread();
 
     return connection;
 }
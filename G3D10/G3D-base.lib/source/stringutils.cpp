@@ -12,6 +12,15 @@
 #include "G3D-base/BinaryInput.h"
 #include <algorithm>
 #include <regex>
+#include <cfloat>
+
+// std::to_chars for floating point requires C++17 and a recent standard library
+#if (__cplusplus >= 201703L) || (defined(_MSVC_LANG) && (_MSVC_LANG >= 201703L))
+#   include <charconv>
+#   if defined(__cpp_lib_to_chars) && (__cpp_lib_to_chars >= 201611L)
+#       define G3D_HAS_FLOAT_TO_CHARS 1
+#   endif
+#endif
 
 #ifdef G3D_WINDOWS
 extern "C" {    
@@ -474,6 +483,272 @@ void buildPrefixTree(const Array<String>& list, DepthFirstTreeBuilder<String>& t
      _internal::buildPrefixTree(list, tree, 0, list.length(), 0);
 }
 
+
+/** Writes inf, -inf, or nan and returns the length, or returns 0 for finite x */
+static int formatSpecial(double x, char* buffer) {
+    const char* s = nullptr;
+    if (isNaN(x)) {
+        s = "nan";
+    } else if (x == inf()) {
+        s = "inf";
+    } else if (x == -inf()) {
+        s = "-inf";
+    } else {
+        return 0;
+    }
+    const int n = int(strlen(s));
+    System::memcpy(buffer, s, n + 1);
+    return n;
+}
+
+
+int formatShortest(float x, char* buffer) {
+    const int n = formatSpecial(x, buffer);
+    if (n > 0) {
+        return n;
+    }
+
+#   ifdef G3D_HAS_FLOAT_TO_CHARS
+        char* stop = std::to_chars(buffer, buffer + SHORTEST_NUMBER_BUFFER_SIZE - 1, x).ptr;
+        *stop = '\0';
+        return int(stop - buffer);
+#   else
+        // The fewest significant digits that survive the round trip
+        for (int precision = 1; precision < 9; ++precision) {
+            const int len = snprintf(buffer, SHORTEST_NUMBER_BUFFER_SIZE, "%.*g", precision, x);
+            if (strtof(buffer, nullptr) == x) {
+                return len;
+            }
+        }
+        return snprintf(buffer, SHORTEST_NUMBER_BUFFER_SIZE, "%.9g", x);
+#   endif
+}
+
+
+int formatShortest(double x, char* buffer) {
+    const int n = formatSpecial(x, buffer);
+    if (n > 0) {
+        return n;
+    }
+
+#   ifdef G3D_HAS_FLOAT_TO_CHARS
+        char* stop = std::to_chars(buffer, buffer + SHORTEST_NUMBER_BUFFER_SIZE - 1, x).ptr;
+        *stop = '\0';
+        return int(stop - buffer);
+#   else
+        for (int precision = 1; precision < 17; ++precision) {
+            const int len = snprintf(buffer, SHORTEST_NUMBER_BUFFER_SIZE, "%.*g", precision, x);
+            if (strtod(buffer, nullptr) == x) {
+                return len;
+            }
+        }
+        return snprintf(buffer, SHORTEST_NUMBER_BUFFER_SIZE, "%.17g", x);
+#   endif
+}
+
+
+namespace _internal {
+
+/** A decimal number split into its parts by scanDecimal() */
+class DecimalParts {
+public:
+    bool        negative = false;
+
+    /** The first 19 significant digits */
+    uint64      mantissa = 0;
+
+    /** Value = mantissa * 10^exponent, if not truncated */
+    int         exponent = 0;
+
+    /** True if nonzero digits were dropped from the mantissa */
+    bool        truncated = false;
+
+    /** 0 if finite, otherwise +/-inf or nan */
+    double      special = 0.0;
+};
+
+static bool matchesIgnoringCase(const char* p, const char* end, const char* word) {
+    for (; *word != '\0'; ++p, ++word) {
+        if ((p >= end) || (tolower(*p) != *word)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Returns one past the last character consumed, or begin if there is no number */
+static const char* scanDecimal(const char* begin, const char* end, DecimalParts& parts) {
+    const char* p = begin;
+    if ((p < end) && ((*p == '-') || (*p == '+'))) {
+        parts.negative = (*p == '-');
+        ++p;
+    }
+
+    if ((p < end) && ! isDigitFast(*p) && (*p != '.')) {
+        if (matchesIgnoringCase(p, end, "infinity")) {
+            parts.special = parts.negative ? -inf() : inf();
+            return p + 8;
+        } else if (matchesIgnoringCase(p, end, "inf")) {
+            parts.special = parts.negative ? -inf() : inf();
+            return p + 3;
+        } else if (matchesIgnoringCase(p, end, "nan")) {
+            parts.special = nan();
+            return p + 3;
+        } else {
+            return begin;
+        }
+    }
+
+    static const int MAX_DIGITS = 19;
+    int numDigits = 0;
+    bool anyDigits = false;
+
+    // Integer part. Leading zeros are not significant.
+    for (; (p < end) && isDigitFast(*p); ++p) {
+        anyDigits = true;
+        const int d = *p - '0';
+        if ((parts.mantissa == 0) && (d == 0)) {
+            continue;
+        } else if (numDigits < MAX_DIGITS) {
+            parts.mantissa = parts.mantissa * 10 + d;
+            ++numDigits;
+        } else {
+            ++parts.exponent;
+            parts.truncated = parts.truncated || (d != 0);
+        }
+    }
+
+    // Fractional part
+    if ((p < end) && (*p == '.')) {
+        for (++p; (p < end) && isDigitFast(*p); ++p) {
+            anyDigits = true;
+            const int d = *p - '0';
+            if ((parts.mantissa == 0) && (d == 0)) {
+                --parts.exponent;
+            } else if (numDigits < MAX_DIGITS) {
+                parts.mantissa = parts.mantissa * 10 + d;
+                ++numDigits;
+                --parts.exponent;
+            } else {
+                parts.truncated = parts.truncated || (d != 0);
+            }
+        }
+    }
+
+    if (! anyDigits) {
+        return begin;
+    }
+
+    // Exponent, only if digits follow the 'e'
+    if ((p < end) && ((*p == 'e') || (*p == 'E'))) {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if ((q < end) && ((*q == '-') || (*q == '+'))) {
+            negativeExponent = (*q == '-');
+            ++q;
+        }
+        if ((q < end) && isDigitFast(*q)) {
+            int e = 0;
+            for (; (q < end) && isDigitFast(*q); ++q) {
+                // Saturate; anything this large is 0 or inf
+                if (e < 100000) {
+                    e = e * 10 + (*q - '0');
+                }
+            }
+            parts.exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    return p;
+}
+
+
+/** Exact powers of ten in double precision */
+static const double powersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/** Clinger's fast path: when the mantissa and the power of ten are both exactly
+    representable, one IEEE multiply or divide is correctly rounded. */
+static bool fastPath(const DecimalParts& parts, double& x) {
+    if (parts.truncated || (parts.mantissa > (uint64(1) << 53)) || (parts.exponent < -22) || (parts.exponent > 22)) {
+        return false;
+    }
+    const double m = double(parts.mantissa);
+    x = (parts.exponent < 0) ? m / powersOfTen[-parts.exponent] : m * powersOfTen[parts.exponent];
+    if (parts.negative) {
+        x = -x;
+    }
+    return true;
+}
+
+
+/** Copies [begin, end) to a NUL-terminated buffer for the C library */
+template<class T>
+static T slowPath(const char* begin, const char* end, T (*convert)(const char*, char**)) {
+    char local[64];
+    const size_t len = size_t(end - begin);
+    if (len < sizeof(local)) {
+        System::memcpy(local, begin, len);
+        local[len] = '\0';
+        return convert(local, nullptr);
+    } else {
+        return convert(String(begin, len).c_str(), nullptr);
+    }
+}
+
+} // _internal
+
+
+const char* parseDouble(const char* begin, const char* end, double& x) {
+    _internal::DecimalParts parts;
+    const char* stop = _internal::scanDecimal(begin, end, parts);
+    if (stop == begin) {
+        return begin;
+    }
+
+    if (parts.special != 0.0) {
+        x = parts.special;
+    } else if (parts.mantissa == 0) {
+        // Every digit was zero
+        x = parts.negative ? -0.0 : 0.0;
+    } else if (! _internal::fastPath(parts, x)) {
+        x = _internal::slowPath<double>(begin, stop, &strtod);
+    }
+    return stop;
+}
+
+
+const char* parseFloat(const char* begin, const char* end, float& x) {
+    _internal::DecimalParts parts;
+    const char* stop = _internal::scanDecimal(begin, end, parts);
+    if (stop == begin) {
+        return begin;
+    }
+
+    double d = 0.0;
+    if (parts.special != 0.0) {
+        x = float(parts.special);
+    } else if (parts.mantissa == 0) {
+        x = parts.negative ? -0.0f : 0.0f;
+    } else if (_internal::fastPath(parts, d) && (fabs(d) >= FLT_MIN) && (fabs(d) <= FLT_MAX)) {
+        // Rounding the correctly rounded double to float is only wrong when the
+        // double lands exactly halfway between two floats. Those have the low 29
+        // bits of the double mantissa equal to 0x10000000.
+        uint64 bits;
+        System::memcpy(&bits, &d, sizeof(bits));
+        if ((bits & 0x1FFFFFFF) != 0x10000000) {
+            x = float(d);
+        } else {
+            x = _internal::slowPath<float>(begin, stop, &strtof);
+        }
+    } else {
+        x = _internal::slowPath<float>(begin, stop, &strtof);
+    }
+    return stop;
+}
+
 }; // namespace
 
 #undef NEWLINE
@@ -74,7 +74,7 @@ namespace G3D {
  <code>#includestring macroarg</code> inserts the value of the macroarg (it does <b>not</b> include a file named
  by the macroarg). It is an error to insert such macros by name only.
 
- NOTE: Shader, when being applied with an Args object, first checks the result preambleAndMacroString(), and uses that as a key into a cache of compiled shader program objects.
+ NOTE: Shader, when being applied with an Args object, first checks the variantHash() of the preamble and macro args, and uses that as a key into a cache of compiled shader program objects.
  If such an object is found, the compilation step is skipped, and Shader uses the program object from the cache, otherwise it is compiled and added to the cache. 
 
  The number of possible shaders to compile is exponential in the number of macro arguments, use them sparingly!
@@ -15,6 +15,7 @@
 #include "G3D-gfx/glcalls.h"
 #include "G3D-gfx/getOpenGLState.h"
 #include "G3D-gfx/Texture.h"
+#include "G3D-gfx/TextureTranscodeCache.h"
 #include "G3D-gfx/glFormat.h"
 #include "G3D-gfx/Milestone.h"
 #include "G3D-gfx/RenderDevice.h"
@@ -30,6 +31,7 @@
 #include "G3D-gfx/GLFWWindow.h"
 #include "G3D-gfx/Args.h"
 #include "G3D-gfx/Shader.h"
+#include "G3D-gfx/ShaderPreprocessCache.h"
 #include "G3D-gfx/GLPixelTransferBuffer.h"
 #include "G3D-gfx/BufferTexture.h"
 #include "G3D-gfx/BindlessTextureHandle.h"
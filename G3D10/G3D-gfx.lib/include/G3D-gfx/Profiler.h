@@ -171,6 +171,14 @@ private:
         /** Full tree of events for the previous frame */
         Array<Event>                        previousEventTree;
 
+        /** True if this thread had a current RenderDevice when it first
+            recorded an event. Other threads, e.g., the simulation thread in
+            GApp::Settings::Pipeline mode, have no OpenGL context, so only
+            their CPU times are recorded. */
+        bool                                timeGPU;
+
+        ThreadInfo();
+
         void beginEvent(const String& name, const String& file, int line, const String& hint = "");
 
         void endEvent();
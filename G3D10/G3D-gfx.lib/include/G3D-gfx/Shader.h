@@ -33,6 +33,8 @@
 
 namespace G3D {
 
+class ShaderPreprocessCache;
+
 /**
   \brief Abstraction of the programmable hardware pipeline with G3D
   preprocessor extensions.
@@ -585,8 +587,17 @@ protected:
 
     };
     
-    /** Maps preamble + macro definitions to compiled shaders */
-    Table<String, shared_ptr<ShaderProgram> >   m_compilationCache;
+    /** A compiled program and the preamble and macro args that it was compiled with */
+    class CompiledVariant {
+    public:
+        String                                  preamble;
+        Array<UniformTable::MacroArgPair>       macroArgArray;
+        shared_ptr<ShaderProgram>               program;
+    };
+
+    /** Maps UniformTable::variantHash() to compiled shaders. Each bucket holds every
+        variant with that hash, which is almost always one. */
+    Table<uint64, SmallArray<CompiledVariant, 1> >  m_compilationCache;
 
     String                                      m_name;
 
@@ -618,6 +629,22 @@ protected:
         when \#including, so that we can produce proper \#line
         directives */
     int                                         m_nextUnusedFileIndex;
+
+    /** Every file read by the most recent loadAndPreprocess(), for ShaderPreprocessCache */
+    Array<String>                               m_dependencyArray;
+
+    /** If not null, loadAndPreprocess() reuses preprocessed source from previous runs */
+    static shared_ptr<ShaderPreprocessCache>    s_preprocessCache;
+
+    /** Everything other than file contents that determines the output of
+        loadAndPreprocess() for \a args */
+    String preprocessCacheKey(const Args& args) const;
+
+    /** Returns true and sets \a preprocessedSource from s_preprocessCache if there is a valid entry
+        for \a key whose file indices do not conflict with those already assigned by this shader */
+    bool loadFromPreprocessCache(const String& key, Array<PreprocessedShaderSource>& preprocessedSource);
+
+    void storeInPreprocessCache(const String& key, const Array<PreprocessedShaderSource>& preprocessedSource) const;
     
     /** Returns a line directive in the format "#line X Y\n", where X
         is the lineNumber, and Y is an integer that maps to
@@ -712,6 +739,19 @@ public:
     /** Set the global failure behavior. See Shader::FailureBehavior */
     static void setFailureBehavior(FailureBehavior f);
 
+    /** Enables the persistent cache of load-time preprocessed source for all shaders
+        loaded after this call. Entries are invalidated automatically when any file that
+        they \#include changes. Pass nullptr to disable the cache, which is the default. 
+
+        \code
+        Shader::setPreprocessCache(ShaderPreprocessCache::create(FilePath::concat(FileSystem::currentDirectory(), "shadercache")));
+        \endcode */
+    static void setPreprocessCache(const shared_ptr<ShaderPreprocessCache>& cache);
+
+    static const shared_ptr<ShaderPreprocessCache>& preprocessCache() {
+        return s_preprocessCache;
+    }
+
     /** Creates a shader from the given specification, loads it from disk, and applies the g3d preprocessor */
     static shared_ptr<Shader> create(const Specification& s);
 
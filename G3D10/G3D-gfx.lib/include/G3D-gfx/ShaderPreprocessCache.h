@@ -0,0 +1,98 @@
+/**
+  \file G3D-gfx.lib/include/G3D-gfx/ShaderPreprocessCache.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_gfx_ShaderPreprocessCache_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/ReferenceCount.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/Table.h"
+#include "G3D-base/G3DString.h"
+
+namespace G3D {
+
+/**
+  \brief Persistent, on-disk cache of the output of the G3D load-time shader
+  preprocessor, so that Shader does not re-read and re-expand every
+  \#include each time that a program starts.
+
+  Entries are named by a key string that the caller builds from everything
+  other than file contents that affects preprocessing (for Shader: the stage
+  sources, the macro arguments and preamble, and the GPU). Each entry also
+  records every file that was read while producing it, and a hash of their
+  contents. get() re-hashes those files and rejects the entry if any has
+  changed or disappeared, so editing any file of the \#include graph
+  invalidates every entry that depends on it.
+
+  Each entry is one file in directory(), written to a temporary name and then
+  renamed, so that concurrent processes never observe partial entries.
+
+  This class does not require an OpenGL context.
+
+  \sa Shader::setPreprocessCache
+*/
+class ShaderPreprocessCache : public ReferenceCountedObject {
+public:
+
+    /** The preprocessed code of one shader stage. \sa Shader::PreprocessedShaderSource */
+    class Stage {
+    public:
+        String          filename;
+        String          preprocessedCode;
+        String          g3dInsertString;
+        String          versionString;
+        String          extensionsString;
+    };
+
+    class Entry {
+    public:
+        /** Every file that was read to produce the stages, as absolute paths */
+        Array<String>       dependencyArray;
+
+        Array<Stage>        stageArray;
+
+        /** The file indices that the \#line pragmas in the stages refer to */
+        Table<int, String>  indexToFilenameTable;
+    };
+
+protected:
+
+    String                  m_directory;
+
+    ShaderPreprocessCache(const String& directory);
+
+    String entryFilename(const String& key) const;
+
+public:
+
+    /** \param directory Created if it does not exist */
+    static shared_ptr<ShaderPreprocessCache> create(const String& directory);
+
+    const String& directory() const {
+        return m_directory;
+    }
+
+    /** Hash of the contents of all of \a filenameArray, in order. Returns false if any
+        file cannot be read. */
+    static bool hashFiles(const Array<String>& filenameArray, uint64& hash);
+
+    /** Sets \a entry and returns true if there is an entry for \a key whose
+        dependencies are unchanged since set() was called for it. */
+    bool get(const String& key, Entry& entry) const;
+
+    /** Stores \a entry under \a key, replacing any previous entry. Hashes the
+        current contents of entry.dependencyArray. Returns false if a dependency
+        cannot be read or the entry cannot be written. */
+    bool set(const String& key, const Entry& entry);
+
+    /** Removes all entries */
+    void clear();
+};
+
+} // namespace G3D
@@ -34,6 +34,8 @@
 #include "G3D-base/FrameName.h"
 #include "G3D-gfx/glheaders.h"
 #include "G3D-gfx/Sampler.h"
+#include <condition_variable>
+#include <exception>
 
 #ifdef G3D_ENABLE_CUDA
 #include <cuda.h>
@@ -52,6 +54,7 @@ class RenderDevice;
 class GLPixelTransferBuffer;
 class Args;
 class UniformTable;
+class TextureTranscodeCache;
 
 
 /**
@@ -814,19 +817,36 @@ protected:
 
     mutable LoadingInfo*              m_loadingInfo = nullptr;
 
-    /** Protects m_needsForce, m_loadingThread, and m_loadingGLCallback. \sa force()  */
+    /** Protects m_needsForce, m_cpuLoadingState, and m_cpuLoadingException. \sa force()  */
     mutable std::mutex                m_loadingMutex;
 
-    /** The thread that lazy loads into memory by invoking the m_loadingCPUCallbackQueue
-        callbacks. Not permitted to make any OpenGL calls.
-        Mutable so that it can be deallocated during the const force() method.
+    enum CPULoadingState {
+        /** Waiting for a thread of the shared decode pool */
+        CPU_LOADING_QUEUED,
 
-        The loading thread advances through m_loadingInfo.nextStep processing
-        until it reaches the UPLOAD_TO_GPU stage. That must be run during force
-        on the GL thread.
+        /** completeCPULoading() is running on a decode thread, or on the thread that called force() */
+        CPU_LOADING_RUNNING,
 
-        \sa force() */
-    mutable std::thread*              m_loadingThread = nullptr;
+        /** completeCPULoading() has returned or thrown */
+        CPU_LOADING_DONE
+    };
+
+    /** Lazily loaded textures are queued on a shared, bounded pool of decode
+        threads, which advance m_loadingInfo.nextStep until it reaches the
+        TRANSFER_TO_GPU stage. That must be run during force() on the GL thread.
+        force() performs the CPU steps itself if no decode thread has started them yet.
+
+        \sa force(), m_cpuLoadingCondition */
+    mutable CPULoadingState           m_cpuLoadingState = CPU_LOADING_DONE;
+
+    /** Notified when m_cpuLoadingState becomes CPU_LOADING_DONE */
+    mutable std::condition_variable   m_cpuLoadingCondition;
+
+    /** Thrown by completeCPULoading() on a decode thread, rethrown by force() */
+    mutable std::exception_ptr        m_cpuLoadingException;
+
+    /** If not null, completeCPULoading() reuses decoded and preprocessed data from previous runs */
+    static shared_ptr<TextureTranscodeCache> s_transcodeCache;
     
     static int64                      m_sizeOfAllTexturesInMemory;
     
@@ -851,9 +871,20 @@ protected:
         blocks on the loading thread and does not return until the upload is completed. Otherwise it 
         does nothing. This should be called on the OpenGL thread. 
         
-        \sa m_loadingThread, m_loadingGLCallback, m_loadingMutex, m_needsForce */
+        \sa m_cpuLoadingState, m_loadingMutex, m_needsForce */
     void force() const;
 
+    /** Queues completeCPULoading() on the shared decode thread pool. Called by fromFile(). */
+    static void queueCPULoading(const shared_ptr<Texture>& texture);
+
+    /** Runs completeCPULoading() if it is CPU_LOADING_QUEUED, and then marks it as done.
+        Called on a decode thread. */
+    void runQueuedCPULoading();
+
+    /** Runs completeCPULoading(), records any exception, and marks it as done.
+        Call after setting m_cpuLoadingState to CPU_LOADING_RUNNING. */
+    void runCPULoading();
+
     friend class BufferTexture;
     
     /**
@@ -866,6 +897,15 @@ protected:
         Blocks. Does nothing if GPU loading is already complete. */
     void completeCPULoading();
 
+    /** Everything that determines the output of completeCPULoading() for a file whose contents hash to \a sourceHash */
+    String transcodeCacheKey(uint64 sourceHash) const;
+
+    /** Returns true and advances m_loadingInfo to TRANSFER_TO_GPU if s_transcodeCache has an entry for \a key */
+    bool loadFromTranscodeCache(const String& key);
+
+    /** Computes the MIP chain on the CPU if it can be, and then stores the result of PREPROCESS in s_transcodeCache */
+    void storeInTranscodeCache(const String& key);
+
     /** Perform the final GPU step specified in m_loadingInfo.
         It assumes that CPU loading has been completed and that
         the caller is on the GL thread.
@@ -1048,6 +1088,24 @@ public:
      int                             depth                          = -1,
      bool                            hasMIPMaps                     = false);
     
+    /** Enables the persistent cache of decoded, preprocessed, and MIP-mapped pixels for all
+        textures loaded by fromFile() after this call. Entries are keyed by the contents of
+        the image files, so editing an image simply misses the cache. Pass nullptr to disable
+        the cache, which is the default.
+
+        With a cache, MIP maps of uncompressed 2D and cube map textures are computed on the
+        CPU by ImageResampler (with a box filter, like glGenerateMipmap) so that they can be
+        stored, instead of on the GPU.
+
+        \code
+        Texture::setTranscodeCache(TextureTranscodeCache::create(FilePath::concat(FileSystem::currentDirectory(), "texturecache")));
+        \endcode */
+    static void setTranscodeCache(const shared_ptr<TextureTranscodeCache>& cache);
+
+    static const shared_ptr<TextureTranscodeCache>& transcodeCache() {
+        return s_transcodeCache;
+    }
+
     /**
      Creates a texture from a single image or a set of files for a texture array or cube
      map based on a wildcard specification
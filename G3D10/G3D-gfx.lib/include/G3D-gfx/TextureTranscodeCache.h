@@ -0,0 +1,106 @@
+/**
+  \file G3D-gfx.lib/include/G3D-gfx/TextureTranscodeCache.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_gfx_TextureTranscodeCache_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/ReferenceCount.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/Color4.h"
+#include "G3D-base/constants.h"
+#include "G3D-base/G3DString.h"
+
+namespace G3D {
+
+class ImageFormat;
+class PixelTransferBuffer;
+
+/**
+  \brief Persistent, on-disk cache of decoded, preprocessed, and MIP-mapped
+  texture data, so that Texture::fromFile does not re-decode image files and
+  re-run Texture::Preprocess each time that a program starts.
+
+  Entries are named by a key string that the caller builds from a hash of the
+  source file contents and everything else that affects the result (for
+  Texture: the Texture::Preprocess, the Texture::Encoding, the dimension, and
+  whether MIP maps are generated). Because the key contains the content hash,
+  editing a source image simply misses the cache, and identical images loaded
+  under different names share one entry.
+
+  Each entry is one file in directory(). It begins with a small header and a
+  table of (offset, size) records, one per MIP level and face, followed by the
+  raw pixels of each level with no row padding. Every level starts on a
+  64-byte boundary, so an entry may be memory-mapped and each level used in
+  place. get() reads each level with a single read directly into a
+  CPUPixelTransferBuffer. Entries are written to a temporary name and then
+  renamed, so that concurrent processes never observe partial entries.
+
+  This class does not require an OpenGL context.
+
+  \sa Texture::setTranscodeCache, ShaderPreprocessCache
+*/
+class TextureTranscodeCache : public ReferenceCountedObject {
+public:
+
+    class Entry {
+    public:
+        /** Texture::Encoding::format after preprocessing */
+        const ImageFormat*  encodingFormat = nullptr;
+        Color4              readMultiplyFirst = Color4::one();
+        Color4              readAddSecond = Color4::zero();
+
+        /** Statistics of MIP level 0, or NaN if they were not computed */
+        Color4              min = Color4::nan();
+        Color4              max = Color4::nan();
+        Color4              mean = Color4::nan();
+        AlphaFilter         detectedHint = AlphaFilter::DETECT;
+
+        /** mipArray[level][face]. All buffers must have the same format,
+            and every level must have the same number of faces. */
+        Array<Array<shared_ptr<PixelTransferBuffer>>> mipArray;
+    };
+
+protected:
+
+    String                  m_directory;
+
+    TextureTranscodeCache(const String& directory);
+
+    String entryFilename(const String& key) const;
+
+public:
+
+    /** \param directory Created if it does not exist */
+    static shared_ptr<TextureTranscodeCache> create(const String& directory);
+
+    const String& directory() const {
+        return m_directory;
+    }
+
+    /** 64-bit FNV-1a hash of \a length bytes, continuing from \a hash, taken a
+        word at a time. Use the default to start a new hash. Hashing data in pieces
+        matches hashing it at once when every piece but the last is a multiple of 8 bytes. */
+    static uint64 hashBytes(const void* data, size_t length, uint64 hash = 0xCBF29CE484222325ULL);
+
+    /** Hash of the contents of \a filename. Returns false if it cannot be read. */
+    static bool hashFile(const String& filename, uint64& hash);
+
+    /** Sets \a entry and returns true if there is a complete entry for \a key. The
+        pixel buffers of \a entry are newly allocated CPUPixelTransferBuffers. */
+    bool get(const String& key, Entry& entry) const;
+
+    /** Stores \a entry under \a key, replacing any previous entry. Returns false
+        if \a entry is malformed or cannot be written. */
+    bool set(const String& key, const Entry& entry);
+
+    /** Removes all entries */
+    void clear();
+};
+
+} // namespace G3D
@@ -166,6 +166,16 @@ protected:
     /** We use a SmallArray to avoid heap allocation for every arg instance */
     SmallArray<MacroArgPair, 12>    m_macroArgs;
 
+    /** FNV-1a hash of m_preamble, which appendToPreamble() extends without rehashing */
+    uint64                          m_preambleHash;
+
+    /** Sum of macroHash() over m_macroArgs, which is independent of their order
+        and is updated by setMacro() in constant time */
+    uint64                          m_macroHash;
+
+    /** Hash of one macro argument for m_macroHash */
+    static uint64 macroHash(const String& name, const String& value);
+
     ArgTable                        m_uniformArgs;
 
     /** Must be empty if m_immediateModeArgs is non-empty */
@@ -198,16 +208,29 @@ public:
         return m_uniformArgs.containsKey(s);
     }
 
-    /** The preamble with macro arg definitions appended */
+    /** The preamble with macro arg definitions appended. 
+        This allocates and sorts, so use variantHash() to identify a shader variant
+        on every draw call. */
     String preambleAndMacroString() const;
 
+    /** 64-bit hash of the preamble and the set of macro arguments, which are what select a compiled
+        variant of a Shader. It is maintained as they change, so this takes constant time and does
+        not allocate. Tables with the same preamble and macros have the same hash. Different ones
+        may collide, so confirm a match with samePreambleAndMacros(). */
+    uint64 variantHash() const;
+
+    /** True if this table has exactly \a preamble and the macro arguments in \a macroArgArray,
+        in any order. Does not allocate. */
+    bool samePreambleAndMacros(const String& preamble, const Array<MacroArgPair>& macroArgArray) const;
+
+    /** Appends the macro arguments, in the order that they were first set */
+    void getMacroArgs(Array<MacroArgPair>& macroArgArray) const;
+
     String preamble() const {
         return m_preamble;
     }
 
-    void appendToPreamble(const String& extra) {
-        m_preamble += extra;
-    }
+    void appendToPreamble(const String& extra);
 
     /** Arbitrary string to append to beginning of the shader */
     void setPreamble(const String& preamble);
@@ -55,10 +55,15 @@ GLuint Profiler::ThreadInfo::getQueryLocationObject(int eventIndex, QueryLocatio
 }
 
 
+Profiler::ThreadInfo::ThreadInfo() : nextQueryObjectIndex(0), timeGPU(notNull(RenderDevice::current)) {}
+
+
 Profiler::ThreadInfo::~ThreadInfo() {
-    glDeleteQueries(queryObjects.size(), queryObjects.getCArray());
-    debugAssertGLOk();
-    queryObjects.clear();
+    if (queryObjects.size() > 0) {
+        glDeleteQueries(queryObjects.size(), queryObjects.getCArray());
+        debugAssertGLOk();
+        queryObjects.clear();
+    }
 }
 
 
@@ -82,9 +87,11 @@ void Profiler::ThreadInfo::beginEvent(const String& name, const String& file, in
             dummy.m_numChildren = -1; // indicates dummy event
             dummy.m_parentIndex = ancestorStack.last();
 
-            // push dummy query objects
-            getQueryLocationObject(eventTree.length(), QUERY_LOCATION_START);
-            getQueryLocationObject(eventTree.length(), QUERY_LOCATION_END);
+            if (timeGPU) {
+                // push dummy query objects
+                getQueryLocationObject(eventTree.length(), QUERY_LOCATION_START);
+                getQueryLocationObject(eventTree.length(), QUERY_LOCATION_END);
+            }
 
             eventTree.append(dummy);
         }
@@ -97,7 +104,7 @@ void Profiler::ThreadInfo::beginEvent(const String& name, const String& file, in
     }
     ancestorStack.push(eventTree.length());
 
-    if (RenderDevice::current) {
+    if (timeGPU && RenderDevice::current) {
         // Set start location marker query object 
         glQueryCounter(getQueryLocationObject(eventTree.length(), QUERY_LOCATION_START), GL_TIMESTAMP);
         debugAssertGLOk();
@@ -120,7 +127,7 @@ void Profiler::ThreadInfo::endEvent() {
 
     Event& event(eventTree[eventIndex]);
 
-    if (RenderDevice::current) {
+    if (timeGPU && RenderDevice::current) {
         // Set end location marker query object
         glQueryCounter(getQueryLocationObject(eventIndex, QUERY_LOCATION_END), GL_TIMESTAMP);
         debugAssertGLOk();
@@ -167,6 +174,11 @@ int Profiler::calculateUnaccountedTime(Array<Event>& eventTree, const int index,
 
 
 void Profiler::threadShutdownHook() {
+    if (isNull(s_threadInfo)) {
+        // This thread never recorded an event
+        return;
+    }
+
     std::lock_guard<std::mutex> guard(s_profilerMutex);
     const int i = s_threadInfoArray.findIndex(*s_threadInfo);
     alwaysAssertM(i != -1, "Could not find thread info during thread destruction for Profiler");
@@ -213,7 +225,7 @@ void Profiler::nextFrame() {
     for (int t = 0; t < s_threadInfoArray.length(); ++t) {
         const shared_ptr<ThreadInfo>& info = s_threadInfoArray[t];
 
-        for (int e = 0; e < info->eventTree.length(); ++e) {
+        for (int e = 0; info->timeGPU && (e < info->eventTree.length()); ++e) {
             Event& event = info->eventTree[e];
             GLuint startQueryObject = info->getQueryLocationObject(e, ThreadInfo::QUERY_LOCATION_START);
             GLuint endQueryObject = info->getQueryLocationObject(e, ThreadInfo::QUERY_LOCATION_END);
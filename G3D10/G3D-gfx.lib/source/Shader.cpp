@@ -15,6 +15,7 @@
 #include "G3D-base/prompt.h"
 #include "G3D-base/g3dmath.h"
 #include "G3D-gfx/Shader.h"
+#include "G3D-gfx/ShaderPreprocessCache.h"
 #include "G3D-gfx/GLCaps.h"
 #include "G3D-gfx/RenderDevice.h"
 #include "G3D-gfx/BufferTexture.h"
@@ -27,6 +28,8 @@ Array< weak_ptr<Shader> > Shader::s_allShaders;
 
 Shader::FailureBehavior Shader::s_failureBehavior = Shader::PROMPT;
 
+shared_ptr<ShaderPreprocessCache> Shader::s_preprocessCache;
+
 GLenum Shader::toGLType(const String& s) {
     if (s == "float") {
         return GL_FLOAT;
@@ -1105,6 +1108,74 @@ GLuint Shader::toGLEnum(ShaderStage s) {
 }
 
 
+String Shader::preprocessCacheKey(const Args& args) const {
+    // The version line and vendor defines depend on the GPU and driver
+    String key = GLCaps::vendor() + "\n" + GLCaps::renderer() + "\n" + GLCaps::driverVersion() + "\n";
+
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        const Source& source = m_specification.shaderStage[s];
+        if (source.type == STRING) {
+            key += format("%s string %d\n", stageName(s).c_str(), int(source.val.size())) + source.val + "\n";
+        } else if (! source.val.empty()) {
+            key += format("%s file\n", stageName(s).c_str()) + FileSystem::resolve(source.val) + "\n";
+        }
+    }
+
+    return key + args.preambleAndMacroString();
+}
+
+
+bool Shader::loadFromPreprocessCache(const String& key, Array<PreprocessedShaderSource>& preprocessedSource) {
+    ShaderPreprocessCache::Entry entry;
+    if (! s_preprocessCache->get(key, entry) || (entry.stageArray.size() != STAGE_COUNT)) {
+        return false;
+    }
+
+    // The #line pragmas in the cached code refer to file indices, which
+    // must mean the same files that they do in this shader
+    for (Table<int, String>::Iterator it = entry.indexToFilenameTable.begin(); it.isValid(); ++it) {
+        const String* filename = m_indexToFilenameTable.getPointer(it->key);
+        const int* index = m_fileNameToIndexTable.getPointer(it->value);
+        if ((notNull(filename) && (*filename != it->value)) || (notNull(index) && (*index != it->key))) {
+            return false;
+        }
+    }
+
+    for (Table<int, String>::Iterator it = entry.indexToFilenameTable.begin(); it.isValid(); ++it) {
+        m_indexToFilenameTable.set(it->key, it->value);
+        m_fileNameToIndexTable.set(it->value, it->key);
+        m_nextUnusedFileIndex = max(m_nextUnusedFileIndex, it->key + 1);
+    }
+
+    for (const ShaderPreprocessCache::Stage& stage : entry.stageArray) {
+        PreprocessedShaderSource& pSource = preprocessedSource.next();
+        pSource.filename            = stage.filename;
+        pSource.preprocessedCode    = stage.preprocessedCode;
+        pSource.g3dInsertString     = stage.g3dInsertString;
+        pSource.versionString       = stage.versionString;
+        pSource.extensionsString    = stage.extensionsString;
+    }
+
+    return true;
+}
+
+
+void Shader::storeInPreprocessCache(const String& key, const Array<PreprocessedShaderSource>& preprocessedSource) const {
+    ShaderPreprocessCache::Entry entry;
+    entry.dependencyArray = m_dependencyArray;
+    entry.indexToFilenameTable = m_indexToFilenameTable;
+    for (const PreprocessedShaderSource& pSource : preprocessedSource) {
+        ShaderPreprocessCache::Stage& stage = entry.stageArray.next();
+        stage.filename          = pSource.filename;
+        stage.preprocessedCode  = pSource.preprocessedCode;
+        stage.g3dInsertString   = pSource.g3dInsertString;
+        stage.versionString     = pSource.versionString;
+        stage.extensionsString  = pSource.extensionsString;
+    }
+    s_preprocessCache->set(key, entry);
+}
+
+
 void Shader::loadAndPreprocess(const Args& args, Array<PreprocessedShaderSource>& preprocessedSource) {
     String loadMessages;
     bool ok = true;
@@ -1112,8 +1183,23 @@ void Shader::loadAndPreprocess(const Args& args, Array<PreprocessedShaderSource>
     // Map code source 0 to generated code
     m_indexToFilenameTable.set(0, "G3D Inserted Code");     
     m_fileNameToIndexTable.set("G3D Inserted Code", 0);
-    
-    for (int s = 0; s < STAGE_COUNT; ++s) {
+
+    {
+        const Source& source = m_specification.shaderStage[COMPUTE];
+        if ((source.type == STRING) || ! source.val.empty()) {
+            m_isCompute = true;
+        }
+    }
+
+    String cacheKey;
+    bool cached = false;
+    if (notNull(s_preprocessCache)) {
+        cacheKey = preprocessCacheKey(args);
+        cached = loadFromPreprocessCache(cacheKey, preprocessedSource);
+    }
+
+    m_dependencyArray.fastClear();
+    for (int s = 0; (s < STAGE_COUNT) && ! cached; ++s) {
         debugAssertGLOk();
 
         const Source& source = m_specification.shaderStage[s];
@@ -1127,19 +1213,13 @@ void Shader::loadAndPreprocess(const Args& args, Array<PreprocessedShaderSource>
         if (source.type == STRING) {
             code = source.val;
             name = format("<:%s:>", stageName(s).c_str());
-            if (s == COMPUTE) {
-                m_isCompute = true;
-            }
         } else {
             name = source.val;
             if (! name.empty()) {
                 name = FileSystem::resolve(name);
                 code = readWholeFile(name);
                 dir = filenamePath(name);
-
-                if (s == COMPUTE) {
-                    m_isCompute = true;
-                }
+                m_dependencyArray.append(name);
             } 
         }
 
@@ -1153,6 +1233,10 @@ void Shader::loadAndPreprocess(const Args& args, Array<PreprocessedShaderSource>
         preprocessedSource.append(pSource);
     }
 
+    if (ok && ! cached && notNull(s_preprocessCache)) {
+        storeInPreprocessCache(cacheKey, preprocessedSource);
+    }
+
     if (ok &&
         preprocessedSource[VERTEX].preprocessedCode.empty() &&
         ! preprocessedSource[PIXEL].preprocessedCode.empty()) {
@@ -1284,13 +1368,21 @@ void Shader::handleRecoverableError(RecoverableErrorType eType, const Args& args
 
 
 shared_ptr<Shader::ShaderProgram> Shader::shaderProgram(const Args& args, String& messages) {
-    const String& preambleAndMacroString = args.preambleAndMacroString();
-
-    shared_ptr<ShaderProgram>* sp = m_compilationCache.getPointer(preambleAndMacroString);
-    if (notNull(sp)) {
-        return *sp;
+    // Find the variant without building the preamble and macro string, which is
+    // expensive to do on every draw call
+    const uint64 variantHash = args.variantHash();
+    SmallArray<CompiledVariant, 1>* bucket = m_compilationCache.getPointer(variantHash);
+    if (notNull(bucket)) {
+        for (int i = 0; i < bucket->size(); ++i) {
+            const CompiledVariant& variant = (*bucket)[i];
+            if (args.samePreambleAndMacros(variant.preamble, variant.macroArgArray)) {
+                return variant.program;
+            }
+        }
     }
 
+    const String& preambleAndMacroString = args.preambleAndMacroString();
+
     /** Maps preamble + macro definitions to an array of the source code each shader stage.
         The array values have STAGE_COUNT elements. */
     Array<PreprocessedShaderSource> preprocessedSource;
@@ -1308,7 +1400,11 @@ shared_ptr<Shader::ShaderProgram> Shader::shaderProgram(const Args& args, String
     debugAssertGLOk();
         
     if (s->ok) {
-        m_compilationCache.set(preambleAndMacroString, s);
+        CompiledVariant variant;
+        variant.preamble = args.preamble();
+        args.getMacroArgs(variant.macroArgArray);
+        variant.program = s;
+        m_compilationCache.getCreate(variantHash).append(variant);
         return s;
     } else {
         messages = s->messages;
@@ -1320,6 +1416,11 @@ shared_ptr<Shader::ShaderProgram> Shader::shaderProgram(const Args& args, String
 void Shader::setFailureBehavior(FailureBehavior f){
     s_failureBehavior = f;
 }
+
+
+void Shader::setPreprocessCache(const shared_ptr<ShaderPreprocessCache>& cache) {
+    s_preprocessCache = cache;
+}
     
 
 void Shader::reload() {
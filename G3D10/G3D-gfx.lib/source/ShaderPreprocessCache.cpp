@@ -0,0 +1,236 @@
+/**
+  \file G3D-gfx.lib/source/ShaderPreprocessCache.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-gfx/ShaderPreprocessCache.h"
+#include "G3D-base/FileSystem.h"
+#include "G3D-base/BinaryInput.h"
+#include "G3D-base/BinaryOutput.h"
+#include "G3D-base/Random.h"
+#include "G3D-base/System.h"
+#include "G3D-base/format.h"
+
+namespace G3D {
+
+/** Identifies entry files. Increment the version whenever the entry layout
+    or the preprocessor output changes, so that old entries are ignored. */
+static const char*  ENTRY_MAGIC     = "G3DSPC";
+static const uint32 ENTRY_VERSION   = 1;
+
+static const uint64 FNV_OFFSET_64   = 0xCBF29CE484222325ULL;
+static const uint64 FNV_PRIME_64    = 0x100000001B3ULL;
+
+static uint64 fnv1a(uint64 h, const void* data, size_t length) {
+    const uint8* byte = (const uint8*)data;
+    for (size_t i = 0; i < length; ++i) {
+        h = (h ^ byte[i]) * FNV_PRIME_64;
+    }
+    return h;
+}
+
+
+/** Reads the file without consulting the FileSystem cache, which may be stale
+    for files that were just edited or deleted. */
+static bool readFile(const String& filename, String& contents) {
+    FILE* file = FileSystem::fopen(filename.c_str(), "rb");
+    if (isNull(file)) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    const long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    bool ok = (length >= 0);
+    if (ok) {
+        char* buffer = (char*)System::malloc(size_t(length) + 1);
+        ok = (fread(buffer, 1, size_t(length), file) == size_t(length));
+        contents = String(buffer, size_t(length));
+        System::free(buffer);
+    }
+    FileSystem::fclose(file);
+    return ok;
+}
+
+
+/** Like BinaryInput::readString32, but fails instead of reading past the end of a truncated entry */
+static bool readString32(BinaryInput& b, String& s) {
+    if (b.getLength() - b.getPosition() < 4) {
+        return false;
+    }
+    const int64 length = b.readUInt32();
+    if (b.getLength() - b.getPosition() < length) {
+        return false;
+    }
+    s = b.readString(length);
+    return true;
+}
+
+
+ShaderPreprocessCache::ShaderPreprocessCache(const String& directory) : m_directory(directory) {
+    if (! FileSystem::exists(m_directory, false)) {
+        FileSystem::createDirectory(m_directory);
+    }
+}
+
+
+shared_ptr<ShaderPreprocessCache> ShaderPreprocessCache::create(const String& directory) {
+    return createShared<ShaderPreprocessCache>(directory);
+}
+
+
+String ShaderPreprocessCache::entryFilename(const String& key) const {
+    const uint64 hash = fnv1a(FNV_OFFSET_64, key.c_str(), key.size());
+    return FilePath::concat(m_directory, format("%016llx.g3dpp", (unsigned long long)hash));
+}
+
+
+bool ShaderPreprocessCache::hashFiles(const Array<String>& filenameArray, uint64& hash) {
+    hash = FNV_OFFSET_64;
+    String contents;
+    for (const String& filename : filenameArray) {
+        if (! readFile(filename, contents)) {
+            return false;
+        }
+        // Include the length so that moving text between files changes the hash
+        const uint64 length = contents.size();
+        hash = fnv1a(hash, &length, sizeof(length));
+        hash = fnv1a(hash, contents.c_str(), contents.size());
+    }
+    return true;
+}
+
+
+bool ShaderPreprocessCache::get(const String& key, Entry& entry) const {
+    String data;
+    if (! readFile(entryFilename(key), data)) {
+        return false;
+    }
+
+    BinaryInput b((const uint8*)data.c_str(), data.size(), G3D_LITTLE_ENDIAN, false, false);
+
+    String magic, storedKey;
+    if (! readString32(b, magic) || (magic != ENTRY_MAGIC) ||
+        (b.getLength() - b.getPosition() < 4) || (b.readUInt32() != ENTRY_VERSION) ||
+        ! readString32(b, storedKey) || (storedKey != key)) {
+        // Another format, or a different key with the same hash
+        return false;
+    }
+
+    if (b.getLength() - b.getPosition() < 12) {
+        return false;
+    }
+    const uint64 storedHash = b.readUInt64();
+    const int numDependencies = b.readInt32();
+    entry.dependencyArray.fastClear();
+    for (int i = 0; i < numDependencies; ++i) {
+        if (! readString32(b, entry.dependencyArray.next())) {
+            return false;
+        }
+    }
+
+    // Validate before parsing the rest, which is the expensive part
+    uint64 hash = 0;
+    if (! hashFiles(entry.dependencyArray, hash) || (hash != storedHash)) {
+        return false;
+    }
+
+    if (b.getLength() - b.getPosition() < 4) {
+        return false;
+    }
+    const int numStages = b.readInt32();
+    if ((numStages < 0) || (numStages * 20 > b.getLength() - b.getPosition())) {
+        return false;
+    }
+    entry.stageArray.resize(numStages);
+    for (Stage& stage : entry.stageArray) {
+        if (! (readString32(b, stage.filename) &&
+               readString32(b, stage.preprocessedCode) &&
+               readString32(b, stage.g3dInsertString) &&
+               readString32(b, stage.versionString) &&
+               readString32(b, stage.extensionsString))) {
+            return false;
+        }
+    }
+
+    if (b.getLength() - b.getPosition() < 4) {
+        return false;
+    }
+    const int numFiles = b.readInt32();
+    entry.indexToFilenameTable.clear();
+    for (int i = 0; i < numFiles; ++i) {
+        if (b.getLength() - b.getPosition() < 4) {
+            return false;
+        }
+        const int index = b.readInt32();
+        if (! readString32(b, entry.indexToFilenameTable.getCreate(index))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool ShaderPreprocessCache::set(const String& key, const Entry& entry) {
+    uint64 hash = 0;
+    if (! hashFiles(entry.dependencyArray, hash)) {
+        return false;
+    }
+
+    const String& filename = entryFilename(key);
+    const String& tempFilename = filename + format(".%08x.tmp", Random::threadCommon().bits());
+
+    {
+        BinaryOutput b(tempFilename, G3D_LITTLE_ENDIAN);
+        b.writeString32(ENTRY_MAGIC);
+        b.writeUInt32(ENTRY_VERSION);
+        b.writeString32(key);
+        b.writeUInt64(hash);
+
+        b.writeInt32(entry.dependencyArray.size());
+        for (const String& dependency : entry.dependencyArray) {
+            b.writeString32(dependency);
+        }
+
+        b.writeInt32(entry.stageArray.size());
+        for (const Stage& stage : entry.stageArray) {
+            b.writeString32(stage.filename);
+            b.writeString32(stage.preprocessedCode);
+            b.writeString32(stage.g3dInsertString);
+            b.writeString32(stage.versionString);
+            b.writeString32(stage.extensionsString);
+        }
+
+        b.writeInt32(entry.indexToFilenameTable.size());
+        for (Table<int, String>::Iterator it = entry.indexToFilenameTable.begin(); it.isValid(); ++it) {
+            b.writeInt32(it->key);
+            b.writeString32(it->value);
+        }
+
+        b.commit();
+    }
+
+    // Rename is atomic, so readers see either the old entry or the complete new one
+    if (FileSystem::rename(tempFilename, filename) != 0) {
+        // Windows cannot rename over an existing file
+        FileSystem::removeFile(filename);
+        if (FileSystem::rename(tempFilename, filename) != 0) {
+            FileSystem::removeFile(tempFilename);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void ShaderPreprocessCache::clear() {
+    FileSystem::removeFile(FilePath::concat(m_directory, "*.g3dpp"));
+}
+
+} // namespace G3D
@@ -269,6 +269,9 @@ bool Shader::processIncludes(const String& dir, String& code, String& messages,
                             format("#error Macro used in shader but not bound to Args at runtime in \"#include %s\"\n", includedFilenameOrVariable.c_str()) : 
                             readWholeFile(includedFilenameOrVariable);
 
+                        if (! macroArgumentNotBound && ! m_dependencyArray.contains(includedFilenameOrVariable)) {
+                            m_dependencyArray.append(includedFilenameOrVariable);
+                        }
                         includedValue = contents;
                     } else if (! includeFilesAtMostOnce) {
                         // If this wasn't the first time that we've loaded this include file, then just skip it.
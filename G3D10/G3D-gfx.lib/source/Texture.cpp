@@ -19,6 +19,8 @@
 #include "G3D-base/CPUPixelTransferBuffer.h"
 #include "G3D-base/format.h"
 #include "G3D-base/CubeMap.h"
+#include "G3D-base/ImageResampler.h"
+#include "G3D-base/ThreadsafeQueue.h"
 #include "G3D-gfx/glcalls.h"
 #include "G3D-gfx/Texture.h"
 #include "G3D-gfx/getOpenGLState.h"
@@ -27,6 +29,7 @@
 #include "G3D-gfx/RenderDevice.h"
 #include "G3D-gfx/Shader.h"
 #include "G3D-gfx/GLPixelTransferBuffer.h"
+#include "G3D-gfx/TextureTranscodeCache.h"
 #include "G3D-app/BumpMap.h"
 #include "G3D-app/GApp.h"
 #include "G3D-app/VideoRecordDialog.h"
@@ -172,7 +175,29 @@ static void computeStats
 void Texture::completeCPULoading() {
     debugAssert(notNull(m_loadingInfo));
 
+    // Empty unless the result of PREPROCESS should be stored in s_transcodeCache
+    String transcodeKey;
+
     if (m_loadingInfo->nextStep == LoadingInfo::LOAD_FROM_DISK) {
+        if (notNull(s_transcodeCache) && m_loadingInfo->lazyLoadable) {
+            // Key on the contents of every source file
+            const int numFaces = (m_dimension == DIM_CUBE_MAP) ? 6 : 1;
+            uint64 sourceHash = TextureTranscodeCache::hashBytes(nullptr, 0);
+            bool hashed = true;
+            for (int f = 0; (f < numFaces) && hashed; ++f) {
+                uint64 fileHash = 0;
+                hashed = TextureTranscodeCache::hashFile(m_loadingInfo->filename[f], fileHash);
+                sourceHash = TextureTranscodeCache::hashBytes(&fileHash, sizeof(fileHash), sourceHash);
+            }
+
+            if (hashed) {
+                transcodeKey = transcodeCacheKey(sourceHash);
+                if (loadFromTranscodeCache(transcodeKey)) {
+                    return;
+                }
+            }
+        }
+
         // Only the first MIP is used by the code path below
         m_loadingInfo->ptbArray.resize(1);
         Array<shared_ptr<PixelTransferBuffer>>& faceArray = m_loadingInfo->ptbArray[0];
@@ -356,7 +381,23 @@ void Texture::completeCPULoading() {
                 break;
             }
 
-            if (computeNormal) {
+            if (computeNormal && m_loadingInfo->generateMipMaps && (m_dimension == DIM_2D)) {
+                // Build the MIP chain on the CPU, because glGenerateMipmap would average
+                // the packed normals without renormalizing them
+                Array<shared_ptr<PixelTransferBuffer>> mipArray;
+                BumpMap::computeNormalMap(src->width(), src->height(), src->format()->numComponents, 
+                                          reinterpret_cast<const unorm8*>(src->mapRead()),
+                                          mipArray, m_loadingInfo->preprocess.bumpMapPreprocess);
+                src->unmap();
+                m_loadingInfo->ptbArray.resize(mipArray.size());
+                for (int level = 0; level < mipArray.size(); ++level) {
+                    m_loadingInfo->ptbArray[level].resize(1);
+                    m_loadingInfo->ptbArray[level][0] = mipArray[level];
+                }
+                m_encoding.format            = m_loadingInfo->ptbArray[0][0]->format();
+                m_encoding.readMultiplyFirst = Color3::one() * 2.0f;
+                m_encoding.readAddSecond     = -Color3::one();
+            } else if (computeNormal) {
                 m_loadingInfo->ptbArray[0][0] = BumpMap::computeNormalMap(src->width(), src->height(), src->format()->numComponents, 
                                                            reinterpret_cast<const unorm8*>(src->mapRead()),
                                                            m_loadingInfo->preprocess.bumpMapPreprocess);
@@ -398,12 +439,99 @@ void Texture::completeCPULoading() {
         }
 
         debugAssert(notNull(m_encoding.format));
+
+        if (! transcodeKey.empty()) {
+            storeInTranscodeCache(transcodeKey);
+        }
     
         m_loadingInfo->nextStep = LoadingInfo::TRANSFER_TO_GPU;
     }
 }
 
 
+String Texture::transcodeCacheKey(uint64 sourceHash) const {
+    const Preprocess& preprocess = m_loadingInfo->preprocess;
+
+    // Preprocess::toAny() omits the offset
+    return G3D::format("%016llx %d %d %d\n", (unsigned long long)sourceHash, int(m_dimension), 
+                  int(m_loadingInfo->generateMipMaps), int(m_loadingInfo->preferSRGBForAuto)) +
+        preprocess.toAny().unparse() + "\n" + preprocess.offset.toString() + "\n" +
+        m_encoding.toAny().unparse();
+}
+
+
+bool Texture::loadFromTranscodeCache(const String& key) {
+    TextureTranscodeCache::Entry entry;
+    if (! s_transcodeCache->get(key, entry)) {
+        return false;
+    }
+
+    const shared_ptr<PixelTransferBuffer>& base = entry.mipArray[0][0];
+    if ((entry.mipArray[0].size() != ((m_dimension == DIM_CUBE_MAP) ? 6 : 1)) ||
+        (base->width() != m_width) || (base->height() != m_height) || (base->depth() != m_depth)) {
+        // Should only happen on a hash collision
+        return false;
+    }
+
+    m_loadingInfo->ptbArray = entry.mipArray;
+    m_encoding.format            = entry.encodingFormat;
+    m_encoding.readMultiplyFirst = entry.readMultiplyFirst;
+    m_encoding.readAddSecond     = entry.readAddSecond;
+    m_min          = entry.min;
+    m_max          = entry.max;
+    m_mean         = entry.mean;
+    m_detectedHint = entry.detectedHint;
+
+    delete m_loadingInfo->binaryInput;
+    m_loadingInfo->binaryInput = nullptr;
+    m_loadingInfo->nextStep = LoadingInfo::TRANSFER_TO_GPU;
+    return true;
+}
+
+
+void Texture::storeInTranscodeCache(const String& key) {
+    MIPCubeFacePTBArray& ptbArray = m_loadingInfo->ptbArray;
+
+    if (m_loadingInfo->generateMipMaps && (ptbArray.size() == 1) && 
+        ((m_dimension == DIM_2D) || (m_dimension == DIM_CUBE_MAP)) && 
+        ! ptbArray[0][0]->format()->compressed) {
+        // Compute the MIP chain here so that later runs can load it instead of calling
+        // glGenerateMipmap. Match that: a box filter, in linear space for sRGB, without alpha weighting.
+        ImageResampler::Specification specification;
+        specification.filter        = ImageResampler::Filter::BOX;
+        specification.sRGB          = (m_encoding.format->colorSpace == ImageFormat::COLOR_SPACE_SRGB);
+        specification.alphaWeighted = false;
+
+        try {
+            MIPCubeFacePTBArray mipArray;
+            for (int f = 0; f < ptbArray[0].size(); ++f) {
+                Array<shared_ptr<Image>> faceMipArray;
+                ImageResampler::generateMipMaps(Image::fromPixelTransferBuffer(ptbArray[0][f]), faceMipArray, specification);
+                mipArray.resize(faceMipArray.size());
+                mipArray[0].append(ptbArray[0][f]);
+                for (int level = 1; level < faceMipArray.size(); ++level) {
+                    mipArray[level].append(faceMipArray[level]->toPixelTransferBuffer());
+                }
+            }
+            ptbArray = mipArray;
+        } catch (...) {
+            // Image cannot represent this format, so leave MIP generation to the GPU
+        }
+    }
+
+    TextureTranscodeCache::Entry entry;
+    entry.encodingFormat    = m_encoding.format;
+    entry.readMultiplyFirst = m_encoding.readMultiplyFirst;
+    entry.readAddSecond     = m_encoding.readAddSecond;
+    entry.min               = m_min;
+    entry.max               = m_max;
+    entry.mean              = m_mean;
+    entry.detectedHint      = m_detectedHint;
+    entry.mipArray          = ptbArray;
+    s_transcodeCache->set(key, entry);
+}
+
+
 void Texture::completeGPULoading() {
     debugAssert(notNull(m_loadingInfo) && 
         (m_loadingInfo->nextStep >= LoadingInfo::TRANSFER_TO_GPU));
@@ -542,28 +670,144 @@ void Texture::completeGPULoading() {
 }
 
 
+namespace {
+
+/** The shared pool of threads that run Texture::completeCPULoading for lazily
+    loaded textures. It is bounded and persistent, so that loading thousands of
+    textures neither creates thousands of threads nor decodes thousands of images
+    at once. */
+class TextureDecodePool {
+private:
+
+    ThreadsafeQueue<std::function<void ()>>     m_queue;
+    Array<std::thread*>                         m_threadArray;
+    std::atomic<bool>                           m_quit;
+
+    void threadMain() {
+        std::function<void ()> job;
+        while (! m_quit) {
+            if (m_queue.waitPopFront(job) && job) {
+                job();
+                // Release anything that the job captured
+                job = nullptr;
+            }
+        }
+    }
+
+public:
+
+    explicit TextureDecodePool(int numThreads) : m_quit(false) {
+        for (int t = 0; t < numThreads; ++t) {
+            m_threadArray.append(new std::thread([this]() { threadMain(); }));
+        }
+    }
+
+    /** Abandons queued jobs, and waits for running ones */
+    ~TextureDecodePool() {
+        m_quit = true;
+        // Wake each thread with an empty job
+        for (int t = 0; t < m_threadArray.size(); ++t) {
+            m_queue.pushBack(nullptr);
+        }
+        for (std::thread* thread : m_threadArray) {
+            thread->join();
+            delete thread;
+        }
+    }
+
+    void enqueue(const std::function<void ()>& job) {
+        m_queue.pushBack(job);
+    }
+
+    static TextureDecodePool& instance() {
+        // Leave a core for the GL thread. More threads than this are limited by
+        // disk and memory bandwidth rather than decoding.
+        static TextureDecodePool pool(clamp(int(std::thread::hardware_concurrency()) - 1, 1, 8));
+        return pool;
+    }
+};
+
+} // namespace
+
+
+void Texture::queueCPULoading(const shared_ptr<Texture>& texture) {
+    // Weak, so that textures released before a decode thread reaches them are never decoded
+    const weak_ptr<Texture> weakTexture = texture;
+    TextureDecodePool::instance().enqueue([weakTexture]() {
+        const shared_ptr<Texture>& texture = weakTexture.lock();
+        if (notNull(texture)) {
+            texture->runQueuedCPULoading();
+        }
+    });
+}
+
+
+void Texture::runQueuedCPULoading() {
+    {
+        std::lock_guard<std::mutex> guard(m_loadingMutex);
+        if (m_cpuLoadingState != CPU_LOADING_QUEUED) {
+            // force() reached this texture first
+            return;
+        }
+        m_cpuLoadingState = CPU_LOADING_RUNNING;
+    }
+    runCPULoading();
+}
+
+
+void Texture::runCPULoading() {
+    std::exception_ptr exception;
+    try {
+        completeCPULoading();
+    } catch (...) {
+        exception = std::current_exception();
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_loadingMutex);
+        m_cpuLoadingException = exception;
+        m_cpuLoadingState = CPU_LOADING_DONE;
+    }
+    m_cpuLoadingCondition.notify_all();
+}
+
+
 void Texture::force() const {
     // Quick, mutex-less conservative out for the common run-time case
     if (! m_needsForce) { return; }
 
-    m_loadingMutex.lock(); {
-        // Check for race condition
-        if (! m_needsForce) { m_loadingMutex.unlock(); return; }
+    std::unique_lock<std::mutex> lock(m_loadingMutex);
+    // Check for race condition
+    if (! m_needsForce) { return; }
 
-        debugAssert(notNull(m_loadingInfo));
-        debugAssert(notNull(m_loadingThread));
+    debugAssert(notNull(m_loadingInfo));
+    Texture* me = const_cast<Texture*>(this);
 
-        // Block on the actual loading operation
-        m_loadingThread->join();
-        // Free the callback code
-        delete m_loadingThread;
-        m_loadingThread = nullptr;       
-        // Upload to GL
-        const_cast<Texture*>(this)->completeGPULoading();
+    if (m_cpuLoadingState == CPU_LOADING_QUEUED) {
+        // No decode thread has reached this texture, so load it here instead of
+        // waiting for the rest of the queue
+        m_cpuLoadingState = CPU_LOADING_RUNNING;
+        lock.unlock();
+        me->runCPULoading();
+        lock.lock();
+    }
 
-        debugAssert(isNull(m_loadingInfo));
-        m_needsForce = false;
-    } m_loadingMutex.unlock();
+    // Block on the actual loading operation
+    m_cpuLoadingCondition.wait(lock, [this]() { return m_cpuLoadingState == CPU_LOADING_DONE; });
+    if (! m_needsForce) {
+        // Completed by another caller while this one was loading
+        return;
+    }
+
+    if (m_cpuLoadingException) {
+        std::rethrow_exception(m_cpuLoadingException);
+    }
+
+    // Upload to GL
+    me->completeGPULoading();
+
+    debugAssert(isNull(m_loadingInfo));
+    m_needsForce = false;
 }
 
 
@@ -655,6 +899,14 @@ WeakCache<uintptr_t, shared_ptr<Texture> > Texture::s_allTextures;
 
 WeakCache<Texture::Specification, shared_ptr<Texture> > Texture::s_cache;
 
+shared_ptr<TextureTranscodeCache> Texture::s_transcodeCache;
+
+
+void Texture::setTranscodeCache(const shared_ptr<TextureTranscodeCache>& cache) {
+    s_transcodeCache = cache;
+}
+
+
 shared_ptr<Texture> Texture::getTextureByName(const String& name) {
     Array<shared_ptr<Texture> > allTextures;
     getAllTextures(allTextures);
@@ -1374,12 +1626,8 @@ shared_ptr<Texture> Texture::fromFile
         instance->completeCPULoading();
         instance->completeGPULoading();
     } else {
-        instance->m_loadingThread = new std::thread([instance]() { instance->completeCPULoading(); });
-#       if defined(G3D_WINDOWS) && 0
-            String sname = String("Loading ") + instance->m_name;
-            std::wstring wname(sname.begin(), sname.end());
-            SetThreadDescription(instance->m_loadingThread->native_handle(), wname.c_str());
-#       endif
+        instance->m_cpuLoadingState = CPU_LOADING_QUEUED;
+        queueCPULoading(instance);
     }
 
     return instance;
@@ -2234,13 +2482,16 @@ bool Texture::isSupportedImage(const String& filename) {
 Texture::~Texture() {
     reallocateHook(m_textureID);
     s_allTextures.remove((uintptr_t)this);
-    if (m_destroyGLTextureInDestructor) {
-        if (notNull(m_loadingThread)) {
-            m_loadingThread->detach();
-            delete m_loadingThread;
-            m_loadingThread = nullptr;
-        }
 
+    if (notNull(m_loadingInfo)) {
+        // Released before force(). Decode threads hold a reference while
+        // loading, so none can be using m_loadingInfo.
+        delete m_loadingInfo->binaryInput;
+        delete m_loadingInfo;
+        m_loadingInfo = nullptr;
+    }
+
+    if (m_destroyGLTextureInDestructor) {
         m_sizeOfAllTexturesInMemory -= sizeInMemory();
         if (m_textureID != GL_NONE) {
             glDeleteTextures(1, &m_textureID);
@@ -0,0 +1,344 @@
+/**
+  \file G3D-gfx.lib/source/TextureTranscodeCache.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-gfx/TextureTranscodeCache.h"
+#include "G3D-base/FileSystem.h"
+#include "G3D-base/BinaryInput.h"
+#include "G3D-base/BinaryOutput.h"
+#include "G3D-base/CPUPixelTransferBuffer.h"
+#include "G3D-base/ImageFormat.h"
+#include "G3D-base/Random.h"
+#include "G3D-base/System.h"
+#include "G3D-base/format.h"
+
+namespace G3D {
+
+/** Identifies entry files. Increment the version whenever the entry layout
+    or the Texture preprocessing output changes, so that old entries are ignored. */
+static const char   ENTRY_MAGIC[8]  = {'G', '3', 'D', 'T', 'T', 'C', '\0', '\0'};
+static const uint32 ENTRY_VERSION   = 1;
+
+/** Magic, version, and header size */
+static const int    PREFIX_BYTES    = 16;
+
+/** Alignment of the header and of each level in the file */
+static const int64  DATA_ALIGNMENT  = 64;
+
+static const uint64 FNV_PRIME_64    = 0x100000001B3ULL;
+
+static int64 alignUp(int64 x) {
+    return (x + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+}
+
+
+/** Like BinaryInput::readString32, but fails instead of reading past the end of a truncated header */
+static bool readString32(BinaryInput& b, String& s) {
+    if (b.getLength() - b.getPosition() < 4) {
+        return false;
+    }
+    const int64 length = b.readUInt32();
+    if (b.getLength() - b.getPosition() < length) {
+        return false;
+    }
+    s = b.readString(length);
+    return true;
+}
+
+
+/** Reads exactly \a length bytes, in chunks that fit in size_t on all platforms */
+static bool readFully(FILE* file, void* data, int64 length) {
+    uint8* byte = (uint8*)data;
+    while (length > 0) {
+        const size_t chunk = size_t(min(length, int64(1) << 30));
+        if (fread(byte, 1, chunk, file) != chunk) {
+            return false;
+        }
+        byte += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+
+TextureTranscodeCache::TextureTranscodeCache(const String& directory) : m_directory(directory) {
+    if (! FileSystem::exists(m_directory, false)) {
+        FileSystem::createDirectory(m_directory);
+    }
+}
+
+
+shared_ptr<TextureTranscodeCache> TextureTranscodeCache::create(const String& directory) {
+    return createShared<TextureTranscodeCache>(directory);
+}
+
+
+String TextureTranscodeCache::entryFilename(const String& key) const {
+    const uint64 hash = hashBytes(key.c_str(), key.size());
+    return FilePath::concat(m_directory, format("%016llx.g3dtc", (unsigned long long)hash));
+}
+
+
+uint64 TextureTranscodeCache::hashBytes(const void* data, size_t length, uint64 hash) {
+    // FNV-1a over 64-bit words and then the remaining bytes. Image files are
+    // large, and the byte-at-a-time version is slower than reading a cache entry.
+    const uint8* byte = (const uint8*)data;
+    size_t i = 0;
+    for (; i + sizeof(uint64) <= length; i += sizeof(uint64)) {
+        uint64 word;
+        memcpy(&word, byte + i, sizeof(word));
+        hash = (hash ^ word) * FNV_PRIME_64;
+    }
+    for (; i < length; ++i) {
+        hash = (hash ^ byte[i]) * FNV_PRIME_64;
+    }
+    return hash;
+}
+
+
+bool TextureTranscodeCache::hashFile(const String& filename, uint64& hash) {
+    // Read directly instead of through BinaryInput, which would consult the
+    // FileSystem cache and keep the whole file in memory
+    FILE* file = FileSystem::fopen(filename.c_str(), "rb");
+    if (isNull(file)) {
+        return false;
+    }
+
+    hash = hashBytes(nullptr, 0);
+    static const size_t bufferSize = 1024 * 1024;
+    uint8* buffer = (uint8*)System::malloc(bufferSize);
+    size_t n = 0;
+    while ((n = fread(buffer, 1, bufferSize, file)) > 0) {
+        hash = hashBytes(buffer, n, hash);
+    }
+    const bool ok = ! ferror(file);
+    System::free(buffer);
+    FileSystem::fclose(file);
+    return ok;
+}
+
+
+bool TextureTranscodeCache::get(const String& key, Entry& entry) const {
+    FILE* file = FileSystem::fopen(entryFilename(key).c_str(), "rb");
+    if (isNull(file)) {
+        return false;
+    }
+
+    bool ok = false;
+    // A loop so that every failure can break to the single fclose below
+    do {
+        uint8 prefix[PREFIX_BYTES];
+        if (! readFully(file, prefix, PREFIX_BYTES)) {
+            break;
+        }
+
+        BinaryInput p(prefix, PREFIX_BYTES, G3D_LITTLE_ENDIAN, false, false);
+        uint8 magic[sizeof(ENTRY_MAGIC)];
+        p.readBytes(magic, sizeof(magic));
+        if ((memcmp(magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) != 0) || (p.readUInt32() != ENTRY_VERSION)) {
+            // Another format
+            break;
+        }
+        const int64 headerBytes = p.readUInt32();
+        if ((headerBytes < PREFIX_BYTES) || (headerBytes % DATA_ALIGNMENT != 0) || (headerBytes > 64 * 1024 * 1024)) {
+            break;
+        }
+
+        Array<uint8> header;
+        header.resize(int(headerBytes - PREFIX_BYTES));
+        if (! readFully(file, header.getCArray(), header.size())) {
+            break;
+        }
+        BinaryInput b(header.getCArray(), header.size(), G3D_LITTLE_ENDIAN, false, false);
+
+        String storedKey, pixelFormatName, encodingFormatName, hintName;
+        if (! readString32(b, storedKey) || (storedKey != key)) {
+            // A different key with the same hash
+            break;
+        }
+        if (! (readString32(b, pixelFormatName) && readString32(b, encodingFormatName) && readString32(b, hintName))) {
+            break;
+        }
+
+        const ImageFormat* pixelFormat = ImageFormat::fromString(pixelFormatName);
+        entry.encodingFormat = ImageFormat::fromString(encodingFormatName);
+        if (isNull(pixelFormat) || isNull(entry.encodingFormat) || pixelFormat->compressed) {
+            break;
+        }
+
+        if (b.getLength() - b.getPosition() < 5 * 16 + 8) {
+            break;
+        }
+        entry.readMultiplyFirst = b.readColor4();
+        entry.readAddSecond     = b.readColor4();
+        entry.min               = b.readColor4();
+        entry.max               = b.readColor4();
+        entry.mean              = b.readColor4();
+        try {
+            entry.detectedHint = AlphaFilter(hintName);
+        } catch (...) {
+            break;
+        }
+
+        const int numLevels = b.readInt32();
+        const int numFaces  = b.readInt32();
+        const int recordBytes = 3 * 4 + 2 * 8;
+        if ((numLevels < 1) || (numFaces < 1) || (int64(numLevels) * numFaces * recordBytes > b.getLength() - b.getPosition())) {
+            break;
+        }
+
+        // Check each record before allocating its buffer
+        entry.mipArray.resize(numLevels);
+        Array<int64> offsetArray;
+        bool tableOK = true;
+        int64 end = 0;
+        for (int level = 0; (level < numLevels) && tableOK; ++level) {
+            entry.mipArray[level].resize(numFaces);
+            for (int face = 0; (face < numFaces) && tableOK; ++face) {
+                const int width  = b.readInt32();
+                const int height = b.readInt32();
+                const int depth  = b.readInt32();
+                const int64 offset = int64(b.readUInt64());
+                const int64 bytes  = int64(b.readUInt64());
+                tableOK = (width > 0) && (height > 0) && (depth > 0) && (offset == alignUp(end)) &&
+                    (bytes == int64(width) * height * depth * pixelFormat->cpuBitsPerPixel / 8);
+                if (tableOK) {
+                    entry.mipArray[level][face] = CPUPixelTransferBuffer::create(width, height, pixelFormat, MemoryManager::create(), depth, 1);
+                    offsetArray.append(offset);
+                    end = offset + bytes;
+                }
+            }
+        }
+        if (! tableOK) {
+            break;
+        }
+
+        // The levels are contiguous apart from alignment padding, so read sequentially
+        int64 position = 0;
+        uint8 padding[DATA_ALIGNMENT];
+        bool dataOK = true;
+        for (int level = 0, i = 0; (level < numLevels) && dataOK; ++level) {
+            for (int face = 0; (face < numFaces) && dataOK; ++face, ++i) {
+                const shared_ptr<PixelTransferBuffer>& ptb = entry.mipArray[level][face];
+                dataOK = readFully(file, padding, offsetArray[i] - position) &&
+                    readFully(file, ptb->mapWrite(), ptb->size());
+                ptb->unmap();
+                position = offsetArray[i] + int64(ptb->size());
+            }
+        }
+        ok = dataOK;
+    } while (false);
+
+    FileSystem::fclose(file);
+    if (! ok) {
+        entry.mipArray.clear();
+    }
+    return ok;
+}
+
+
+bool TextureTranscodeCache::set(const String& key, const Entry& entry) {
+    if ((entry.mipArray.size() == 0) || (entry.mipArray[0].size() == 0) || isNull(entry.encodingFormat)) {
+        return false;
+    }
+    const int numLevels = entry.mipArray.size();
+    const int numFaces  = entry.mipArray[0].size();
+    const ImageFormat* pixelFormat = entry.mipArray[0][0]->format();
+    if (pixelFormat->compressed) {
+        return false;
+    }
+
+    // Everything after the prefix
+    BinaryOutput body("<memory>", G3D_LITTLE_ENDIAN);
+    body.writeString32(key);
+    body.writeString32(pixelFormat->name());
+    body.writeString32(entry.encodingFormat->name());
+    body.writeString32(entry.detectedHint.toString());
+    body.writeColor4(entry.readMultiplyFirst);
+    body.writeColor4(entry.readAddSecond);
+    body.writeColor4(entry.min);
+    body.writeColor4(entry.max);
+    body.writeColor4(entry.mean);
+    body.writeInt32(numLevels);
+    body.writeInt32(numFaces);
+
+    int64 end = 0;
+    for (const Array<shared_ptr<PixelTransferBuffer>>& faceArray : entry.mipArray) {
+        if (faceArray.size() != numFaces) {
+            return false;
+        }
+        for (const shared_ptr<PixelTransferBuffer>& ptb : faceArray) {
+            const int64 bytes = int64(ptb->width()) * ptb->height() * ptb->depth() * pixelFormat->cpuBitsPerPixel / 8;
+            if ((ptb->format() != pixelFormat) || (int64(ptb->size()) != bytes)) {
+                // Mixed formats, or padded rows
+                return false;
+            }
+            body.writeInt32(ptb->width());
+            body.writeInt32(ptb->height());
+            body.writeInt32(ptb->depth());
+            body.writeUInt64(alignUp(end));
+            body.writeUInt64(bytes);
+            end = alignUp(end) + bytes;
+        }
+    }
+
+    BinaryOutput header("<memory>", G3D_LITTLE_ENDIAN);
+    header.writeBytes(ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+    header.writeUInt32(ENTRY_VERSION);
+    header.writeUInt32(uint32(alignUp(PREFIX_BYTES + body.length())));
+    header.writeBytes(body.getCArray(), body.length());
+
+    const String& filename = entryFilename(key);
+    const String& tempFilename = filename + format(".%08x.tmp", Random::threadCommon().bits());
+
+    FILE* file = FileSystem::fopen(tempFilename.c_str(), "wb");
+    if (isNull(file)) {
+        return false;
+    }
+
+    // Write the pixels straight from the buffers, rather than copying them into a BinaryOutput
+    static const uint8 zero[DATA_ALIGNMENT] = {};
+    bool ok = (fwrite(header.getCArray(), 1, size_t(header.length()), file) == size_t(header.length())) &&
+        (fwrite(zero, 1, size_t(alignUp(header.length()) - header.length()), file) == size_t(alignUp(header.length()) - header.length()));
+
+    int64 position = 0;
+    for (int level = 0; (level < numLevels) && ok; ++level) {
+        for (int face = 0; (face < numFaces) && ok; ++face) {
+            const shared_ptr<PixelTransferBuffer>& ptb = entry.mipArray[level][face];
+            const size_t padding = size_t(alignUp(position) - position);
+            ok = (fwrite(zero, 1, padding, file) == padding) &&
+                (fwrite(ptb->mapRead(), 1, ptb->size(), file) == ptb->size());
+            ptb->unmap();
+            position = alignUp(position) + ptb->size();
+        }
+    }
+    FileSystem::fclose(file);
+
+    if (! ok) {
+        FileSystem::removeFile(tempFilename);
+        return false;
+    }
+
+    // Rename is atomic, so readers see either the old entry or the complete new one
+    if (FileSystem::rename(tempFilename, filename) != 0) {
+        // Windows cannot rename over an existing file
+        FileSystem::removeFile(filename);
+        if (FileSystem::rename(tempFilename, filename) != 0) {
+            FileSystem::removeFile(tempFilename);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void TextureTranscodeCache::clear() {
+    FileSystem::removeFile(FilePath::concat(m_directory, "*.g3dtc"));
+}
+
+} // namespace G3D
@@ -29,10 +29,39 @@ static const String SYMBOL_SPACE = " ";
 static const String SYMBOL_NEWLINE = "\n";
 static const String SYMBOL_POUND_define = "#define ";
 
+static const uint64 FNV_OFFSET_64 = 0xCBF29CE484222325ULL;
+static const uint64 FNV_PRIME_64  = 0x100000001B3ULL;
+
+/** Extends the FNV-1a hash \a h with the characters of \a s */
+static uint64 fnv1a(uint64 h, const String& s) {
+    const char* c = s.c_str();
+    for (size_t i = 0; i < s.size(); ++i) {
+        h = (h ^ uint64(uint8(c[i]))) * FNV_PRIME_64;
+    }
+    return h;
+}
+
+
+uint64 UniformTable::macroHash(const String& name, const String& value) {
+    // The separator keeps ("AB", "C") and ("A", "BC") distinct
+    uint64 h = fnv1a(FNV_OFFSET_64, name);
+    h = (h ^ uint64('=')) * FNV_PRIME_64;
+    h = fnv1a(h, value);
+
+    // Finalize (from MurmurHash3) so that the sums in m_macroHash do not cancel
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+
 UniformTable::~UniformTable() {}
 
 
-UniformTable::UniformTable(const Any& any) {
+UniformTable::UniformTable(const Any& any) : m_preambleHash(FNV_OFFSET_64), m_macroHash(0) {
     for (Table<String, Any>::Iterator it = any.table().begin(); it.hasMore(); ++it) {
         const Any& v = it->value;
         switch (v.type()) {
@@ -98,6 +127,53 @@ UniformTable::UniformTable(const Any& any) {
 
 void UniformTable::setPreamble(const String& preamble) {
     m_preamble = preamble;
+    m_preambleHash = fnv1a(FNV_OFFSET_64, preamble);
+}
+
+
+void UniformTable::appendToPreamble(const String& extra) {
+    m_preamble += extra;
+    m_preambleHash = fnv1a(m_preambleHash, extra);
+}
+
+
+uint64 UniformTable::variantHash() const {
+    return (m_preambleHash * FNV_PRIME_64) ^ m_macroHash;
+}
+
+
+bool UniformTable::samePreambleAndMacros(const String& preamble, const Array<MacroArgPair>& macroArgArray) const {
+    if ((m_macroArgs.size() != macroArgArray.size()) || (m_preamble != preamble)) {
+        return false;
+    }
+
+    // Names are unique within each table, so matching every one of ours
+    // to an equal argument implies the sets are equal
+    for (int i = 0; i < m_macroArgs.size(); ++i) {
+        const MacroArgPair& arg = m_macroArgs[i];
+
+        // The same call site usually sets macros in the same order
+        int j = i;
+        if (macroArgArray[j].name != arg.name) {
+            for (j = 0; (j < macroArgArray.size()) && (macroArgArray[j].name != arg.name); ++j) {}
+            if (j == macroArgArray.size()) {
+                return false;
+            }
+        }
+
+        if (macroArgArray[j].value != arg.value) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void UniformTable::getMacroArgs(Array<MacroArgPair>& macroArgArray) const {
+    for (int i = 0; i < m_macroArgs.size(); ++i) {
+        macroArgArray.append(m_macroArgs[i]);
+    }
 }
 
 
@@ -260,12 +336,16 @@ void UniformTable::setMacro(const String& name, const String& value) {
 
     for (int i = 0; i < m_macroArgs.size(); ++i){
         if (m_macroArgs[i].name == name) {
-            m_macroArgs[i].value = value;
+            if (m_macroArgs[i].value != value) {
+                m_macroHash += macroHash(name, value) - macroHash(name, m_macroArgs[i].value);
+                m_macroArgs[i].value = value;
+            }
             return;
         }
     }
 
     m_macroArgs.append(MacroArgPair(name, value));
+    m_macroHash += macroHash(name, value);
 }
 
 
@@ -719,7 +799,7 @@ void UniformTable::setUniform(const String& name, const shared_ptr<BindlessTextu
 }
 
 
-UniformTable::UniformTable() {}
+UniformTable::UniformTable() : m_preambleHash(FNV_OFFSET_64), m_macroHash(0) {}
 
 void UniformTable::setArrayUniform(const String& name, int index, const shared_ptr<BindlessTextureHandle>& val, bool optional) {
     Arg& arg = m_uniformArgs.getCreate(name + format("[%d]", index));
@@ -97,6 +97,51 @@ void testMeshAlgTangentSpace();
 void perfQueue();
 void testQueue();
 
+void perfLog();
+void testLog();
+
+void perfSurfaceCuller();
+void testSurfaceCuller();
+void perfWelder();
+void testWelder();
+void perfLightTree();
+void testLightTree();
+
+void perfCubeMapSampler();
+void testCubeMapSampler();
+void perfUniformTable();
+void testUniformTable();
+
+void perfCollisionWorld();
+void testCollisionWorld();
+
+void perfEntityReplicator();
+void testEntityReplicator();
+
+void perfImageResampler();
+void testImageResampler();
+void perfVideoOutput();
+void perfVideoInput();
+
+void testShaderPreprocessCache();
+
+void perfNetwork();
+void testNetwork();
+
+void perfFramePipeline();
+void testFramePipeline();
+
+void perfScenePose();
+void testScenePose();
+
+void perfTextureTranscodeCache();
+void testTextureTranscodeCache();
+void perfBumpMap();
+void testBumpMap();
+
+void perfGFont();
+void testGFont();
+
 void testBinaryIO();
 void testHugeBinaryIO();
 void perfBinaryIO();
@@ -746,6 +791,24 @@ int main(int argc, char* argv[]) {
 
         perfQueue();
 
+        perfLog();
+
+        perfSurfaceCuller();
+        perfWelder();
+        perfLightTree();
+        perfCubeMapSampler();
+        perfUniformTable();
+        perfCollisionWorld();
+        perfEntityReplicator();
+        perfImageResampler();
+        perfNetwork();
+        perfVideoOutput();
+        perfVideoInput();
+        perfFramePipeline();
+        perfScenePose();
+        perfTextureTranscodeCache();
+        perfBumpMap();
+
         perfMatrix3();
 
         perfTextOutput();
@@ -764,6 +827,7 @@ int main(int argc, char* argv[]) {
         }
 
         perfPointHashGrid();
+        perfGFont();
 
         measureRDPushPopPerformance(renderDevice);
         
@@ -833,6 +897,7 @@ int main(int argc, char* argv[]) {
     if (renderDevice) {
         testKDTree();
         testGLight();
+        testGFont();
     }
 
     if (renderDevice) {
@@ -878,6 +943,23 @@ int main(int argc, char* argv[]) {
 
     testQueue();
 
+    testLog();
+
+    testSurfaceCuller();
+    testWelder();
+    testLightTree();
+    testCubeMapSampler();
+    testUniformTable();
+    testCollisionWorld();
+    testEntityReplicator();
+    testImageResampler();
+    testShaderPreprocessCache();
+    testNetwork();
+    testFramePipeline();
+    testScenePose();
+    testTextureTranscodeCache();
+    testBumpMap();
+
     testMeshAlgTangentSpace();
 
     testConvexPolygon2D();
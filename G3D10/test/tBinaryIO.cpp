@@ -177,6 +177,53 @@ static void testCompression() {
         double j = g.readFloat64();
         testAssert(j == 1.234); (void)j;
     }
+
+    // Many small chunks, in both endians and in the older single-block format
+    const int N = 10000;
+    const G3DEndian endianArray[] = {G3D_LITTLE_ENDIAN, G3D_BIG_ENDIAN, G3D_LITTLE_ENDIAN};
+    const int chunkSizeArray[] = {1000, 1000, 0};
+    for (int t = 0; t < 3; ++t) {
+        {
+            BinaryOutput b("out.t", endianArray[t]);
+            for (int i = 0; i < N; ++i) {
+                b.writeInt32(i);
+            }
+            b.compress(6, chunkSizeArray[t]);
+            b.commit();
+        }
+
+        BinaryInput whole("out.t", endianArray[t], true);
+        testAssert(whole.size() == N * 4);
+        bool match = true;
+        for (int i = 0; i < N; ++i) {
+            match = (whole.readInt32() == i) && match;
+        }
+        testAssert(match);
+
+        // Random access to a range that starts and ends inside chunks
+        BinaryInput range("out.t", endianArray[t], 4 * 2345, 4 * 3000);
+        testAssert(range.size() == 4 * 3000);
+        for (int i = 0; i < 3000; ++i) {
+            match = (range.readInt32() == 2345 + i) && match;
+        }
+        testAssert(match);
+
+        // Past the end
+        BinaryInput tail("out.t", endianArray[t], 4 * (N - 1), 100);
+        testAssert(tail.size() == 4);
+        const int32 last = tail.readInt32();
+        testAssert(last == N - 1);
+    }
+
+    // In memory
+    BinaryOutput m("<memory>", G3D_LITTLE_ENDIAN);
+    m.writeString32("chunked");
+    m.compress(9, 3);
+    BinaryInput fromMemory(m.getCArray(), m.length(), G3D_LITTLE_ENDIAN, true);
+    const String& s = fromMemory.readString32();
+    testAssert(s == "chunked");
+
+    FileSystem::removeFile("out.t");
 }
 
 
@@ -258,10 +305,64 @@ static void measureOverhead() {
 }
 
 
+/** Compares the single-block and chunked compressed formats */
+static void measureCompression() {
+    const int N = 8 * 1024 * 1024;
+    Random rnd(1, false);
+    BinaryOutput data("<memory>", G3D_LITTLE_ENDIAN);
+    for (int i = 0; i < N; ++i) {
+        // Compressible, but not trivially so
+        data.writeFloat32(float(i / 64) + float(rnd.integer(0, 3)));
+    }
+
+    Stopwatch stopwatch;
+    chrono::nanoseconds compressTime[2], decompressTime[2];
+    for (int f = 0; f < 2; ++f) {
+        const int chunkSize = (f == 0) ? 0 : BinaryOutput::DEFAULT_COMPRESSION_CHUNK_SIZE;
+        BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
+        b.writeBytes(data.getCArray(), data.length());
+
+        stopwatch.tick();
+        b.compress(6, chunkSize);
+        stopwatch.tock();
+        compressTime[f] = stopwatch.elapsedDuration();
+
+        stopwatch.tick();
+        BinaryInput in(b.getCArray(), b.length(), G3D_LITTLE_ENDIAN, true);
+        stopwatch.tock();
+        decompressTime[f] = stopwatch.elapsedDuration();
+        testAssert(in.size() == data.length());
+    }
+
+    // Read 4 kB from the middle of a compressed file
+    {
+        BinaryOutput b("out.t", G3D_LITTLE_ENDIAN);
+        b.writeBytes(data.getCArray(), data.length());
+        b.compress(6);
+        b.commit();
+    }
+    stopwatch.tick();
+    BinaryInput range("out.t", G3D_LITTLE_ENDIAN, data.length() / 2, 4096);
+    stopwatch.tock();
+    const chrono::nanoseconds rangeTime = stopwatch.elapsedDuration();
+    testAssert(range.size() == 4096);
+    FileSystem::removeFile("out.t");
+
+    const double MB = double(data.length()) / (1024.0 * 1024.0);
+    PRINT_HEADER("Compression");
+    PRINT_MILLI("Single block compress", "(ms/MB)", compressTime[0] / MB);
+    PRINT_MILLI("Chunked compress", "(ms/MB)", compressTime[1] / MB);
+    PRINT_MILLI("Single block decompress", "(ms/MB)", decompressTime[0] / MB);
+    PRINT_MILLI("Chunked decompress", "(ms/MB)", decompressTime[1] / MB);
+    PRINT_MILLI("Chunked 4 kB range", "(ms)", rangeTime);
+}
+
+
 void perfBinaryIO() {
     PRINT_SECTION("Performance: BinaryOutput", "Measures performance of read/write operations");
     measureOverhead();
     measureSerializerPerformance();
+    measureCompression();
 }
 
 
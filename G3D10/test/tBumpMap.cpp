@@ -0,0 +1,278 @@
+/**
+  \file test/tBumpMap.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+/** The straightforward per-pixel Sobel filter that BumpMap::computeNormalMap must match exactly */
+static shared_ptr<CPUPixelTransferBuffer> referenceNormalMap(int w, int h, int channels, const unorm8* B, const BumpMapPreprocess& preprocess) {
+    const shared_ptr<CPUPixelTransferBuffer>& normal = CPUPixelTransferBuffer::create(w, h, ImageFormat::RGBA8());
+    Color4unorm8* N = static_cast<Color4unorm8*>(normal->buffer());
+    float whiteHeightInPixels = preprocess.zExtentPixels;
+    if (whiteHeightInPixels < 0.0f) {
+        whiteHeightInPixels = max(w, h) * -whiteHeightInPixels * 0.15f;
+    }
+    const float elevationInvScale = 255.0f / whiteHeightInPixels;
+
+    runConcurrently(Point2int32(0, 0), Point2int32(w, h), [&](const Point2int32& P) {
+        const int x = P.x;
+        const int y = P.y;
+        const int i = x + y * w;
+        const auto E = [&](int dx, int dy) { return int(B[((dx + x + w) % w + ((dy + y + h) % h) * w) * channels].bits()); };
+
+        Vector3 delta;
+        delta.y = float(-(E(-1, -1) + E(0, -1) * 2 + E(1, -1) - E(-1, 1) - E(0, 1) * 2 - E(1, 1)));
+        delta.x = float(-(-E(-1, -1) + E(1, -1) - E(-1, 0) * 2 + E(1, 0) * 2 - E(-1, 1) + E(1, 1)));
+        delta.z = 4 * 2 * elevationInvScale;
+        delta = delta.direction();
+
+        float H = B[i * channels];
+        if (preprocess.lowPassFilter) {
+            H = (E(-1, -1) + E(0, -1) + E(1, -1) + E(-1, 0) + E(0, 0) + E(1, 0) + E(-1, 1) + E(0, 1) + E(1, 1)) / (255.0f * 9.0f);
+        }
+        if (preprocess.scaleZByNz) {
+            H *= delta.z;
+        }
+
+        delta = delta * 0.5f + Vector3(0.5f, 0.5f, 0.5f);
+        N[i] = Color4unorm8(unorm8(delta.x), unorm8(delta.y), unorm8(delta.z), unorm8(H));
+    });
+
+    return normal;
+}
+
+
+/** The straightforward per-pixel Poisson solve that BumpMap::computeBumpMap must match exactly */
+static shared_ptr<CPUPixelTransferBuffer> referenceBumpMap(const shared_ptr<CPUPixelTransferBuffer>& normalMap, float signConvention) {
+    const int w = normalMap->width();
+    const int h = normalMap->height();
+    const int stride = normalMap->format()->numComponents;
+    const unorm8* bytes = static_cast<const unorm8*>(normalMap->buffer());
+    const auto red   = [&](int x, int y) { return float(bytes[(((x + w) % w) + ((y + h) % h) * w) * stride]); };
+    const auto green = [&](int x, int y) { return float(bytes[(((x + w) % w) + ((y + h) % h) * w) * stride + 1]); };
+
+    Array<float> laplacian, src, dst;
+    laplacian.resize(w * h);
+    dst.resize(w * h);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            laplacian[x + y * w] = ((red(x + 1, y) - red(x - 1, y)) + signConvention * (green(x, y + 1) - green(x, y - 1))) * 0.5f;
+            dst[x + y * w] = 0.5f;
+        }
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        src = dst;
+        const auto S = [&](int x, int y) { return src[((x + w) % w) + ((y + h) % h) * w]; };
+        for (int y = 0; y < h; ++y) {
+            for (int x = 0; x < w; ++x) {
+                dst[x + y * w] = (S(x - 1, y) + S(x, y - 1) + S(x + 1, y) + S(x, y + 1) + laplacian[x + y * w]) * 0.25f;
+            }
+        }
+    }
+
+    float lo = finf(), hi = -finf();
+    for (const float v : dst) {
+        lo = min(lo, v);
+        hi = max(hi, v);
+    }
+
+    const shared_ptr<CPUPixelTransferBuffer>& final = CPUPixelTransferBuffer::create(w, h, ImageFormat::RGB8());
+    Color3unorm8* F = static_cast<Color3unorm8*>(final->buffer());
+    for (int i = 0; i < w * h; ++i) {
+        const unorm8 b((dst[i] - lo) / (hi - lo));
+        F[i] = Color3unorm8(b, b, b);
+    }
+    return final;
+}
+
+
+static Array<unorm8> randomHeightField(int w, int h, int channels, Random& rnd) {
+    Array<unorm8> bytes;
+    bytes.resize(w * h * channels);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            // Smooth hills with noise, so that the normals vary over the full range
+            const float v = 0.5f + 0.3f * sinf(x * 0.3f) * cosf(y * 0.2f) + rnd.uniform(-0.2f, 0.2f);
+            for (int c = 0; c < channels; ++c) {
+                bytes[(x + y * w) * channels + c] = unorm8(v);
+            }
+        }
+    }
+    return bytes;
+}
+
+
+static bool sameBytes(const shared_ptr<PixelTransferBuffer>& a, const shared_ptr<PixelTransferBuffer>& b) {
+    const bool same = (a->width() == b->width()) && (a->height() == b->height()) &&
+        (a->format() == b->format()) && (a->size() == b->size()) && (memcmp(a->mapRead(), b->mapRead(), a->size()) == 0);
+    a->unmap();
+    b->unmap();
+    return same;
+}
+
+
+static Vector3 unpackNormal(const Color4unorm8& c) {
+    return Vector3(Color3(c.rgb())) * 2.0f - Vector3::one();
+}
+
+
+static void testNormalMap() {
+    Random rnd(50, false);
+    const Vector2int32 sizes[] = {Vector2int32(1, 1), Vector2int32(2, 3), Vector2int32(5, 1), Vector2int32(1, 7),
+                                  Vector2int32(17, 5), Vector2int32(64, 64), Vector2int32(67, 33)};
+
+    for (const Vector2int32& size : sizes) {
+        for (int channels = 1; channels <= 4; channels += (channels == 1) ? 2 : 1) {
+            const Array<unorm8>& src = randomHeightField(size.x, size.y, channels, rnd);
+            for (int variant = 0; variant < 4; ++variant) {
+                BumpMapPreprocess preprocess;
+                preprocess.lowPassFilter = (variant & 1) != 0;
+                preprocess.scaleZByNz    = (variant & 2) != 0;
+                preprocess.zExtentPixels = (variant == 3) ? 2.0f : preprocess.zExtentPixels;
+
+                const shared_ptr<PixelTransferBuffer>& normal = BumpMap::computeNormalMap(size.x, size.y, channels, src.getCArray(), preprocess);
+                testAssert(sameBytes(normal, referenceNormalMap(size.x, size.y, channels, src.getCArray(), preprocess)));
+            }
+        }
+    }
+}
+
+
+static void testNormalMapMIPChain() {
+    Random rnd(51, false);
+    const int w = 37, h = 20;
+    const Array<unorm8>& src = randomHeightField(w, h, 1, rnd);
+
+    Array<shared_ptr<PixelTransferBuffer>> mipArray;
+    BumpMap::computeNormalMap(w, h, 1, src.getCArray(), mipArray);
+
+    // 37 x 20, 18 x 10, 9 x 5, 4 x 2, 2 x 1, 1 x 1
+    testAssert(mipArray.size() == 6);
+    testAssert(sameBytes(mipArray[0], BumpMap::computeNormalMap(w, h, 1, src.getCArray())));
+    testAssert((mipArray[3]->width() == 4) && (mipArray[3]->height() == 2));
+    testAssert((mipArray.last()->width() == 1) && (mipArray.last()->height() == 1));
+
+    for (int level = 1; level < mipArray.size(); ++level) {
+        const int lw = mipArray[level]->width(), lh = mipArray[level]->height();
+        const int pw = mipArray[level - 1]->width();
+        testAssert(mipArray[level]->format() == ImageFormat::RGBA8());
+        const Color4unorm8* P = static_cast<const Color4unorm8*>(mipArray[level - 1]->mapRead());
+        const Color4unorm8* L = static_cast<const Color4unorm8*>(mipArray[level]->mapRead());
+        for (int y = 0; y < lh; ++y) {
+            for (int x = 0; x < lw; ++x) {
+                // Renormalized, unlike a box filter of the packed values
+                const Vector3& n = unpackNormal(L[x + y * lw]);
+                testAssert(abs(n.length() - 1.0f) < 0.02f);
+                testAssert(n.z > 0.0f);
+
+                // The direction of the average of the 2 x 2 block
+                const Vector3& sum = unpackNormal(P[2 * x + 2 * y * pw]) + unpackNormal(P[min(2 * x + 1, pw - 1) + 2 * y * pw]) +
+                    unpackNormal(P[2 * x + min(2 * y + 1, mipArray[level - 1]->height() - 1) * pw]) +
+                    unpackNormal(P[min(2 * x + 1, pw - 1) + min(2 * y + 1, mipArray[level - 1]->height() - 1) * pw]);
+                testAssert(n.direction().dot(sum.direction()) > 0.999f);
+            }
+        }
+        mipArray[level - 1]->unmap();
+        mipArray[level]->unmap();
+    }
+
+    // A flat height field points straight up at every level
+    Array<unorm8> flat;
+    flat.resize(8 * 8);
+    for (unorm8& b : flat) {
+        b = unorm8(0.5f);
+    }
+    BumpMap::computeNormalMap(8, 8, 1, flat.getCArray(), mipArray);
+    testAssert(mipArray.size() == 4);
+    const Color4unorm8& top = *static_cast<const Color4unorm8*>(mipArray.last()->mapRead());
+    testAssert((top.r.bits() == 128) && (top.g.bits() == 128) && (top.b.bits() == 255) && (top.a.bits() == 128));
+    mipArray.last()->unmap();
+}
+
+
+static void testBumpMapFromNormals() {
+    Random rnd(52, false);
+    const Vector2int32 sizes[] = {Vector2int32(1, 1), Vector2int32(2, 3), Vector2int32(31, 9)};
+    for (const Vector2int32& size : sizes) {
+        const Array<unorm8>& src = randomHeightField(size.x, size.y, 1, rnd);
+        const shared_ptr<CPUPixelTransferBuffer>& normalRGBA = dynamic_pointer_cast<CPUPixelTransferBuffer>(BumpMap::computeNormalMap(size.x, size.y, 1, src.getCArray()));
+
+        // The same normals without alpha
+        const shared_ptr<CPUPixelTransferBuffer>& normalRGB = CPUPixelTransferBuffer::create(size.x, size.y, ImageFormat::RGB8());
+        for (int i = 0; i < size.x * size.y; ++i) {
+            static_cast<Color3unorm8*>(normalRGB->buffer())[i] = static_cast<const Color4unorm8*>(normalRGBA->buffer())[i].rgb();
+        }
+
+        for (const float signConvention : {-1.0f, 1.0f}) {
+            const shared_ptr<PixelTransferBuffer>& bump = BumpMap::computeBumpMap(normalRGBA, signConvention);
+            testAssert(sameBytes(bump, referenceBumpMap(normalRGBA, signConvention)));
+            testAssert(sameBytes(BumpMap::computeBumpMap(normalRGB, signConvention), bump));
+        }
+    }
+}
+
+
+void testBumpMap() {
+    printf("BumpMap ");
+    testNormalMap();
+    testNormalMapMIPChain();
+    testBumpMapFromNormals();
+    printf("passed\n");
+}
+
+
+void perfBumpMap() {
+    PRINT_SECTION("Performance: BumpMap", "Normal maps from height fields, without a GPU");
+
+    Random rnd(2020, false);
+    const int size = 4096;
+    const Array<unorm8>& src = randomHeightField(size, size, 1, rnd);
+    BumpMapPreprocess lowPass;
+    lowPass.lowPassFilter = true;
+
+    const int numTrials = 3;
+    chrono::nanoseconds referenceTime = chrono::nanoseconds::zero(), time = chrono::nanoseconds::zero(), mipTime = chrono::nanoseconds::zero();
+    for (int trial = 0; trial < numTrials; ++trial) {
+        Stopwatch stopwatch;
+        stopwatch.tick();
+        referenceNormalMap(size, size, 1, src.getCArray(), lowPass);
+        stopwatch.tock();
+        referenceTime += stopwatch.elapsedDuration();
+
+        stopwatch.tick();
+        BumpMap::computeNormalMap(size, size, 1, src.getCArray(), lowPass);
+        stopwatch.tock();
+        time += stopwatch.elapsedDuration();
+
+        Array<shared_ptr<PixelTransferBuffer>> mipArray;
+        stopwatch.tick();
+        BumpMap::computeNormalMap(size, size, 1, src.getCArray(), mipArray, lowPass);
+        stopwatch.tock();
+        mipTime += stopwatch.elapsedDuration();
+    }
+
+    // The Poisson solve is much slower per pixel
+    const int bumpSize = 1024;
+    const shared_ptr<CPUPixelTransferBuffer>& normal = dynamic_pointer_cast<CPUPixelTransferBuffer>(BumpMap::computeNormalMap(bumpSize, bumpSize, 1, src.getCArray()));
+    Stopwatch stopwatch;
+    stopwatch.tick();
+    referenceBumpMap(normal, -1.0f);
+    stopwatch.tock();
+    const chrono::nanoseconds referenceBumpTime = stopwatch.elapsedDuration();
+    stopwatch.tick();
+    BumpMap::computeBumpMap(normal, -1.0f);
+    stopwatch.tock();
+    const chrono::nanoseconds bumpTime = stopwatch.elapsedDuration();
+
+    PRINT_TEXT("", "Per-pixel", "Current");
+    PRINT_MILLI(format("%d^2 normal map", size).c_str(), "(ms)", referenceTime / numTrials, time / numTrials);
+    PRINT_MILLI(format("%d^2 with MIP chain", size).c_str(), "(ms)", referenceTime / numTrials, mipTime / numTrials);
+    PRINT_MILLI(format("%d^2 bump map", bumpSize).c_str(), "(ms)", referenceBumpTime, bumpTime);
+}
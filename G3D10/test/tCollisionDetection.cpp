@@ -313,6 +313,32 @@ void testCollisionDetection() {
         testAssertM(outLocation.fuzzyEq(Vector3(1,1,0)), "Wrong collision location");
     }
 
+    // Batch tests agree with the scalar tests, including for partial batches
+    {
+        Random rnd(7, false);
+        const int count = 103;
+        Array<Sphere> sphere1, sphere2;
+        Array<Box> box;
+        for (int i = 0; i < count; ++i) {
+            sphere1.append(Sphere(Point3(rnd.uniform(-2, 2), rnd.uniform(-2, 2), rnd.uniform(-2, 2)), rnd.uniform(0.1f, 1.0f)));
+            sphere2.append(Sphere(Point3(rnd.uniform(-2, 2), rnd.uniform(-2, 2), rnd.uniform(-2, 2)), rnd.uniform(0.1f, 1.0f)));
+            const CoordinateFrame frame(Matrix3::fromEulerAnglesXYZ(rnd.uniform(0, 3), rnd.uniform(0, 3), rnd.uniform(0, 3)), Point3(rnd.uniform(-1, 1), 0, 0));
+            box.append(frame.toWorldSpace(Box(Point3(-0.5f, -0.3f, -1.0f), Point3(0.5f, 0.3f, 1.0f))));
+        }
+
+        Array<bool> result;
+        result.resize(count);
+        CollisionDetection::fixedSolidSphereIntersectsFixedSolidSphere(sphere1.getCArray(), sphere2.getCArray(), count, result.getCArray());
+        for (int i = 0; i < count; ++i) {
+            testAssert(result[i] == CollisionDetection::fixedSolidSphereIntersectsFixedSolidSphere(sphere1[i], sphere2[i]));
+        }
+
+        CollisionDetection::fixedSolidSphereIntersectsFixedSolidBox(sphere1.getCArray(), box.getCArray(), count, result.getCArray());
+        for (int i = 0; i < count; ++i) {
+            testAssert(result[i] == CollisionDetection::fixedSolidSphereIntersectsFixedSolidBox(sphere1[i], box[i]));
+        }
+    }
+
     printf("passed\n");
 }
 
@@ -0,0 +1,281 @@
+/**
+  \file test/tCollisionWorld.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+/** A square of 2 * n^2 triangles in the plane y = height, centered on the origin */
+static shared_ptr<TriTree> makeGround(float height, float size, int n) {
+    CPUVertexArray vertexArray;
+    vertexArray.hasTangent   = false;
+    vertexArray.hasTexCoord0 = false;
+    for (int z = 0; z <= n; ++z) {
+        for (int x = 0; x <= n; ++x) {
+            CPUVertexArray::Vertex v;
+            v.position = Point3((float(x) / n - 0.5f) * size, height, (float(z) / n - 0.5f) * size);
+            v.normal   = Vector3::unitY();
+            vertexArray.vertex.append(v);
+        }
+    }
+
+    Array<Tri> triArray;
+    for (int z = 0; z < n; ++z) {
+        for (int x = 0; x < n; ++x) {
+            const int i = z * (n + 1) + x;
+            triArray.append(Tri(i, i + n + 1, i + 1, vertexArray));
+            triArray.append(Tri(i + 1, i + n + 1, i + n + 2, vertexArray));
+        }
+    }
+
+    const shared_ptr<TriTree>& tree = TriTree::create(false);
+    tree->setContents(triArray, vertexArray);
+    return tree;
+}
+
+
+static Box randomBox(Random& rnd, const Point3& center, float size) {
+    const CoordinateFrame frame(Matrix3::fromEulerAnglesXYZ(rnd.uniform(0, 3), rnd.uniform(0, 3), rnd.uniform(0, 3)), center);
+    const Vector3& halfExtent = Vector3(rnd.uniform(0.2f, 1.0f), rnd.uniform(0.2f, 1.0f), rnd.uniform(0.2f, 1.0f)) * size * 0.5f;
+    return frame.toWorldSpace(Box(-halfExtent, halfExtent));
+}
+
+
+/** Adds \a count random spheres, boxes, and capsules of about \a size within \a extent of the origin to \a world and \a idArray */
+static void addRandomBodies(CollisionWorld& world, Array<CollisionWorld::BodyID>& idArray, Random& rnd, int count, float extent, float size) {
+    for (int i = 0; i < count; ++i) {
+        const Point3 center(rnd.uniform(-extent, extent), rnd.uniform(-extent, extent), rnd.uniform(-extent, extent));
+        switch (i % 3) {
+        case 0:
+            idArray.append(world.addSphere(Sphere(center, rnd.uniform(0.2f, 0.5f) * size)));
+            break;
+
+        case 1:
+            idArray.append(world.addBox(randomBox(rnd, center, size)));
+            break;
+
+        default:
+            {
+                const Vector3& half = Vector3::random(rnd) * size * 0.5f;
+                idArray.append(world.addCapsule(Capsule(center - half, center + half, rnd.uniform(0.1f, 0.3f) * size)));
+            }
+        }
+    }
+}
+
+
+/** All pairs of bodies whose bounds overlap, excluding pairs of meshes, sorted */
+static void bruteForcePotentialPairs(const CollisionWorld& world, const Array<CollisionWorld::BodyID>& idArray, Array<CollisionWorld::Pair>& pairArray) {
+    pairArray.fastClear();
+    for (int i = 0; i < idArray.size(); ++i) {
+        for (int j = i + 1; j < idArray.size(); ++j) {
+            const CollisionWorld::BodyID a = idArray[i], b = idArray[j];
+            if (! ((world.type(a) == CollisionWorld::MESH) && (world.type(b) == CollisionWorld::MESH)) &&
+                world.bounds(a).intersects(world.bounds(b))) {
+                pairArray.append(CollisionWorld::Pair(a, b));
+            }
+        }
+    }
+    pairArray.sort();
+}
+
+
+static bool samePairs(const Array<CollisionWorld::Pair>& x, const Array<CollisionWorld::Pair>& y) {
+    if (x.size() != y.size()) {
+        return false;
+    }
+    for (int i = 0; i < x.size(); ++i) {
+        if (! (x[i] == y[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void testCollisionWorld() {
+    printf("CollisionWorld ");
+
+    // Broadphase matches brute force as bodies are added, moved, and removed
+    {
+        Random rnd(11, false);
+        CollisionWorld world;
+        Array<CollisionWorld::BodyID> idArray;
+        idArray.append(world.addMesh(makeGround(-8.0f, 20.0f, 8)), world.addMesh(makeGround(8.0f, 20.0f, 8)));
+        addRandomBodies(world, idArray, rnd, 600, 10.0f, 2.0f);
+
+        Array<CollisionWorld::Pair> pairArray, expected;
+        for (int frame = 0; frame < 6; ++frame) {
+            testAssert(world.size() == idArray.size());
+            world.getPotentialPairs(pairArray);
+            pairArray.sort();
+            bruteForcePotentialPairs(world, idArray, expected);
+            testAssert(pairArray.size() > 0);
+            testAssert(samePairs(pairArray, expected));
+
+            // Every colliding pair is a potential pair
+            Array<CollisionWorld::Pair> collidingArray;
+            world.getCollidingPairs(collidingArray);
+            collidingArray.sort();
+            testAssert(collidingArray.size() > 0);
+            testAssert(collidingArray.size() < pairArray.size());
+            for (const CollisionWorld::Pair& pair : collidingArray) {
+                testAssert(expected.contains(pair));
+            }
+
+            // Small coherent motion, except every third frame, which teleports everything
+            const float step = (frame % 3 == 2) ? 10.0f : 0.2f;
+            for (const CollisionWorld::BodyID id : idArray) {
+                const Vector3 delta(rnd.uniform(-step, step), rnd.uniform(-step, step), rnd.uniform(-step, step));
+                switch (world.type(id)) {
+                case CollisionWorld::SPHERE:
+                    world.setSphere(id, Sphere(world.bounds(id).center() + delta, world.bounds(id).extent().x * 0.5f));
+                    break;
+
+                case CollisionWorld::BOX:
+                    world.setBox(id, randomBox(rnd, world.bounds(id).center() + delta, 2.0f));
+                    break;
+
+                default:;
+                }
+            }
+
+            // Remove some bodies, but not the meshes, and add others in their slots
+            for (int i = 0; i < 20; ++i) {
+                const int k = rnd.integer(2, idArray.size() - 1);
+                world.remove(idArray[k]);
+                idArray.fastRemove(k);
+            }
+            addRandomBodies(world, idArray, rnd, 10, 10.0f, 2.0f);
+        }
+    }
+
+    // Narrowphase for each kind of pair
+    {
+        CollisionWorld world;
+        const CollisionWorld::BodyID ground = world.addMesh(makeGround(0.0f, 10.0f, 4));
+
+        // Touching spheres and a separate one
+        const CollisionWorld::BodyID s0 = world.addSphere(Sphere(Point3(0, 5, 0), 1.0f));
+        const CollisionWorld::BodyID s1 = world.addSphere(Sphere(Point3(1.5f, 5, 0), 1.0f));
+        world.addSphere(Sphere(Point3(0, 5, 3), 0.5f));
+
+        // A rotated box whose bounds, but not geometry, overlap a sphere
+        const CollisionWorld::BodyID b0 = world.addBox(CoordinateFrame(Matrix3::fromAxisAngle(Vector3::unitY(), toRadians(45)), Point3(-3, 2, -3)).toWorldSpace(Box(Point3(-1, -1, -1), Point3(1, 1, 1))));
+        world.addSphere(Sphere(Point3(-4.3f, 2, -4.3f), 0.3f));
+
+        // A box resting on the ground
+        const CollisionWorld::BodyID b1 = world.addBox(Box(Point3(2, -0.1f, 2), Point3(3, 1, 3)));
+
+        // Crossed capsules and a capsule over the ground
+        const CollisionWorld::BodyID c0 = world.addCapsule(Capsule(Point3(-2, 6, 3), Point3(2, 6, 3), 0.3f));
+        const CollisionWorld::BodyID c1 = world.addCapsule(Capsule(Point3(0, 6.5f, 1), Point3(0, 6.5f, 5), 0.3f));
+        world.addCapsule(Capsule(Point3(-3, 0.5f, 3), Point3(-2, 0.5f, 3), 0.4f));
+
+        Array<CollisionWorld::Pair> pairArray;
+        world.getCollidingPairs(pairArray);
+        pairArray.sort();
+
+        Array<CollisionWorld::Pair> expected;
+        expected.append(CollisionWorld::Pair(s0, s1), CollisionWorld::Pair(ground, b1), CollisionWorld::Pair(c0, c1));
+        expected.sort();
+        testAssert(samePairs(pairArray, expected));
+        (void)b0;
+    }
+
+    // A sphere falling onto the ground at an angle slides along it
+    {
+        CollisionWorld world;
+        world.addMesh(makeGround(0.0f, 20.0f, 4));
+        const CollisionWorld::BodyID wall = world.addBox(Box(Point3(5, 0, -5), Point3(6, 5, 5)));
+
+        const Sphere sphere(Point3(0, 2, 0), 0.5f);
+        const Point3& P = world.slideSphere(sphere, Vector3(2, -4, 0), 1.0f);
+        testAssert(fabs(P.y - 0.5f) < 0.01f);
+        testAssert(P.x > 1.9f);
+
+        // Stops at the wall
+        const Point3& Q = world.slideSphere(Sphere(P, 0.5f), Vector3(10, 0, 0), 1.0f);
+        testAssert(fabs(Q.x - 4.5f) < 0.01f);
+
+        // Unless the wall is ignored
+        const Point3& R = world.slideSphere(Sphere(P, 0.5f), Vector3(10, 0, 0), 1.0f, wall);
+        testAssert(R.x > 9.0f);
+    }
+
+    printf("passed\n");
+}
+
+
+void perfCollisionWorld() {
+    PRINT_SECTION("Performance: CollisionWorld", "10k moving spheres and boxes over 20 frames");
+
+    const int numBodies = 10000;
+    const int numFrames = 20;
+    const float extent = 50.0f;
+
+    Random rnd(3, false);
+    CollisionWorld world;
+    Array<Vector3> velocity;
+    for (int i = 0; i < numBodies; ++i) {
+        const Point3 center(rnd.uniform(-extent, extent), rnd.uniform(-extent, extent) * 0.2f, rnd.uniform(-extent, extent));
+        if (i % 2 == 0) {
+            world.addSphere(Sphere(center, rnd.uniform(0.2f, 1.0f)));
+        } else {
+            world.addBox(randomBox(rnd, center, 2.0f));
+        }
+        velocity.append(Vector3::random(rnd) * 0.3f);
+    }
+
+    Stopwatch stopwatch;
+    Array<CollisionWorld::Pair> pairArray;
+    int numPairs = 0;
+    std::chrono::duration<double, std::nano> moveTime(0), pairTime(0);
+    for (int frame = 0; frame < numFrames; ++frame) {
+        stopwatch.tick();
+        for (int id = 0; id < numBodies; ++id) {
+            const Point3& center = world.bounds(id).center() + velocity[id];
+            if (world.type(id) == CollisionWorld::SPHERE) {
+                world.setSphere(id, Sphere(center, world.bounds(id).extent().x * 0.5f));
+            } else {
+                const AABox& bounds = world.bounds(id);
+                world.setBox(id, Box(bounds.low() + velocity[id], bounds.high() + velocity[id]));
+            }
+        }
+        stopwatch.tock();
+        moveTime += stopwatch.elapsedDuration();
+
+        stopwatch.tick();
+        world.getCollidingPairs(pairArray);
+        stopwatch.tock();
+        pairTime += stopwatch.elapsedDuration();
+        numPairs += pairArray.size();
+    }
+
+    // All-pairs bounds tests for one frame, as a game without a broadphase would do
+    stopwatch.tick();
+    int numBruteForce = 0;
+    for (int a = 0; a < numBodies; ++a) {
+        const AABox& bounds = world.bounds(a);
+        for (int b = a + 1; b < numBodies; ++b) {
+            numBruteForce += bounds.intersects(world.bounds(b)) ? 1 : 0;
+        }
+    }
+    stopwatch.tock();
+    const std::chrono::duration<double, std::nano> bruteForceTime = stopwatch.elapsedDuration();
+
+    Array<CollisionWorld::Pair> potentialArray;
+    world.getPotentialPairs(potentialArray);
+    testAssert(potentialArray.size() == numBruteForce);
+
+    PRINT_TEXT("", "Time/frame");
+    PRINT_MILLI("Move bodies", "(ms)", moveTime / numFrames);
+    PRINT_MILLI("Colliding pairs", "(ms)", pairTime / numFrames);
+    PRINT_MILLI("All-pairs AABox", "(ms)", bruteForceTime);
+    printf("  %d colliding pairs/frame\n", numPairs / numFrames);
+}
@@ -0,0 +1,202 @@
+/**
+  \file test/tCubeMapSampler.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+/** A dim sky with a small, very bright sun of 2x2 texels at the center of the +Y face */
+static shared_ptr<CubeMap> makeSky(int size, float sunRadiance, const Color3& skyRadiance = Color3(0.1f, 0.2f, 0.5f)) {
+    Array<shared_ptr<Image3>> faceArray;
+    for (int f = 0; f < 6; ++f) {
+        const shared_ptr<Image3>& face = Image3::createEmpty(size, size);
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                const bool sun = (f == CubeFace::POS_Y) && (abs(2 * x + 1 - size) <= 2) && (abs(2 * y + 1 - size) <= 2);
+                face->set(x, y, sun ? Color3(1.0f, 0.9f, 0.8f) * sunRadiance : skyRadiance);
+            }
+        }
+        faceArray.append(face);
+    }
+    return CubeMap::create(faceArray);
+}
+
+
+/** Integral of the sampler's pdf over the sphere, by the midpoint rule on each face */
+static double integratePDF(const CubeMapSampler& sampler, int K) {
+    double sum = 0.0;
+    const float h = 2.0f / float(K);
+    for (int f = 0; f < 6; ++f) {
+        const int axis = f / 2;
+        for (int j = 0; j < K; ++j) {
+            for (int i = 0; i < K; ++i) {
+                Vector3 w;
+                w[axis] = (f & 1) ? -1.0f : 1.0f;
+                w[(axis + 1) % 3] = (float(i) + 0.5f) * h - 1.0f;
+                w[(axis + 2) % 3] = (float(j) + 0.5f) * h - 1.0f;
+                const float r2 = w.squaredLength();
+                sum += double(sampler.pdf(w)) * square(h) / (r2 * sqrt(r2));
+            }
+        }
+    }
+    return sum;
+}
+
+
+void testCubeMapSampler() {
+    printf("CubeMapSampler ");
+
+    Random rnd(1024, false);
+
+    // Full resolution and prefiltered to lower resolution
+    for (int maxResolution = 4; maxResolution <= 16; maxResolution *= 4) {
+        const shared_ptr<CubeMapSampler>& sampler = CubeMapSampler::create(makeSky(16, 1e4f), maxResolution);
+        testAssert(sampler->resolution() == maxResolution);
+        testAssert(! sampler->black());
+
+        // The pdf is a distribution over the sphere
+        testAssert(fabs(integratePDF(*sampler, 4 * 16) - 1.0) < 1e-3);
+
+        // sample() reports the same density as pdf(), and mostly chooses the sun
+        int numSun = 0;
+        for (int s = 0; s < 2000; ++s) {
+            float pdfValue;
+            const Vector3& w = sampler->sample(rnd, pdfValue);
+            testAssert(fuzzyEq(w.length(), 1.0f));
+            testAssert(pdfValue > 0.0f);
+            testAssert(fabs(pdfValue - sampler->pdf(w)) <= 1e-3f * pdfValue);
+            if (w.y > 0.8f) {
+                ++numSun;
+            }
+        }
+        testAssert(numSun > 1800);
+
+        // Every direction with radiance can be chosen, including the sky
+        testAssert(sampler->pdf(Vector3::unitY()) > sampler->pdf(-Vector3::unitY()));
+        testAssert(sampler->pdf(-Vector3::unitY()) > 0.0f);
+    }
+
+    // Black environment
+    {
+        const shared_ptr<CubeMapSampler>& sampler = CubeMapSampler::create(makeSky(8, 0.0f, Color3::zero()));
+        testAssert(sampler->black());
+        testAssert(fabs(integratePDF(*sampler, 32) - 1.0) < 1e-3);
+    }
+
+    printf("passed\n");
+}
+
+
+void perfCubeMapSampler() {
+    PRINT_SECTION("Performance: CubeMapSampler", "Irradiance from a 6x256^2 sky with a small bright sun");
+
+    const shared_ptr<CubeMap>& sky = makeSky(256, 2e5f);
+
+    Stopwatch stopwatch;
+    stopwatch.tick();
+    const shared_ptr<CubeMapSampler>& sampler = CubeMapSampler::create(sky);
+    stopwatch.tock();
+    PRINT_TEXT("", "Time");
+    PRINT_MILLI("Build", "(ms)", stopwatch.elapsedDuration());
+    printf("\n");
+
+    // Surfaces tilted away from the sun by various amounts
+    Random rnd(1, false);
+    Array<Vector3> normalArray;
+    for (int i = 0; i < 16; ++i) {
+        const float theta = toRadians(80.0f) * float(i) / 15.0f;
+        normalArray.append(Vector3(sinf(theta), cosf(theta), 0.0f));
+    }
+
+    // Reference irradiance by stratified sampling of every texel
+    Array<double> reference;
+    for (const Vector3& n : normalArray) {
+        double E = 0.0;
+        const int K = 2 * 256;
+        const float h = 2.0f / float(K);
+        for (int f = 0; f < 6; ++f) {
+            const int axis = f / 2;
+            for (int j = 0; j < K; ++j) {
+                for (int i = 0; i < K; ++i) {
+                    Vector3 w;
+                    w[axis] = (f & 1) ? -1.0f : 1.0f;
+                    w[(axis + 1) % 3] = (float(i) + rnd.uniform()) * h - 1.0f;
+                    w[(axis + 2) % 3] = (float(j) + rnd.uniform()) * h - 1.0f;
+                    const float r = w.length();
+                    const float cosTheta = w.dot(n) / r;
+                    if (cosTheta > 0.0f) {
+                        E += double(sky->bilinear(w).average()) * cosTheta * square(h) / (r * r * r);
+                    }
+                }
+            }
+        }
+        reference.append(E);
+    }
+
+    // Each method takes one radiance lookup per sample. Efficiency = 1 / (variance * time).
+    PRINT_TEXT("", "us/sample", "rel. RMSE", "rel. eff.");
+    const int samplesPerEstimate = 16;
+    const int numEstimates = 4096;
+    double baselineEfficiency = 0.0;
+    for (int method = 0; method < 3; ++method) {
+        double squaredError = 0.0;
+        stopwatch.tick();
+        for (int e = 0; e < numEstimates; ++e) {
+            const int k = e % normalArray.size();
+            const Vector3& n = normalArray[k];
+            double sum = 0.0;
+            for (int s = 0; s < samplesPerEstimate; ++s) {
+                Vector3 w;
+                float estimate = 0.0f;
+                if (method == 0) {
+                    // Cosine-weighted hemisphere sampling, as for a Lambertian BSDF
+                    float pdfValue;
+                    Vector3::cosHemiRandom(n, rnd, w, pdfValue);
+                    if (pdfValue > 0.0f) {
+                        estimate = sky->bilinear(w).average() * w.dot(n) / pdfValue;
+                    }
+                } else if (method == 1) {
+                    float pdfValue;
+                    w = sampler->sample(rnd, pdfValue);
+                    const float cosTheta = w.dot(n);
+                    if (cosTheta > 0.0f) {
+                        estimate = sky->bilinear(w).average() * cosTheta / pdfValue;
+                    }
+                } else {
+                    // One-sample multiple importance sampling with the balance heuristic,
+                    // as in PathTracer
+                    if (rnd.uniform() < 0.5f) {
+                        float pdfValue;
+                        w = sampler->sample(rnd, pdfValue);
+                    } else {
+                        float pdfValue;
+                        Vector3::cosHemiRandom(n, rnd, w, pdfValue);
+                    }
+                    const float cosTheta = w.dot(n);
+                    if (cosTheta > 0.0f) {
+                        const float pdfValue = 0.5f * sampler->pdf(w) + 0.5f * cosTheta / pif();
+                        estimate = sky->bilinear(w).average() * cosTheta / pdfValue;
+                    }
+                }
+                sum += estimate;
+            }
+            squaredError += square((sum / samplesPerEstimate - reference[k]) / reference[k]);
+        }
+        stopwatch.tock();
+
+        const double usPerSample = stopwatch.elapsedDuration<std::chrono::duration<double, std::micro>>().count() / (double(numEstimates) * samplesPerEstimate);
+        const double relativeMSE = squaredError / numEstimates;
+        const double efficiency = 1.0 / (relativeMSE * samplesPerEstimate * usPerSample);
+        if (method == 0) {
+            baselineEfficiency = efficiency;
+        }
+
+        static const char* name[3] = {"Cosine", "CubeMapSampler", "MIS"};
+        PRINT_TEXT(name[method], format("%.3f", usPerSample).c_str(), format("%.4f", sqrt(relativeMSE)).c_str(), format("%.1fx", efficiency / baselineEfficiency).c_str());
+    }
+}
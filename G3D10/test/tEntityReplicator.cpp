@@ -0,0 +1,278 @@
+/**
+  \file test/tEntityReplicator.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+/** Encodes the server's current snapshot for \a client, decodes it with \a receiver, and acknowledges
+    it if \a acknowledge is true. Returns the size of the message in bytes. */
+static int64 loopback(EntityReplicator& server, EntityReplicator::ClientID client, EntityReplicator::Receiver& receiver, bool acknowledge) {
+    BinaryOutput message("<memory>", G3D_LITTLE_ENDIAN);
+    server.encode(client, message);
+
+    BinaryInput input(message.getCArray(), message.size(), G3D_LITTLE_ENDIAN);
+    const uint32 sequence = receiver.receive(input);
+    testAssert(sequence == server.sequence());
+    testAssert(input.getPosition() == input.size());
+
+    if (acknowledge) {
+        server.acknowledge(client, sequence);
+    }
+    return message.size();
+}
+
+
+static bool sameFrame(const PhysicsFrame& a, const PhysicsFrame& b) {
+    return (a.translation == b.translation) && (a.rotation == b.rotation);
+}
+
+
+/** Checks that \a receiver has exactly the quantized frames of \a entityArray */
+static void checkReceived(const Array<shared_ptr<Entity>>& entityArray, const EntityReplicator::Receiver& receiver, const QuantizedPhysicsFrame::Format& format) {
+    testAssert(receiver.size() == entityArray.size());
+    for (const shared_ptr<Entity>& entity : entityArray) {
+        PhysicsFrame frame;
+        testAssert(receiver.getFrame(entity->name(), frame));
+        testAssert(sameFrame(frame, QuantizedPhysicsFrame(PhysicsFrame(entity->frame()), format).toPhysicsFrame(format)));
+    }
+}
+
+
+static CFrame randomFrame(Random& rnd, float extent) {
+    return CFrame(Matrix3::fromEulerAnglesXYZ(rnd.uniform(-3, 3), rnd.uniform(-3, 3), rnd.uniform(-3, 3)),
+                  Point3(rnd.uniform(-extent, extent), rnd.uniform(-extent, extent), rnd.uniform(-extent, extent)));
+}
+
+
+static void testQuantization() {
+    const QuantizedPhysicsFrame::Format format;
+    Random rnd(7, false);
+    for (int i = 0; i < 1000; ++i) {
+        const PhysicsFrame frame(randomFrame(rnd, 1000.0f));
+        const QuantizedPhysicsFrame q(frame, format);
+        const PhysicsFrame& result = q.toPhysicsFrame(format);
+
+        testAssert((result.translation - frame.translation).abs().max() <= format.translationPrecision);
+
+        // q and -q are the same rotation
+        const float cosHalfAngle = fabsf(result.rotation.dot(frame.rotation));
+        testAssert(cosHalfAngle > 0.99999f);
+
+        // Quantization is idempotent, so unchanged frames are detected exactly
+        testAssert(QuantizedPhysicsFrame(result, format) == q);
+    }
+
+    // Bit serialization, including deltas of every combination of changed axes
+    BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
+    Array<QuantizedPhysicsFrame> frameArray;
+    b.beginBits();
+    for (int i = 0; i < 200; ++i) {
+        QuantizedPhysicsFrame q(PhysicsFrame(randomFrame(rnd, 100.0f)), format);
+        if ((i > 0) && (i % 2 == 1)) {
+            q = frameArray.last();
+            for (int a = 0; a < 3; ++a) {
+                if (((i >> a) & 2) != 0) {
+                    q.translation[a] += rnd.integer(-1000, 1000);
+                }
+            }
+            if ((i & 16) != 0) {
+                q.rotation = QuantizedPhysicsFrame(PhysicsFrame(randomFrame(rnd, 1.0f)), format).rotation;
+            }
+            q.serializeDeltaBits(frameArray.last(), b, format);
+        } else {
+            q.serializeBits(b, format);
+        }
+        frameArray.append(q);
+    }
+    QuantizedPhysicsFrame::writeSignedBits(b, -1073741823);
+    QuantizedPhysicsFrame::writeSignedBits(b, 1073741823);
+    QuantizedPhysicsFrame::writeSignedBits(b, 0);
+    b.endBits();
+
+    BinaryInput input(b.getCArray(), b.size(), G3D_LITTLE_ENDIAN);
+    input.beginBits();
+    for (int i = 0; i < frameArray.size(); ++i) {
+        QuantizedPhysicsFrame q;
+        if ((i > 0) && (i % 2 == 1)) {
+            q.deserializeDeltaBits(frameArray[i - 1], input, format);
+        } else {
+            q.deserializeBits(input, format);
+        }
+        testAssert(q == frameArray[i]);
+    }
+    testAssert(QuantizedPhysicsFrame::readSignedBits(input) == -1073741823);
+    testAssert(QuantizedPhysicsFrame::readSignedBits(input) == 1073741823);
+    testAssert(QuantizedPhysicsFrame::readSignedBits(input) == 0);
+    input.endBits();
+    testAssert(input.getPosition() == input.size());
+}
+
+
+static void testReplication() {
+    const shared_ptr<EntityReplicator>& server = EntityReplicator::create();
+    const QuantizedPhysicsFrame::Format& frameFormat = server->specification().format;
+    const EntityReplicator::ClientID reliable = server->addClient();
+    const EntityReplicator::ClientID lossy = server->addClient();
+    const EntityReplicator::ClientID late = server->addClient();
+
+    // The server's entities and the clients' copies of them
+    Random rnd(11, false);
+    Array<shared_ptr<Entity>> serverArray;
+    Array<shared_ptr<Entity>> clientArray;
+    const shared_ptr<EntityReplicator::Receiver>& reliableReceiver = EntityReplicator::Receiver::create(frameFormat);
+    const shared_ptr<EntityReplicator::Receiver>& lossyReceiver = EntityReplicator::Receiver::create(frameFormat);
+    const shared_ptr<EntityReplicator::Receiver>& lateReceiver = EntityReplicator::Receiver::create(frameFormat);
+    for (int i = 0; i < 50; ++i) {
+        const String& name = format("marker%d", i);
+        serverArray.append(MarkerEntity::create(name, nullptr, Array<Box>(), Color3::white(), randomFrame(rnd, 50.0f)));
+        server->add(serverArray.last());
+
+        clientArray.append(MarkerEntity::create(name, nullptr));
+        reliableReceiver->add(clientArray.last());
+    }
+
+    server->snapshot();
+    loopback(*server, reliable, *reliableReceiver, true);
+    checkReceived(serverArray, *reliableReceiver, frameFormat);
+
+    // The client's entities follow the server's
+    for (int i = 0; i < clientArray.size(); ++i) {
+        testAssert(sameFrame(PhysicsFrame(clientArray[i]->frame()), QuantizedPhysicsFrame(PhysicsFrame(serverArray[i]->frame()), frameFormat).toPhysicsFrame(frameFormat)));
+    }
+
+    // Nothing moved, so the delta contains no records
+    server->snapshot();
+    testAssert(loopback(*server, reliable, *reliableReceiver, true) == 12);
+
+    for (int tick = 0; tick < 40; ++tick) {
+        // Move some entities
+        for (int i = 0; i < serverArray.size(); i += 1 + rnd.integer(0, 5)) {
+            CFrame frame = serverArray[i]->frame();
+            frame.translation += Vector3::random(rnd) * 0.1f;
+            if (rnd.integer(0, 3) == 0) {
+                frame.rotation = randomFrame(rnd, 0.0f).rotation;
+            }
+            serverArray[i]->setFrame(frame);
+        }
+
+        // Add and remove entities
+        if (tick % 7 == 3) {
+            const int i = rnd.integer(0, serverArray.size() - 1);
+            server->remove(serverArray[i]);
+            serverArray.remove(i);
+        }
+        if (tick % 5 == 2) {
+            serverArray.append(MarkerEntity::create(format("added%d", tick), nullptr, Array<Box>(), Color3::white(), randomFrame(rnd, 50.0f)));
+            server->add(serverArray.last());
+        }
+
+        server->snapshot();
+        loopback(*server, reliable, *reliableReceiver, true);
+        checkReceived(serverArray, *reliableReceiver, frameFormat);
+
+        // This client loses most acknowledgements, so its deltas span several snapshots
+        loopback(*server, lossy, *lossyReceiver, tick % 4 == 0);
+        checkReceived(serverArray, *lossyReceiver, frameFormat);
+
+        // This client never acknowledges and always receives the full state
+        if (tick > 30) {
+            loopback(*server, late, *lateReceiver, false);
+            checkReceived(serverArray, *lateReceiver, frameFormat);
+        }
+    }
+
+    // A message that is older than one already received is ignored
+    BinaryOutput message("<memory>", G3D_LITTLE_ENDIAN);
+    server->encode(late, message);
+    server->snapshot();
+    loopback(*server, lossy, *lossyReceiver, false);
+    BinaryInput input(message.getCArray(), message.size(), G3D_LITTLE_ENDIAN);
+    testAssert(lossyReceiver->receive(input) == 0);
+    checkReceived(serverArray, *lossyReceiver, frameFormat);
+}
+
+
+void testEntityReplicator() {
+    printf("EntityReplicator ");
+    testQuantization();
+    testReplication();
+    printf("passed\n");
+}
+
+
+void perfEntityReplicator() {
+    PRINT_SECTION("Performance: EntityReplicator", "5000 entities, 10% moving each tick, 60 ticks");
+
+    const int numEntities = 5000;
+    const int numTicks = 60;
+
+    const shared_ptr<EntityReplicator>& server = EntityReplicator::create();
+    const QuantizedPhysicsFrame::Format& frameFormat = server->specification().format;
+    const EntityReplicator::ClientID deltaClient = server->addClient();
+    const EntityReplicator::ClientID fullClient = server->addClient();
+    const shared_ptr<EntityReplicator::Receiver>& deltaReceiver = EntityReplicator::Receiver::create(frameFormat);
+    const shared_ptr<EntityReplicator::Receiver>& fullReceiver = EntityReplicator::Receiver::create(frameFormat);
+
+    Random rnd(5, false);
+    Array<shared_ptr<Entity>> entityArray;
+    for (int i = 0; i < numEntities; ++i) {
+        entityArray.append(MarkerEntity::create(format("entity%d", i), nullptr, Array<Box>(), Color3::white(), randomFrame(rnd, 200.0f)));
+        server->add(entityArray.last());
+    }
+
+    // Reach the steady state
+    server->snapshot();
+    loopback(*server, deltaClient, *deltaReceiver, true);
+
+    Stopwatch stopwatch;
+    std::chrono::duration<double, std::nano> snapshotTime(0), encodeTime(0), decodeTime(0);
+    int64 textBytes = 0, fullBytes = 0, deltaBytes = 0;
+    BinaryOutput message("<memory>", G3D_LITTLE_ENDIAN);
+    for (int tick = 0; tick < numTicks; ++tick) {
+        for (int i = 0; i < numEntities / 10; ++i) {
+            const shared_ptr<Entity>& entity = entityArray[rnd.integer(0, numEntities - 1)];
+            CFrame frame = entity->frame();
+            frame.translation += Vector3::random(rnd) * 0.05f;
+            frame.rotation = frame.rotation * Matrix3::fromAxisAngle(Vector3::unitY(), 0.01f);
+            entity->setFrame(frame);
+        }
+
+        stopwatch.tick();
+        server->snapshot();
+        stopwatch.tock();
+        snapshotTime += stopwatch.elapsedDuration();
+
+        stopwatch.tick();
+        message.reset();
+        server->encode(deltaClient, message);
+        stopwatch.tock();
+        encodeTime += stopwatch.elapsedDuration();
+        deltaBytes += message.size();
+
+        stopwatch.tick();
+        BinaryInput input(message.getCArray(), message.size(), G3D_LITTLE_ENDIAN, false, false);
+        server->acknowledge(deltaClient, deltaReceiver->receive(input));
+        stopwatch.tock();
+        decodeTime += stopwatch.elapsedDuration();
+
+        fullBytes += loopback(*server, fullClient, *fullReceiver, false);
+
+        // The naive alternative: every entity's name and frame as text
+        for (const shared_ptr<Entity>& entity : entityArray) {
+            textBytes += entity->name().size() + Any(entity->frame()).unparse().size();
+        }
+    }
+
+    PRINT_TEXT("", "Time/tick");
+    PRINT_MILLI("Snapshot", "(ms)", snapshotTime / numTicks);
+    PRINT_MILLI("Encode delta", "(ms)", encodeTime / numTicks);
+    PRINT_MILLI("Receive delta", "(ms)", decodeTime / numTicks);
+    printf("  Bytes/tick: %d text, %d full binary, %d delta\n",
+        int(textBytes / numTicks), int(fullBytes / numTicks), int(deltaBytes / numTicks));
+}
@@ -0,0 +1,223 @@
+/**
+  \file test/tFramePipeline.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+namespace {
+
+/** A posed body: a frame and a bounding sphere, with no rendering */
+class BodySurface : public Surface {
+public:
+    CFrame      m_frame;
+    int         m_frameIndex;
+
+    BodySurface(const CFrame& frame, int frameIndex) : m_frame(frame), m_frameIndex(frameIndex) {}
+
+    virtual void getCoordinateFrame(CoordinateFrame& cframe, bool previous = false) const override {
+        cframe = m_frame;
+    }
+
+    virtual void getObjectSpaceBoundingBox(AABox& box, bool previous = false) const override {
+        box = AABox(Point3(-0.5f, -0.5f, -0.5f), Point3(0.5f, 0.5f, 0.5f));
+    }
+
+    virtual void getObjectSpaceBoundingSphere(Sphere& sphere, bool previous = false) const override {
+        sphere = Sphere(Point3::zero(), 0.87f);
+    }
+
+    virtual TransparencyType transparencyType() const override {
+        return TransparencyType::NONE;
+    }
+
+    virtual void renderWireframeHomogeneous(RenderDevice* rd, const Array<shared_ptr<Surface> >& surfaceArray, const Color4& color, bool previous) const override {}
+
+    virtual bool canBeFullyRepresentedInGBuffer(const GBuffer::Specification& specification) const override {
+        return false;
+    }
+
+    virtual void render(RenderDevice* rd, const LightingEnvironment& environment, RenderPassType passType) const override {}
+
+    virtual void setStorage(ImageStorage newStorage) override {}
+};
+
+
+/** Stands in for a Scene: bodies that tumble under gravity and bounce */
+class SyntheticScene {
+public:
+    Array<Point3>       position;
+    Array<Vector3>      velocity;
+    Array<Vector3>      spin;
+    int                 frameIndex;
+
+    explicit SyntheticScene(int numBodies) : frameIndex(0) {
+        Random rnd(4321, false);
+        for (int i = 0; i < numBodies; ++i) {
+            position.append(Point3(rnd.uniform(-50, 50), rnd.uniform(0, 50), rnd.uniform(-50, 50)));
+            velocity.append(Vector3(rnd.uniform(-1, 1), rnd.uniform(-1, 1), rnd.uniform(-1, 1)));
+            spin.append(Vector3(rnd.uniform(0, 360), rnd.uniform(0, 360), rnd.uniform(0, 360)));
+        }
+    }
+
+    void onSimulation(SimTime sdt) {
+        for (int i = 0; i < position.size(); ++i) {
+            velocity[i].y -= 9.8f * sdt;
+            position[i] += velocity[i] * sdt;
+            if (position[i].y < 0.0f) {
+                position[i].y = -position[i].y;
+                velocity[i].y = abs(velocity[i].y) * 0.9f;
+            }
+            spin[i] += Vector3(30.0f, 45.0f, 60.0f) * sdt;
+        }
+        ++frameIndex;
+    }
+
+    void onPose(Array<shared_ptr<Surface> >& posed3D) const {
+        for (int i = 0; i < position.size(); ++i) {
+            const CFrame& frame = CFrame::fromXYZYPRDegrees(position[i].x, position[i].y, position[i].z, spin[i].x, spin[i].y, spin[i].z);
+            posed3D.append(std::make_shared<BodySurface>(frame, frameIndex));
+        }
+    }
+};
+
+
+/** Stands in for submitting draw calls: touches every posed surface. Returns a checksum. */
+float renderSynthetic(const Array<shared_ptr<Surface> >& posed3D, int repeats) {
+    float checksum = 0.0f;
+    for (int r = 0; r < repeats; ++r) {
+        for (const shared_ptr<Surface>& surface : posed3D) {
+            CFrame frame;
+            Sphere sphere;
+            surface->getCoordinateFrame(frame);
+            surface->getObjectSpaceBoundingSphere(sphere);
+            checksum += frame.toWorldSpace(sphere).center.length();
+        }
+    }
+    return checksum;
+}
+
+} // anonymous namespace
+
+
+void testFramePipeline() {
+    printf("FramePipeline ");
+
+    const shared_ptr<FramePipeline>& pipeline = FramePipeline::create();
+    testAssert(! pipeline->busy());
+    testAssert(! pipeline->isWorkerThread());
+    testAssert((pipeline->front().posed3D.size() == 0) && (pipeline->back().posed3D.size() == 0));
+
+    SyntheticScene scene(100);
+    for (int f = 0; f < 10; ++f) {
+        // The front frame is exactly the previous pose while the next one is produced
+        const int frontSize = pipeline->front().posed3D.size();
+        const shared_ptr<Surface> frontFirst = (frontSize > 0) ? pipeline->front().posed3D[0] : nullptr;
+
+        bool ranOnWorker = false;
+        pipeline->launch([&](FramePipeline::Frame& frame) {
+            ranOnWorker = pipeline->isWorkerThread();
+            testAssert(frame.posed3D.size() == 0);
+            scene.onSimulation(1.0f / 60.0f);
+            scene.onPose(frame.posed3D);
+        });
+
+        testAssert(pipeline->front().posed3D.size() == frontSize);
+        testAssert((frontSize == 0) || (pipeline->front().posed3D[0] == frontFirst));
+        renderSynthetic(pipeline->front().posed3D, 1);
+
+        pipeline->swap();
+        testAssert(ranOnWorker);
+        testAssert(! pipeline->busy());
+        testAssert(pipeline->front().posed3D.size() == 100);
+        testAssert(pipeline->back().posed3D.size() == 0);
+        testAssert(dynamic_pointer_cast<BodySurface>(pipeline->front().posed3D[0])->m_frameIndex == f + 1);
+    }
+
+    // Exceptions thrown by a job reach the caller
+    pipeline->launch([](FramePipeline::Frame& frame) { throw String("simulation failed"); });
+    bool caught = false;
+    try {
+        pipeline->wait();
+    } catch (const String& e) {
+        caught = (e == "simulation failed");
+    }
+    testAssert(caught);
+
+    // ...once
+    pipeline->wait();
+
+    pipeline->clear();
+    testAssert((pipeline->front().posed3D.size() == 0) && (pipeline->back().posed3D.size() == 0));
+
+    // Destroying a busy pipeline waits for the job
+    {
+        const shared_ptr<FramePipeline>& other = FramePipeline::create();
+        other->launch([](FramePipeline::Frame& frame) { System::sleep(0.01); });
+    }
+
+    printf("passed\n");
+}
+
+
+void perfFramePipeline() {
+    PRINT_SECTION("Performance: FramePipeline", "Synthetic simulation, pose, and submission without a GPU");
+
+    const int numBodies = 50000, numFrames = 60, renderRepeats = 4;
+    const SimTime sdt = 1.0f / 60.0f;
+    float checksum = 0.0f;
+
+    // Sequential, like GApp::oneFrame
+    chrono::nanoseconds sequentialTime;
+    {
+        SyntheticScene scene(numBodies);
+        Array<shared_ptr<Surface> > posed3D;
+        Stopwatch stopwatch;
+        stopwatch.tick();
+        for (int f = 0; f < numFrames; ++f) {
+            scene.onSimulation(sdt);
+            posed3D.fastClear();
+            scene.onPose(posed3D);
+            checksum += renderSynthetic(posed3D, renderRepeats);
+        }
+        stopwatch.tock();
+        sequentialTime = stopwatch.elapsedDuration();
+    }
+
+    // Pipelined, like GApp::onePipelinedFrame
+    chrono::nanoseconds pipelinedTime[2];
+    for (int poseOnWorker = 0; poseOnWorker < 2; ++poseOnWorker) {
+        SyntheticScene scene(numBodies);
+        const shared_ptr<FramePipeline>& pipeline = FramePipeline::create();
+        Stopwatch stopwatch;
+        stopwatch.tick();
+        for (int f = 0; f < numFrames + 1; ++f) {
+            pipeline->launch([&](FramePipeline::Frame& frame) {
+                scene.onSimulation(sdt);
+                if (poseOnWorker) {
+                    scene.onPose(frame.posed3D);
+                }
+            });
+            checksum += renderSynthetic(pipeline->front().posed3D, renderRepeats);
+            pipeline->wait();
+            if (! poseOnWorker) {
+                scene.onPose(pipeline->back().posed3D);
+            }
+            pipeline->swap();
+        }
+        stopwatch.tock();
+        // The extra iteration drains the pipeline
+        pipelinedTime[poseOnWorker] = stopwatch.elapsedDuration();
+    }
+    testAssert(checksum > 0.0f);
+
+    PRINT_TEXT("", "Time");
+    PRINT_MILLI("Sequential", "(ms/frame)", sequentialTime / numFrames);
+    PRINT_MILLI("Pipelined, pose on main", "(ms/frame)", pipelinedTime[0] / numFrames);
+    PRINT_MILLI("Pipelined, pose on worker", "(ms/frame)", pipelinedTime[1] / numFrames);
+}
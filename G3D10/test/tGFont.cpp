@@ -0,0 +1,162 @@
+/**
+  \file test/tGFont.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+static const char* loremIpsum =
+    "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore "
+    "et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut "
+    "aliquip ex ea commodo consequat.";
+
+void testGFont() {
+    printf("GFont ");
+
+    const shared_ptr<GFont>& font = GFont::fromFile(System::findDataFile("arial.fnt"));
+    Array<GFont::CPUCharVertex> vertexArray;
+    Array<int> indexArray;
+
+    // The same string at another position and color has the same glyphs, translated
+    const String text = "Hello, world";
+    const Vector2& bounds = font->appendToCharVertexArray(vertexArray, indexArray, nullptr, text, Point2(10, 20), 14, Color3::red());
+    const int numVertices = vertexArray.size();
+    testAssert(numVertices == 4 * (int(text.size()) - 1));
+    testAssert(indexArray.size() == numVertices / 4 * 6);
+    testAssert(fuzzyEq(bounds.x, font->bounds(text, 14).x));
+
+    font->appendToCharVertexArray(vertexArray, indexArray, nullptr, text, Point2(110, 220), 14, Color3::blue(), Color3::white());
+    testAssert(vertexArray.size() == 2 * numVertices);
+    for (int v = 0; v < numVertices; ++v) {
+        const GFont::CPUCharVertex& a = vertexArray[v];
+        const GFont::CPUCharVertex& b = vertexArray[v + numVertices];
+        testAssert(a.texCoord == b.texCoord);
+        testAssert((b.position - a.position).fuzzyEq(Vector2(100, 200)));
+        testAssert((a.color == Color4(Color3::red())) && (b.color == Color4(Color3::blue())));
+        testAssert((a.borderColor == Color4::clear()) && (b.borderColor == Color4(Color3::white())));
+    }
+    for (int i = 0; i < indexArray.size() / 2; ++i) {
+        testAssert(indexArray[i + indexArray.size() / 2] == indexArray[i] + numVertices);
+    }
+
+    // Alignment is part of the layout
+    vertexArray.fastClear();
+    indexArray.fastClear();
+    font->appendToCharVertexArray(vertexArray, indexArray, nullptr, text, Point2(300, 20), 14, Color3::black(), Color4::clear(), GFont::XALIGN_RIGHT);
+    testAssert(vertexArray.last().position.x <= 300.0f);
+    testAssert(vertexArray.last().position.x > 300.0f - bounds.x / 2);
+
+    // Word wrapping
+    for (int i = 0; i < 2; ++i) {
+        vertexArray.fastClear();
+        indexArray.fastClear();
+        const Vector2& wrapBounds = font->appendToCharVertexArrayWordWrap(vertexArray, indexArray, nullptr, 150, loremIpsum, Point2(5, 5), 12);
+        testAssert(wrapBounds.fuzzyEq(font->boundsWordWrap(150, loremIpsum, 12)));
+        testAssert(wrapBounds.y > 12 * 1.5f * 4);
+        for (const GFont::CPUCharVertex& vertex : vertexArray) {
+            testAssert(vertex.position.x <= 5 + 150 + font->bounds("M", 12).x);
+        }
+    }
+
+    // Flushing the cache does not change the result
+    vertexArray.fastClear();
+    indexArray.fastClear();
+    font->appendToCharVertexArray(vertexArray, indexArray, nullptr, text, Point2(10, 20), 14, Color3::red());
+    const Array<GFont::CPUCharVertex> firstArray = vertexArray;
+    for (int i = 0; i < 20000; ++i) {
+        font->appendToCharVertexArray(vertexArray, indexArray, nullptr, format("Line %d of many", i), Point2(0, 0), 14);
+        vertexArray.fastClear();
+        indexArray.fastClear();
+    }
+    font->appendToCharVertexArray(vertexArray, indexArray, nullptr, text, Point2(10, 20), 14, Color3::red());
+    testAssert(vertexArray.size() == firstArray.size());
+    for (int v = 0; v < vertexArray.size(); ++v) {
+        testAssert(vertexArray[v].position == firstArray[v].position);
+        testAssert(vertexArray[v].texCoord == firstArray[v].texCoord);
+    }
+
+    printf("passed\n");
+}
+
+
+void perfGFont() {
+    PRINT_SECTION("Performance: GFont", "CPU layout of 2000 lines and 200 wrapped paragraphs");
+
+    const shared_ptr<GFont>& font = GFont::fromFile(System::findDataFile("arial.fnt"));
+    const int numLines = 2000;
+    const int numParagraphs = 200;
+    const int numFrames = 20;
+
+    Array<String> lineArray;
+    for (int i = 0; i < numLines; ++i) {
+        lineArray.append(format("%5d: The quick brown fox jumps over the lazy dog %d times", i, i * 7));
+    }
+
+    Array<GFont::CPUCharVertex> vertexArray;
+    Array<int> indexArray;
+    Stopwatch stopwatch;
+
+    // Every line changes every frame, so no layout is reused
+    std::chrono::duration<double, std::nano> changingTime(0);
+    for (int frame = 0; frame < numFrames; ++frame) {
+        vertexArray.fastClear();
+        indexArray.fastClear();
+        const String& prefix = format("%d", frame);
+        stopwatch.tick();
+        for (int i = 0; i < numLines; ++i) {
+            font->appendToCharVertexArray(vertexArray, indexArray, nullptr, prefix + lineArray[i], Point2(0, float(i * 16)), 12);
+        }
+        stopwatch.tock();
+        changingTime += stopwatch.elapsedDuration();
+    }
+
+    // The same lines every frame, as in a console or GUI
+    std::chrono::duration<double, std::nano> staticTime(0);
+    for (int frame = 0; frame <= numFrames; ++frame) {
+        vertexArray.fastClear();
+        indexArray.fastClear();
+        stopwatch.tick();
+        for (int i = 0; i < numLines; ++i) {
+            font->appendToCharVertexArray(vertexArray, indexArray, nullptr, lineArray[i], Point2(0, float(i * 16)), 12);
+        }
+        stopwatch.tock();
+        if (frame > 0) {
+            staticTime += stopwatch.elapsedDuration();
+        }
+    }
+
+    // Word-wrapped paragraphs, as in GuiTextBox and GuiLabel
+    std::chrono::duration<double, std::nano> wrapChangingTime(0), wrapStaticTime(0);
+    for (int frame = 0; frame <= numFrames; ++frame) {
+        vertexArray.fastClear();
+        indexArray.fastClear();
+        stopwatch.tick();
+        for (int i = 0; i < numParagraphs; ++i) {
+            font->appendToCharVertexArrayWordWrap(vertexArray, indexArray, nullptr, 300, format("%d %d ", frame, i) + loremIpsum, Point2(0, float(i * 100)), 12);
+        }
+        stopwatch.tock();
+        wrapChangingTime += stopwatch.elapsedDuration();
+
+        vertexArray.fastClear();
+        indexArray.fastClear();
+        stopwatch.tick();
+        for (int i = 0; i < numParagraphs; ++i) {
+            font->appendToCharVertexArrayWordWrap(vertexArray, indexArray, nullptr, 300, format("%d ", i) + loremIpsum, Point2(0, float(i * 100)), 12);
+        }
+        stopwatch.tock();
+        if (frame > 0) {
+            wrapStaticTime += stopwatch.elapsedDuration();
+        }
+    }
+
+    PRINT_TEXT("", "Time/frame");
+    PRINT_MILLI("Changing lines", "(ms)", changingTime / numFrames);
+    PRINT_MILLI("Static lines", "(ms)", staticTime / numFrames);
+    PRINT_MILLI("Changing wrap", "(ms)", wrapChangingTime / (numFrames + 1));
+    PRINT_MILLI("Static wrap", "(ms)", wrapStaticTime / numFrames);
+}
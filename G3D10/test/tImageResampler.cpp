@@ -0,0 +1,166 @@
+/**
+  \file test/tImageResampler.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+static shared_ptr<Image4> makeImage(int width, int height, const std::function<Color4(int, int)>& f) {
+    const shared_ptr<Image4>& image = Image4::createEmpty(width, height, WrapMode::CLAMP);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            image->set(x, y, f(x, y));
+        }
+    }
+    return image;
+}
+
+
+static Color4 mean(const shared_ptr<Image4>& image) {
+    Color4 sum = Color4::zero();
+    for (int y = 0; y < image->height(); ++y) {
+        for (int x = 0; x < image->width(); ++x) {
+            sum += image->get(x, y);
+        }
+    }
+    return sum / float(image->width() * image->height());
+}
+
+
+static bool fuzzyEqColor(const Color4& a, const Color4& b, float epsilon = 1e-4f) {
+    return (fabsf(a.r - b.r) < epsilon) && (fabsf(a.g - b.g) < epsilon) && (fabsf(a.b - b.b) < epsilon) && (fabsf(a.a - b.a) < epsilon);
+}
+
+
+void testImageResampler() {
+    printf("ImageResampler ");
+
+    ImageResampler::Specification spec;
+    spec.alphaWeighted = false;
+
+    // A constant image stays constant, whatever the filter, size, and edge mode
+    const Color4 constant(0.25f, 0.5f, 0.75f, 1.0f);
+    const shared_ptr<Image4>& flat = makeImage(37, 20, [&](int x, int y) { return constant; });
+    for (int f = 0; f < 3; ++f) {
+        spec.filter = ImageResampler::Filter(ImageResampler::Filter::Value(f));
+        for (int wrap = 0; wrap < 2; ++wrap) {
+            spec.wrapMode = (wrap == 0) ? WrapMode::CLAMP : WrapMode::TILE;
+            const shared_ptr<Image4>& smaller = ImageResampler::resize(flat, 13, 7, spec);
+            const shared_ptr<Image4>& larger = ImageResampler::resize(flat, 80, 45, spec);
+            testAssert((smaller->width() == 13) && (smaller->height() == 7));
+            testAssert((larger->width() == 80) && (larger->height() == 45));
+            for (int y = 0; y < 7; ++y) {
+                for (int x = 0; x < 13; ++x) {
+                    testAssert(fuzzyEqColor(smaller->get(x, y), constant));
+                }
+            }
+            testAssert(fuzzyEqColor(larger->get(79, 44), constant));
+        }
+    }
+    spec.wrapMode = WrapMode::CLAMP;
+
+    // Halving with a box filter averages 2x2 blocks
+    Random rnd(3, false);
+    const shared_ptr<Image4>& noise = makeImage(32, 16, [&](int x, int y) { return Color4(rnd.uniform(), rnd.uniform(), rnd.uniform(), 1.0f); });
+    spec.filter = ImageResampler::Filter::BOX;
+    const shared_ptr<Image4>& half = ImageResampler::resize(noise, 16, 8, spec);
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 16; ++x) {
+            const Color4& expected = (noise->get(2 * x, 2 * y) + noise->get(2 * x + 1, 2 * y) + noise->get(2 * x, 2 * y + 1) + noise->get(2 * x + 1, 2 * y + 1)) * 0.25f;
+            testAssert(fuzzyEqColor(half->get(x, y), expected));
+        }
+    }
+
+    // sRGB filtering averages light, not encoded values
+    const shared_ptr<Image4>& checker = makeImage(8, 8, [&](int x, int y) { return ((x + y) % 2 == 0) ? Color4(1, 1, 1, 1) : Color4(0, 0, 0, 1); });
+    testAssert(fuzzyEq(ImageResampler::resize(checker, 4, 4, spec)->get(1, 1).r, 0.5f));
+    spec.sRGB = true;
+    testAssert(fabsf(ImageResampler::resize(checker, 4, 4, spec)->get(1, 1).r - 0.7354f) < 1e-3f);
+    spec.sRGB = false;
+
+    // Alpha weighting keeps transparent pixels from bleeding
+    const shared_ptr<Image4>& cutout = makeImage(8, 8, [&](int x, int y) { return (x % 2 == 0) ? Color4(1, 0, 0, 1) : Color4(0, 1, 0, 0); });
+    testAssert(fuzzyEqColor(ImageResampler::resize(cutout, 4, 8, spec)->get(2, 2), Color4(0.5f, 0.5f, 0, 0.5f)));
+    spec.alphaWeighted = true;
+    testAssert(fuzzyEqColor(ImageResampler::resize(cutout, 4, 8, spec)->get(2, 2), Color4(1, 0, 0, 0.5f)));
+
+    // Magnifying a ramp reproduces the ramp away from the edges
+    spec.filter = ImageResampler::Filter::LANCZOS;
+    const shared_ptr<Image4>& ramp = makeImage(16, 4, [&](int x, int y) { return Color4(float(x) / 16, 0, 0, 1); });
+    const shared_ptr<Image4>& bigRamp = ImageResampler::resize(ramp, 64, 4, spec);
+    for (int x = 16; x < 48; ++x) {
+        testAssert(fabsf(bigRamp->get(x, 2).r - (x + 0.5f - 2.0f) / 64.0f) < 2e-3f);
+    }
+
+    // MIP chains
+    for (int f = 0; f < 3; ++f) {
+        spec.filter = ImageResampler::Filter(ImageResampler::Filter::Value(f));
+        Array<shared_ptr<Image4>> mipArray;
+        ImageResampler::generateMipMaps(noise, mipArray, spec);
+        testAssert(mipArray.size() == 6);
+        testAssert(mipArray[0] == noise);
+        for (int i = 1; i < mipArray.size(); ++i) {
+            testAssert(mipArray[i]->width() == max(1, noise->width() >> i));
+            testAssert(mipArray[i]->height() == max(1, noise->height() >> i));
+            testAssert(fuzzyEqColor(mean(mipArray[i]), mean(noise), 0.05f));
+        }
+    }
+
+    Array<shared_ptr<Image4>> faceArray;
+    for (int face = 0; face < 6; ++face) {
+        faceArray.append(makeImage(16, 16, [&](int x, int y) { return Color4(float(face) / 6, float(x) / 16, float(y) / 16, 1); }));
+    }
+    Array<Array<shared_ptr<Image4>>> cubeMipArray;
+    ImageResampler::generateCubeMapMipMaps(faceArray, cubeMipArray, spec);
+    testAssert(cubeMipArray.size() == 5);
+    for (int level = 0; level < cubeMipArray.size(); ++level) {
+        testAssert(cubeMipArray[level].size() == 6);
+        for (int face = 0; face < 6; ++face) {
+            testAssert(cubeMipArray[level][face]->width() == (16 >> level));
+            testAssert(fabsf(mean(cubeMipArray[level][face]).r - float(face) / 6) < 1e-3f);
+        }
+    }
+
+    printf("passed\n");
+}
+
+
+void perfImageResampler() {
+    PRINT_SECTION("Performance: ImageResampler", "2048x2048 RGBA float");
+
+    Random rnd(5, false);
+    const int size = 2048;
+    const shared_ptr<Image4>& image = makeImage(size, size, [&](int x, int y) { return Color4(rnd.uniform(), rnd.uniform(), rnd.uniform(), rnd.uniform()); });
+
+    ImageResampler::Specification spec;
+    spec.sRGB = true;
+    Stopwatch stopwatch;
+    Array<shared_ptr<Image4>> mipArray;
+
+    const char* name[] = {"Box", "Lanczos3", "Kaiser3"};
+    std::chrono::duration<double, std::nano> mipTime[3], resizeTime[3];
+    for (int f = 0; f < 3; ++f) {
+        spec.filter = ImageResampler::Filter(ImageResampler::Filter::Value(f));
+
+        stopwatch.tick();
+        ImageResampler::generateMipMaps(image, mipArray, spec);
+        stopwatch.tock();
+        mipTime[f] = stopwatch.elapsedDuration();
+
+        stopwatch.tick();
+        ImageResampler::resize(image, 1920, 1080, spec);
+        stopwatch.tock();
+        resizeTime[f] = stopwatch.elapsedDuration();
+    }
+
+    PRINT_TEXT("", "MIP chain", "To 1920x1080");
+    for (int f = 0; f < 3; ++f) {
+        PRINT_MILLI(name[f], "(ms)", mipTime[f], resizeTime[f]);
+    }
+    printf("  %.0f Mpixel/s Lanczos3 MIP chain input\n", double(size * size) / (1e3 * std::chrono::duration<double, std::milli>(mipTime[1]).count()));
+}
@@ -132,6 +132,170 @@ static void testBoxIntersect() {
 }
 
 
+/** Sorted squared distances from \a q to the \a k nearest points within \a maxRadius */
+static void bruteForceKNearest(const Array<Point3>& point, const Point3& q, int k, float maxRadius, Array<float>& squaredDistance) {
+    for (const Point3& p : point) {
+        const float d2 = (p - q).squaredLength();
+        if (d2 <= square(maxRadius)) {
+            squaredDistance.append(d2);
+        }
+    }
+    squaredDistance.sort();
+    squaredDistance.resize(min(k, squaredDistance.size()));
+}
+
+
+static void testPointKDTreeKNearest() {
+    Random rnd(11, false);
+    Array<Point3> point;
+    for (int i = 0; i < 5000; ++i) {
+        point.append(Point3(rnd.uniform(-10, 10), rnd.uniform(-10, 10), rnd.uniform(-1, 1)));
+    }
+
+    PointKDTree<Point3> unbalanced;
+    unbalanced.insert(point);
+
+    PointKDTree<Point3> tree;
+    tree.insert(point);
+    tree.balance();
+
+    for (int t = 0; t < 200; ++t) {
+        const Point3 q(rnd.uniform(-15, 15), rnd.uniform(-15, 15), rnd.uniform(-3, 3));
+        const int k = rnd.integer(0, 40);
+        const float maxRadius = (t % 3 == 0) ? finf() : rnd.uniform(0.1f, 3.0f);
+
+        Array<float> expected;
+        bruteForceKNearest(point, q, k, maxRadius, expected);
+
+        // Both the flat layout from balance() and the pointer tree
+        for (const PointKDTree<Point3>* T : {&tree, &unbalanced}) {
+            Array<Point3> result;
+            Array<float> squaredDistance;
+            T->kNearest(q, k, maxRadius, result, squaredDistance);
+            testAssert(result.size() == expected.size());
+            for (int i = 0; i < result.size(); ++i) {
+                testAssert(squaredDistance[i] == expected[i]);
+                testAssert((result[i] - q).squaredLength() == expected[i]);
+            }
+        }
+    }
+
+    // Batch queries match single queries
+    Array<Point3> queryArray;
+    for (int i = 0; i < 500; ++i) {
+        queryArray.append(point[i]);
+    }
+    Array<Array<Point3>> resultArray;
+    tree.kNearest(queryArray, 8, finf(), resultArray);
+    testAssert(resultArray.size() == queryArray.size());
+    for (int i = 0; i < queryArray.size(); ++i) {
+        testAssert(resultArray[i].size() == 8);
+        testAssert(resultArray[i][0] == queryArray[i]);
+    }
+
+    // Mutating after balance() falls back to the pointer tree
+    tree.remove(point[0]);
+    Array<Point3> result;
+    tree.kNearest(point[0], 1, 0.0f, result);
+    testAssert(result.size() == 0);
+}
+
+
+/** Sorted results of the queries that have a flat version in balanced trees */
+static void queryAll(const KDTree<AABox>& tree, const AABox& box, const Sphere& sphere, const Array<Plane>& plane, const Ray& ray, Array<AABox>& result, float& rayDistance) {
+    tree.getIntersectingMembers(box, result);
+    tree.getIntersectingMembers(sphere, result);
+    tree.getIntersectingMembers(plane, result);
+    for (KDTree<AABox>::BoxIntersectionIterator it = tree.beginBoxIntersection(box); it != tree.endBoxIntersection(); ++it) {
+        result.append(*it);
+    }
+    std::sort(result.begin(), result.end(), [](const AABox& a, const AABox& b) { return a.low().x < b.low().x; });
+
+    const auto callback = [](const Ray& ray, const AABox& box, float& distance) {
+        const float t = ray.intersectionTime(box);
+        if ((t > 0) && (t < distance)) {
+            distance = t;
+        }
+    };
+    rayDistance = finf();
+    tree.intersectRay(ray, callback, rayDistance);
+}
+
+
+static void testFlatLayout() {
+    Random rnd(17, false);
+    Array<AABox> array;
+    for (int i = 0; i < 40000; ++i) {
+        const Point3 p(rnd.uniform(-10, 10), rnd.uniform(-10, 10), rnd.uniform(-10, 10));
+        array.append(AABox(p, p + Vector3(rnd.uniform(0, 0.5f), rnd.uniform(0, 0.5f), rnd.uniform(0, 0.5f))));
+    }
+
+    KDTree<AABox> tree;
+    tree.setContents(array);
+
+    // Inserting and removing a value converts the copy back to a tree of nodes with the same structure
+    KDTree<AABox> nodeTree(tree);
+    const AABox extra(Point3(100, 100, 100), Point3(101, 101, 101));
+    nodeTree.insert(extra);
+    nodeTree.remove(extra);
+    testAssert(nodeTree.size() == tree.size());
+
+    Array<Plane> plane;
+    plane.append(Plane(Vector3(-1, 0, 0), Point3(3, 1, 1)));
+    plane.append(Plane(Vector3(1, 0, 0), Point3(1, 1, 1)));
+    plane.append(Plane(Vector3(0, 0, -1), Point3(1, 1, 3)));
+
+    for (int q = 0; q < 50; ++q) {
+        const Point3 c(rnd.uniform(-9, 9), rnd.uniform(-9, 9), rnd.uniform(-9, 9));
+        const AABox box(c, c + Vector3(1, 2, 1));
+        const Sphere sphere(c, 1.5f);
+        const Ray& ray = Ray::fromOriginAndDirection(Point3(c.x, c.y, -12), Vector3(rnd.uniform(-0.2f, 0.2f), rnd.uniform(-0.2f, 0.2f), 1).direction());
+
+        Array<AABox> flatResult, nodeResult;
+        float flatDistance, nodeDistance;
+        queryAll(tree, box, sphere, plane, ray, flatResult, flatDistance);
+        queryAll(nodeTree, box, sphere, plane, ray, nodeResult, nodeDistance);
+        testAssert(flatResult.size() == nodeResult.size());
+        for (int i = 0; i < flatResult.size(); ++i) {
+            testAssert(flatResult[i] == nodeResult[i]);
+        }
+        testAssert(flatDistance == nodeDistance);
+
+        int expected = 0;
+        for (const AABox& b : array) {
+            expected += b.intersects(box) ? 1 : 0;
+        }
+        Array<AABox> boxResult;
+        tree.getIntersectingMembers(box, boxResult);
+        testAssert(boxResult.size() == expected);
+    }
+
+    // Both serialized forms restore the same structure
+    BinaryOutput nodeOutput("<memory>", G3D_LITTLE_ENDIAN);
+    nodeTree.serializeStructure(nodeOutput);
+    BinaryOutput flatOutput("<memory>", G3D_LITTLE_ENDIAN);
+    tree.serializeStructure(flatOutput);
+    testAssert((nodeOutput.size() == flatOutput.size()) && (memcmp(nodeOutput.getCArray(), flatOutput.getCArray(), size_t(flatOutput.size())) == 0));
+
+    BinaryOutput mappableOutput("<memory>", G3D_LITTLE_ENDIAN);
+    tree.serializeFlatStructure(mappableOutput);
+    BinaryInput mappableInput(mappableOutput.getCArray(), mappableOutput.size(), G3D_LITTLE_ENDIAN);
+    KDTree<AABox> restored;
+    restored.deserializeStructure(mappableInput);
+    BinaryOutput restoredOutput("<memory>", G3D_LITTLE_ENDIAN);
+    restored.serializeStructure(restoredOutput);
+    testAssert((restoredOutput.size() == flatOutput.size()) && (memcmp(restoredOutput.getCArray(), flatOutput.getCArray(), size_t(flatOutput.size())) == 0));
+
+    // Values inserted into the restored structure are found
+    restored.insert(array);
+    Array<AABox> restoredResult;
+    restored.getIntersectingMembers(AABox(Point3(-1, -1, -1), Point3(1, 1, 1)), restoredResult);
+    Array<AABox> flatResult;
+    tree.getIntersectingMembers(AABox(Point3(-1, -1, -1), Point3(1, 1, 1)), flatResult);
+    testAssert(restoredResult.size() == flatResult.size());
+}
+
+
 void perfKDTree() {
     PRINT_SECTION("Performance:: KDTree", "");
     Array<AABox>                array;
@@ -198,6 +362,53 @@ void perfKDTree() {
     PRINT_MILLI("plane", "(ms)", bspcount);
     PRINT_MILLI("box", "(ms)", boxcount);
     PRINT_MILLI("culled by AABox", "(ms)", arraycount);
+
+    {
+        PointKDTree<Point3> pointTree;
+        Array<Point3> queryArray;
+        for (int i = 0; i < NUM_POINTS; ++i) {
+            const Point3& pt = array[i].low();
+            pointTree.insert(pt);
+            if ((i % 10) == 0) {
+                queryArray.append(pt);
+            }
+        }
+        pointTree.balance();
+
+        const int k = 16;
+        Array<Point3> result;
+
+        // The guessed-radius loop that kNearest replaces: grow a sphere until it holds k points
+        stopwatch.tick();
+        for (const Point3& q : queryArray) {
+            for (float radius = 0.05f; result.size() < k; radius *= 2.0f) {
+                result.fastClear();
+                pointTree.getIntersectingMembers(Sphere(q, radius), result);
+            }
+            result.fastClear();
+        }
+        stopwatch.tock();
+        const chrono::nanoseconds sphereTime = stopwatch.elapsedDuration();
+
+        stopwatch.tick();
+        for (const Point3& q : queryArray) {
+            pointTree.kNearest(q, k, finf(), result);
+            result.fastClear();
+        }
+        stopwatch.tock();
+        const chrono::nanoseconds kNearestTime = stopwatch.elapsedDuration();
+
+        Array<Array<Point3>> resultArray;
+        stopwatch.tick();
+        pointTree.kNearest(queryArray, k, finf(), resultArray);
+        stopwatch.tock();
+        const chrono::nanoseconds batchTime = stopwatch.elapsedDuration();
+
+        PRINT_HEADER("PointKDTree<Point3> 16 nearest");
+        PRINT_NANO("sphere search", "(ns/query)", sphereTime / queryArray.size());
+        PRINT_NANO("kNearest", "(ns/query)", kNearestTime / queryArray.size());
+        PRINT_NANO("batch kNearest", "(ns/query)", batchTime / queryArray.size());
+    }
 }
 
 class IntersectCallback {
@@ -306,6 +517,8 @@ void testKDTree() {
     testRayIntersect();
     testBoxIntersect();
     testSerialize();
+    testFlatLayout();
+    testPointKDTreeKNearest();
 
     printf("passed\n");
 }
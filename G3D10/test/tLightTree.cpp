@@ -0,0 +1,250 @@
+/**
+  \file test/tLightTree.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+/** Small square Lambertian emitters facing down from a ceiling at y = 3, as in a large office */
+static void makeCeilingLights(int n, Array<LightTree::Emitter>& emitterArray, Array<float>& radiance) {
+    Random rnd(n, false);
+    const float spacing = 20.0f / float(n);
+    const float side = 0.2f * spacing;
+    for (int z = 0; z < n; ++z) {
+        for (int x = 0; x < n; ++x) {
+            const Point3 center(float(x) * spacing - 10.0f, 3.0f, float(z) * spacing - 10.0f);
+            const float L = rnd.uniform(0.5f, 2.0f);
+
+            LightTree::Emitter emitter;
+            emitter.bounds = AABox(center - Vector3(side, 0, side) * 0.5f, center + Vector3(side, 0, side) * 0.5f);
+            emitter.axis = -Vector3::unitY();
+            emitter.thetaO = 0.0f;
+            emitter.power = 4.0f * pif() * L * square(side);
+            emitterArray.append(emitter);
+            radiance.append(L);
+        }
+    }
+}
+
+
+/** Biradiance times the cosine at floor point X due to a uniformly chosen point on emitter \a e.
+    Returns the chosen point in Y. */
+static float ceilingLightContribution(const LightTree::Emitter& e, float L, const Point3& X, Random& rnd, Point3& Y) {
+    Y = e.bounds.low() + Vector3(rnd.uniform(), 0.0f, rnd.uniform()) * e.bounds.extent();
+    const Vector3& delta = Y - X;
+    const float d2 = delta.squaredLength();
+    const float cosTheta = delta.y / sqrtf(d2);
+    return L * e.bounds.extent().x * e.bounds.extent().z * square(cosTheta) / d2;
+}
+
+
+/** Stands in for a shadow ray */
+static bool visible(const Array<Sphere>& occluderArray, const Point3& X, const Point3& Y) {
+    const Vector3& delta = Y - X;
+    for (const Sphere& sphere : occluderArray) {
+        // Closest point on the segment to the sphere center
+        const float t = clamp((sphere.center - X).dot(delta) / delta.squaredLength(), 0.0f, 1.0f);
+        if ((X + delta * t - sphere.center).squaredLength() < square(sphere.radius)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void testLightTree() {
+    printf("LightTree ");
+
+    Random rnd(1017, false);
+
+    // Empty
+    {
+        LightTree tree;
+        float pdfValue;
+        testAssert(tree.sample(Point3::zero(), Vector3::unitY(), 0.5f, pdfValue) == -1);
+    }
+
+    // Mixed finite, infinite, and zero-power emitters
+    Array<LightTree::Emitter> emitterArray;
+    for (int i = 0; i < 300; ++i) {
+        LightTree::Emitter e;
+        const Point3 center(rnd.uniform(-10, 10), rnd.uniform(-10, 10), rnd.uniform(-10, 10));
+        const Vector3 extent(rnd.uniform(0, 0.5f), rnd.uniform(0, 0.5f), rnd.uniform(0, 0.5f));
+        e.bounds = AABox(center - extent, center + extent);
+        e.axis = Vector3::random(rnd);
+        e.thetaO = (i % 3 == 0) ? pif() : rnd.uniform(0, 0.5f);
+        e.power = (i % 37 == 0) ? 0.0f : rnd.uniform(0.1f, 10.0f);
+        e.infinite = (i % 101 == 0);
+        emitterArray.append(e);
+    }
+
+    LightTree tree;
+    tree.setEmitters(emitterArray);
+    testAssert(tree.size() == emitterArray.size());
+
+    for (int t = 0; t < 50; ++t) {
+        const Point3 X(rnd.uniform(-12, 12), rnd.uniform(-12, 12), rnd.uniform(-12, 12));
+        const Vector3& n = (t % 10 == 0) ? Vector3::nan() : Vector3::random(rnd);
+
+        // The probabilities form a distribution
+        double sum = 0.0;
+        for (int e = 0; e < emitterArray.size(); ++e) {
+            const float p = tree.pdf(e, X, n);
+            testAssert(p >= 0.0f);
+            if (emitterArray[e].power == 0.0f) {
+                testAssert(p == 0.0f);
+            }
+            sum += p;
+        }
+        testAssert(fuzzyEq(sum, 1.0));
+
+        // Omnidirectional emitters always have a chance
+        for (int e = 0; e < emitterArray.size(); e += 3) {
+            if ((emitterArray[e].power > 0.0f) && ! emitterArray[e].infinite) {
+                testAssert(tree.pdf(e, X, Vector3::nan()) > 0.0f);
+            }
+        }
+
+        // sample() reports the same probability as pdf()
+        for (int s = 0; s < 20; ++s) {
+            float pdfValue;
+            const int e = tree.sample(X, n, rnd.uniform(), pdfValue);
+            testAssert((e >= 0) && (e < emitterArray.size()));
+            testAssert(emitterArray[e].power > 0.0f);
+            testAssert(pdfValue > 0.0f);
+            testAssert(fabs(pdfValue - tree.pdf(e, X, n)) <= 1e-4f * pdfValue);
+        }
+    }
+
+    // One-sided emitters never choose a point behind all of them
+    {
+        Array<LightTree::Emitter> ceiling;
+        Array<float> radiance;
+        makeCeilingLights(8, ceiling, radiance);
+        tree.setEmitters(ceiling);
+        float pdfValue;
+        testAssert(tree.sample(Point3(0, 100, 0), Vector3::nan(), 0.5f, pdfValue) == -1);
+        testAssert(tree.sample(Point3(0, 0, 0), Vector3::unitY(), 0.5f, pdfValue) != -1);
+    }
+
+    printf("passed\n");
+}
+
+
+void perfLightTree() {
+    PRINT_SECTION("Performance: LightTree", "Direct light from 4096 ceiling lights at 256 floor points with occluders");
+
+    Array<LightTree::Emitter> emitterArray;
+    Array<float> radiance;
+    makeCeilingLights(64, emitterArray, radiance);
+    const int numLights = emitterArray.size();
+
+    Random rnd(10, false);
+    Array<Sphere> occluderArray;
+    for (int i = 0; i < 32; ++i) {
+        occluderArray.append(Sphere(Point3(rnd.uniform(-10, 10), rnd.uniform(1, 2), rnd.uniform(-10, 10)), rnd.uniform(0.5f, 1.0f)));
+    }
+
+    Array<Point3> pointArray;
+    for (int i = 0; i < 256; ++i) {
+        pointArray.append(Point3(rnd.uniform(-10, 10), 0.0f, rnd.uniform(-10, 10)));
+    }
+    const Vector3& n = Vector3::unitY();
+
+    // Reference: several shadowed samples of every light
+    Array<double> reference;
+    for (const Point3& X : pointArray) {
+        double sum = 0.0;
+        for (int k = 0; k < 8; ++k) {
+            for (int j = 0; j < numLights; ++j) {
+                Point3 Y;
+                const float c = ceilingLightContribution(emitterArray[j], radiance[j], X, rnd, Y);
+                if (visible(occluderArray, X, Y)) {
+                    sum += c;
+                }
+            }
+        }
+        reference.append(sum / 8.0);
+    }
+
+    Stopwatch stopwatch;
+    stopwatch.tick();
+    LightTree tree;
+    tree.setEmitters(emitterArray);
+    stopwatch.tock();
+    PRINT_TEXT("", "Time");
+    PRINT_MILLI("Build", "(ms)", stopwatch.elapsedDuration());
+    printf("\n");
+
+    // Each method casts one shadow ray per sample. Efficiency = 1 / (variance * time),
+    // which is the convergence rate per second. All methods are unbiased.
+    PRINT_TEXT("", "us/sample", "rel. RMSE", "rel. eff.");
+    double baselineEfficiency = 0.0;
+    Array<float> contribution;
+    Array<Point3> position;
+    contribution.resize(numLights);
+    position.resize(numLights);
+    for (int method = 0; method < 3; ++method) {
+        // The exhaustive method is so slow that it gets fewer samples
+        const int samplesPerPoint = (method == 0) ? 4 : 64;
+
+        double squaredError = 0.0;
+        stopwatch.tick();
+        for (int i = 0; i < pointArray.size(); ++i) {
+            const Point3& X = pointArray[i];
+            double sum = 0.0;
+            for (int s = 0; s < samplesPerPoint; ++s) {
+                int j = -1;
+                float estimate = 0.0f;
+                Point3 Y;
+                if (method == 0) {
+                    // Resample from all lights in proportion to their contribution, as
+                    // PathTracer does for small numbers of lights
+                    float total = 0.0f;
+                    for (int k = 0; k < numLights; ++k) {
+                        contribution[k] = ceilingLightContribution(emitterArray[k], radiance[k], X, rnd, position[k]);
+                        total += contribution[k];
+                    }
+                    float r = rnd.uniform(0, total);
+                    for (j = 0; (j < numLights - 1) && (r > contribution[j]); ++j) {
+                        r -= contribution[j];
+                    }
+                    estimate = total;
+                    Y = position[j];
+                } else if (method == 1) {
+                    // Uniform light selection
+                    j = rnd.integer(0, numLights - 1);
+                    estimate = ceilingLightContribution(emitterArray[j], radiance[j], X, rnd, Y) * float(numLights);
+                } else {
+                    float pdfValue;
+                    j = tree.sample(X, n, rnd.uniform(), pdfValue);
+                    if (j >= 0) {
+                        estimate = ceilingLightContribution(emitterArray[j], radiance[j], X, rnd, Y) / pdfValue;
+                    }
+                }
+
+                if ((j >= 0) && visible(occluderArray, X, Y)) {
+                    sum += estimate;
+                }
+            }
+            squaredError += square((sum / samplesPerPoint - reference[i]) / reference[i]);
+        }
+        stopwatch.tock();
+
+        const double usPerSample = stopwatch.elapsedDuration<std::chrono::duration<double, std::micro>>().count() / (double(pointArray.size()) * samplesPerPoint);
+        const double relativeMSE = squaredError / pointArray.size();
+        // Per-sample variance, so that efficiency does not depend on samplesPerPoint
+        const double efficiency = 1.0 / (relativeMSE * samplesPerPoint * usPerSample);
+        if (method == 0) {
+            baselineEfficiency = efficiency;
+        }
+
+        static const char* name[3] = {"All lights", "Uniform", "LightTree"};
+        PRINT_TEXT(name[method], format("%.2f", usPerSample).c_str(), format("%.4f", sqrt(relativeMSE)).c_str(), format("%.1fx", efficiency / baselineEfficiency).c_str());
+    }
+}
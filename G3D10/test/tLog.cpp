@@ -0,0 +1,94 @@
+/**
+  \file test/tLog.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+#include <thread>
+
+static const char* asyncLogFilename = "tLog-async.txt";
+static const char* syncLogFilename  = "tLog-sync.txt";
+
+/** Runs \a numThreads threads that each log \a messagesPerThread short lines */
+static void logFromThreads(Log& log, int numThreads, int messagesPerThread) {
+    Array<std::thread> threadArray;
+    for (int t = 0; t < numThreads; ++t) {
+        threadArray.append(std::thread([&log, t, messagesPerThread]() {
+            for (int i = 0; i < messagesPerThread; ++i) {
+                log.printf("thread %d message %d value %f\n", t, i, float(i) * 0.5f);
+            }
+        }));
+    }
+    for (std::thread& thread : threadArray) {
+        thread.join();
+    }
+}
+
+
+void testLog() {
+    printf("Log ");
+
+    const int numThreads = 4;
+    const int messagesPerThread = 2000;
+    {
+        Log::Settings settings;
+        settings.asynchronous = true;
+        // Small enough to force producers to wait on the writer
+        settings.threadBufferBytes = 4096;
+
+        Log log(asyncLogFilename, settings);
+        logFromThreads(log, numThreads, messagesPerThread);
+        log.println("last line");
+        log.flush();
+        testAssert(log.droppedMessageCount() == 0);
+
+        const String& contents = readWholeFile(asyncLogFilename);
+        for (int t = 0; t < numThreads; ++t) {
+            testAssert(contents.find(format("thread %d message %d ", t, messagesPerThread - 1)) != String::npos);
+        }
+        testAssert(contents.find("last line\n") != String::npos);
+    }
+
+    // The destructor must have written the shutdown section
+    testAssert(readWholeFile(asyncLogFilename).find("Closing log file") != String::npos);
+    FileSystem::removeFile(asyncLogFilename);
+
+    printf("passed\n");
+}
+
+
+void perfLog() {
+    PRINT_SECTION("Performance: Log", "Cost per printf call from several threads");
+
+    const int messagesPerThread = 20000;
+    const int threadCounts[] = {1, 4, 8};
+
+    PRINT_TEXT("", "1 thread", "4 threads", "8 threads");
+
+    for (int mode = 0; mode < 3; ++mode) {
+        chrono::nanoseconds perCall[3];
+        for (int c = 0; c < 3; ++c) {
+            const int numThreads = threadCounts[c];
+            Log::Settings settings;
+            settings.asynchronous = (mode > 0);
+            settings.dropWhenFull = (mode == 2);
+
+            Log log(syncLogFilename, settings);
+            Stopwatch stopwatch;
+            stopwatch.tick();
+            logFromThreads(log, numThreads, messagesPerThread);
+            stopwatch.tock();
+            perCall[c] = stopwatch.elapsedDuration() / (numThreads * messagesPerThread);
+        }
+
+        static const char* name[] = {"Synchronous", "Asynchronous (block)", "Asynchronous (drop)"};
+        PRINT_NANO(name[mode], "(ns/call)", perCall[0], perCall[1], perCall[2]);
+    }
+
+    FileSystem::removeFile(syncLogFilename);
+}
@@ -0,0 +1,174 @@
+/**
+  \file test/tNetwork.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+#include <thread>
+#ifndef G3D_WINDOWS
+#   include <sys/resource.h>
+#endif
+
+static const uint16 testPort = 17451;
+
+/** CPU time consumed by all threads of this process, in seconds */
+static RealTime processTime() {
+#   ifdef G3D_WINDOWS
+        FILETIME creation, exit, kernel, user;
+        GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+        const uint64 ticks = ((uint64(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime) + ((uint64(user.dwHighDateTime) << 32) | user.dwLowDateTime);
+        return RealTime(ticks) * 100e-9;
+#   else
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return RealTime(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + RealTime(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#   endif
+}
+
+
+/** Connects a client to a new server over loopback and returns both ends */
+static void connectOverLoopback(shared_ptr<NetServer>& server, shared_ptr<NetConnection>& client, shared_ptr<NetConnection>& serverSide) {
+    server = NetServer::create(NetAddress("127.0.0.1", testPort), 4, 2);
+    client = NetConnection::connectToServer(NetAddress("127.0.0.1", testPort), 2);
+
+    const RealTime timeout = System::time() + 5.0;
+    while ((isNull(serverSide) || (client->status() == NetConnection::WAITING_TO_CONNECT)) && (System::time() < timeout)) {
+        NetConnectionIterator& it = server->newConnectionIterator();
+        if (it.isValid()) {
+            serverSide = it.connection();
+            ++it;
+        }
+        System::sleep(0.001);
+    }
+    testAssertM(notNull(serverSide) && (client->status() != NetConnection::DISCONNECTED), "Could not connect over loopback");
+
+    // Create the incoming queues before any message arrives on the network thread
+    for (NetChannel c = 0; c < 2; ++c) {
+        client->incomingMessageIterator(c);
+        serverSide->incomingMessageIterator(c);
+    }
+}
+
+
+static void disconnectLoopback(shared_ptr<NetServer>& server, shared_ptr<NetConnection>& client, shared_ptr<NetConnection>& serverSide) {
+    client->disconnect(false);
+    server->stop();
+    client.reset();
+    serverSide.reset();
+    server.reset();
+}
+
+
+void testNetwork() {
+    printf("Network ");
+
+    shared_ptr<NetServer> server;
+    shared_ptr<NetConnection> client, serverSide;
+    connectOverLoopback(server, client, serverSide);
+
+    // A burst of messages on two channels arrives complete and in order on each
+    const int numMessages = 200;
+    for (int i = 0; i < numMessages; ++i) {
+        BinaryOutput bo("<memory>", G3D_LITTLE_ENDIAN);
+        bo.writeInt32(i);
+        client->send(i % 3, bo, i % 2);
+    }
+
+    int next[2] = {0, 1};
+    const RealTime timeout = System::time() + 5.0;
+    while (((next[0] < numMessages) || (next[1] < numMessages)) && (System::time() < timeout)) {
+        for (NetChannel c = 0; c < 2; ++c) {
+            NetMessageIterator& msg = serverSide->incomingMessageIterator(c);
+            while (msg.isValid()) {
+                testAssert(msg.channel() == c);
+                testAssert(msg.type() == NetMessageType(next[c] % 3));
+                const int value = msg.binaryInput().readInt32();
+                testAssert(value == next[c]);
+                next[c] += 2;
+                ++msg;
+            }
+        }
+        System::sleep(0.001);
+    }
+    testAssert((next[0] >= numMessages) && (next[1] >= numMessages));
+
+    // Broadcasts reach the client
+    BinaryOutput bo("<memory>", G3D_LITTLE_ENDIAN);
+    bo.writeString32("to everyone");
+    server->omniConnection()->send(7, bo);
+    bool received = false;
+    for (const RealTime t = System::time() + 5.0; ! received && (System::time() < t); System::sleep(0.001)) {
+        NetMessageIterator& msg = client->incomingMessageIterator(0);
+        if (msg.isValid()) {
+            testAssert(msg.type() == 7);
+            const String& text = msg.binaryInput().readString32();
+            testAssert(text == "to everyone");
+            received = true;
+            ++msg;
+        }
+    }
+    testAssert(received);
+
+    disconnectLoopback(server, client, serverSide);
+    printf("passed\n");
+}
+
+
+void perfNetwork() {
+    PRINT_SECTION("Performance: Network", "Loopback round trips and idle cost of the network thread");
+
+    shared_ptr<NetServer> server;
+    shared_ptr<NetConnection> client, serverSide;
+    connectOverLoopback(server, client, serverSide);
+
+    // Ping-pong: the server side echoes each message as soon as it is received
+    const int numRoundTrips = 200;
+    Stopwatch stopwatch;
+    stopwatch.tick();
+    int completed = 0;
+    const RealTime timeout = System::time() + 20.0;
+    for (int i = 0; (i < numRoundTrips) && (System::time() < timeout); ++i) {
+        BinaryOutput ping("<memory>", G3D_LITTLE_ENDIAN);
+        ping.writeInt32(i);
+        client->send(1, ping);
+
+        bool echoed = false;
+        while (! echoed && (System::time() < timeout)) {
+            NetMessageIterator& request = serverSide->incomingMessageIterator(0);
+            if (request.isValid()) {
+                BinaryOutput pong("<memory>", G3D_LITTLE_ENDIAN);
+                pong.writeInt32(request.binaryInput().readInt32());
+                ++request;
+                serverSide->send(2, pong);
+            }
+
+            NetMessageIterator& reply = client->incomingMessageIterator(0);
+            if (reply.isValid()) {
+                echoed = (reply.binaryInput().readInt32() == i);
+                ++reply;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        completed += echoed ? 1 : 0;
+    }
+    stopwatch.tock();
+    testAssert(completed == numRoundTrips);
+
+    // Connected, but nothing to send or receive
+    const RealTime idleSeconds = 1.0;
+    const RealTime cpuStart = processTime();
+    System::sleep(idleSeconds);
+    const RealTime idleCPU = (processTime() - cpuStart) / idleSeconds;
+
+    PRINT_TEXT("", "Time");
+    PRINT_MICRO("Round trip", "(us)", stopwatch.elapsedDuration() / max(completed, 1));
+    printf("  Idle CPU while connected: %.1f%% of one core\n", 100.0 * idleCPU);
+
+    disconnectLoopback(server, client, serverSide);
+}
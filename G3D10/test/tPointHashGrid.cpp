@@ -182,9 +182,50 @@ void testSphereIterator() {
     }
 }
 
+/** The three point structures must agree on k-nearest distances */
+void testKNearest() {
+    Array<Vector3> point;
+    for (int i = 0; i < 3000; ++i) {
+        point.append(Vector3(uniformRandom(0, 4), uniformRandom(0, 4), uniformRandom(0, 4)));
+    }
+
+    PointHashGrid<Vector3> grid(0.25f);
+    FastPointHashGrid<Vector3> fastGrid(0.25f);
+    PointKDTree<Vector3> tree;
+    grid.insert(point);
+    fastGrid.insert(point);
+    tree.insert(point);
+    tree.balance();
+
+    for (int t = 0; t < 300; ++t) {
+        const Point3 q(uniformRandom(-1, 5), uniformRandom(-1, 5), uniformRandom(-1, 5));
+        const int k = Random::common().integer(0, 30);
+        const float maxRadius = (t % 2 == 0) ? finf() : uniformRandom(0.1f, 1.0f);
+
+        Array<Vector3> treeResult, gridResult, fastGridResult;
+        Array<float> treeDistance, gridDistance, fastGridDistance;
+        tree.kNearest(q, k, maxRadius, treeResult, treeDistance);
+        grid.kNearest(q, k, maxRadius, gridResult, gridDistance);
+        fastGrid.kNearest(q, k, maxRadius, fastGridResult, fastGridDistance);
+
+        testAssert(gridDistance.size() == treeDistance.size());
+        testAssert(fastGridDistance.size() == treeDistance.size());
+        for (int i = 0; i < treeDistance.size(); ++i) {
+            testAssert(gridDistance[i] == treeDistance[i]);
+            testAssert(fastGridDistance[i] == treeDistance[i]);
+        }
+    }
+
+    // More neighbors requested than there are values
+    Array<Vector3> all;
+    fastGrid.kNearest(Point3(100, 100, 100), point.size() + 10, finf(), all);
+    testAssert(all.size() == point.size());
+}
+
 void testPointHashGrid() {
     testSphereIterator();
     correctPointHashGrid();
+    testKNearest();
 
     Array<Vector3> vec3Array;
     vec3Array.append(Vector3(0.0, 0.0, 0.0));
@@ -386,6 +427,62 @@ void perfPointHashGrid() {
     PRINT_MILLI("PointKDTree", "(ms/elt)", treeTime * 1e6 / count);
     PRINT_MILLI("PointHashGrid", "(ms/elt)", hashGridTime * 1e6 / count);
 
+    // k-nearest neighbors, compared to growing a sphere until it holds k points
+    FastPointHashGrid<Vector3> fastGrid(sphere.radius * 2.0f);
+    fastGrid.insert(v);
+
+    const int k = 16;
+    Array<Vector3> result;
+    const int numQueries = numSpheres / 10;
+    chrono::nanoseconds kNearestTime[3], batchTime[3], sphereTime;
+
+    treeTimer.tick();
+    for (int i = 0; i < numQueries; ++i) {
+        for (float radius = sphere.radius; result.size() < k; radius *= 2.0f) {
+            result.fastClear();
+            tree.getIntersectingMembers(Sphere(pos[i], radius), result);
+        }
+        result.fastClear();
+    }
+    treeTimer.tock();
+    sphereTime = treeTimer.elapsedDuration();
+
+    Array<Point3> queryArray;
+    for (int i = 0; i < numQueries; ++i) {
+        queryArray.append(pos[i]);
+    }
+
+    for (int s = 0; s < 3; ++s) {
+        Array<Array<Vector3>> resultArray;
+        treeTimer.tick();
+        for (int i = 0; i < numQueries; ++i) {
+            switch (s) {
+            case 0: tree.kNearest(pos[i], k, finf(), result); break;
+            case 1: hashGrid.kNearest(pos[i], k, finf(), result); break;
+            default: fastGrid.kNearest(pos[i], k, finf(), result); break;
+            }
+            result.fastClear();
+        }
+        treeTimer.tock();
+        kNearestTime[s] = treeTimer.elapsedDuration() / numQueries;
+
+        treeTimer.tick();
+        switch (s) {
+        case 0: tree.kNearest(queryArray, k, finf(), resultArray); break;
+        case 1: hashGrid.kNearest(queryArray, k, finf(), resultArray); break;
+        default: fastGrid.kNearest(queryArray, k, finf(), resultArray); break;
+        }
+        treeTimer.tock();
+        batchTime[s] = treeTimer.elapsedDuration() / numQueries;
+    }
+
+    PRINT_HEADER("16 Nearest Neighbors");
+    PRINT_TEXT("", "kNearest", "batch");
+    PRINT_NANO("PointKDTree sphere search", "(ns/query)", sphereTime / numQueries);
+    PRINT_NANO("PointKDTree", "(ns/query)", kNearestTime[0], batchTime[0]);
+    PRINT_NANO("PointHashGrid", "(ns/query)", kNearestTime[1], batchTime[1]);
+    PRINT_NANO("FastPointHashGrid", "(ns/query)", kNearestTime[2], batchTime[2]);
+
     //PRINT_HEADER("PointHashGrid Performance");
     //printf("\nPointHashGrid performance: max bucket size = %d, average length = %f\n", hashGrid.debugGetDeepestBucketSize(), hashGrid.debugGetAverageBucketSize());
 }
@@ -14,6 +14,7 @@ using G3D::uint8;
 using G3D::uint32;
 using G3D::uint64;
 #include <deque>
+#include <thread>
 
 class BigE {
 public:
@@ -47,6 +48,88 @@ public:
 };
 
 
+/** The Spinlock-protected Queue that ThreadsafeQueue used to be, as a baseline */
+template<class T>
+class SpinlockQueue {
+private:
+    Spinlock    m_mutex;
+    Queue<T>    m_data;
+public:
+    void pushBack(const T& v) {
+        m_mutex.lock();
+        m_data.pushBack(v);
+        m_mutex.unlock();
+    }
+
+    bool popFront(T& v) {
+        bool read = false;
+        m_mutex.lock();
+        if (m_data.size() > 0) {
+            v = m_data.popFront();
+            read = true;
+        }
+        m_mutex.unlock();
+        return read;
+    }
+};
+
+
+/** Time for \a numProducers threads to each push \a count elements through \a q
+    while \a numConsumers threads pop them */
+template<class Q>
+static chrono::nanoseconds contend(Q& q, int numProducers, int numConsumers, int count) {
+    std::atomic<int> remaining(numProducers * count);
+    Array<std::thread*> threadArray;
+
+    Stopwatch stopwatch;
+    stopwatch.tick();
+    for (int p = 0; p < numProducers; ++p) {
+        threadArray.append(new std::thread([&q, count]() {
+            for (int i = 0; i < count; ++i) {
+                q.pushBack(i);
+            }
+        }));
+    }
+    for (int c = 0; c < numConsumers; ++c) {
+        threadArray.append(new std::thread([&q, &remaining]() {
+            int v;
+            while (remaining.load(std::memory_order_relaxed) > 0) {
+                if (q.popFront(v)) {
+                    remaining.fetch_sub(1, std::memory_order_relaxed);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+    for (std::thread* t : threadArray) {
+        t->join();
+        delete t;
+    }
+    stopwatch.tock();
+
+    return stopwatch.elapsedDuration();
+}
+
+
+static void perfThreadsafeQueue() {
+    const int count = 200000;
+
+    PRINT_HEADER("Contended push/pop (producer threads + consumer threads)");
+    PRINT_TEXT("", "Spinlock", "Threadsafe");
+    for (int n = 1; n <= 4; n *= 2) {
+        SpinlockQueue<int> spinlockQ;
+        const chrono::nanoseconds spinlockTime = contend(spinlockQ, n, n, count);
+
+        ThreadsafeQueue<int> threadsafeQ(1024);
+        const chrono::nanoseconds threadsafeTime = contend(threadsafeQ, n, n, count);
+
+        const std::string leader = std::to_string(n) + " + " + std::to_string(n);
+        PRINT_NANO(leader.c_str(), "(ns/elt)", spinlockTime / (n * count), threadsafeTime / (n * count));
+    }
+}
+
+
 void perfQueue() {
     PRINT_SECTION("Performance: Queue", "");
     Stopwatch stopwatch;
@@ -241,6 +324,8 @@ void perfQueue() {
     PRINT_MICRO("std::deque<int>", "(us/iteration)", stdStreamSmall / iterations);
     PRINT_MICRO("G3D::Queue<BigE>", "(us/iteration)", g3dStreamLarge / iterations);
     PRINT_MICRO("std::deque<BigE>", "(us/iteration)", stdStreamLarge / iterations);
+
+    perfThreadsafeQueue();
 }
 
 
@@ -280,6 +365,105 @@ static void testCopy() {
 }
 
 
+static void testThreadsafeQueue() {
+    // Bounded ring
+    {
+        MPMCQueue<int> q(5);
+        testAssert(q.capacity() == 8);
+        int pushed = 0;
+        for (int i = 0; i < 10; ++i) {
+            pushed += q.tryPush(i) ? 1 : 0;
+        }
+        testAssert(pushed == 8);
+        int v = -1;
+        bool read = q.tryPop(v);
+        testAssert(read && (v == 0));
+
+        int batch[10];
+        const int popped = q.tryPopBatch(batch, 10);
+        testAssert((popped == 7) && (batch[0] == 1) && (batch[6] == 7));
+        const int batchPushed = q.tryPushBatch(batch, 7);
+        testAssert(batchPushed == 7);
+        testAssert(q.size() == 7);
+
+        q.clear();
+        read = q.waitPop(v, 0.01);
+        testAssert(! read);
+    }
+
+    // Order is preserved when the ring overflows, and by the double-ended operations
+    {
+        ThreadsafeQueue<int> q(4);
+        for (int i = 1; i <= 10; ++i) {
+            q.pushBack(i);
+        }
+        q.pushFront(0);
+        testAssert(q.size() == 11);
+
+        int v = -1;
+        bool read = q.popBack(v);
+        testAssert(read && (v == 10));
+        q.pushBack(10);
+
+        for (int i = 0; i <= 10; ++i) {
+            read = q.popFront(v);
+            testAssert(read && (v == i));
+        }
+        read = q.popFront(v);
+        testAssert(! read && q.empty());
+
+        Array<int> in, out;
+        for (int i = 0; i < 9; ++i) {
+            in.append(i);
+        }
+        q.pushBack(in);
+        const int n = q.popFront(out, 20);
+        testAssert((n == 9) && (out.size() == 9) && (out[8] == 8));
+    }
+
+    // Every element arrives exactly once, and in order from each producer
+    {
+        ThreadsafeQueue<int> q(64);
+        const int numProducers = 3, numConsumers = 3, count = 20000;
+        std::atomic<int> received(0);
+        std::atomic<bool> outOfOrder(false);
+        Array<std::thread*> threadArray;
+
+        for (int p = 0; p < numProducers; ++p) {
+            threadArray.append(new std::thread([&q, p, count]() {
+                for (int i = 0; i < count; ++i) {
+                    q.pushBack(p * count + i);
+                }
+            }));
+        }
+        for (int c = 0; c < numConsumers; ++c) {
+            threadArray.append(new std::thread([&, c]() {
+                int last[numProducers] = {-1, -1, -1};
+                int v;
+                while (received.load() < numProducers * count) {
+                    if (q.waitPopFront(v, 0.01)) {
+                        const int p = v / count;
+                        if (v % count <= last[p]) {
+                            outOfOrder = true;
+                        }
+                        last[p] = v % count;
+                        ++received;
+                    }
+                }
+            }));
+        }
+        for (std::thread* t : threadArray) {
+            t->join();
+            delete t;
+        }
+
+        testAssert(received.load() == numProducers * count);
+        testAssert(! outOfOrder.load());
+        testAssert(q.empty());
+    }
+}
+
+
 void testQueue() {
     printf("Queue ");
 
@@ -373,6 +557,8 @@ void testQueue() {
         Queue<int> r(q);
         _check(r);
     }
+
+    testThreadsafeQueue();
     
     printf("succeeded\n");
 }
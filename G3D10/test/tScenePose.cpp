@@ -0,0 +1,279 @@
+/**
+  \file test/tScenePose.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+namespace {
+
+/** One posed part of a PartModel, with no rendering */
+class PartSurface : public Surface {
+public:
+    CFrame      m_frame;
+    CFrame      m_previousFrame;
+
+    PartSurface(const CFrame& frame, const CFrame& previousFrame, const ExpressiveLightScatteringProperties& e) :
+        Surface(e), m_frame(frame), m_previousFrame(previousFrame) {}
+
+    virtual void getCoordinateFrame(CoordinateFrame& cframe, bool previous = false) const override {
+        cframe = previous ? m_previousFrame : m_frame;
+    }
+
+    virtual void getObjectSpaceBoundingBox(AABox& box, bool previous = false) const override {
+        box = AABox(Point3(-0.5f, -0.5f, -0.5f), Point3(0.5f, 0.5f, 0.5f));
+    }
+
+    virtual void getObjectSpaceBoundingSphere(Sphere& sphere, bool previous = false) const override {
+        sphere = Sphere(Point3::zero(), 0.87f);
+    }
+
+    virtual TransparencyType transparencyType() const override {
+        return TransparencyType::NONE;
+    }
+
+    virtual void renderWireframeHomogeneous(RenderDevice* rd, const Array<shared_ptr<Surface> >& surfaceArray, const Color4& color, bool previous) const override {}
+
+    virtual bool canBeFullyRepresentedInGBuffer(const GBuffer::Specification& specification) const override {
+        return false;
+    }
+
+    virtual void render(RenderDevice* rd, const LightingEnvironment& environment, RenderPassType passType) const override {}
+
+    virtual void setStorage(ImageStorage newStorage) override {}
+};
+
+
+/** A chain of parts that poses like an unskinned ArticulatedModel, including
+    per-model scratch space for the part transforms, without a GPU */
+class PartModel : public Model {
+protected:
+    String          m_name;
+    Array<CFrame>   m_partFrame;
+    Array<CFrame>   m_previousPartFrame;
+
+public:
+    bool            concurrent;
+    int             poseCount;
+
+    PartModel(const String& name, int numParts) : m_name(name), concurrent(true), poseCount(0) {
+        m_partFrame.resize(numParts);
+        m_previousPartFrame.resize(numParts);
+    }
+
+    virtual const String& name() const override {
+        return m_name;
+    }
+
+    virtual const String& className() const override {
+        static const String n("PartModel");
+        return n;
+    }
+
+    virtual void pose
+    (Array<shared_ptr<Surface> >&   surfaceArray,
+     const CFrame&                  rootFrame,
+     const CFrame&                  prevFrame,
+     const shared_ptr<Entity>&      entity,
+     const Model::Pose*             pose,
+     const Model::Pose*             prevPose,
+     const Surface::ExpressiveLightScatteringProperties& e) override {
+
+        ++poseCount;
+        const CFrame& joint = CFrame::fromXYZYPRDegrees(0.0f, 1.0f, 0.0f, 15.0f, 5.0f, 0.0f);
+        for (int p = 0; p < m_partFrame.size(); ++p) {
+            m_partFrame[p]         = ((p == 0) ? rootFrame : m_partFrame[p - 1]) * joint;
+            m_previousPartFrame[p] = ((p == 0) ? prevFrame : m_previousPartFrame[p - 1]) * joint;
+        }
+
+        for (int p = 0; p < m_partFrame.size(); ++p) {
+            surfaceArray.append(std::make_shared<PartSurface>(m_partFrame[p], m_previousPartFrame[p], e));
+        }
+    }
+
+    virtual bool canPoseConcurrently() const override {
+        return concurrent;
+    }
+};
+
+
+CFrame frameOf(const shared_ptr<Surface>& surface, bool previous = false) {
+    CFrame frame;
+    surface->getCoordinateFrame(frame, previous);
+    return frame;
+}
+
+} // anonymous namespace
+
+
+void testScenePose() {
+    printf("Scene::onPose ");
+
+    const int numParts = 3;
+    const shared_ptr<Scene>& scene = Scene::create(nullptr);
+    const shared_ptr<PartModel>& model = std::make_shared<PartModel>("model", numParts);
+
+    const shared_ptr<VisibleEntity>& still  = VisibleEntity::create("still", scene.get(), model, CFrame());
+    const shared_ptr<VisibleEntity>& moving = VisibleEntity::create("moving", scene.get(), model, Point3(10, 0, 0));
+    const shared_ptr<VisibleEntity>& hidden = VisibleEntity::create("hidden", scene.get(), model, Point3(20, 0, 0), nullptr, true, true, false);
+    scene->insert(still);
+    scene->insert(moving);
+    scene->insert(hidden);
+
+    Array<shared_ptr<Surface> > previous, current;
+    scene->onPose(previous);
+    scene->onPose(current);
+    testAssert(current.size() == 2 * numParts);
+
+    // Nothing changed, so the same surfaces come back without posing
+    int poseCount = model->poseCount;
+    Array<shared_ptr<Surface> > cached;
+    scene->onPose(cached);
+    testAssert(model->poseCount == poseCount);
+    testAssert(cached.size() == current.size());
+    for (int i = 0; i < cached.size(); ++i) {
+        testAssert(cached[i] == current[i]);
+    }
+
+    // Only the moving entity is re-posed, and the order is unchanged
+    const CFrame& moved = Point3(11, 0, 0);
+    moving->setFrame(moved, true);
+    previous = cached;
+    current.fastClear();
+    scene->onPose(current);
+    testAssert(model->poseCount == poseCount + 1);
+    testAssert(current.size() == 2 * numParts);
+    for (int p = 0; p < numParts; ++p) {
+        testAssert(current[p] == previous[p]);
+        testAssert(current[numParts + p] != previous[numParts + p]);
+    }
+    testAssert(frameOf(current[numParts]).translation.x > 10.5f);
+    testAssert(frameOf(current[numParts], true).translation.x < 10.5f);
+
+    // After stopping, the previous-frame transforms catch up before the cache is reused
+    moving->setFrame(moved, true);
+    current.fastClear();
+    scene->onPose(current);
+    testAssert(frameOf(current[numParts], true).translation == frameOf(current[numParts]).translation);
+    poseCount = model->poseCount;
+    current.fastClear();
+    scene->onPose(current);
+    current.fastClear();
+    scene->onPose(current);
+    testAssert(model->poseCount == poseCount);
+
+    // Changes that do not move the entity also invalidate the cache
+    still->setCastsShadows(false);
+    current.fastClear();
+    scene->onPose(current);
+    testAssert(model->poseCount == poseCount + 1);
+    testAssert(! current[0]->expressiveLightScatteringProperties.castsShadows);
+
+    hidden->setVisible(true);
+    current.fastClear();
+    scene->onPose(current);
+    testAssert(current.size() == 3 * numParts);
+
+    // Many models re-posed concurrently produce the same result as posing serially
+    const shared_ptr<Scene>& crowd = Scene::create(nullptr);
+    Array<shared_ptr<PartModel> > modelArray;
+    Array<shared_ptr<VisibleEntity> > entityArray;
+    for (int m = 0; m < 16; ++m) {
+        modelArray.append(std::make_shared<PartModel>(format("model%d", m), numParts));
+    }
+    for (int e = 0; e < 200; ++e) {
+        entityArray.append(VisibleEntity::create(format("entity%d", e), crowd.get(), modelArray[e % modelArray.size()], Point3(float(e), 0, 0)));
+        crowd->insert(entityArray.last());
+    }
+    for (int e = 0; e < entityArray.size(); ++e) {
+        entityArray[e]->setFrame(Point3(float(e), 1, 0), true);
+    }
+    current.fastClear();
+    crowd->onPose(current);
+    testAssert(current.size() == entityArray.size() * numParts);
+    for (int e = 0; e < entityArray.size(); ++e) {
+        Array<shared_ptr<Surface> > expected;
+        modelArray[e % modelArray.size()]->pose(expected, entityArray[e]->frame(), entityArray[e]->previousFrame(), entityArray[e], nullptr, nullptr, Surface::ExpressiveLightScatteringProperties());
+        for (int p = 0; p < numParts; ++p) {
+            testAssert(frameOf(current[e * numParts + p]) == frameOf(expected[p]));
+            testAssert(frameOf(current[e * numParts + p], true) == frameOf(expected[p], true));
+        }
+    }
+
+    printf("passed\n");
+}
+
+
+void perfScenePose() {
+    PRINT_SECTION("Performance: Scene::onPose", "50k synthetic unskinned entities without a GPU");
+
+    const int numEntities = 50000, numModels = 500, numParts = 8, numFrames = 10;
+    const float fraction[] = {0.0f, 0.01f, 0.1f, 0.5f, 1.0f};
+
+    const shared_ptr<Scene>& scene = Scene::create(nullptr);
+    Array<shared_ptr<PartModel> > modelArray;
+    Array<shared_ptr<VisibleEntity> > entityArray;
+    for (int m = 0; m < numModels; ++m) {
+        modelArray.append(std::make_shared<PartModel>(format("model%d", m), numParts));
+    }
+    Random rnd(1234, false);
+    for (int e = 0; e < numEntities; ++e) {
+        const Point3 position(rnd.uniform(-100, 100), 0, rnd.uniform(-100, 100));
+        entityArray.append(VisibleEntity::create(format("entity%d", e), scene.get(), modelArray[e % numModels], position));
+        scene->insert(entityArray.last());
+    }
+
+    // A fixed, scattered order in which entities start moving
+    Array<int> order;
+    for (int e = 0; e < numEntities; ++e) {
+        order.append(e);
+    }
+    order.randomize(rnd);
+
+    Array<shared_ptr<Surface> > surfaceArray;
+    PRINT_TEXT("Moving entities", "Uncached", "Cached");
+    for (const float f : fraction) {
+        const int numMoving = iRound(f * numEntities);
+        chrono::nanoseconds time[2];
+        for (int cached = 0; cached < 2; ++cached) {
+            for (const shared_ptr<PartModel>& model : modelArray) {
+                // Uncached approximates the previous behavior: every entity re-posed on the calling thread
+                model->concurrent = (cached != 0);
+            }
+
+            // Warm up, so that static entities have settled
+            for (int w = 0; w < 2; ++w) {
+                surfaceArray.fastClear();
+                scene->onPose(surfaceArray);
+            }
+
+            time[cached] = chrono::nanoseconds::zero();
+            for (int frame = 0; frame < numFrames; ++frame) {
+                for (int i = 0; i < numMoving; ++i) {
+                    const shared_ptr<VisibleEntity>& entity = entityArray[order[i]];
+                    entity->setFrame(entity->frame().translation + Vector3(0.01f, 0, 0), true);
+                }
+                if (! cached) {
+                    for (const shared_ptr<VisibleEntity>& entity : entityArray) {
+                        entity->markChanged();
+                    }
+                }
+
+                Stopwatch stopwatch;
+                stopwatch.tick();
+                surfaceArray.fastClear();
+                scene->onPose(surfaceArray);
+                stopwatch.tock();
+                time[cached] += stopwatch.elapsedDuration();
+                testAssert(surfaceArray.size() == numEntities * numParts);
+            }
+        }
+
+        PRINT_MILLI(format("%5.1f%%", f * 100.0f).c_str(), "(ms/frame)", time[0] / numFrames, time[1] / numFrames);
+    }
+}
@@ -0,0 +1,120 @@
+/**
+  \file test/tShaderPreprocessCache.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+static void writeFile(const String& filename, const String& contents) {
+    FILE* file = FileSystem::fopen(filename.c_str(), "wb");
+    fwrite(contents.c_str(), 1, contents.size(), file);
+    FileSystem::fclose(file);
+}
+
+
+static String readFile(const String& filename) {
+    FILE* file = FileSystem::fopen(filename.c_str(), "rb");
+    String contents;
+    char buffer[1024];
+    for (size_t n = fread(buffer, 1, sizeof(buffer), file); n > 0; n = fread(buffer, 1, sizeof(buffer), file)) {
+        contents.append(buffer, n);
+    }
+    FileSystem::fclose(file);
+    return contents;
+}
+
+
+void testShaderPreprocessCache() {
+    printf("ShaderPreprocessCache ");
+
+    const String& directory = FilePath::concat(FileSystem::currentDirectory(), "shaderPreprocessCache-test");
+    const String& mainFile = FilePath::concat(directory, "main.pix");
+    const String& includeFile = FilePath::concat(directory, "common.glsl");
+    const String& cacheDirectory = FilePath::concat(directory, "cache");
+
+    FileSystem::createDirectory(directory);
+    writeFile(mainFile, "#include \"common.glsl\"\nvoid main() { color = f(); }\n");
+    writeFile(includeFile, "vec4 f() { return vec4(1); }\n");
+
+    ShaderPreprocessCache::Entry entry;
+    entry.dependencyArray.append(mainFile, includeFile);
+    entry.stageArray.resize(Shader::STAGE_COUNT);
+    entry.stageArray[Shader::PIXEL].filename = mainFile;
+    entry.stageArray[Shader::PIXEL].preprocessedCode = "#line 1 1\n#line 1 2\nvec4 f() { return vec4(1); }\n#line 1 1\nvoid main() { color = f(); }\n";
+    entry.stageArray[Shader::PIXEL].versionString = "#version 410\n";
+    entry.indexToFilenameTable.set(0, "G3D Inserted Code");
+    entry.indexToFilenameTable.set(1, mainFile);
+    entry.indexToFilenameTable.set(2, includeFile);
+
+    const String key = "PIXEL file\nmain.pix\n#define LIGHTS 2\n";
+    {
+        const shared_ptr<ShaderPreprocessCache>& cache = ShaderPreprocessCache::create(cacheDirectory);
+        cache->clear();
+
+        ShaderPreprocessCache::Entry result;
+        const bool found = cache->get(key, result);
+        testAssert(! found);
+        const bool stored = cache->set(key, entry);
+        testAssert(stored);
+    }
+
+    // Entries persist across instances, e.g., between runs of a program
+    const shared_ptr<ShaderPreprocessCache>& cache = ShaderPreprocessCache::create(cacheDirectory);
+    ShaderPreprocessCache::Entry result;
+    bool found = cache->get(key, result);
+    testAssert(found);
+    testAssert(result.stageArray.size() == Shader::STAGE_COUNT);
+    testAssert(result.stageArray[Shader::PIXEL].preprocessedCode == entry.stageArray[Shader::PIXEL].preprocessedCode);
+    testAssert(result.stageArray[Shader::PIXEL].versionString == entry.stageArray[Shader::PIXEL].versionString);
+    testAssert(result.stageArray[Shader::VERTEX].preprocessedCode.empty());
+    testAssert(result.dependencyArray.size() == 2);
+    testAssert(result.indexToFilenameTable.size() == 3);
+    testAssert(result.indexToFilenameTable[2] == includeFile);
+
+    // Other arguments are other entries
+    found = cache->get("PIXEL file\nmain.pix\n#define LIGHTS 3\n", result);
+    testAssert(! found);
+
+    // Editing a file anywhere in the include graph invalidates the entry
+    writeFile(includeFile, "vec4 f() { return vec4(0); }\n");
+    found = cache->get(key, result);
+    testAssert(! found);
+    bool stored = cache->set(key, entry);
+    found = cache->get(key, result);
+    testAssert(stored && found);
+
+    // So does deleting one
+    FileSystem::removeFile(includeFile);
+    found = cache->get(key, result);
+    stored = cache->set(key, entry);
+    testAssert(! found && ! stored);
+
+    // Truncated entries are ignored
+    writeFile(includeFile, "vec4 f() { return vec4(1); }\n");
+    stored = cache->set(key, entry);
+    testAssert(stored);
+    Array<String> entryFileArray;
+    FileSystem::getFiles(FilePath::concat(cacheDirectory, "*.g3dpp"), entryFileArray, true);
+    testAssert(entryFileArray.size() == 1);
+    const String& data = readFile(entryFileArray[0]);
+    writeFile(entryFileArray[0], data.substr(0, data.size() - 10));
+    found = cache->get(key, result);
+    testAssert(! found);
+    writeFile(entryFileArray[0], data.substr(0, 7));
+    found = cache->get(key, result);
+    testAssert(! found);
+
+    cache->clear();
+    found = cache->get(key, result);
+    testAssert(! found);
+
+    FileSystem::removeFile(FilePath::concat(cacheDirectory, "*"));
+    FileSystem::removeFile(FilePath::concat(directory, "*"));
+
+    printf("passed\n");
+}
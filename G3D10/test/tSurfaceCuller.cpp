@@ -0,0 +1,225 @@
+/**
+  \file test/tSurfaceCuller.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+namespace {
+
+/** A Surface with explicit bounds and no rendering */
+class BoundsSurface : public Surface {
+public:
+    CFrame      m_frame;
+    AABox       m_box;
+    Sphere      m_sphere;
+
+    BoundsSurface(const CFrame& frame, const AABox& box) : m_frame(frame), m_box(box) {
+        if (box.isEmpty()) {
+            m_sphere = Sphere(Point3::zero(), 1.0f);
+        } else {
+            box.getBounds(m_sphere);
+        }
+    }
+
+    virtual void getCoordinateFrame(CoordinateFrame& cframe, bool previous = false) const override {
+        cframe = m_frame;
+    }
+
+    virtual void getObjectSpaceBoundingBox(AABox& box, bool previous = false) const override {
+        box = m_box;
+    }
+
+    virtual void getObjectSpaceBoundingSphere(Sphere& sphere, bool previous = false) const override {
+        sphere = m_sphere;
+    }
+
+    virtual TransparencyType transparencyType() const override {
+        return TransparencyType::NONE;
+    }
+
+    virtual void renderWireframeHomogeneous(RenderDevice* rd, const Array<shared_ptr<Surface> >& surfaceArray, const Color4& color, bool previous) const override {}
+
+    virtual bool canBeFullyRepresentedInGBuffer(const GBuffer::Specification& specification) const override {
+        return false;
+    }
+
+    virtual void render(RenderDevice* rd, const LightingEnvironment& environment, RenderPassType passType) const override {}
+
+    virtual void setStorage(ImageStorage newStorage) override {}
+};
+
+} // anonymous namespace
+
+
+static void makeSurfaces(int num, Array<shared_ptr<Surface>>& surfaceArray) {
+    Random rnd(1234, false);
+    for (int i = 0; i < num; ++i) {
+        const CFrame& frame = CFrame::fromXYZYPRDegrees
+            (rnd.uniform(-60, 60), rnd.uniform(-60, 60), rnd.uniform(-60, 60),
+             rnd.uniform(0, 360), rnd.uniform(-90, 90), rnd.uniform(0, 360));
+
+        // Include flat boxes and a few empty ones
+        const Vector3 extent(rnd.uniform(0.1f, 5.0f), rnd.uniform(0.1f, 5.0f), rnd.uniform(0.0f, 5.0f));
+        const AABox& box = (i % 97 == 0) ? AABox() : AABox(-extent, extent * 0.5f);
+        surfaceArray.append(std::make_shared<BoundsSurface>(frame, box));
+    }
+}
+
+
+static void makeViews(int num, Array<SurfaceCuller::View>& viewArray) {
+    Random rnd(5678, false);
+    for (int v = 0; v < num; ++v) {
+        Projection projection;
+        projection.setFieldOfViewAngleDegrees(rnd.uniform(20, 90));
+        projection.setNearPlaneZ(-rnd.uniform(0.1f, 2.0f));
+        projection.setFarPlaneZ((v % 5 == 0) ? -finf() : -rnd.uniform(10, 100));
+        const CFrame& frame = CFrame::fromXYZYPRDegrees(rnd.uniform(-20, 20), 0, rnd.uniform(-20, 20), rnd.uniform(0, 360), rnd.uniform(-30, 30));
+        viewArray.append(SurfaceCuller::View(frame, projection, Rect2D::xywh(0, 0, 640, 480)));
+    }
+}
+
+
+/** The single-view test that SurfaceCuller must match */
+static void bruteForceCull(const SurfaceCuller::View& view, const Array<shared_ptr<Surface>>& surfaceArray, Array<shared_ptr<Surface>>& visible) {
+    Frustum frustum;
+    view.projection.frustum(view.viewport, frustum);
+    frustum = view.frame.toWorldSpace(frustum);
+
+    Array<Plane> clipPlanes;
+    view.projection.getClipPlanes(view.viewport, clipPlanes);
+    for (Plane& plane : clipPlanes) {
+        plane = view.frame.toWorldSpace(plane);
+    }
+
+    for (const shared_ptr<Surface>& surface : surfaceArray) {
+        CFrame frame;
+        Sphere sphere;
+        AABox box;
+        surface->getCoordinateFrame(frame);
+        surface->getObjectSpaceBoundingSphere(sphere);
+        surface->getObjectSpaceBoundingBox(box);
+
+        const bool culled = frame.toWorldSpace(sphere).culledBy(clipPlanes) ||
+            box.isEmpty() || frame.toWorldSpace(box).culledBy(frustum);
+        if (! culled) {
+            visible.append(surface);
+        }
+    }
+}
+
+
+static bool sameSurfaces(const Array<shared_ptr<Surface>>& a, const Array<shared_ptr<Surface>>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (int i = 0; i < a.size(); ++i) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void testSurfaceCuller() {
+    printf("SurfaceCuller ");
+
+    Array<shared_ptr<Surface>> surfaceArray;
+    makeSurfaces(5003, surfaceArray);
+
+    // More views than fit in one pass
+    Array<SurfaceCuller::View> viewArray;
+    makeViews(SurfaceCuller::MAX_VIEWS_PER_PASS + 5, viewArray);
+
+    SurfaceCuller culler;
+    culler.setSurfaces(surfaceArray);
+    testAssert(culler.size() == surfaceArray.size());
+
+    Array<Array<shared_ptr<Surface>>> visibleArray;
+    culler.cull(viewArray, visibleArray);
+    testAssert(visibleArray.size() == viewArray.size());
+
+    for (int v = 0; v < viewArray.size(); ++v) {
+        Array<shared_ptr<Surface>> expected;
+        bruteForceCull(viewArray[v], surfaceArray, expected);
+
+        // Same surfaces in the same order
+        testAssert(sameSurfaces(visibleArray[v], expected));
+
+        Array<shared_ptr<Surface>> single;
+        culler.cull(viewArray[v], single, true);
+        testAssert(sameSurfaces(single, expected));
+    }
+
+    // Surface::cull is built on SurfaceCuller, in both forms
+    {
+        const SurfaceCuller::View& view = viewArray[1];
+        Array<shared_ptr<Surface>> expected;
+        bruteForceCull(view, surfaceArray, expected);
+
+        Array<shared_ptr<Surface>> visible;
+        Surface::cull(view.frame, view.projection, view.viewport, surfaceArray, visible);
+        testAssert(sameSurfaces(visible, expected));
+
+        Array<shared_ptr<Surface>> inPlace(surfaceArray);
+        Surface::cull(view.frame, view.projection, view.viewport, inPlace);
+        testAssert(sameSurfaces(inPlace, expected));
+    }
+
+    printf("passed\n");
+}
+
+
+void perfSurfaceCuller() {
+    PRINT_SECTION("Performance: SurfaceCuller", "Frustum culling 100k surfaces");
+
+    Array<shared_ptr<Surface>> surfaceArray;
+    makeSurfaces(100000, surfaceArray);
+
+    Array<SurfaceCuller::View> viewArray;
+    makeViews(4, viewArray);
+
+    Stopwatch stopwatch;
+    PRINT_TEXT("", "1 view", "4 views");
+
+    // Surface::cull once per view, as Light::renderShadowMaps used to
+    chrono::nanoseconds perView[2];
+    for (int c = 0; c < 2; ++c) {
+        const int numViews = (c == 0) ? 1 : 4;
+        Array<shared_ptr<Surface>> visible;
+        stopwatch.tick();
+        for (int v = 0; v < numViews; ++v) {
+            visible.fastClear();
+            bruteForceCull(viewArray[v], surfaceArray, visible);
+        }
+        stopwatch.tock();
+        perView[c] = stopwatch.elapsedDuration();
+    }
+    PRINT_MILLI("Scalar, one view at a time", "(ms)", perView[0], perView[1]);
+
+    for (int threads = 0; threads < 2; ++threads) {
+        const bool singleThread = (threads == 0);
+        chrono::nanoseconds elapsed[2];
+        for (int c = 0; c < 2; ++c) {
+            Array<SurfaceCuller::View> passArray;
+            for (int v = 0; v < ((c == 0) ? 1 : 4); ++v) {
+                passArray.append(viewArray[v]);
+            }
+
+            Array<Array<shared_ptr<Surface>>> visibleArray;
+            stopwatch.tick();
+            SurfaceCuller culler;
+            culler.setSurfaces(surfaceArray);
+            culler.cull(passArray, visibleArray, singleThread);
+            stopwatch.tock();
+            elapsed[c] = stopwatch.elapsedDuration();
+        }
+        PRINT_MILLI(singleThread ? "SurfaceCuller (1 thread)" : "SurfaceCuller (parallel)", "(ms)", elapsed[0], elapsed[1]);
+    }
+}
@@ -55,6 +55,122 @@ void perfTextOutput() {
         PRINT_MICRO("format", "(us)", tf / (k * N));
         PRINT_MICRO("TextOutput::printf", "(us)", tt / (k * N));
     }
+
+    // Number conversion
+    {
+        const int N = 100000;
+        Array<double> value;
+        Random rnd(3, false);
+        for (int i = 0; i < N; ++i) {
+            value.append(float(rnd.uniform(-100.0f, 100.0f)));
+        }
+
+        Stopwatch stopwatch;
+        char buf[SHORTEST_NUMBER_BUFFER_SIZE];
+        Array<String> text;
+        text.resize(N);
+
+        stopwatch.tick();
+        for (int i = 0; i < N; ++i) {
+            sprintf(buf, "%g", value[i]);
+        }
+        stopwatch.tock();
+        const chrono::nanoseconds printfTime = stopwatch.elapsedDuration();
+
+        stopwatch.tick();
+        for (int i = 0; i < N; ++i) {
+            sprintf(buf, "%.9g", value[i]);
+        }
+        stopwatch.tock();
+        const chrono::nanoseconds printf9Time = stopwatch.elapsedDuration();
+
+        for (int i = 0; i < N; ++i) {
+            formatShortest(float(value[i]), buf);
+            text[i] = buf;
+        }
+
+        stopwatch.tick();
+        for (int i = 0; i < N; ++i) {
+            formatShortest(float(value[i]), buf);
+        }
+        stopwatch.tock();
+        const chrono::nanoseconds shortestTime = stopwatch.elapsedDuration();
+
+        double x = 0;
+        stopwatch.tick();
+        for (int i = 0; i < N; ++i) {
+            sscanf(text[i].c_str(), "%lg", &x);
+        }
+        stopwatch.tock();
+        const chrono::nanoseconds scanfTime = stopwatch.elapsedDuration();
+
+        stopwatch.tick();
+        for (int i = 0; i < N; ++i) {
+            x = strtod(text[i].c_str(), nullptr);
+        }
+        stopwatch.tock();
+        const chrono::nanoseconds strtodTime = stopwatch.elapsedDuration();
+
+        stopwatch.tick();
+        for (int i = 0; i < N; ++i) {
+            parseDouble(text[i].c_str(), text[i].c_str() + text[i].length(), x);
+        }
+        stopwatch.tock();
+        const chrono::nanoseconds parseTime = stopwatch.elapsedDuration();
+
+        PRINT_HEADER("Formatting a float (not round trip)");
+        PRINT_NANO("sprintf(\"%g\")", "(ns)", printfTime / N);
+        PRINT_HEADER("Formatting a float (round trip)");
+        PRINT_NANO("sprintf(\"%.9g\")", "(ns)", printf9Time / N);
+        PRINT_NANO("formatShortest", "(ns)", shortestTime / N);
+        PRINT_HEADER("Parsing a double");
+        PRINT_NANO("sscanf(\"%lg\")", "(ns)", scanfTime / N);
+        PRINT_NANO("strtod", "(ns)", strtodTime / N);
+        PRINT_NANO("parseDouble", "(ns)", parseTime / N);
+    }
+
+    // Text serialization of a large Any, as for scene and model files
+    {
+        Array<Vector3> position;
+        Any vertices(Any::ARRAY);
+        Random rnd(4, false);
+        for (int i = 0; i < 30000; ++i) {
+            position.append(Vector3(rnd.uniform(-100, 100), rnd.uniform(-100, 100), rnd.uniform(-1, 1)));
+            vertices.append(position.last());
+        }
+
+        Stopwatch stopwatch;
+        stopwatch.tick();
+        const String& src = vertices.unparse();
+        stopwatch.tock();
+        const chrono::nanoseconds unparseTime = stopwatch.elapsedDuration();
+
+        stopwatch.tick();
+        const Any& parsed = Any::parse(src);
+        stopwatch.tock();
+        const chrono::nanoseconds parseTime = stopwatch.elapsedDuration();
+        testAssert(parsed.size() == vertices.size());
+
+        // Equivalent OBJ vertex data
+        TextOutput obj;
+        for (const Vector3& v : position) {
+            obj.printf("v %g %g %g\n", v.x, v.y, v.z);
+        }
+        obj.printf("f 1 2 3\n");
+        String objSrc;
+        obj.commitString(objSrc);
+
+        ParseOBJ parser;
+        stopwatch.tick();
+        parser.parse(objSrc.c_str(), objSrc.length(), "", ParseOBJ::Options());
+        stopwatch.tock();
+        const chrono::nanoseconds objTime = stopwatch.elapsedDuration();
+
+        PRINT_HEADER("30k Vector3 as text");
+        PRINT_MILLI("Any::unparse", "(ms)", unparseTime);
+        PRINT_MILLI("Any::parse", "(ms)", parseTime);
+        PRINT_MILLI("ParseOBJ::parse", "(ms)", objTime);
+    }
 }
 
 
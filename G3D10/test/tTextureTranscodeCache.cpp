@@ -0,0 +1,263 @@
+/**
+  \file test/tTextureTranscodeCache.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+static String readFile(const String& filename) {
+    FILE* file = FileSystem::fopen(filename.c_str(), "rb");
+    String contents;
+    char buffer[1024];
+    for (size_t n = fread(buffer, 1, sizeof(buffer), file); n > 0; n = fread(buffer, 1, sizeof(buffer), file)) {
+        contents.append(buffer, n);
+    }
+    FileSystem::fclose(file);
+    return contents;
+}
+
+
+static void writeFile(const String& filename, const String& contents) {
+    FILE* file = FileSystem::fopen(filename.c_str(), "wb");
+    fwrite(contents.c_str(), 1, contents.size(), file);
+    FileSystem::fclose(file);
+}
+
+
+static shared_ptr<PixelTransferBuffer> randomBuffer(int width, int height, const ImageFormat* format, Random& rnd) {
+    const shared_ptr<CPUPixelTransferBuffer>& ptb = CPUPixelTransferBuffer::create(width, height, format);
+    uint8* byte = (uint8*)ptb->mapWrite();
+    for (size_t i = 0; i < ptb->size(); ++i) {
+        byte[i] = uint8(rnd.bits());
+    }
+    ptb->unmap();
+    return ptb;
+}
+
+
+static bool sameBytes(const shared_ptr<PixelTransferBuffer>& a, const shared_ptr<PixelTransferBuffer>& b) {
+    const bool same = (a->width() == b->width()) && (a->height() == b->height()) && (a->depth() == b->depth()) &&
+        (a->format() == b->format()) && (a->size() == b->size()) && (memcmp(a->mapRead(), b->mapRead(), a->size()) == 0);
+    a->unmap();
+    b->unmap();
+    return same;
+}
+
+
+/** A MIP chain with \a numFaces faces, from width x height down to 1 x 1 */
+static TextureTranscodeCache::Entry mipChainEntry(int width, int height, int numFaces, Random& rnd) {
+    TextureTranscodeCache::Entry entry;
+    entry.encodingFormat    = ImageFormat::SRGB8();
+    entry.readMultiplyFirst = Color4(2, 2, 2, 1);
+    entry.readAddSecond     = Color4(-1, -1, -1, 0);
+    entry.min               = Color4(0.1f, 0.2f, 0.3f, 1.0f);
+    entry.max               = Color4(0.9f, 0.8f, 0.7f, 1.0f);
+    entry.mean              = Color4(0.5f, 0.5f, 0.5f, 1.0f);
+    entry.detectedHint      = AlphaFilter::ONE;
+    while (true) {
+        Array<shared_ptr<PixelTransferBuffer>>& faceArray = entry.mipArray.next();
+        for (int f = 0; f < numFaces; ++f) {
+            faceArray.append(randomBuffer(width, height, ImageFormat::RGB8(), rnd));
+        }
+        if ((width == 1) && (height == 1)) {
+            break;
+        }
+        width  = max(1, width / 2);
+        height = max(1, height / 2);
+    }
+    return entry;
+}
+
+
+static void testRoundTrip(const shared_ptr<TextureTranscodeCache>& cache, const String& key, const TextureTranscodeCache::Entry& entry) {
+    bool stored = cache->set(key, entry);
+    testAssert(stored);
+
+    TextureTranscodeCache::Entry result;
+    bool found = cache->get(key, result);
+    testAssert(found);
+    testAssert(result.encodingFormat == entry.encodingFormat);
+    testAssert(result.readMultiplyFirst == entry.readMultiplyFirst);
+    testAssert(result.readAddSecond == entry.readAddSecond);
+    testAssert(result.min == entry.min);
+    testAssert(result.max == entry.max);
+    testAssert(result.mean == entry.mean);
+    testAssert(result.detectedHint == entry.detectedHint);
+    testAssert(result.mipArray.size() == entry.mipArray.size());
+    for (int level = 0; level < entry.mipArray.size(); ++level) {
+        testAssert(result.mipArray[level].size() == entry.mipArray[level].size());
+        for (int f = 0; f < entry.mipArray[level].size(); ++f) {
+            testAssert(sameBytes(result.mipArray[level][f], entry.mipArray[level][f]));
+        }
+    }
+}
+
+
+void testTextureTranscodeCache() {
+    printf("TextureTranscodeCache ");
+
+    const String& directory = FilePath::concat(FileSystem::currentDirectory(), "textureTranscodeCache-test");
+    FileSystem::createDirectory(directory);
+    Random rnd(1010, false);
+
+    // Content hashes
+    const String& sourceFile = FilePath::concat(directory, "source.bin");
+    const String& contents = "not really an image";
+    writeFile(sourceFile, contents);
+    uint64 hash = 0;
+    bool hashed = TextureTranscodeCache::hashFile(sourceFile, hash);
+    testAssert(hashed && (hash == TextureTranscodeCache::hashBytes(contents.c_str(), contents.size())));
+    testAssert(hash != TextureTranscodeCache::hashBytes("not really an imagf", contents.size()));
+    hashed = TextureTranscodeCache::hashFile(FilePath::concat(directory, "missing.bin"), hash);
+    testAssert(! hashed);
+
+    const String& cacheDirectory = FilePath::concat(directory, "cache");
+    const TextureTranscodeCache::Entry& entry2D = mipChainEntry(37, 20, 1, rnd);
+    const TextureTranscodeCache::Entry& entryCube = mipChainEntry(16, 16, 6, rnd);
+    const String key2D   = "0123456789abcdef 0 1 1\nTexture::Preprocess{ }";
+    const String keyCube = "0123456789abcdef 4 1 1\nTexture::Preprocess{ }";
+    {
+        const shared_ptr<TextureTranscodeCache>& cache = TextureTranscodeCache::create(cacheDirectory);
+        cache->clear();
+
+        TextureTranscodeCache::Entry result;
+        const bool found = cache->get(key2D, result);
+        testAssert(! found);
+        testRoundTrip(cache, key2D, entry2D);
+    }
+
+    // Entries persist across instances, e.g., between runs of a program
+    const shared_ptr<TextureTranscodeCache>& cache = TextureTranscodeCache::create(cacheDirectory);
+    TextureTranscodeCache::Entry result;
+    bool found = cache->get(key2D, result);
+    testAssert(found);
+    testRoundTrip(cache, keyCube, entryCube);
+
+    // Other keys are other entries
+    found = cache->get(key2D + " ", result);
+    testAssert(! found);
+
+    // Every level starts on a 64-byte boundary, so that entries can be mapped
+    Array<String> entryFileArray;
+    FileSystem::getFiles(FilePath::concat(cacheDirectory, "*.g3dtc"), entryFileArray, true);
+    testAssert(entryFileArray.size() == 2);
+    const String& data = readFile(entryFileArray[0]);
+    const String& data2 = readFile(entryFileArray[1]);
+    const String& data2D = (data.size() < data2.size()) ? data : data2;
+    for (const Array<shared_ptr<PixelTransferBuffer>>& faceArray : entry2D.mipArray) {
+        const shared_ptr<PixelTransferBuffer>& ptb = faceArray[0];
+        const size_t offset = data2D.find(String((const char*)ptb->mapRead(), ptb->size()));
+        ptb->unmap();
+        testAssert((offset != String::npos) && (offset % 64 == 0));
+    }
+
+    // Malformed entries are rejected
+    TextureTranscodeCache::Entry mixed = mipChainEntry(4, 4, 1, rnd);
+    mixed.mipArray[1][0] = randomBuffer(2, 2, ImageFormat::RGBA8(), rnd);
+    bool stored = cache->set("mixed", mixed);
+    testAssert(! stored);
+    TextureTranscodeCache::Entry empty;
+    stored = cache->set("empty", empty);
+    testAssert(! stored);
+
+    // Truncated entries are ignored
+    const String& entryFile = (data.size() < data2.size()) ? entryFileArray[0] : entryFileArray[1];
+    writeFile(entryFile, data2D.substr(0, data2D.size() - 10));
+    found = cache->get(key2D, result);
+    testAssert(! found);
+    writeFile(entryFile, data2D.substr(0, 100));
+    found = cache->get(key2D, result);
+    testAssert(! found);
+    writeFile(entryFile, data2D.substr(0, 7));
+    found = cache->get(key2D, result);
+    testAssert(! found);
+
+    cache->clear();
+    found = cache->get(keyCube, result);
+    testAssert(! found);
+
+    FileSystem::removeFile(FilePath::concat(cacheDirectory, "*"));
+    FileSystem::removeFile(FilePath::concat(directory, "*"));
+
+    printf("passed\n");
+}
+
+
+void perfTextureTranscodeCache() {
+    PRINT_SECTION("Performance: TextureTranscodeCache", "Loading a 2048 x 2048 PNG with a MIP chain, without a GPU");
+
+    const String& directory = FilePath::concat(FileSystem::currentDirectory(), "textureTranscodeCache-perf");
+    FileSystem::createDirectory(directory);
+    const String& sourceFile = FilePath::concat(directory, "source.png");
+    const String& cacheDirectory = FilePath::concat(directory, "cache");
+
+    // Smooth color with some noise, which compresses like a typical texture
+    {
+        const int size = 2048;
+        Random rnd(2020, false);
+        const shared_ptr<Image>& image = Image::create(size, size, ImageFormat::RGB8());
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                const float n = rnd.uniform(-0.05f, 0.05f);
+                image->set(Point2int32(x, y), Color3(float(x) / size + n, float(y) / size + n, 0.5f + n));
+            }
+        }
+        image->save(sourceFile);
+    }
+
+    const shared_ptr<TextureTranscodeCache>& cache = TextureTranscodeCache::create(cacheDirectory);
+    cache->clear();
+
+    ImageResampler::Specification specification;
+    specification.filter = ImageResampler::Filter::BOX;
+    specification.sRGB = true;
+    specification.alphaWeighted = false;
+
+    const int numTrials = 3;
+    chrono::nanoseconds decodeTime = chrono::nanoseconds::zero(), hashTime = chrono::nanoseconds::zero(), readTime = chrono::nanoseconds::zero();
+    for (int trial = 0; trial < numTrials; ++trial) {
+        // What Texture::completeCPULoading does without a cache entry
+        Stopwatch stopwatch;
+        stopwatch.tick();
+        Array<shared_ptr<Image>> mipArray;
+        ImageResampler::generateMipMaps(Image::fromFile(sourceFile), mipArray, specification);
+        TextureTranscodeCache::Entry entry;
+        entry.encodingFormat = ImageFormat::SRGB8();
+        for (const shared_ptr<Image>& level : mipArray) {
+            entry.mipArray.next().append(level->toPixelTransferBuffer());
+        }
+        stopwatch.tock();
+        decodeTime += stopwatch.elapsedDuration();
+
+        // ...and with one
+        stopwatch.tick();
+        uint64 hash = 0;
+        TextureTranscodeCache::hashFile(sourceFile, hash);
+        stopwatch.tock();
+        hashTime += stopwatch.elapsedDuration();
+
+        const String& key = format("%016llx", (unsigned long long)hash);
+        cache->set(key, entry);
+
+        stopwatch.tick();
+        TextureTranscodeCache::Entry result;
+        const bool found = cache->get(key, result);
+        stopwatch.tock();
+        readTime += stopwatch.elapsedDuration();
+        testAssert(found && (result.mipArray.size() == entry.mipArray.size()));
+    }
+
+    PRINT_TEXT("", "Time");
+    PRINT_MILLI("Decode and MIP map", "(ms)", decodeTime / numTrials);
+    PRINT_MILLI("Hash source file", "(ms)", hashTime / numTrials);
+    PRINT_MILLI("Read cache entry", "(ms)", readTime / numTrials);
+
+    cache->clear();
+    FileSystem::removeFile(FilePath::concat(cacheDirectory, "*"));
+    FileSystem::removeFile(FilePath::concat(directory, "*"));
+}
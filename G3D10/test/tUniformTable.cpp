@@ -0,0 +1,173 @@
+/**
+  \file test/tUniformTable.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+/** Macros like those that UniversalSurface sets for one draw call. \a variant selects among 2^6 variants. */
+static void setTypicalMacros(UniformTable& args, int variant) {
+    args.setPreamble("#extension GL_ARB_bindless_texture : enable\n#define G3D_DEFERRED 1\n");
+    args.setMacro("HAS_ALPHA", (variant & 1) != 0);
+    args.setMacro("ALPHA_HINT", 3);
+    args.setMacro("HAS_VERTEX_COLOR", (variant & 2) != 0);
+    args.setMacro("HAS_BONES", (variant & 4) != 0);
+    args.setMacro("HAS_TEXTURE_COORD_1", false);
+    args.setMacro("NUM_LIGHTS", (variant >> 3) & 3);
+    args.setMacro("USE_PARALLAX_MAPPING", (variant & 32) != 0);
+    args.setMacro("NORMALBUMPMAP", 1);
+    args.setMacro("PARALLAXSTEPS", 0);
+    args.setMacro("INFER_AMBIENT_OCCLUSION_AT_TRANSPARENT_PIXELS", false);
+    args.setMacro("HAS_EMISSIVE", true);
+    args.setMacro("LAMBERTIAN_LAYER_FORMAT", "vec3");
+}
+
+
+void testUniformTable() {
+    printf("UniformTable ");
+
+    // Order of macros does not matter
+    {
+        UniformTable a, b;
+        a.setMacro("A", 1);
+        a.setMacro("B", "x");
+        b.setMacro("B", "x");
+        b.setMacro("A", 1);
+        testAssert(a.variantHash() == b.variantHash());
+        testAssert(a.preambleAndMacroString() == b.preambleAndMacroString());
+
+        Array<UniformTable::MacroArgPair> macroArgArray;
+        b.getMacroArgs(macroArgArray);
+        testAssert(a.samePreambleAndMacros("", macroArgArray));
+        testAssert(! a.samePreambleAndMacros("#version 410\n", macroArgArray));
+
+        // Changing a value changes the hash, and changing it back restores it
+        const uint64 original = a.variantHash();
+        a.setMacro("A", 2);
+        testAssert(a.variantHash() != original);
+        testAssert(! a.samePreambleAndMacros("", macroArgArray));
+        a.setMacro("A", 1);
+        testAssert(a.variantHash() == original);
+        testAssert(a.samePreambleAndMacros("", macroArgArray));
+
+        // Moving characters between the name and value changes the hash
+        UniformTable c, d;
+        c.setMacro("AB", "C");
+        d.setMacro("A", "BC");
+        testAssert(c.variantHash() != d.variantHash());
+
+        // An added macro changes the hash
+        a.setMacro("C", 0);
+        testAssert(a.variantHash() != original);
+        testAssert(! a.samePreambleAndMacros("", macroArgArray));
+    }
+
+    // Appending to the preamble matches setting it all at once
+    {
+        UniformTable a, b;
+        a.setPreamble("#define X 1\n");
+        a.appendToPreamble("#define Y 2\n");
+        b.setPreamble("#define X 1\n#define Y 2\n");
+        testAssert(a.variantHash() == b.variantHash());
+        b.setPreamble("#define X 1\n");
+        testAssert(a.variantHash() != b.variantHash());
+    }
+
+    // Every typical variant has a distinct hash
+    {
+        Set<uint64> hashes;
+        for (int v = 0; v < 64; ++v) {
+            UniformTable args;
+            setTypicalMacros(args, v);
+            testAssert(! hashes.contains(args.variantHash()));
+            hashes.insert(args.variantHash());
+        }
+    }
+
+    // append() with and without a prefix maintains the hash
+    {
+        UniformTable inner, outer, expected;
+        inner.setMacro("N", 3);
+        outer.append(inner, "material_");
+        expected.setMacro("material_N", 3);
+        testAssert(outer.variantHash() == expected.variantHash());
+    }
+
+    printf("passed\n");
+}
+
+
+void perfUniformTable() {
+    PRINT_SECTION("Performance: UniformTable", "Shader variant lookup for typical UniversalSurface macros");
+
+    // Args for a sequence of draw calls that use a few variants
+    const int numVariants = 64;
+    const int numDraws = 100000;
+    Array<UniformTable> argsArray;
+    argsArray.resize(numVariants);
+    for (int v = 0; v < numVariants; ++v) {
+        setTypicalMacros(argsArray[v], v);
+    }
+
+    // The old cache, keyed on the preamble and macro string
+    Table<String, int> stringCache;
+    for (int v = 0; v < numVariants; ++v) {
+        stringCache.set(argsArray[v].preambleAndMacroString(), v);
+    }
+
+    // The new cache, keyed on the variant hash and verified against the macros
+    class Variant {
+    public:
+        String                              preamble;
+        Array<UniformTable::MacroArgPair>   macroArgArray;
+        int                                 index = 0;
+    };
+    Table<uint64, SmallArray<Variant, 1>> hashCache;
+    for (int v = 0; v < numVariants; ++v) {
+        Variant variant;
+        variant.preamble = argsArray[v].preamble();
+        argsArray[v].getMacroArgs(variant.macroArgArray);
+        variant.index = v;
+        hashCache.getCreate(argsArray[v].variantHash()).append(variant);
+    }
+
+    Random rnd(1, false);
+    Array<int> drawVariant;
+    for (int d = 0; d < numDraws; ++d) {
+        drawVariant.append(rnd.integer(0, numVariants - 1));
+    }
+
+    Stopwatch stopwatch;
+    int checksum[2] = {0, 0};
+    stopwatch.tick();
+    for (int d = 0; d < numDraws; ++d) {
+        checksum[0] += stringCache[argsArray[drawVariant[d]].preambleAndMacroString()];
+    }
+    stopwatch.tock();
+    const double stringTime = stopwatch.elapsedDuration<std::chrono::duration<double, std::nano>>().count() / numDraws;
+
+    stopwatch.tick();
+    for (int d = 0; d < numDraws; ++d) {
+        const UniformTable& args = argsArray[drawVariant[d]];
+        const SmallArray<Variant, 1>& bucket = hashCache[args.variantHash()];
+        for (int i = 0; i < bucket.size(); ++i) {
+            if (args.samePreambleAndMacros(bucket[i].preamble, bucket[i].macroArgArray)) {
+                checksum[1] += bucket[i].index;
+                break;
+            }
+        }
+    }
+    stopwatch.tock();
+    const double hashTime = stopwatch.elapsedDuration<std::chrono::duration<double, std::nano>>().count() / numDraws;
+
+    testAssert(checksum[0] == checksum[1]);
+
+    PRINT_TEXT("", "ns/draw");
+    PRINT_TEXT("String key", format("%.0f", stringTime).c_str());
+    PRINT_TEXT("Hash key", format("%.0f", hashTime).c_str());
+}
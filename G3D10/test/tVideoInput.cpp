@@ -0,0 +1,115 @@
+/**
+  \file test/tVideoInput.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+#include <thread>
+
+#ifndef G3D_NO_FFMPEG
+
+/** Writes a local sample video of moving gradients, since the repository does not ship one */
+static bool writeSampleVideo(const String& filename, int width, int height, int numFrames) {
+    VideoOutput::Settings settings;
+    settings.width = width;
+    settings.height = height;
+    settings.fps = 30;
+    settings.setBitrateQuality();
+    settings.encoder = VideoOutput::Encoder::MPEG4();
+    // Keyframes every second, so that seeks have somewhere to land
+    settings.encoder.options.set("g", "30");
+
+    const shared_ptr<VideoOutput>& video = VideoOutput::create(filename, settings);
+    if (isNull(video)) {
+        return false;
+    }
+
+    const shared_ptr<CPUPixelTransferBuffer>& buffer = CPUPixelTransferBuffer::create(width, height, ImageFormat::RGB8());
+    for (int f = 0; f < numFrames; ++f) {
+        Color3unorm8* pixel = (Color3unorm8*)buffer->buffer();
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x, ++pixel) {
+                *pixel = Color3unorm8(Color3(float((x + f * 8) % width) / width, float(y) / height, float(f % 30) / 30.0f));
+            }
+        }
+        video->append(buffer);
+    }
+    video->commit();
+    return true;
+}
+
+
+/** Reads every frame of \a filename as fast as possible. Returns the number of frames. */
+static int decodeAll(const String& filename, const ImageFormat* format, chrono::nanoseconds& time) {
+    Stopwatch stopwatch;
+    stopwatch.tick();
+    const shared_ptr<VideoInput>& video = VideoInput::fromFile(filename, format);
+    int numFrames = 0;
+    while (notNull(video) && ! video->finished()) {
+        const shared_ptr<CPUPixelTransferBuffer>& frame = video->nextFrame();
+        if (notNull(frame)) {
+            ++numFrames;
+            video->recycleFrame(frame);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    stopwatch.tock();
+    time = stopwatch.elapsedDuration();
+    return numFrames;
+}
+
+
+void perfVideoInput() {
+    PRINT_SECTION("Performance: VideoInput", "Decoding a generated 1920x1080 MPEG-4 video");
+
+    const int width = 1920, height = 1080, numFrames = 150;
+    const String& filename = FilePath::concat(FileSystem::currentDirectory(), "VideoInput-perf.mp4");
+    const bool wrote = writeSampleVideo(filename, width, height, numFrames);
+    testAssertM(wrote, "Could not write the sample video");
+    if (! wrote) {
+        return;
+    }
+
+    chrono::nanoseconds rgbTime, yuvTime;
+    const int rgbFrames = decodeAll(filename, ImageFormat::RGB8(), rgbTime);
+    const int yuvFrames = decodeAll(filename, ImageFormat::YUV420_PLANAR(), yuvTime);
+    testAssert((rgbFrames == numFrames) && (yuvFrames == numFrames));
+
+    // Random access: each seek is followed by waiting for the target frame
+    const shared_ptr<VideoInput>& video = VideoInput::fromFile(filename, ImageFormat::YUV420_PLANAR());
+    const int numSeeks = 20;
+    Random rnd(1, false);
+    Stopwatch stopwatch;
+    stopwatch.tick();
+    int seeksFound = 0;
+    for (int i = 0; i < numSeeks; ++i) {
+        const bool sought = video->seek(rnd.uniform(0.0f, float(video->length()) - 0.5f));
+        shared_ptr<CPUPixelTransferBuffer> frame;
+        for (const RealTime timeout = System::time() + 5.0; sought && isNull(frame) && (System::time() < timeout); frame = video->nextFrame()) {
+            std::this_thread::yield();
+        }
+        seeksFound += notNull(frame) ? 1 : 0;
+        video->recycleFrame(frame);
+    }
+    stopwatch.tock();
+    testAssert(seeksFound == numSeeks);
+
+    PRINT_TEXT("", "Time");
+    PRINT_MILLI("Decode to RGB8", "(ms/frame)", rgbTime / max(rgbFrames, 1));
+    PRINT_MILLI("Decode to YUV420_PLANAR", "(ms/frame)", yuvTime / max(yuvFrames, 1));
+    PRINT_MILLI("Seek to a random frame", "(ms)", stopwatch.elapsedDuration() / numSeeks);
+
+    FileSystem::removeFile(filename);
+}
+
+#else
+
+void perfVideoInput() {}
+
+#endif
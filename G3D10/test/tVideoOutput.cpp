@@ -0,0 +1,100 @@
+/**
+  \file test/tVideoOutput.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+#ifndef G3D_NO_FFMPEG
+
+/** Encodes \a numFrames of \a frameArray, cycling, and returns the time spent in
+    append() and the total time through commit(). */
+static void encodeSyntheticFrames(const Array<shared_ptr<CPUPixelTransferBuffer>>& frameArray, int numFrames, VideoOutput::Settings settings, chrono::nanoseconds& appendTime, chrono::nanoseconds& totalTime, int& droppedFrames) {
+    const String& filename = FilePath::concat(FileSystem::currentDirectory(), "VideoOutput-perf.mp4");
+    settings.encoder = VideoOutput::Encoder::MPEG4();
+
+    Stopwatch total, append;
+    total.tick();
+    const shared_ptr<VideoOutput>& video = VideoOutput::create(filename, settings);
+    testAssertM(notNull(video), "Could not create an MPEG-4 encoder");
+    if (isNull(video)) {
+        return;
+    }
+
+    appendTime = chrono::nanoseconds::zero();
+    for (int i = 0; i < numFrames; ++i) {
+        append.tick();
+        video->append(frameArray[i % frameArray.size()]);
+        append.tock();
+        appendTime += append.elapsedDuration();
+    }
+    video->commit();
+    total.tock();
+    totalTime = total.elapsedDuration();
+    droppedFrames = video->droppedFrameCount();
+
+    FILE* file = FileSystem::fopen(filename.c_str(), "rb");
+    testAssertM(notNull(file), "No video file written");
+    if (isNull(file)) {
+        return;
+    }
+    fseek(file, 0, SEEK_END);
+    const long fileSize = ftell(file);
+    FileSystem::fclose(file);
+    testAssert(fileSize > 0);
+    FileSystem::removeFile(filename);
+}
+
+
+void perfVideoOutput() {
+    PRINT_SECTION("Performance: VideoOutput", "Encoding synthetic 1280x720 frames without a GPU");
+
+    const int width = 1280, height = 720, numFrames = 120;
+
+    Array<shared_ptr<CPUPixelTransferBuffer>> frameArray;
+    for (int f = 0; f < 8; ++f) {
+        const shared_ptr<CPUPixelTransferBuffer>& buffer = CPUPixelTransferBuffer::create(width, height, ImageFormat::RGB8());
+        Color3unorm8* pixel = (Color3unorm8*)buffer->buffer();
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x, ++pixel) {
+                *pixel = Color3unorm8(Color3(float((x + f * 16) % width) / width, float(y) / height, float(f) / 8.0f));
+            }
+        }
+        frameArray.append(buffer);
+    }
+
+    VideoOutput::Settings settings;
+    settings.width = width;
+    settings.height = height;
+    settings.fps = 30;
+    settings.setBitrateQuality();
+
+    chrono::nanoseconds syncAppend, syncTotal, asyncAppend, asyncTotal, dropAppend, dropTotal;
+    int ignore = 0, dropped = 0;
+
+    settings.queueLength = 0;
+    encodeSyntheticFrames(frameArray, numFrames, settings, syncAppend, syncTotal, ignore);
+
+    settings.queueLength = 4;
+    encodeSyntheticFrames(frameArray, numFrames, settings, asyncAppend, asyncTotal, ignore);
+
+    settings.dropFramesWhenBusy = true;
+    encodeSyntheticFrames(frameArray, numFrames, settings, dropAppend, dropTotal, dropped);
+
+    PRINT_TEXT("", "append()", "Total");
+    PRINT_MILLI("Synchronous", "(ms/frame)", syncAppend / numFrames, syncTotal / numFrames);
+    PRINT_MILLI("Encoder thread", "(ms/frame)", asyncAppend / numFrames, asyncTotal / numFrames);
+    PRINT_MILLI("Encoder thread, dropping", "(ms/frame)", dropAppend / numFrames, dropTotal / numFrames);
+    printf("  Frames dropped: %d of %d\n", dropped, numFrames);
+}
+
+#else
+
+void perfVideoOutput() {}
+
+#endif
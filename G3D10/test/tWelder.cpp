@@ -0,0 +1,258 @@
+/**
+  \file test/tWelder.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2020, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+#include "printhelpers.h"
+
+namespace {
+
+/** Vertex stored in the reference implementation's grid */
+class RefVertex {
+public:
+    Vector3         vertex;
+    Vector3         normal;
+    Vector2         texCoord;
+    int             index;
+
+    RefVertex() : index(0) {}
+    RefVertex(const Vector3& v, const Vector3& n, const Vector2& t, int i) : vertex(v), normal(n), texCoord(t), index(i) {}
+};
+
+} // anonymous namespace
+
+template<> struct PositionTrait<RefVertex> {
+    static void getPosition(const RefVertex& v, G3D::Vector3& p) { p = v.vertex; }
+};
+
+template<> struct HashTrait<RefVertex> {
+    static size_t hashCode(const RefVertex& k) { return static_cast<size_t>(k.vertex.hashCode()); }
+};
+
+template<> struct EqualsTrait<RefVertex> {
+    static bool equals(const RefVertex& a, const RefVertex& b) { return a.vertex == b.vertex; }
+};
+
+
+/** The original single-threaded Welder, which the parallel one must match exactly */
+static void referenceWeld
+(Array<Vector3>&           vertexArray,
+ Array<Vector2>&           texCoordArray,
+ Array<Vector3>&           normalArray,
+ Array<int>&               indexArray,
+ const Welder::Settings&   settings) {
+
+    const bool hasTexCoords = (texCoordArray.size() > 0);
+    if (! hasTexCoords) {
+        texCoordArray.resize(vertexArray.size());
+    }
+
+    Array<Vector3> position;
+    Array<Vector2> texCoord;
+    for (int i : indexArray) {
+        position.append(vertexArray[i]);
+        texCoord.append(texCoordArray[i]);
+    }
+
+    Array<Vector3> faceNormal;
+    for (int v = 0; v < position.size(); v += 3) {
+        const Vector3& n = (position[v + 1] - position[v]).cross((position[v + 2] - position[v]) * 256.0f).directionOrZero();
+        faceNormal.append(n, n, n);
+    }
+
+    const float cosThreshold = (float)cos(settings.normalSmoothingAngle);
+    Array<Vector3> smooth;
+    smooth.resize(position.size());
+    PointHashGrid<RefVertex> smoothGrid((settings.vertexWeldRadius > 0) ? settings.vertexWeldRadius : 1.0f);
+    for (int v = 0; v < position.size(); ++v) {
+        smoothGrid.insert(RefVertex(position[v], faceNormal[v], Vector2(), v));
+    }
+
+    for (int v = 0; v < position.size(); ++v) {
+        if (settings.normalSmoothingAngle <= 0) {
+            smooth[v] = faceNormal[v];
+            continue;
+        }
+
+        const Vector3& original = faceNormal[v];
+        Vector3 sum;
+        if (settings.vertexWeldRadius == 0) {
+            for (int w = 0; w < position.size(); ++w) {
+                if ((position[w] == position[v]) && (faceNormal[w].dot(original) > cosThreshold)) {
+                    sum += faceNormal[w] * 256.0f;
+                }
+            }
+        } else {
+            for (PointHashGrid<RefVertex>::SphereIterator it = smoothGrid.begin(Sphere(position[v], settings.vertexWeldRadius)); it.isValid(); ++it) {
+                if (it->normal.dot(original) > cosThreshold) {
+                    sum += it->normal * 256.0f;
+                }
+            }
+        }
+
+        const Vector3& average = sum.directionOrZero();
+        smooth[v] = (average.isZero() || (original.dot(average) < 0)) ? original : average;
+    }
+
+    vertexArray.fastClear();
+    normalArray.fastClear();
+    texCoordArray.fastClear();
+
+    PointHashGrid<RefVertex> weldGrid(max(settings.vertexWeldRadius, 0.1f));
+    for (int u = 0; u < position.size(); ++u) {
+        const Vector3& n = smooth[u];
+        const Vector2& t = texCoord[u];
+        int index = -1;
+        for (PointHashGrid<RefVertex>::SphereIterator it = weldGrid.begin(Sphere(position[u], settings.vertexWeldRadius)); it.isValid() && (index == -1); ++it) {
+            if ((n.isZero() || ((n - it->normal).squaredLength() <= square(settings.normalWeldRadius))) &&
+                ((t - it->texCoord).squaredLength() <= square(settings.textureWeldRadius))) {
+                index = it->index;
+            }
+        }
+
+        if (index == -1) {
+            index = vertexArray.size();
+            vertexArray.append(position[u]);
+            normalArray.append(n);
+            texCoordArray.append(t);
+            weldGrid.insert(RefVertex(position[u], n, t, index));
+        }
+        indexArray[u] = index;
+    }
+
+    if (! hasTexCoords) {
+        texCoordArray.resize(0);
+    }
+}
+
+
+/** A bumpy height field with an independent copy of each triangle's vertices,
+    slightly perturbed so that welding has work to do. */
+static void makeSoup(int n, float jitter, Array<Vector3>& vertexArray, Array<Vector2>& texCoordArray, Array<int>& indexArray) {
+    Random rnd(n, false);
+    const float scale = 10.0f / float(n);
+    for (int z = 0; z < n; ++z) {
+        for (int x = 0; x < n; ++x) {
+            Point3 corner[4];
+            Point2 tex[4];
+            for (int c = 0; c < 4; ++c) {
+                const int i = x + (c & 1);
+                const int j = z + (c >> 1);
+                corner[c] = Point3(float(i) * scale, sin(float(i) * 0.3f) * cos(float(j) * 0.2f), float(j) * scale);
+                // A texture seam down the middle
+                tex[c] = Point2(float(i) / float(n) + ((x < n / 2) ? 0.0f : 0.5f), float(j) / float(n));
+            }
+
+            static const int quad[6] = {0, 2, 1, 1, 2, 3};
+            for (int k = 0; k < 6; ++k) {
+                indexArray.append(vertexArray.size());
+                vertexArray.append(corner[quad[k]] + Vector3(rnd.uniform(-jitter, jitter), 0.0f, rnd.uniform(-jitter, jitter)));
+                texCoordArray.append(tex[quad[k]]);
+            }
+        }
+    }
+}
+
+
+static bool sameVectors(const Array<Vector3>& a, const Array<Vector3>& b) {
+    if (a.size() != b.size()) { return false; }
+    for (int i = 0; i < a.size(); ++i) {
+        if (a[i] != b[i]) { return false; }
+    }
+    return true;
+}
+
+
+static bool sameVectors(const Array<Vector2>& a, const Array<Vector2>& b) {
+    if (a.size() != b.size()) { return false; }
+    for (int i = 0; i < a.size(); ++i) {
+        if (a[i] != b[i]) { return false; }
+    }
+    return true;
+}
+
+
+void testWelder() {
+    printf("Welder ");
+
+    Welder::Settings settingsArray[4];
+    // Default settings
+    // Exact positions only
+    settingsArray[1].vertexWeldRadius = 0.0f;
+    // No smoothing
+    settingsArray[2].normalSmoothingAngle = 0.0f;
+    // Large radii, so that many candidates compete
+    settingsArray[3].vertexWeldRadius = 0.05f;
+    settingsArray[3].normalWeldRadius = 0.5f;
+    settingsArray[3].textureWeldRadius = 0.1f;
+
+    for (int s = 0; s < 4; ++s) {
+        for (int withTexCoords = 0; withTexCoords < 2; ++withTexCoords) {
+            Array<Vector3> vertexArray;
+            Array<Vector2> texCoordArray;
+            Array<int> indexArray;
+            makeSoup(40, (s == 1) ? 0.0f : 0.0004f, vertexArray, texCoordArray, indexArray);
+            if (withTexCoords == 0) {
+                texCoordArray.clear();
+            }
+
+            Array<Vector3> refVertexArray(vertexArray);
+            Array<Vector2> refTexCoordArray(texCoordArray);
+            Array<Vector3> refNormalArray;
+            Array<int> refIndexArray(indexArray);
+            referenceWeld(refVertexArray, refTexCoordArray, refNormalArray, refIndexArray, settingsArray[s]);
+
+            Array<Vector3> normalArray;
+            Welder::weld(vertexArray, texCoordArray, normalArray, indexArray, settingsArray[s]);
+
+            testAssert(vertexArray.size() < indexArray.size());
+            testAssert(sameVectors(vertexArray, refVertexArray));
+            testAssert(sameVectors(normalArray, refNormalArray));
+            testAssert(sameVectors(texCoordArray, refTexCoordArray));
+            testAssert(indexArray.size() == refIndexArray.size());
+            for (int i = 0; i < indexArray.size(); ++i) {
+                testAssert(indexArray[i] == refIndexArray[i]);
+            }
+        }
+    }
+
+    printf("passed\n");
+}
+
+
+void perfWelder() {
+    PRINT_SECTION("Performance: Welder", "Welding a 2M-triangle soup");
+
+    Array<Vector3> vertexArray;
+    Array<Vector2> texCoordArray;
+    Array<int> indexArray;
+    makeSoup(1000, 0.0001f, vertexArray, texCoordArray, indexArray);
+
+    const Welder::Settings settings;
+    Stopwatch stopwatch;
+    chrono::nanoseconds elapsed[2];
+    for (int i = 0; i < 2; ++i) {
+        Array<Vector3> v(vertexArray);
+        Array<Vector2> t(texCoordArray);
+        Array<Vector3> n;
+        Array<int> index(indexArray);
+
+        stopwatch.tick();
+        if (i == 0) {
+            referenceWeld(v, t, n, index, settings);
+        } else {
+            Welder::weld(v, t, n, index, settings);
+        }
+        stopwatch.tock();
+        elapsed[i] = stopwatch.elapsedDuration();
+    }
+
+    PRINT_TEXT("", "Time");
+    PRINT_MILLI("Sequential hash grid", "(ms)", elapsed[0]);
+    PRINT_MILLI("Welder::weld", "(ms)", elapsed[1]);
+}
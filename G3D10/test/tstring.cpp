@@ -70,6 +70,114 @@ void helperTestFinds(const String& s) {
 */   
 }
 
+static double parseWhole(const char* s) {
+    double x = -1.0;
+    const char* end = s + strlen(s);
+    const char* stop = parseDouble(s, end, x);
+    testAssertM(stop == end, format("parseDouble did not consume \"%s\"", s));
+    return x;
+}
+
+
+/** formatShortest, parseDouble, and parseFloat */
+static void testNumberConversion() {
+    char buffer[SHORTEST_NUMBER_BUFFER_SIZE];
+
+    // Shortest forms
+    formatShortest(0.1f, buffer);
+    testAssertM(String(buffer) == "0.1", buffer);
+    formatShortest(0.1, buffer);
+    testAssertM(String(buffer) == "0.1", buffer);
+    formatShortest(-2.5f, buffer);
+    testAssertM(String(buffer) == "-2.5", buffer);
+    formatShortest(finf(), buffer);
+    testAssertM(String(buffer) == "inf", buffer);
+    formatShortest(-inf(), buffer);
+    testAssertM(String(buffer) == "-inf", buffer);
+    formatShortest(fnan(), buffer);
+    testAssertM(String(buffer) == "nan", buffer);
+
+    // Parsing
+    testAssert(parseWhole("0") == 0.0);
+    testAssert(parseWhole("-0.0") == 0.0);
+    testAssert(parseWhole("1.5e3") == 1500.0);
+    testAssert(parseWhole("+.25") == 0.25);
+    testAssert(parseWhole("7.") == 7.0);
+    testAssert(parseWhole("0.000000000000000000000000000001") == 1e-30);
+    testAssert(parseWhole("123456789012345678901234567890") == 123456789012345678901234567890.0);
+    testAssert(parseWhole("2.2250738585072014e-308") == 2.2250738585072014e-308);
+    testAssert(parseWhole("1e400") == inf());
+    testAssert(parseWhole("-Infinity") == -inf());
+    testAssert(isNaN(parseWhole("NaN")));
+
+    {
+        // Stops at the first character that cannot continue the number
+        const char* s = "3.25e+x";
+        double x = 0;
+        testAssert(parseDouble(s, s + strlen(s), x) == s + 4);
+        testAssert(x == 3.25);
+
+        // Respects the end pointer
+        testAssert(parseDouble(s, s + 2, x) == s + 2);
+        testAssert(x == 3.0);
+
+        // No number
+        x = 5.0;
+        s = "-.e";
+        testAssert(parseDouble(s, s + strlen(s), x) == s);
+        testAssert(x == 5.0);
+    }
+
+    {
+        // Values exactly halfway between two floats must round to even
+        float f = 0;
+        const char* s = "16777217";
+        parseFloat(s, s + strlen(s), f);
+        testAssert(f == 16777216.0f);
+        s = "16777219";
+        parseFloat(s, s + strlen(s), f);
+        testAssert(f == 16777220.0f);
+        s = "16777217.000001";
+        parseFloat(s, s + strlen(s), f);
+        testAssert(f == 16777218.0f);
+    }
+
+    // Random round trips, against the C library
+    Random rnd(10, false);
+    for (int i = 0; i < 20000; ++i) {
+        uint32 fbits = rnd.bits();
+        float f;
+        memcpy(&f, &fbits, sizeof(f));
+        if (isFinite(f)) {
+            const int len = formatShortest(f, buffer);
+            float g = 0;
+            testAssertM(parseFloat(buffer, buffer + len, g) == buffer + len, buffer);
+            testAssertM(g == f, buffer);
+            testAssert(g == strtof(buffer, nullptr));
+        }
+
+        const uint64 dbits = (uint64(rnd.bits()) << 32) | rnd.bits();
+        double d;
+        memcpy(&d, &dbits, sizeof(d));
+        if (isFinite(d)) {
+            const int len = formatShortest(d, buffer);
+            double e = 0;
+            testAssertM(parseDouble(buffer, buffer + len, e) == buffer + len, buffer);
+            testAssertM(e == d, buffer);
+        }
+
+        // Typical short decimals, which take the fast path
+        const String& s = format("%.*f", rnd.integer(0, 7), rnd.uniform(-1000.0f, 1000.0f));
+        double x = 0;
+        parseDouble(s.c_str(), s.c_str() + s.length(), x);
+        testAssertM(x == strtod(s.c_str(), nullptr), s);
+        float y = 0;
+        parseFloat(s.c_str(), s.c_str() + s.length(), y);
+        testAssertM(y == strtof(s.c_str(), nullptr), s);
+    }
+}
+
+
 /** Testing functions here(http://www.cplusplus.com/reference/string/string/). Doesn't include C++11 functionality, iterator tests, relational operators, stream operators, get_allocator, or getline */
 void teststring() {
     
@@ -315,6 +423,8 @@ void teststring() {
         testAssertM(tree.output == "-Glossy \n -Box\n -Box \n  -Mirror\n  -Water\n", "G3D::buildPrefixTree is broken");
     }
 
+    testNumberConversion();
+
     printf(" passed\n");
 }
 